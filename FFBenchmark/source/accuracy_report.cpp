@@ -0,0 +1,113 @@
+﻿#include "accuracy_report.h"
+#include "FFSimulation.h"
+#include "FFSolverCPU.h"
+#include "Basic/FFTelemetry.h"
+#include "Circuit/FFCircuit.h"
+#include <math.h>
+#include <algorithm>
+
+using namespace FFFDTD;
+
+
+
+// コンストラクタ
+AccuracyReport::AccuracyReport(void)
+	: m_Threads(1)
+{
+
+}
+
+// 全精度でシーンを計算し、単精度に対する誤差をCSVに書き出す
+void AccuracyReport::run(const SceneGenerator &generator, FILE *csv) const{
+	static const Precision PRECISION_LIST[] = {
+		Precision::Single, Precision::Double, Precision::Half, Precision::BFloat16,
+	};
+	static const char *SIGNAL_NAMES[2] = { "voltage", "current" };
+
+	fputs("precision,port,signal,rel_l2,rel_l2_db,rel_max,run_s,speedup,bytes_per_step\n", csv);
+	fflush(csv);
+
+	// 単精度の結果を基準とする
+	Result_t reference = simulate(generator, Precision::Single);
+	for (Precision precision : PRECISION_LIST){
+		Result_t result = (precision == Precision::Single) ? reference : simulate(generator, precision);
+		double speedup = (0.0 < result.run_time) ? (reference.run_time / result.run_time) : 0.0;
+		printf("  %s : %.3f s (x%.2f), %.1f MiB/step\n",
+			getPrecisionName(precision), result.run_time, speedup, result.bytes_per_step / (1024.0 * 1024.0));
+
+		// ポート・レーンごとに電圧と電流の誤差を求める (作成したシーンは1レーンのため、ポート番号と一致する)
+		for (size_t port = 0; port < result.voltage_list.size(); port++){
+			for (int signal = 0; signal < 2; signal++){
+				const std::vector<double> &value = (signal == 0) ? result.voltage_list[port] : result.current_list[port];
+				const std::vector<double> &ref = (signal == 0) ? reference.voltage_list[port] : reference.current_list[port];
+				Error_t error = calcError(value, ref);
+				double rel_l2_db = (0.0 < error.rel_l2) ? (20.0 * log10(error.rel_l2)) : -HUGE_VAL;
+				printf("    port %u %-8s rel L2 %.3e (%.1f dB), max %.3e\n",
+					(unsigned int)port, SIGNAL_NAMES[signal], error.rel_l2, rel_l2_db, error.rel_max);
+				fprintf(csv, "%s,%u,%s,%.6e,%.3f,%.6e,%.6f,%.4f,%llu\n",
+					getPrecisionName(precision), (unsigned int)port, SIGNAL_NAMES[signal],
+					error.rel_l2, rel_l2_db, error.rel_max, result.run_time, speedup,
+					(unsigned long long)result.bytes_per_step);
+			}
+		}
+		fflush(stdout);
+		fflush(csv);
+	}
+}
+
+// 指定した精度でシーンを計算する
+// 全ポートが自プロセスに属するように1プロセスで計算する
+AccuracyReport::Result_t AccuracyReport::simulate(const SceneGenerator &generator, Precision precision) const{
+	SceneGenerator precision_generator = generator;
+	precision_generator.setPrecision(precision);
+	FFScene scene;
+	precision_generator.generate(scene);
+
+	Result_t result;
+	result.precision = precision;
+	FFSolver *solver = FFSolverCPU::createSolver(m_Threads);
+	try{
+		std::vector<FFSolver*> solver_list(1, solver);
+		std::vector<uint64_t> speed_list(1, 1);
+		FFSimulation simulation(solver_list, speed_list, MPI_COMM_SELF);
+		simulation.setup(scene);
+		result.bytes_per_step = solver->estimateBytesPerStep();
+
+		double run_start = FFTelemetry::now();
+		simulation.run();
+		result.run_time = FFTelemetry::now() - run_start;
+
+		// ポート・レーンごとの履歴をコピーする
+		for (size_t i = 0; i < simulation.getNumberOfPorts(); i++){
+			const FFCircuit *circuit = simulation.getPortCircuit((oindex_t)i);
+			for (index_t lane = 0; lane < circuit->lanes(); lane++){
+				result.voltage_list.push_back(circuit->getVoltageHistory(lane));
+				result.current_list.push_back(circuit->getCurrentHistory(lane));
+			}
+		}
+	}
+	catch (...){
+		delete solver;
+		throw;
+	}
+	delete solver;
+	return result;
+}
+
+// 波形の誤差を求める
+AccuracyReport::Error_t AccuracyReport::calcError(const std::vector<double> &value, const std::vector<double> &reference){
+	double diff_sum = 0.0, ref_sum = 0.0, diff_max = 0.0, ref_max = 0.0;
+	size_t count = std::min(value.size(), reference.size());
+	for (size_t n = 0; n < count; n++){
+		double diff = value[n] - reference[n];
+		diff_sum += diff * diff;
+		ref_sum += reference[n] * reference[n];
+		diff_max = std::max(diff_max, fabs(diff));
+		ref_max = std::max(ref_max, fabs(reference[n]));
+	}
+
+	Error_t error;
+	error.rel_l2 = (0.0 < ref_sum) ? sqrt(diff_sum / ref_sum) : sqrt(diff_sum);
+	error.rel_max = (0.0 < ref_max) ? (diff_max / ref_max) : diff_max;
+	return error;
+}
@@ -0,0 +1,57 @@
+﻿#pragma once
+
+#include "scene_generator.h"
+#include <stdio.h>
+#include <vector>
+
+
+
+// 電磁界成分の精度ごとにシーンを計算し、ポートの波形を単精度の結果と比較するクラス
+// 半精度やbfloat16で格納したときの誤差を、同じシーンの単精度の結果に対する相対誤差として報告する
+class AccuracyReport{
+	/*** 定義 ***/
+private:
+	// 1精度の計算結果
+	struct Result_t{
+		FFFDTD::Precision precision;						// 精度
+		std::vector<std::vector<double>> voltage_list;		// ポート・レーンごとの電圧の履歴
+		std::vector<std::vector<double>> current_list;		// ポート・レーンごとの電流の履歴
+		double run_time;									// 全ステップの計算時間[s]
+		uint64_t bytes_per_step;							// 1ステップの推定転送量[byte]
+	};
+
+	// 1波形の誤差
+	struct Error_t{
+		double rel_l2;		// 基準の波形に対する相対L2誤差
+		double rel_max;		// 基準の波形の最大振幅に対する最大誤差
+	};
+
+
+
+	/*** メンバー変数 ***/
+private:
+	// スレッド数
+	int m_Threads;
+
+
+
+	/*** メソッド ***/
+public:
+	// コンストラクタ
+	AccuracyReport(void);
+
+	// スレッド数を設定する
+	void setThreads(int threads){
+		m_Threads = threads;
+	}
+
+	// 全精度でシーンを計算し、単精度に対する誤差をCSVに書き出す
+	void run(const SceneGenerator &generator, FILE *csv) const;
+
+private:
+	// 指定した精度でシーンを計算する
+	Result_t simulate(const SceneGenerator &generator, FFFDTD::Precision precision) const;
+
+	// 波形の誤差を求める
+	static Error_t calcError(const std::vector<double> &value, const std::vector<double> &reference);
+};
@@ -0,0 +1,412 @@
+﻿#include "kernel_benchmark.h"
+#include "Basic/FFTelemetry.h"
+#include "Circuit/FFVoltageSourceComponent.h"
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+#include <type_traits>
+
+using namespace FFFDTD;
+
+
+
+// 浮動小数点数の2値のULP差を求める
+// 符号ビットで並びを反転させた整数の差とし、どちらかがNaNのときはビット列が一致しなければ最大値とする
+template<typename T>
+static uint64_t calcULPDistance(T a, T b){
+	using U = typename std::conditional<sizeof(T) == 2, uint16_t,
+		typename std::conditional<sizeof(T) == 4, uint32_t, uint64_t>::type>::type;
+	const U SIGN = (U)1 << (sizeof(T) * 8 - 1);
+	U ua, ub;
+	memcpy(&ua, &a, sizeof(T));
+	memcpy(&ub, &b, sizeof(T));
+	if ((a != a) || (b != b)){
+		return (ua == ub) ? 0 : UINT64_MAX;
+	}
+	ua = (ua & SIGN) ? ~ua : (ua | SIGN);
+	ub = (ub & SIGN) ? ~ub : (ub | SIGN);
+	return (ua < ub) ? (uint64_t)(ub - ua) : (uint64_t)(ua - ub);
+}
+
+
+
+// コンストラクタ
+KernelBenchmark::KernelBenchmark(void)
+	: m_Variant(FFSolverCPU::KERNEL_REFERENCE)
+	, m_Threads(1)
+	, m_Lanes(1)
+	, m_MaxWorkingSet((uint64_t)1024 * 1024 * 1024)
+	, m_MinTime(0.1)
+	, m_ToleranceULP(0)
+	, m_Precision(DEFAULT_PRECISION)
+{
+
+}
+
+// 全サイズ・全カーネルを計測してCSVに書き出す
+bool KernelBenchmark::run(FILE *csv){
+	const char *variant_name = FFSolverCPU::getKernelVariantName(m_Variant);
+	const char *precision_name = getPrecisionName(m_Precision);
+	const bool cross_check = (m_Variant != FFSolverCPU::KERNEL_REFERENCE);
+	const uint64_t bytes_per_cell = calcBytesPerCell();
+	bool passed = true;
+
+	fputs("variant,precision,lanes,threads,kernel,size,working_set_bytes,elements,calls,time_s,elements_per_s,bandwidth_bytes_per_s,max_ulp\n", csv);
+	fflush(csv);
+
+	// 作業領域を8倍ずつ大きくしながら計測する
+	for (uint64_t working_set = MIN_WORKING_SET; working_set <= m_MaxWorkingSet; working_set *= 8){
+		index_t size = std::max<index_t>(4, (index_t)cbrt((double)working_set / bytes_per_cell) - 1);
+		uint64_t actual_working_set = bytes_per_cell * (uint64_t)(size + 1) * (size + 1) * (size + 1);
+		printf("  %s (%s) : %u^3 cells, %.1f KiB\n", variant_name, precision_name, size, actual_working_set / 1024.0);
+		fflush(stdout);
+
+		Instance_t target = createInstance(size, m_Variant);
+		Instance_t reference = {};
+		if (cross_check){
+			reference = createInstance(size, FFSolverCPU::KERNEL_REFERENCE);
+		}
+
+		try{
+			Result_t result_list[NUM_OF_KERNELS];
+
+			// 基準の実装と同じ入力で計算して結果を照合する
+			// 照合は計測より先に全カーネルで行い、PMLの分割成分も含めて両者の状態を揃えておく
+			for (int kernel = 0; kernel < NUM_OF_KERNELS; kernel++){
+				result_list[kernel].max_ulp = 0;
+				if (cross_check){
+					fillFields(target, 1 + kernel);
+					fillFields(reference, 1 + kernel);
+					for (int n = 0; n < CHECK_STEPS; n++){
+						callKernel(target, kernel);
+						callKernel(reference, kernel);
+					}
+					result_list[kernel].max_ulp = compareFields(target, reference);
+				}
+			}
+
+			// カーネルごとに同じ初期値から計測する
+			for (int kernel = 0; kernel < NUM_OF_KERNELS; kernel++){
+				fillFields(target, 0);
+				measure([&](){ callKernel(target, kernel); }, result_list[kernel]);
+			}
+
+			// 結果を書き出す
+			for (int kernel = 0; kernel < NUM_OF_KERNELS; kernel++){
+				const Result_t &result = result_list[kernel];
+				uint64_t elements, bytes;
+				calcKernelModel(size, kernel, elements, bytes);
+				double elements_per_sec = (double)elements * result.calls / result.time;
+				double bandwidth = (double)bytes * result.calls / result.time;
+				bool failed = cross_check && (m_ToleranceULP < result.max_ulp);
+				passed &= !failed;
+
+				char ulp_text[32] = "";
+				if (cross_check){
+					snprintf(ulp_text, sizeof(ulp_text), "%llu", (unsigned long long)result.max_ulp);
+				}
+				printf("    %-16s %12.4e elem/s %10.2f GB/s%s%s%s\n",
+					getKernelName(kernel), elements_per_sec, bandwidth * 1e-9,
+					cross_check ? "  max ULP " : "", ulp_text, failed ? " (MISMATCH)" : "");
+				fprintf(csv, "%s,%s,%u,%d,%s,%u,%llu,%llu,%llu,%.6e,%.6e,%.6e,%s\n",
+					variant_name, precision_name, m_Lanes, m_Threads, getKernelName(kernel), size,
+					(unsigned long long)actual_working_set, (unsigned long long)elements, (unsigned long long)result.calls,
+					result.time, elements_per_sec, bandwidth, ulp_text);
+			}
+			fflush(stdout);
+			fflush(csv);
+		}
+		catch (...){
+			destroyInstance(target);
+			destroyInstance(reference);
+			throw;
+		}
+		destroyInstance(target);
+		destroyInstance(reference);
+	}
+	return passed;
+}
+
+// カーネルの名前を取得する
+const char* KernelBenchmark::getKernelName(int kernel){
+	static const char *KERNEL_NAMES[NUM_OF_KERNELS] = {
+		"Ex", "Ey", "Ez", "PML Ex", "PML Ey", "PML Ez",
+		"Hx", "Hy", "Hz", "PML Hx", "PML Hy", "PML Hz",
+		"exchangeEdgeE", "exchangeEdgeH", "calcTotalEM", "feedAndMeasure",
+	};
+	return ((0 <= kernel) && (kernel < NUM_OF_KERNELS)) ? KERNEL_NAMES[kernel] : "unknown";
+}
+
+// 1セルあたりの作業領域[byte]を求める
+// 電磁界6成分と係数インデックス、全セルに置いたPMLの分割成分と係数インデックスを数える
+uint64_t KernelBenchmark::calcBytesPerCell(void) const{
+	const uint64_t RealSize = getRealSize(m_Precision);
+	const uint64_t ComputeSize = getComputeSize(m_Precision);
+	uint64_t normal_bytes = 6 * (RealSize * m_Lanes + sizeof(cindex_t));
+	uint64_t pml_bytes = 6 * (2 * ComputeSize * m_Lanes + sizeof(cindex2_t));
+	return normal_bytes + pml_bytes;
+}
+
+// 合成データを格納したソルバーを作成する
+// 全成分を通常空間の計算範囲とし、同じ範囲をPML空間の直方体にも登録して両方のカーネルが全域を更新するようにする
+KernelBenchmark::Instance_t KernelBenchmark::createInstance(index_t size, int variant) const{
+	const index_t N = size;
+	const index_t Nx = N + 1, Ny = N + 1, Nz = N + 1;
+	const size_t volume = (size_t)Nx * Ny * Nz;
+
+	Instance_t instance;
+	instance.solver = FFSolverCPU::createSolver(m_Threads);
+	instance.iteration = 0;
+	instance.total = dvec2(0.0, 0.0);
+	FFSolverCPU *solver = instance.solver;
+	solver->setKernelVariant(variant);
+	solver->initializeMemory(
+		index3_t(N, N, N),
+		index3_t(0, 0, 0), index3_t(1, 1, 1),
+		index3_t(N, N, N), index3_t(N - 1, N - 1, N - 1),
+		m_Lanes, m_Precision);
+
+	// 係数インデックスを決定的な乱数で割り当てる
+	uint32_t random = 12345;
+	auto next = [&random](void) -> uint32_t{
+		random = random * 1664525 + 1013904223;
+		return random >> 8;
+	};
+	static const EMType TYPE_LIST[6] = { EMType::Ex, EMType::Ey, EMType::Ez, EMType::Hx, EMType::Hy, EMType::Hz };
+	for (int component = 0; component < 6; component++){
+		// 自成分の軸方向はM、それ以外はNの範囲とする (磁界は逆)
+		int axis = component % 3;
+		bool is_e = (component < 3);
+		index_t begin[3], end[3];
+		for (int a = 0; a < 3; a++){
+			bool range_m = ((a == axis) == is_e);
+			begin[a] = range_m ? 0 : 1;
+			end[a] = N;
+		}
+		std::vector<cindex_t> normal_cindex(volume);
+		for (auto &cindex : normal_cindex){
+			cindex = (cindex_t)(next() % NUM_OF_MATERIALS);
+		}
+		std::vector<PMLBox_t> pml_box_list(1);
+		PMLBox_t &box = pml_box_list[0];
+		box.start = index3_t(begin[0], begin[1], begin[2]);
+		box.size = index3_t(end[0] - begin[0], end[1] - begin[1], end[2] - begin[2]);
+		box.offset = 0;
+		box.cindex.resize((size_t)box.size.x * box.size.y * box.size.z);
+		for (auto &cindex : box.cindex){
+			cindex.x = (cindex_t)(next() % NUM_OF_MATERIALS);
+			cindex.y = (cindex_t)(next() % NUM_OF_MATERIALS);
+		}
+		// PMLのカーネルは分割型PMLのみを計測し、CPMLの補正は行わない
+		solver->storeCoefficientIndex(TYPE_LIST[component], normal_cindex, pml_box_list, std::vector<PMLBox_t>());
+	}
+
+	// クーラン条件を満たす一様格子相当の係数を材質ごとに作る
+	// 減衰させると同じカーネルを繰り返すうちに非正規化数になり計測を歪めるため、損失のない媒質とする
+	std::vector<dvec2> coef2_list;
+	std::vector<dvec3> coef3_list;
+	for (int m = 0; m < NUM_OF_MATERIALS; m++){
+		double eps_r = 1.0 + 0.5 * m;
+		coef2_list.push_back(dvec2(1.0, 0.5 / eps_r));
+		coef3_list.push_back(dvec3(1.0, 0.5 / eps_r, 0.5 / eps_r));
+	}
+	solver->storeCoefficientList(coef2_list, coef3_list, 1);
+
+	// 空間の対角線上にZ方向のポートを置く
+	std::vector<Probe_t> td_probe_list;
+	auto addProbe = [&](index_t x, index_t y, index_t z, EMType type) -> oindex_t{
+		Probe_t probe;
+		probe.index = x + Nx * (y + Ny * z);
+		probe.pos = index3_t(x, y, z);
+		probe.type = type;
+		td_probe_list.push_back(probe);
+		return (oindex_t)(td_probe_list.size() - 1);
+	};
+	for (int i = 0; i < NUM_OF_PORTS; i++){
+		index_t p = 1 + (index_t)((uint64_t)i * (N - 2) / NUM_OF_PORTS);
+		FFPort *port = new FFPort(new FFVoltageSourceComponent(new FFWaveform("exp(-((t-3e-11)/1e-11)^2)"), 50.0));
+		port->attachEProbe(addProbe(p, p, p, EMType::Ez), 1.0);
+		port->attachMProbe(addProbe(p, p, p, EMType::Hy), 1.0);
+		port->attachMProbe(addProbe(p - 1, p, p, EMType::Hy), -1.0);
+		port->attachMProbe(addProbe(p, p, p, EMType::Hx), -1.0);
+		port->attachMProbe(addProbe(p, p - 1, p, EMType::Hx), 1.0);
+		port->allocate(MAX_ITERATION, 1e-12, m_Lanes);
+		instance.port_list.push_back(port);
+	}
+	solver->storeMeasurementInfo(std::vector<double>(1, 1e9), MAX_ITERATION, td_probe_list, std::vector<Probe_t>());
+	solver->storePortList(instance.port_list);
+	return instance;
+}
+
+// ソルバーを破棄する
+void KernelBenchmark::destroyInstance(Instance_t &instance){
+	delete instance.solver;
+	instance.solver = nullptr;
+	for (FFPort *port : instance.port_list){
+		delete port;
+	}
+	instance.port_list.clear();
+}
+
+// 電磁界成分を決定的な乱数で初期化する
+void KernelBenchmark::fillFields(Instance_t &instance, uint32_t seed) const{
+	const index3_t &size = instance.solver->getSize();
+	const size_t count = (size_t)(size.x + 1) * (size.y + 1) * (size.z + 1) * m_Lanes;
+	uint32_t random = seed * 2654435761u + 1;
+	for (int type = (int)EMType::Ex; type <= (int)EMType::Hz; type++){
+		void *field = instance.solver->getFieldData((EMType)type);
+		for (size_t i = 0; i < count; i++){
+			random = random * 1664525 + 1013904223;
+			double value = (random >> 8) * (2.0 / 16777216.0) - 1.0;
+			switch (m_Precision){
+			case Precision::Double:
+				((double*)field)[i] = value;
+				break;
+			case Precision::Half:
+				((half_t*)field)[i] = (float)value;
+				break;
+			case Precision::BFloat16:
+				((bfloat16_t*)field)[i] = (float)value;
+				break;
+			default:
+				((float*)field)[i] = (float)value;
+				break;
+			}
+		}
+	}
+	instance.iteration = 0;
+}
+
+// カーネルを1回計算する
+void KernelBenchmark::callKernel(Instance_t &instance, int kernel){
+	FFSolverCPU *solver = instance.solver;
+	if (kernel < KERNEL_EXCHANGE_E){
+		// 指定したカーネルのみを有効にして電界または磁界を計算する
+		solver->setKernelMask(1u << kernel);
+		if (kernel < KERNEL_HX){
+			solver->calcEField();
+		}
+		else{
+			solver->calcHField();
+		}
+		solver->setKernelMask(FFSolverCPU::ALL_KERNELS);
+		return;
+	}
+	switch (kernel){
+	case KERNEL_EXCHANGE_E:
+		solver->exchangeEdgeE(Axis::X);
+		solver->exchangeEdgeE(Axis::Y);
+		solver->exchangeEdgeE(Axis::Z);
+		break;
+
+	case KERNEL_EXCHANGE_H:
+		solver->exchangeEdgeH(Axis::X);
+		solver->exchangeEdgeH(Axis::Y);
+		solver->exchangeEdgeH(Axis::Z);
+		break;
+
+	case KERNEL_TOTAL_EM:
+		instance.total = solver->calcTotalEM();
+		break;
+
+	case KERNEL_FEED_AND_MEASURE:
+		solver->feedAndMeasure(instance.iteration);
+		instance.iteration = (instance.iteration + 1) % MAX_ITERATION;
+		break;
+	}
+}
+
+// 2つのソルバーの電磁界成分の最大ULP差を求める
+uint64_t KernelBenchmark::compareFields(Instance_t &a, Instance_t &b) const{
+	const index3_t &size = a.solver->getSize();
+	const size_t count = (size_t)(size.x + 1) * (size.y + 1) * (size.z + 1) * m_Lanes;
+	uint64_t max_ulp = 0;
+	for (int type = (int)EMType::Ex; type <= (int)EMType::Hz; type++){
+		const void *field_a = a.solver->getFieldData((EMType)type);
+		const void *field_b = b.solver->getFieldData((EMType)type);
+		for (size_t i = 0; i < count; i++){
+			switch (m_Precision){
+			case Precision::Double:
+				max_ulp = std::max(max_ulp, calcULPDistance(((const double*)field_a)[i], ((const double*)field_b)[i]));
+				break;
+			case Precision::Half:
+				max_ulp = std::max(max_ulp, calcULPDistance(((const half_t*)field_a)[i], ((const half_t*)field_b)[i]));
+				break;
+			case Precision::BFloat16:
+				max_ulp = std::max(max_ulp, calcULPDistance(((const bfloat16_t*)field_a)[i], ((const bfloat16_t*)field_b)[i]));
+				break;
+			default:
+				max_ulp = std::max(max_ulp, calcULPDistance(((const float*)field_a)[i], ((const float*)field_b)[i]));
+				break;
+			}
+		}
+	}
+	max_ulp = std::max(max_ulp, calcULPDistance(a.total.x, b.total.x));
+	max_ulp = std::max(max_ulp, calcULPDistance(a.total.y, b.total.y));
+	return max_ulp;
+}
+
+// 最短計測時間を超えるまで呼び出し回数を倍にしながら計測する
+void KernelBenchmark::measure(const std::function<void(void)> &func, Result_t &result) const{
+	// 1回目はキャッシュとページを温めるために捨てる
+	func();
+	for (uint64_t calls = 1; ; calls *= 2){
+		double start = FFTelemetry::now();
+		for (uint64_t n = 0; n < calls; n++){
+			func();
+		}
+		double time = FFTelemetry::now() - start;
+		if ((m_MinTime <= time) || ((UINT64_MAX / 2) < calls)){
+			result.calls = calls;
+			result.time = time;
+			return;
+		}
+	}
+}
+
+// 1回の呼び出しで処理する要素数と転送量[byte]を求める
+// 電磁界の更新はFFSolverCPU::recordKernel()と同じモデルとし、要素数はレーンごとに数える
+void KernelBenchmark::calcKernelModel(index_t size, int kernel, uint64_t &elements, uint64_t &bytes) const{
+	const uint64_t N = size;
+	const uint64_t L = m_Lanes;
+	const uint64_t RealSize = getRealSize(m_Precision);
+	const uint64_t ComputeSize = getComputeSize(m_Precision);
+	const uint64_t update_count = N * (N - 1) * (N - 1);
+	const uint64_t face_count = (N + 1) * (N + 1);
+	const uint64_t volume = (N + 1) * (N + 1) * (N + 1);
+	if (kernel < KERNEL_EXCHANGE_E){
+		bool is_pml = ((KERNEL_PML_EX <= kernel) && (kernel <= KERNEL_PML_EZ)) || (KERNEL_PML_HX <= kernel);
+		elements = update_count * L;
+		if (is_pml == false){
+			bytes = update_count * (4 * RealSize * L + sizeof(cindex_t));
+		}
+		else{
+			bytes = update_count * ((4 * RealSize + 4 * ComputeSize) * L + sizeof(cindex2_t) + sizeof(index_t) + sizeof(cindex_t));
+		}
+		return;
+	}
+	switch (kernel){
+	case KERNEL_EXCHANGE_E:
+	case KERNEL_EXCHANGE_H:
+		// 3軸それぞれで3成分の1面を読み書きする
+		elements = 9 * face_count * L;
+		bytes = 2 * RealSize * elements;
+		break;
+
+	case KERNEL_TOTAL_EM:
+		elements = 6 * volume * L;
+		bytes = RealSize * elements;
+		break;
+
+	case KERNEL_FEED_AND_MEASURE:
+		// ポートごとに電界1点と磁界4点のプローブを読み、観測値を書き込む
+		elements = 5 * NUM_OF_PORTS * L;
+		bytes = 2 * RealSize * elements;
+		break;
+
+	default:
+		elements = 0;
+		bytes = 0;
+		break;
+	}
+}
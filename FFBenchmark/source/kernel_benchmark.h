@@ -0,0 +1,162 @@
+﻿#pragma once
+
+#include "FFSolverCPU.h"
+#include <stdio.h>
+#include <functional>
+
+
+
+// FFSolverCPUのカーネルを合成データで個別に計測するクラス
+// 作業領域がL1キャッシュからDRAMまでにわたる空間のサイズで、カーネルごとのcell/sと実効帯域幅を計測する
+// 基準以外の実装を選択したときは、各カーネルを基準の実装と同じ入力で計算して結果のULP差を照合する
+class KernelBenchmark{
+	/*** 定数 ***/
+public:
+	// 計測するカーネル
+	enum Kernel : int{
+		// FFSolverCPU::PerfKernelと同じ並び
+		KERNEL_EX = 0, KERNEL_EY, KERNEL_EZ,
+		KERNEL_PML_EX, KERNEL_PML_EY, KERNEL_PML_EZ,
+		KERNEL_HX, KERNEL_HY, KERNEL_HZ,
+		KERNEL_PML_HX, KERNEL_PML_HY, KERNEL_PML_HZ,
+
+		// 電磁界の更新以外の処理
+		KERNEL_EXCHANGE_E, KERNEL_EXCHANGE_H,
+		KERNEL_TOTAL_EM,
+		KERNEL_FEED_AND_MEASURE,
+		NUM_OF_KERNELS
+	};
+
+	// 最小の作業領域[byte]
+	static const uint64_t MIN_WORKING_SET = 16 * 1024;
+
+	// 係数の種類数
+	static const int NUM_OF_MATERIALS = 8;
+
+	// ポート数
+	static const int NUM_OF_PORTS = 8;
+
+	// 照合の際に各カーネルを計算する回数
+	static const int CHECK_STEPS = 4;
+
+	// 観測値を保持するステップ数
+	static const size_t MAX_ITERATION = 4096;
+
+
+
+	/*** 定義 ***/
+private:
+	// 合成データを格納したソルバー
+	struct Instance_t{
+		FFFDTD::FFSolverCPU *solver;				// ソルバー
+		std::vector<FFFDTD::FFPort*> port_list;		// ポートのリスト (ソルバーは所有しない)
+		size_t iteration;							// 次に給電と観測を行うステップ
+		FFFDTD::dvec2 total;						// calcTotalEM()の結果
+	};
+
+	// 1カーネルの計測結果
+	struct Result_t{
+		uint64_t calls;			// 呼び出し回数
+		double time;			// 経過時間[s]
+		uint64_t max_ulp;		// 基準の実装との最大ULP差
+	};
+
+
+
+	/*** メンバー変数 ***/
+private:
+	// 計測するカーネルの実装
+	int m_Variant;
+
+	// スレッド数
+	int m_Threads;
+
+	// レーン数
+	FFFDTD::index_t m_Lanes;
+
+	// 最大の作業領域[byte]
+	uint64_t m_MaxWorkingSet;
+
+	// 1カーネルあたりの最短計測時間[s]
+	double m_MinTime;
+
+	// 許容する最大ULP差
+	uint64_t m_ToleranceULP;
+
+	// 電磁界成分の精度
+	FFFDTD::Precision m_Precision;
+
+
+
+	/*** メソッド ***/
+public:
+	// コンストラクタ
+	KernelBenchmark(void);
+
+	// 計測するカーネルの実装を設定する
+	void setVariant(int variant){
+		m_Variant = variant;
+	}
+
+	// スレッド数を設定する
+	void setThreads(int threads){
+		m_Threads = threads;
+	}
+
+	// レーン数を設定する
+	void setLanes(FFFDTD::index_t lanes){
+		m_Lanes = lanes;
+	}
+
+	// 最大の作業領域[byte]を設定する
+	void setMaxWorkingSet(uint64_t bytes){
+		m_MaxWorkingSet = bytes;
+	}
+
+	// 1カーネルあたりの最短計測時間[s]を設定する
+	void setMinTime(double time){
+		m_MinTime = time;
+	}
+
+	// 許容する最大ULP差を設定する
+	void setToleranceULP(uint64_t ulp){
+		m_ToleranceULP = ulp;
+	}
+
+	// 電磁界成分の精度を設定する
+	void setPrecision(FFFDTD::Precision precision){
+		m_Precision = precision;
+	}
+
+	// 全サイズ・全カーネルを計測してCSVに書き出す
+	// 照合で許容差を超えたカーネルがあったときはfalseを返す
+	bool run(FILE *csv);
+
+	// カーネルの名前を取得する
+	static const char* getKernelName(int kernel);
+
+private:
+	// 1セルあたりの作業領域[byte]を求める
+	uint64_t calcBytesPerCell(void) const;
+
+	// 合成データを格納したソルバーを作成する
+	Instance_t createInstance(FFFDTD::index_t size, int variant) const;
+
+	// ソルバーを破棄する
+	static void destroyInstance(Instance_t &instance);
+
+	// 電磁界成分を決定的な乱数で初期化する
+	void fillFields(Instance_t &instance, uint32_t seed) const;
+
+	// カーネルを1回計算する
+	static void callKernel(Instance_t &instance, int kernel);
+
+	// 2つのソルバーの電磁界成分の最大ULP差を求める
+	uint64_t compareFields(Instance_t &a, Instance_t &b) const;
+
+	// 最短計測時間を超えるまで呼び出し回数を倍にしながら計測する
+	void measure(const std::function<void(void)> &func, Result_t &result) const;
+
+	// 1回の呼び出しで処理する要素数と転送量[byte]を求める
+	void calcKernelModel(FFFDTD::index_t size, int kernel, uint64_t &cells, uint64_t &bytes) const;
+};
@@ -0,0 +1,544 @@
+﻿// ソルバーのスケーリングを計測するベンチマーク
+//
+// 合成シーンでスレッド数とMPIプロセス数を変えながらシミュレーションし、構成ごとの結果をCSVに書き出す
+// 1台のマシンで"mpirun -np N FFBenchmark ..."として起動すると、1..Nプロセスの構成を順に計測する
+// -xを指定したときはFFSolverCPUのカーネルを合成データで個別に計測する
+// -rを指定したときは電磁界成分の精度ごとにポートの波形を計算し、単精度に対する誤差を報告する
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <mpi.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+#if defined(_WIN32)
+#define NOMINMAX
+#include <Windows.h>
+#include <Psapi.h>
+#elif defined(__GNUC__)
+#include <unistd.h>
+#endif
+
+#include "FFSimulation.h"
+#include "FFSolverCPU.h"
+#include "Basic/FFException.h"
+#include "Basic/FFTelemetry.h"
+#include "scene_generator.h"
+#include "kernel_benchmark.h"
+#include "accuracy_report.h"
+
+using namespace FFFDTD;
+
+
+
+// ルートランク
+static const int ROOT_RANK = 0;
+
+
+
+// 自プロセスのランク
+static int g_mpi_my_rank;
+
+// プロセス数
+static int g_mpi_total_process;
+
+
+
+// スケーリングの種類
+enum class Scaling{
+	Strong,		// 空間のサイズを固定する
+	Weak,		// 空間のサイズをスレッド数とプロセス数の積に比例させる
+};
+
+// ベンチマークの設定
+struct BENCHSETTING_t{
+	SceneGenerator generator;			// シーンの作成器 (空間のサイズは1スレッド1プロセスのときのもの)
+	std::vector<Scaling> scaling_list;	// 計測するスケーリングのリスト
+	int max_threads;					// 最大スレッド数
+	std::string csv_path;				// 結果を書き出すCSVファイルへのパス
+	std::string scene_path;				// シーンを書き出すファイルへのパス (空でなければシーンを書き出して終了する)
+	bool kernel_mode;					// カーネルを個別に計測するか
+	KernelBenchmark kernel_benchmark;	// カーネルの計測器
+	bool accuracy_mode;					// 精度ごとの誤差を報告するか
+};
+
+// 1構成の計測結果
+struct BENCHRESULT_t{
+	double setup_time;		// シミュレーション環境の構成時間[s]
+	double run_time;		// 全ステップの計算時間[s]
+	uint64_t steps;			// 計算したステップ数
+	uint64_t memory;		// 全プロセスの常駐メモリー量の合計[byte]
+};
+
+
+
+// 自プロセスの常駐メモリー量[byte]を取得する
+static uint64_t getResidentMemory(void){
+#if defined(_WIN32)
+	PROCESS_MEMORY_COUNTERS counters;
+	if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)) != FALSE){
+		return counters.WorkingSetSize;
+	}
+	return 0;
+#elif defined(__GNUC__)
+	unsigned long long total_pages = 0, resident_pages = 0;
+	FILE *fp = fopen("/proc/self/statm", "r");
+	if (fp == nullptr){
+		return 0;
+	}
+	if (fscanf(fp, "%llu %llu", &total_pages, &resident_pages) != 2){
+		resident_pages = 0;
+	}
+	fclose(fp);
+	return resident_pages * (uint64_t)sysconf(_SC_PAGESIZE);
+#else
+	return 0;
+#endif
+}
+
+// 1, 2, 4, ...と倍にしながら最大値までのリストを作成する
+static std::vector<int> makePowerOfTwoList(int max_value){
+	std::vector<int> result;
+	for (int value = 1; value < max_value; value *= 2){
+		result.push_back(value);
+	}
+	result.push_back(max_value);
+	return result;
+}
+
+// コマンドライン引数をパースする
+static bool parseCmdline(int argc, char *argv[], BENCHSETTING_t &setting){
+	enum STATE_e{
+		ST_OPTION,
+		ST_SIZE,
+		ST_PML,
+		ST_WIRE,
+		ST_DIELECTRIC,
+		ST_PORTS,
+		ST_ITERATION,
+		ST_THREADS,
+		ST_SCALING,
+		ST_CSVPATH,
+		ST_SCENEPATH,
+		ST_VARIANT,
+		ST_LANES,
+		ST_WORKINGSET,
+		ST_TOLERANCE,
+		ST_PRECISION,
+	};
+
+	bool show_help = false;
+	STATE_e state = ST_OPTION;
+	while (0 < argc--){
+		const char *p = *argv++;
+		switch (state){
+		case ST_OPTION:
+			if (p[0] == '-'){
+				switch (p[1]){
+				case 'h':
+					show_help = true;
+					break;
+				case 'n':
+					state = ST_SIZE;
+					break;
+				case 'p':
+					state = ST_PML;
+					break;
+				case 'w':
+					state = ST_WIRE;
+					break;
+				case 'e':
+					state = ST_DIELECTRIC;
+					break;
+				case 'k':
+					state = ST_PORTS;
+					break;
+				case 'i':
+					state = ST_ITERATION;
+					break;
+				case 't':
+					state = ST_THREADS;
+					break;
+				case 's':
+					state = ST_SCALING;
+					break;
+				case 'o':
+					state = ST_CSVPATH;
+					break;
+				case 'g':
+					state = ST_SCENEPATH;
+					break;
+				case 'x':
+					setting.kernel_mode = true;
+					break;
+				case 'v':
+					state = ST_VARIANT;
+					break;
+				case 'l':
+					state = ST_LANES;
+					break;
+				case 'b':
+					state = ST_WORKINGSET;
+					break;
+				case 'u':
+					state = ST_TOLERANCE;
+					break;
+				case 'f':
+					state = ST_PRECISION;
+					break;
+				case 'r':
+					setting.accuracy_mode = true;
+					break;
+				default:
+					printf("Unknown option '%s'\n", p);
+					show_help = true;
+					break;
+				}
+			}
+			break;
+
+		case ST_SIZE:
+		{
+			// "N"または"X,Y,Z"の形式
+			unsigned int x = 0, y = 0, z = 0;
+			int count = sscanf(p, "%u,%u,%u", &x, &y, &z);
+			if (count == 1){
+				setting.generator.setSize(index3_t(x, x, x));
+			}
+			else if (count == 3){
+				setting.generator.setSize(index3_t(x, y, z));
+			}
+			else{
+				printf("Invalid size '%s'\n", p);
+				show_help = true;
+			}
+			state = ST_OPTION;
+			break;
+		}
+
+		case ST_PML:
+			setting.generator.setPMLFraction(atof(p));
+			state = ST_OPTION;
+			break;
+
+		case ST_WIRE:
+			setting.generator.setWireFraction(atof(p));
+			state = ST_OPTION;
+			break;
+
+		case ST_DIELECTRIC:
+			setting.generator.setDielectricFraction(atof(p));
+			state = ST_OPTION;
+			break;
+
+		case ST_PORTS:
+			setting.generator.setNumOfPorts(std::max(1, atoi(p)));
+			state = ST_OPTION;
+			break;
+
+		case ST_ITERATION:
+			setting.generator.setIteration((size_t)std::max(1, atoi(p)));
+			state = ST_OPTION;
+			break;
+
+		case ST_THREADS:
+			setting.max_threads = std::max(1, atoi(p));
+			state = ST_OPTION;
+			break;
+
+		case ST_SCALING:
+			setting.scaling_list.clear();
+			if ((strcmp(p, "strong") == 0) || (strcmp(p, "both") == 0)){
+				setting.scaling_list.push_back(Scaling::Strong);
+			}
+			if ((strcmp(p, "weak") == 0) || (strcmp(p, "both") == 0)){
+				setting.scaling_list.push_back(Scaling::Weak);
+			}
+			if (setting.scaling_list.empty()){
+				printf("Unknown scaling '%s'\n", p);
+				show_help = true;
+			}
+			state = ST_OPTION;
+			break;
+
+		case ST_CSVPATH:
+			setting.csv_path = p;
+			state = ST_OPTION;
+			break;
+
+		case ST_SCENEPATH:
+			setting.scene_path = p;
+			state = ST_OPTION;
+			break;
+
+		case ST_VARIANT:
+		{
+			int variant;
+			for (variant = 0; variant < FFSolverCPU::NUM_OF_KERNEL_VARIANTS; variant++){
+				if (strcmp(p, FFSolverCPU::getKernelVariantName(variant)) == 0){
+					break;
+				}
+			}
+			if (variant < FFSolverCPU::NUM_OF_KERNEL_VARIANTS){
+				setting.kernel_benchmark.setVariant(variant);
+			}
+			else{
+				printf("Unknown kernel variant '%s'\n", p);
+				show_help = true;
+			}
+			state = ST_OPTION;
+			break;
+		}
+
+		case ST_LANES:
+			setting.kernel_benchmark.setLanes((index_t)std::max(1, atoi(p)));
+			state = ST_OPTION;
+			break;
+
+		case ST_WORKINGSET:
+			setting.kernel_benchmark.setMaxWorkingSet((uint64_t)std::max(1, atoi(p)) * 1024 * 1024);
+			state = ST_OPTION;
+			break;
+
+		case ST_TOLERANCE:
+			setting.kernel_benchmark.setToleranceULP((uint64_t)std::max(0, atoi(p)));
+			state = ST_OPTION;
+			break;
+
+		case ST_PRECISION:
+		{
+			static const struct{
+				const char *name;
+				Precision precision;
+			} PRECISION_LIST[] = {
+				{"single", Precision::Single}, {"double", Precision::Double},
+				{"half", Precision::Half}, {"bfloat16", Precision::BFloat16},
+			};
+			bool found = false;
+			for (auto &entry : PRECISION_LIST){
+				if (strcmp(p, entry.name) == 0){
+					setting.generator.setPrecision(entry.precision);
+					setting.kernel_benchmark.setPrecision(entry.precision);
+					found = true;
+				}
+			}
+			if (found == false){
+				printf("Unknown precision '%s'\n", p);
+				show_help = true;
+			}
+			state = ST_OPTION;
+			break;
+		}
+
+		default:
+			state = ST_OPTION;
+			break;
+		}
+	}
+
+	if (show_help == true){
+		if (g_mpi_my_rank == ROOT_RANK){
+			// ヘルプメッセージを表示して終了
+			puts("  -h  Display this help message");
+			puts("  -n  Space size in cells as N or X,Y,Z (for 1 thread and 1 process in weak scaling)");
+			puts("  -p  Volume fraction of PML layers (0 for PEC boundaries)");
+			puts("  -w  Fraction of cells crossed by PEC wires");
+			puts("  -e  Volume fraction of dielectric blocks");
+			puts("  -k  Number of ports");
+			puts("  -i  Number of steps per configuration");
+			puts("  -t  Maximum number of threads");
+			puts("  -s  Scaling to measure (strong, weak or both)");
+			puts("  -o  Path to CSV file of the results");
+			puts("  -g  Path to msgpack input file of the scene (write the scene and exit)");
+			puts("  -x  Measure each CPU kernel on synthetic arrays instead of the scaling sweep");
+			puts("  -v  Kernel variant to measure and cross-check against the reference");
+			puts("  -l  Number of lanes for the kernel measurement");
+			puts("  -b  Maximum working set of the kernel measurement in MiB");
+			puts("  -u  Maximum ULP difference allowed in the cross-check");
+			puts("  -f  Precision of the fields (single, double, half or bfloat16)");
+			puts("  -r  Compare port waveforms of each precision against single precision");
+		}
+		return false;
+	}
+	return true;
+}
+
+// 1構成を計測する
+static BENCHRESULT_t runConfiguration(const SceneGenerator &generator, int threads, MPI_Comm comm){
+	BENCHRESULT_t result;
+	FFScene scene;
+	generator.generate(scene);
+
+	FFSolver *solver = FFSolverCPU::createSolver(threads);
+	try{
+		std::vector<FFSolver*> solver_list(1, solver);
+		std::vector<uint64_t> speed_list(1, 1);
+		FFSimulation simulation(solver_list, speed_list, comm);
+
+		// シミュレーション環境を構成する
+		MPI_Barrier(comm);
+		double setup_start = FFTelemetry::now();
+		simulation.setup(scene);
+		MPI_Barrier(comm);
+		result.setup_time = FFTelemetry::now() - setup_start;
+
+		// 全プロセスの常駐メモリー量を合計する
+		uint64_t memory = getResidentMemory();
+		MPI_Allreduce(&memory, &result.memory, 1, MPI_UINT64_T, MPI_SUM, comm);
+
+		// 全ステップを計算する
+		double run_start = FFTelemetry::now();
+		simulation.run();
+		result.run_time = FFTelemetry::now() - run_start;
+		result.steps = simulation.getIteration();
+	}
+	catch (...){
+		delete solver;
+		throw;
+	}
+	delete solver;
+	return result;
+}
+
+
+
+// メイン
+int main(int argc, char *argv[]){
+	int mpi_multithread_level;
+	MPI_Init_thread(&argc, &argv, MPI_THREAD_MULTIPLE, &mpi_multithread_level);
+	MPI_Comm_rank(MPI_COMM_WORLD, &g_mpi_my_rank);
+	MPI_Comm_size(MPI_COMM_WORLD, &g_mpi_total_process);
+
+	int exit_code = 0;
+	try{
+		// 全プロセスで同じコマンドライン引数をパースする
+		BENCHSETTING_t setting;
+		setting.scaling_list = {Scaling::Strong, Scaling::Weak};
+#ifdef _OPENMP
+		setting.max_threads = omp_get_num_procs();
+#else
+		setting.max_threads = 1;
+#endif
+		setting.csv_path = "benchmark.csv";
+		setting.kernel_mode = false;
+		setting.accuracy_mode = false;
+		if (parseCmdline(argc - 1, argv + 1, setting) == false){
+			MPI_Finalize();
+			return 1;
+		}
+
+		// シーンを書き出して終了する
+		if (setting.scene_path.empty() == false){
+			if (g_mpi_my_rank == ROOT_RANK){
+				FFScene scene;
+				setting.generator.generate(scene);
+				SceneGenerator::writeScene(scene, setting.scene_path.c_str());
+				printf("Scene written to '%s'\n", setting.scene_path.c_str());
+			}
+			MPI_Finalize();
+			return 0;
+		}
+
+		// 結果を書き出すCSVファイルを開く
+		FILE *csv = nullptr;
+		if (g_mpi_my_rank == ROOT_RANK){
+			csv = fopen(setting.csv_path.c_str(), "w");
+			if (csv == nullptr){
+				throw FFException("Failed to open '%s'", setting.csv_path.c_str());
+			}
+		}
+
+		// カーネルを個別に計測して終了する
+		if (setting.kernel_mode == true){
+			if (g_mpi_my_rank == ROOT_RANK){
+				setting.kernel_benchmark.setThreads(setting.max_threads);
+				if (setting.kernel_benchmark.run(csv) == false){
+					puts("Cross-check against the reference kernel failed");
+					exit_code = 1;
+				}
+				fclose(csv);
+				printf("Results written to '%s'\n", setting.csv_path.c_str());
+			}
+			MPI_Bcast(&exit_code, 1, MPI_INT, ROOT_RANK, MPI_COMM_WORLD);
+			MPI_Finalize();
+			return exit_code;
+		}
+
+		// 精度ごとの誤差を報告して終了する
+		if (setting.accuracy_mode == true){
+			if (g_mpi_my_rank == ROOT_RANK){
+				AccuracyReport report;
+				report.setThreads(setting.max_threads);
+				report.run(setting.generator, csv);
+				fclose(csv);
+				printf("Results written to '%s'\n", setting.csv_path.c_str());
+			}
+			MPI_Finalize();
+			return 0;
+		}
+
+		if (csv != nullptr){
+			fputs("scaling,ranks,threads,size_x,size_y,size_z,cells,steps,setup_s,run_s,cells_per_s,memory_bytes\n", csv);
+			fflush(csv);
+		}
+
+		const index3_t base_size = setting.generator.getSize();
+		std::vector<int> rank_list = makePowerOfTwoList(g_mpi_total_process);
+		std::vector<int> thread_list = makePowerOfTwoList(setting.max_threads);
+		for (Scaling scaling : setting.scaling_list){
+			const char *scaling_name = (scaling == Scaling::Strong) ? "strong" : "weak";
+			for (int ranks : rank_list){
+				// 先頭からranks個のプロセスで構成を計測し、残りのプロセスは待機する
+				MPI_Comm comm;
+				MPI_Comm_split(MPI_COMM_WORLD, (g_mpi_my_rank < ranks) ? 0 : MPI_UNDEFINED, g_mpi_my_rank, &comm);
+				for (int threads : thread_list){
+					// 弱スケーリングではZ方向のサイズを並列数に比例させる
+					SceneGenerator generator = setting.generator;
+					index3_t size = base_size;
+					if (scaling == Scaling::Weak){
+						size.z *= (index_t)(ranks * threads);
+					}
+					generator.setSize(size);
+
+					if (comm != MPI_COMM_NULL){
+						BENCHRESULT_t result = runConfiguration(generator, threads, comm);
+						if (g_mpi_my_rank == ROOT_RANK){
+							uint64_t cells = (uint64_t)size.x * size.y * size.z;
+							double cells_per_sec = (0.0 < result.run_time) ? ((double)cells * result.steps / result.run_time) : 0.0;
+							printf("  %s : %d ranks x %d threads, %u x %u x %u, setup %.3f s, %.4e cell/s, %.1f MiB\n",
+								scaling_name, ranks, threads, size.x, size.y, size.z,
+								result.setup_time, cells_per_sec, result.memory / (1024.0 * 1024.0));
+							fflush(stdout);
+							fprintf(csv, "%s,%d,%d,%u,%u,%u,%llu,%llu,%.6f,%.6f,%.6e,%llu\n",
+								scaling_name, ranks, threads, size.x, size.y, size.z,
+								(unsigned long long)cells, (unsigned long long)result.steps,
+								result.setup_time, result.run_time, cells_per_sec, (unsigned long long)result.memory);
+							fflush(csv);
+						}
+					}
+					MPI_Barrier(MPI_COMM_WORLD);
+				}
+				if (comm != MPI_COMM_NULL){
+					MPI_Comm_free(&comm);
+				}
+			}
+		}
+
+		if (csv != nullptr){
+			fclose(csv);
+			printf("Results written to '%s'\n", setting.csv_path.c_str());
+		}
+	}
+	catch (FFException &exception){
+		exception.print();
+		exit_code = 1;
+		MPI_Abort(MPI_COMM_WORLD, 1);
+	}
+
+	MPI_Finalize();
+	return exit_code;
+}
@@ -0,0 +1,398 @@
+﻿#include "scene_generator.h"
+#include "Basic/FFException.h"
+#include "mpack/mpack.h"
+#include <stdio.h>
+#include <math.h>
+#include <algorithm>
+
+using namespace FFFDTD;
+
+
+
+// セルの幅[m]
+static const double CELL_WIDTH = 1e-3;
+
+// 誘電体ブロックの比誘電率
+static const double DIELECTRIC_EPS = 4.0;
+
+// ポートの内部抵抗[Ω]
+static const double PORT_ESR = 50.0;
+
+// ポートの励振波形
+static const char PORT_WAVEFORM[] = "exp(-((t-3e-11)/1e-11)^2)";
+
+// 周波数ドメインプローブの解析周波数[Hz]
+static const double PROBE_FREQUENCY = 1e9;
+
+// 配置の並べ替えに使う乱数の種
+static const uint32_t SHUFFLE_SEED = 12345;
+
+
+
+// 処理系によらず同じ順序になるように並べ替える
+template<typename T>
+static void shuffle(std::vector<T> &list){
+	uint32_t state = SHUFFLE_SEED;
+	for (size_t i = list.size(); 1 < i; i--){
+		state = state * 1664525 + 1013904223;
+		size_t j = (size_t)(((uint64_t)state * i) >> 32);
+		std::swap(list[i - 1], list[j]);
+	}
+}
+
+
+
+// コンストラクタ
+SceneGenerator::SceneGenerator(void)
+	: m_Size(64, 64, 64)
+	, m_PMLFraction(0.2), m_WireFraction(0.01), m_DielectricFraction(0.1)
+	, m_NumOfPorts(1), m_Iteration(200), m_Precision(DEFAULT_PRECISION)
+{
+}
+
+// シーンを作成する
+void SceneGenerator::generate(FFScene &scene) const{
+	scene = FFScene();
+	const index_t L = calcPMLLayers();
+	const index3_t start(L, L, L);
+	const index3_t end(m_Size.x - L, m_Size.y - L, m_Size.z - L);
+	const index3_t inner = end - start;
+	if ((inner.x < 4) || (inner.y < 4) || (inner.z < 4)){
+		throw FFException("Space is too small for the PML fraction");
+	}
+	const double total_cells = (double)m_Size.x * m_Size.y * m_Size.z;
+
+	// グリッドと境界条件を設定する
+	scene.grid_x = FFGrid(std::vector<double>(m_Size.x, CELL_WIDTH));
+	scene.grid_y = FFGrid(std::vector<double>(m_Size.y, CELL_WIDTH));
+	scene.grid_z = FFGrid(std::vector<double>(m_Size.z, CELL_WIDTH));
+	if (0 < L){
+		scene.bc.set(Axis::X, BoundaryCondition::PML, L);
+		scene.bc.set(Axis::Y, BoundaryCondition::PML, L);
+		scene.bc.set(Axis::Z, BoundaryCondition::PML, L);
+		scene.bc.pmlM = 3.0;
+		scene.bc.pmlR0 = 1e-6;
+	}
+
+	// ポートをPML層の内側の対角線上に等間隔に並べる
+	std::vector<index3_t> port_pos_list;
+	for (int i = 0; i < m_NumOfPorts; i++){
+		index3_t pos = start + inner * (index_t)(i + 1) / (index_t)(m_NumOfPorts + 1);
+		port_pos_list.push_back(pos);
+
+		FFScene::Port_t port;
+		port.pos = pos;
+		port.dir = Z_PLUS;
+		port.waveform = PORT_WAVEFORM;
+		port.esr = PORT_ESR;
+		scene.port_list.push_back(port);
+	}
+
+	// 誘電体ブロックを格子状の候補位置から選んで配置する
+	if (0.0 < m_DielectricFraction){
+		scene.material_list.push_back(std::vector<FFMaterial>(1, FFMaterial(DIELECTRIC_EPS)));
+		index_t block = std::max<index_t>(2, std::min(std::min(inner.x, inner.y), inner.z) / 8);
+		index_t pitch = block + 1;
+		std::vector<index3_t> candidate_list;
+		for (index_t z = start.z; z + block <= end.z; z += pitch){
+			for (index_t y = start.y; y + block <= end.y; y += pitch){
+				for (index_t x = start.x; x + block <= end.x; x += pitch){
+					candidate_list.push_back(index3_t(x, y, z));
+				}
+			}
+		}
+		shuffle(candidate_list);
+		size_t count = (size_t)(m_DielectricFraction * total_cells / ((double)block * block * block) + 0.5);
+		count = std::min(count, candidate_list.size());
+		for (size_t i = 0; i < count; i++){
+			FFScene::Cuboid_t cuboid;
+			cuboid.pec = false;
+			cuboid.matid = 1;
+			cuboid.start = candidate_list[i];
+			cuboid.end = candidate_list[i] + index3_t(block, block, block);
+			scene.object_list.push_back(cuboid);
+		}
+	}
+
+	// PECワイヤーをZ方向に通し、ポートと同じXY座標は避ける
+	if (0.0 < m_WireFraction){
+		std::vector<index3_t> candidate_list;
+		for (index_t y = start.y + 1; y < end.y; y += 2){
+			for (index_t x = start.x + 1; x < end.x; x += 2){
+				bool on_port = false;
+				for (auto &pos : port_pos_list){
+					on_port |= (pos.x == x) && (pos.y == y);
+				}
+				if (on_port == false){
+					candidate_list.push_back(index3_t(x, y, start.z));
+				}
+			}
+		}
+		shuffle(candidate_list);
+		size_t count = (size_t)(m_WireFraction * total_cells / inner.z + 0.5);
+		count = std::min(count, candidate_list.size());
+		for (size_t i = 0; i < count; i++){
+			FFScene::Cuboid_t cuboid;
+			cuboid.pec = true;
+			cuboid.matid = 0;
+			cuboid.start = candidate_list[i];
+			cuboid.end = index3_t(candidate_list[i].x, candidate_list[i].y, end.z);
+			scene.object_list.push_back(cuboid);
+		}
+	}
+
+	// 計算条件を設定する
+	scene.timestep = 0.0;
+	scene.iteration = m_Iteration;
+	scene.freq_list.push_back(PROBE_FREQUENCY);
+	scene.precision = m_Precision;
+}
+
+// 体積の割合に最も近いPML層数を求める
+index_t SceneGenerator::calcPMLLayers(void) const{
+	if (m_PMLFraction <= 0.0){
+		return 0;
+	}
+	const double total_cells = (double)m_Size.x * m_Size.y * m_Size.z;
+	const index_t max_layers = std::min(std::min(m_Size.x, m_Size.y), m_Size.z) / 2;
+	index_t result = 1;
+	double best_error = HUGE_VAL;
+	for (index_t L = 1; L < max_layers; L++){
+		double inner_cells = (double)(m_Size.x - 2 * L) * (m_Size.y - 2 * L) * (m_Size.z - 2 * L);
+		double error = fabs(1.0 - inner_cells / total_cells - m_PMLFraction);
+		if (error < best_error){
+			best_error = error;
+			result = L;
+		}
+	}
+	return result;
+}
+
+// シーンを入力ファイルと同じmsgpack形式で書き出す
+void SceneGenerator::writeScene(const FFScene &scene, const char *path){
+	char *data = nullptr;
+	size_t size = 0;
+	mpack_writer_t writer;
+	mpack_writer_init_growable(&writer, &data, &size);
+
+	// 境界条件の名前を取得する
+	auto bc_to_string = [](BoundaryCondition bc) -> const char*{
+		switch (bc){
+		case BoundaryCondition::PML:
+			return "PML";
+		case BoundaryCondition::Periodic:
+			return "Periodic";
+		case BoundaryCondition::PMC:
+			return "PMC";
+		case BoundaryCondition::PECSymmetry:
+			return "PECSymmetry";
+		default:
+			return "PEC";
+		}
+	};
+
+	// 方向の名前を取得する
+	auto dir_to_string = [](DIR_e dir) -> const char*{
+		switch (dir){
+		case X_PLUS:
+			return "+X";
+		case Y_PLUS:
+			return "+Y";
+		case Z_PLUS:
+			return "+Z";
+		case X_MINUS:
+			return "-X";
+		case Y_MINUS:
+			return "-Y";
+		default:
+			return "-Z";
+		}
+	};
+
+	// 3要素のベクトルを書き込む
+	auto write_vec3 = [&](const index3_t &v){
+		mpack_start_array(&writer, 3);
+		mpack_write_u32(&writer, v.x);
+		mpack_write_u32(&writer, v.y);
+		mpack_write_u32(&writer, v.z);
+		mpack_finish_array(&writer);
+	};
+
+	// 面ごとの境界条件を書き込む (両面が同じ軸は1つの値とする)
+	auto write_face_bc = [&](const BoundaryCondition *lower, const BoundaryCondition *upper){
+		mpack_start_array(&writer, 3);
+		for (int axis = 0; axis < 3; axis++){
+			if (lower[axis] == upper[axis]){
+				mpack_write_cstr(&writer, bc_to_string(lower[axis]));
+			}
+			else{
+				mpack_start_array(&writer, 2);
+				mpack_write_cstr(&writer, bc_to_string(lower[axis]));
+				mpack_write_cstr(&writer, bc_to_string(upper[axis]));
+				mpack_finish_array(&writer);
+			}
+		}
+		mpack_finish_array(&writer);
+	};
+
+	// 面ごとの層数を書き込む (両面が同じ軸は1つの値とする)
+	auto write_face_u32 = [&](const index3_t &lower, const index3_t &upper){
+		mpack_start_array(&writer, 3);
+		for (int axis = 0; axis < 3; axis++){
+			if (lower[axis] == upper[axis]){
+				mpack_write_u32(&writer, lower[axis]);
+			}
+			else{
+				mpack_start_array(&writer, 2);
+				mpack_write_u32(&writer, lower[axis]);
+				mpack_write_u32(&writer, upper[axis]);
+				mpack_finish_array(&writer);
+			}
+		}
+		mpack_finish_array(&writer);
+	};
+
+	mpack_start_map(&writer, 5);
+
+	// グリッドと境界条件を書き込む
+	mpack_write_cstr(&writer, "Space");
+	mpack_start_map(&writer, 3);
+	mpack_write_cstr(&writer, "Grid");
+	mpack_start_array(&writer, 3);
+	for (const FFGrid *grid : {&scene.grid_x, &scene.grid_y, &scene.grid_z}){
+		mpack_start_array(&writer, grid->count());
+		for (index_t i = 0; i < grid->count(); i++){
+			mpack_write_double(&writer, grid->width(i));
+		}
+		mpack_finish_array(&writer);
+	}
+	mpack_finish_array(&writer);
+	mpack_write_cstr(&writer, "BoundaryCondition");
+	write_face_bc(scene.bc.lower, scene.bc.upper);
+	mpack_write_cstr(&writer, "PML");
+	mpack_start_map(&writer, 3);
+	mpack_write_cstr(&writer, "Layers");
+	write_face_u32(scene.bc.pmlLower, scene.bc.pmlUpper);
+	mpack_write_cstr(&writer, "Order");
+	mpack_write_double(&writer, scene.bc.pmlM);
+	mpack_write_cstr(&writer, "R0");
+	mpack_write_double(&writer, scene.bc.pmlR0);
+	mpack_finish_map(&writer);
+	mpack_finish_map(&writer);
+
+	// 材質を書き込む (レーンごとの値を持つときは配列にする)
+	mpack_write_cstr(&writer, "Material");
+	mpack_start_array(&writer, (uint32_t)scene.material_list.size());
+	for (auto &mat_list : scene.material_list){
+		auto write_values = [&](double (FFMaterial::*getter)(void) const){
+			if (mat_list.size() == 1){
+				mpack_write_double(&writer, (mat_list[0].*getter)());
+			}
+			else{
+				mpack_start_array(&writer, (uint32_t)mat_list.size());
+				for (auto &mat : mat_list){
+					mpack_write_double(&writer, (mat.*getter)());
+				}
+				mpack_finish_array(&writer);
+			}
+		};
+		mpack_start_map(&writer, 3);
+		mpack_write_cstr(&writer, "Epsilon");
+		write_values(&FFMaterial::eps_r);
+		mpack_write_cstr(&writer, "Sigma");
+		write_values(&FFMaterial::sigma);
+		mpack_write_cstr(&writer, "Mu");
+		write_values(&FFMaterial::mu_r);
+		mpack_finish_map(&writer);
+	}
+	mpack_finish_array(&writer);
+
+	// 物体を書き込む
+	mpack_write_cstr(&writer, "Object");
+	mpack_start_array(&writer, (uint32_t)scene.object_list.size());
+	for (auto &object : scene.object_list){
+		mpack_start_map(&writer, 4);
+		mpack_write_cstr(&writer, "Type");
+		mpack_write_cstr(&writer, "Cuboid");
+		mpack_write_cstr(&writer, "Material");
+		if (object.pec == true){
+			mpack_write_cstr(&writer, "PEC");
+		}
+		else{
+			mpack_write_u32(&writer, object.matid);
+		}
+		mpack_write_cstr(&writer, "Start");
+		write_vec3(object.start);
+		mpack_write_cstr(&writer, "End");
+		write_vec3(object.end);
+		mpack_finish_map(&writer);
+	}
+	mpack_finish_array(&writer);
+
+	// ポートを書き込む
+	mpack_write_cstr(&writer, "Port");
+	mpack_start_array(&writer, (uint32_t)scene.port_list.size());
+	for (auto &port : scene.port_list){
+		mpack_start_map(&writer, 5);
+		mpack_write_cstr(&writer, "Type");
+		mpack_write_cstr(&writer, "VoltageSource");
+		mpack_write_cstr(&writer, "Position");
+		write_vec3(port.pos);
+		mpack_write_cstr(&writer, "Direction");
+		mpack_write_cstr(&writer, dir_to_string(port.dir));
+		mpack_write_cstr(&writer, "ESR");
+		mpack_write_double(&writer, port.esr);
+		mpack_write_cstr(&writer, "Waveform");
+		mpack_write_cstr(&writer, port.waveform.c_str());
+		mpack_finish_map(&writer);
+	}
+	mpack_finish_array(&writer);
+
+	// 計算条件を書き込む
+	mpack_write_cstr(&writer, "Solver");
+	mpack_start_map(&writer, scene.excitation_list.empty() ? 4 : 5);
+	mpack_write_cstr(&writer, "Timestep");
+	if (0.0 < scene.timestep){
+		mpack_write_double(&writer, scene.timestep);
+	}
+	else{
+		mpack_write_cstr(&writer, "Auto");
+	}
+	mpack_write_cstr(&writer, "Frequency");
+	mpack_start_array(&writer, (uint32_t)scene.freq_list.size());
+	for (double freq : scene.freq_list){
+		mpack_write_double(&writer, freq);
+	}
+	mpack_finish_array(&writer);
+	mpack_write_cstr(&writer, "Iteration");
+	mpack_write_u32(&writer, (uint32_t)scene.iteration);
+	mpack_write_cstr(&writer, "Precision");
+	mpack_write_cstr(&writer, getPrecisionName(scene.precision));
+	if (scene.excitation_list.empty() == false){
+		mpack_write_cstr(&writer, "Excitation");
+		mpack_start_array(&writer, (uint32_t)scene.excitation_list.size());
+		for (oindex_t port : scene.excitation_list){
+			mpack_write_u32(&writer, port);
+		}
+		mpack_finish_array(&writer);
+	}
+	mpack_finish_map(&writer);
+
+	mpack_finish_map(&writer);
+	if (mpack_writer_destroy(&writer) != mpack_ok){
+		throw FFException("Failed to encode the scene");
+	}
+
+	// ファイルに書き出す
+	FILE *fp = fopen(path, "wb");
+	if (fp == nullptr){
+		MPACK_FREE(data);
+		throw FFException("Failed to open '%s'", path);
+	}
+	size_t written = fwrite(data, 1, size, fp);
+	fclose(fp);
+	MPACK_FREE(data);
+	if (written != size){
+		throw FFException("Failed to write '%s'", path);
+	}
+}
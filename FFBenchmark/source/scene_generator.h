@@ -0,0 +1,89 @@
+﻿#pragma once
+
+#include "FFScene.h"
+
+
+
+// ベンチマーク用の合成シーンを作成するクラス
+// 空間のサイズとPML・PECワイヤー・誘電体ブロックの割合、ポート数から決定的にシーンを作成する
+class SceneGenerator{
+	/*** メンバー変数 ***/
+private:
+	// 空間のセル数
+	FFFDTD::index3_t m_Size;
+
+	// PML層が占める体積の割合
+	double m_PMLFraction;
+
+	// PECワイヤーが通るセルの割合
+	double m_WireFraction;
+
+	// 誘電体ブロックが占める体積の割合
+	double m_DielectricFraction;
+
+	// ポート数
+	int m_NumOfPorts;
+
+	// 計算ステップ数
+	size_t m_Iteration;
+
+	// 電磁界成分の精度
+	FFFDTD::Precision m_Precision;
+
+
+
+	/*** メソッド ***/
+public:
+	// コンストラクタ
+	SceneGenerator(void);
+
+	// 空間のセル数を設定する
+	void setSize(const FFFDTD::index3_t &size){
+		m_Size = size;
+	}
+
+	// 空間のセル数を取得する
+	const FFFDTD::index3_t& getSize(void) const{
+		return m_Size;
+	}
+
+	// PML層が占める体積の割合を設定する (0のときは境界をPECとする)
+	void setPMLFraction(double fraction){
+		m_PMLFraction = fraction;
+	}
+
+	// PECワイヤーが通るセルの割合を設定する
+	void setWireFraction(double fraction){
+		m_WireFraction = fraction;
+	}
+
+	// 誘電体ブロックが占める体積の割合を設定する
+	void setDielectricFraction(double fraction){
+		m_DielectricFraction = fraction;
+	}
+
+	// ポート数を設定する
+	void setNumOfPorts(int count){
+		m_NumOfPorts = count;
+	}
+
+	// 計算ステップ数を設定する
+	void setIteration(size_t iteration){
+		m_Iteration = iteration;
+	}
+
+	// 電磁界成分の精度を設定する
+	void setPrecision(FFFDTD::Precision precision){
+		m_Precision = precision;
+	}
+
+	// シーンを作成する
+	void generate(FFFDTD::FFScene &scene) const;
+
+	// シーンを入力ファイルと同じmsgpack形式で書き出す
+	static void writeScene(const FFFDTD::FFScene &scene, const char *path);
+
+private:
+	// 体積の割合に最も近いPML層数を求める
+	FFFDTD::index_t calcPMLLayers(void) const;
+};
@@ -0,0 +1,144 @@
+﻿#pragma once
+
+#include <stdint.h>
+#include <string.h>
+#if defined(__F16C__) || (defined(_MSC_VER) && defined(__AVX2__))
+#define FFFDTD_HAS_F16C
+#include <immintrin.h>
+#endif
+
+
+
+namespace FFFDTD{
+	// 半精度浮動小数点数 (IEEE 754 binary16) の格納型
+	// 演算は単精度で行い、格納するときに最近接偶数丸めで変換する
+	struct half_t{
+		/*** メンバー変数 ***/
+		uint16_t bits;
+
+
+
+		/*** メソッド ***/
+		// コンストラクタ
+		half_t(void) = default;
+
+		// 単精度から変換する
+		half_t(float value) : bits(fromFloat(value)){}
+
+		// 単精度に変換する
+		operator float(void) const{
+			return toFloat(bits);
+		}
+
+		// 単精度を半精度のビット列に変換する
+		static uint16_t fromFloat(float value){
+#ifdef FFFDTD_HAS_F16C
+			return (uint16_t)_cvtss_sh(value, _MM_FROUND_TO_NEAREST_INT);
+#else
+			const uint32_t F32_INFINITY = 255u << 23;
+			const uint32_t F16_MAX = (127u + 16) << 23;
+			const uint32_t DENORM_MAGIC = ((127u - 15) + (23 - 10) + 1) << 23;
+			uint32_t u;
+			memcpy(&u, &value, sizeof(u));
+			const uint32_t sign = u & 0x80000000u;
+			u ^= sign;
+
+			uint16_t result;
+			if (F16_MAX <= u){
+				// 無限大とNaN
+				result = (F32_INFINITY < u) ? 0x7e00 : 0x7c00;
+			}
+			else if (u < (113u << 23)){
+				// 非正規化数と0 (加算で仮数部を下位に揃え、丸めを浮動小数点数の加算に任せる)
+				float f, magic;
+				memcpy(&f, &u, sizeof(f));
+				memcpy(&magic, &DENORM_MAGIC, sizeof(magic));
+				f += magic;
+				memcpy(&u, &f, sizeof(u));
+				result = (uint16_t)(u - DENORM_MAGIC);
+			}
+			else{
+				// 正規化数
+				const uint32_t mant_odd = (u >> 13) & 1;
+				u += ((uint32_t)(15 - 127) << 23) + 0xfff;
+				u += mant_odd;
+				result = (uint16_t)(u >> 13);
+			}
+			return result | (uint16_t)(sign >> 16);
+#endif
+		}
+
+		// 半精度のビット列を単精度に変換する
+		static float toFloat(uint16_t bits){
+#ifdef FFFDTD_HAS_F16C
+			return _cvtsh_ss(bits);
+#else
+			const uint32_t SHIFTED_EXP = 0x7c00u << 13;
+			const uint32_t MAGIC = 113u << 23;
+			uint32_t u = (uint32_t)(bits & 0x7fff) << 13;
+			const uint32_t exp = SHIFTED_EXP & u;
+			u += (uint32_t)(127 - 15) << 23;
+			if (exp == SHIFTED_EXP){
+				// 無限大とNaN
+				u += (uint32_t)(128 - 16) << 23;
+			}
+			else if (exp == 0){
+				// 非正規化数と0
+				float f, magic;
+				u += 1u << 23;
+				memcpy(&f, &u, sizeof(f));
+				memcpy(&magic, &MAGIC, sizeof(magic));
+				f -= magic;
+				memcpy(&u, &f, sizeof(u));
+			}
+			u |= (uint32_t)(bits & 0x8000) << 16;
+			float result;
+			memcpy(&result, &u, sizeof(result));
+			return result;
+#endif
+		}
+	};
+
+
+
+	// bfloat16 (単精度の上位16bit) の格納型
+	// 演算は単精度で行い、格納するときに最近接偶数丸めで変換する
+	struct bfloat16_t{
+		/*** メンバー変数 ***/
+		uint16_t bits;
+
+
+
+		/*** メソッド ***/
+		// コンストラクタ
+		bfloat16_t(void) = default;
+
+		// 単精度から変換する
+		bfloat16_t(float value) : bits(fromFloat(value)){}
+
+		// 単精度に変換する
+		operator float(void) const{
+			return toFloat(bits);
+		}
+
+		// 単精度をbfloat16のビット列に変換する
+		static uint16_t fromFloat(float value){
+			uint32_t u;
+			memcpy(&u, &value, sizeof(u));
+			if ((u & 0x7fffffffu) > 0x7f800000u){
+				// NaNは丸めで無限大にならないようにquiet NaNとする
+				return (uint16_t)((u >> 16) | 0x40);
+			}
+			u += 0x7fffu + ((u >> 16) & 1);
+			return (uint16_t)(u >> 16);
+		}
+
+		// bfloat16のビット列を単精度に変換する
+		static float toFloat(uint16_t bits){
+			uint32_t u = (uint32_t)bits << 16;
+			float result;
+			memcpy(&result, &u, sizeof(result));
+			return result;
+		}
+	};
+}
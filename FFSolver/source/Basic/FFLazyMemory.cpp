@@ -0,0 +1,32 @@
+﻿#include "FFLazyMemory.h"
+#ifdef _WIN32
+#define NOMINMAX
+#include <Windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+
+
+namespace FFFDTD{
+	// 0で初期化したページをOSから確保する
+	void* allocateLazyMemory(size_t size){
+#ifdef _WIN32
+		// コミットしたページも最初にアクセスするまで物理メモリーは割り当てられない
+		return VirtualAlloc(nullptr, size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+#else
+		// 無名マッピングのページは最初に書き込むまで物理メモリーを割り当てられない (読むだけなら共有の0のページを参照する)
+		void *p = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		return (p != MAP_FAILED) ? p : nullptr;
+#endif
+	}
+
+	// allocateLazyMemory()で確保したメモリーを解放する
+	void freeLazyMemory(void *p, size_t size){
+#ifdef _WIN32
+		VirtualFree(p, 0, MEM_RELEASE);
+#else
+		munmap(p, size);
+#endif
+	}
+}
@@ -0,0 +1,91 @@
+﻿#pragma once
+
+#include <stddef.h>
+#include <new>
+#include <utility>
+#include <vector>
+
+
+
+namespace FFFDTD{
+	// 0で初期化したページをOSから確保する
+	// 物理メモリーは最初に書き込んだときにページ単位で割り当てられるため、書き込まない範囲はメモリーを消費しない
+	// 確保できないときはnullptrを返す
+	void* allocateLazyMemory(size_t size);
+
+	// allocateLazyMemory()で確保したメモリーを解放する
+	void freeLazyMemory(void *p, size_t size);
+
+	// 0で初期化したページに格納する配列のアロケーター
+	// 引数のないconstruct()は書き込まずに0のままとするため、要素型はビットが全て0の値を0として扱える型とすること
+	// 書き込まない範囲は物理メモリーを消費しないため、常に0のままの成分を含む電磁界成分の配列に使う
+	template<typename T>
+	class FFLazyAllocator{
+		/*** 定義 ***/
+	public:
+		using value_type = T;
+
+
+
+		/*** メソッド ***/
+	public:
+		// コンストラクタ
+		FFLazyAllocator(void) = default;
+
+		// 別の要素型のアロケーターから変換する
+		template<typename U>
+		FFLazyAllocator(const FFLazyAllocator<U>&){}
+
+		// n個の要素のメモリーを確保する
+		T* allocate(size_t n){
+			if (n == 0){
+				return nullptr;
+			}
+			void *p = allocateLazyMemory(n * sizeof(T));
+			if (p == nullptr){
+				throw std::bad_alloc();
+			}
+			return (T*)p;
+		}
+
+		// n個の要素のメモリーを解放する
+		void deallocate(T *p, size_t n){
+			if (p != nullptr){
+				freeLazyMemory(p, n * sizeof(T));
+			}
+		}
+
+		// 値を指定して要素を構築する
+		template<typename U, typename... Args>
+		void construct(U *p, Args&&... args){
+			::new((void*)p) U(std::forward<Args>(args)...);
+		}
+
+		// 値を指定せずに要素を構築する (確保したページは0のため書き込まない)
+		template<typename U>
+		void construct(U*){}
+	};
+
+	// 同じアロケーターか比較する (全て同じOSのページを扱うため常に等しい)
+	template<typename T, typename U>
+	bool operator==(const FFLazyAllocator<T>&, const FFLazyAllocator<U>&){
+		return true;
+	}
+
+	template<typename T, typename U>
+	bool operator!=(const FFLazyAllocator<T>&, const FFLazyAllocator<U>&){
+		return false;
+	}
+
+	// 0で初期化したページに格納する配列
+	template<typename T>
+	using FFLazyVector = std::vector<T, FFLazyAllocator<T>>;
+
+	// 配列のメモリーを解放し、0で初期化したn個の要素を確保し直す
+	// resize()で増やした要素は書き込まれないため、一度書き込んだメモリーを使い回さないよう新しく確保する
+	template<typename T>
+	void assignLazyZero(FFLazyVector<T> &v, size_t n){
+		FFLazyVector<T>().swap(v);
+		v.resize(n);
+	}
+}
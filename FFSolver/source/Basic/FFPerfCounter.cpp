@@ -0,0 +1,364 @@
+﻿#include "FFPerfCounter.h"
+#include "FFTelemetry.h"
+#include <stdio.h>
+#include <string.h>
+#include <memory>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+#if defined(__linux__)
+#include <errno.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#endif
+#endif
+
+
+
+namespace FFFDTD{
+#if defined(__linux__)
+	// カウンターの設定
+	struct EventConfig_t{
+		uint32_t type;		// イベントの種類
+		uint64_t config;	// イベントの設定値
+		bool intel_only;	// Intel CPUのみで有効なRAWイベントか
+	};
+
+	// PerfEventの順に並べたカウンターの設定
+	// 浮動小数点演算命令数はFP_ARITH_INST_RETIREDで単精度と倍精度を合わせて数える (FMAは2命令として数えられる)
+	static const EventConfig_t EVENT_CONFIG[FFPerfCounter::NUM_OF_EVENTS] = {
+		{PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK, false},
+		{PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES, false},
+		{PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS, false},
+		{PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_REFERENCES, false},
+		{PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES, false},
+		{PERF_TYPE_RAW, 0x03C7, true},
+		{PERF_TYPE_RAW, 0x0CC7, true},
+		{PERF_TYPE_RAW, 0x30C7, true},
+		{PERF_TYPE_RAW, 0xC0C7, true},
+	};
+
+	// 呼び出したスレッドのIDを取得する
+	static long getThreadID(void){
+		return (long)syscall(SYS_gettid);
+	}
+
+	// Intel CPUか調べる
+	static bool isIntelCPU(void){
+#if defined(__x86_64__) || defined(__i386__)
+		unsigned int eax, ebx, ecx, edx;
+		if (__get_cpuid(0, &eax, &ebx, &ecx, &edx) == 0){
+			return false;
+		}
+		char vendor[12];
+		memcpy(vendor + 0, &ebx, 4);
+		memcpy(vendor + 4, &edx, 4);
+		memcpy(vendor + 8, &ecx, 4);
+		return memcmp(vendor, "GenuineIntel", 12) == 0;
+#else
+		return false;
+#endif
+	}
+#endif
+
+	// 値が有効なときのみ書式に従って文字列にする
+	static const char* formatValue(char *buf, size_t size, const char *format, double value, bool available){
+		if (available == true){
+			snprintf(buf, size, format, value);
+		}
+		else{
+			snprintf(buf, size, "n/a");
+		}
+		return buf;
+	}
+
+
+
+	// コンストラクタ
+	FFPerfCounter::FFPerfCounter(void)
+		: m_ThreadList(), m_Message()
+		, m_ElementSize(4)
+		, m_StreamBandwidth(0.0)
+		, m_KernelList()
+		, m_CurrentThread(-1), m_BeginTime(0.0)
+		, m_BeginValue(), m_EndValue()
+	{
+		for (int e = 0; e < NUM_OF_EVENTS; e++){
+			m_Available[e] = false;
+		}
+	}
+
+	// デストラクタ
+	FFPerfCounter::~FFPerfCounter(){
+#if defined(__linux__)
+		for (auto &thread : m_ThreadList){
+			for (int e = 0; e < NUM_OF_EVENTS; e++){
+				if (0 <= thread.fd[e]){
+					close(thread.fd[e]);
+				}
+			}
+		}
+#endif
+	}
+
+	// OpenMPの全スレッドでカウンターを開き、メモリー帯域幅を計測する
+	void FFPerfCounter::open(int element_size){
+		m_ElementSize = element_size;
+#if defined(__linux__)
+		// 全スレッドのIDを集める
+		std::vector<long> tid_list;
+#ifdef _OPENMP
+#pragma omp parallel
+		{
+			long tid = getThreadID();
+#pragma omp critical
+			tid_list.push_back(tid);
+		}
+#else
+		tid_list.push_back(getThreadID());
+#endif
+
+		// 最初のスレッドで開けたカウンターを有効とする
+		for (size_t i = 0; i < tid_list.size(); i++){
+			openThread(tid_list[i]);
+			if (i == 0){
+				for (int e = 0; e < NUM_OF_EVENTS; e++){
+					m_Available[e] = (0 <= m_ThreadList[0].fd[e]);
+				}
+			}
+		}
+#else
+		m_Message = "Hardware counters are supported only on Linux";
+#endif
+
+		m_StreamBandwidth = measureStreamBandwidth();
+	}
+
+	// カーネルを登録してIDを取得する
+	int FFPerfCounter::addKernel(const char *name){
+		Kernel_t kernel;
+		kernel.name = name;
+		m_KernelList.push_back(kernel);
+		reset();
+		return (int)m_KernelList.size() - 1;
+	}
+
+	// カーネルの計測を開始する
+	void FFPerfCounter::begin(void){
+		m_CurrentThread = -1;
+#if defined(__linux__)
+#ifdef _OPENMP
+		if (omp_in_parallel()){
+			// 入れ子の並列領域は逐次実行されるため、呼び出したスレッドのカウンターのみ読む
+			long tid = getThreadID();
+			for (size_t i = 0; i < m_ThreadList.size(); i++){
+				if (m_ThreadList[i].tid == tid){
+					m_CurrentThread = (int)i;
+					break;
+				}
+			}
+			if (m_CurrentThread < 0){
+				openThread(tid);
+				m_CurrentThread = (int)m_ThreadList.size() - 1;
+			}
+		}
+#endif
+		readValues(m_BeginValue);
+#endif
+		m_BeginTime = FFTelemetry::now();
+	}
+
+	// カーネルの計測を終了し、更新したセル数とモデル上の演算数・転送量とともに加算する
+	void FFPerfCounter::end(int kernel, uint64_t cells, double model_flop, double model_bytes){
+		double end_time = FFTelemetry::now();
+		Kernel_t &target = m_KernelList[kernel];
+		target.calls++;
+		target.cells += cells;
+		target.time += end_time - m_BeginTime;
+		target.model_flop += model_flop;
+		target.model_bytes += model_bytes;
+#if defined(__linux__)
+		readValues(m_EndValue);
+		size_t num_of_threads = (m_CurrentThread < 0) ? m_ThreadList.size() : 1;
+		target.thread_time += (end_time - m_BeginTime) * num_of_threads;
+		for (size_t t = 0; t < num_of_threads; t++){
+			for (int e = 0; e < NUM_OF_EVENTS; e++){
+				const Value_t &begin_value = m_BeginValue[t * NUM_OF_EVENTS + e];
+				const Value_t &end_value = m_EndValue[t * NUM_OF_EVENTS + e];
+				double delta = (double)(end_value.value - begin_value.value);
+				uint64_t enabled = end_value.enabled - begin_value.enabled;
+				uint64_t running = end_value.running - begin_value.running;
+				if ((0 < running) && (running < enabled)){
+					// 多重化されたカウンターは計測できた時間の比率で補正する
+					delta *= (double)enabled / running;
+				}
+				target.count[e] += delta;
+			}
+		}
+#endif
+	}
+
+	// 集計値をすべて0にする
+	void FFPerfCounter::reset(void){
+		for (auto &kernel : m_KernelList){
+			kernel.calls = 0;
+			kernel.cells = 0;
+			kernel.time = 0.0;
+			kernel.thread_time = 0.0;
+			kernel.model_flop = 0.0;
+			kernel.model_bytes = 0.0;
+			for (int e = 0; e < NUM_OF_EVENTS; e++){
+				kernel.count[e] = 0.0;
+			}
+		}
+	}
+
+	// カーネルごとの集計結果を表示する
+	void FFPerfCounter::print(const char *title) const{
+		const bool has_cycles = m_Available[(int)PerfEvent::Cycles] && m_Available[(int)PerfEvent::Instructions];
+		const bool has_llc = m_Available[(int)PerfEvent::LLCMisses];
+		bool has_fp = true;
+		for (int e = (int)PerfEvent::FPScalar; e <= (int)PerfEvent::FP512; e++){
+			has_fp &= m_Available[e];
+		}
+
+		printf("Roofline %s : STREAM Triad %.2f GB/s, %d threads\n", title, m_StreamBandwidth * 1e-9, (int)m_ThreadList.size());
+		if (m_Message.empty() == false){
+			printf("  %s\n", m_Message.c_str());
+		}
+		puts("  Kernel     Time[s]      Cell/s  Roof[%]  Busy[%]   IPC  FLOP/cell(model/meas)  Byte/cell(model/LLC)    GB/s  Vector(S/128/256/512)  Bound");
+		for (auto &kernel : m_KernelList){
+			if ((kernel.calls == 0) || (kernel.cells == 0) || (kernel.time <= 0.0)){
+				continue;
+			}
+			double cells = (double)kernel.cells;
+			double cell_rate = cells / kernel.time;
+
+			// 実測のメモリー転送量が得られないときはモデル上の転送量で帯域幅を求める
+			double model_bytes = kernel.model_bytes / cells;
+			double llc_bytes = kernel.count[(int)PerfEvent::LLCMisses] * CACHE_LINE_SIZE / cells;
+			double bytes = has_llc ? llc_bytes : model_bytes;
+			double bandwidth = bytes * cell_rate;
+			double roof = ((0.0 < bytes) && (0.0 < m_StreamBandwidth)) ? (cell_rate / (m_StreamBandwidth / bytes)) : 0.0;
+
+			// 浮動小数点演算数と命令の内訳を求める
+			const double *count = kernel.count;
+			double lanes = 16.0 / m_ElementSize;
+			double fp_scalar = count[(int)PerfEvent::FPScalar];
+			double fp_128 = count[(int)PerfEvent::FP128];
+			double fp_256 = count[(int)PerfEvent::FP256];
+			double fp_512 = count[(int)PerfEvent::FP512];
+			double fp_total = fp_scalar + fp_128 + fp_256 + fp_512;
+			double flop = (fp_scalar + lanes * fp_128 + 2.0 * lanes * fp_256 + 4.0 * lanes * fp_512) / cells;
+			char vector_mix[32];
+			if (has_fp && (0.0 < fp_total)){
+				snprintf(vector_mix, sizeof(vector_mix), "%3.0f/%3.0f/%3.0f/%3.0f", 100.0 * fp_scalar / fp_total, 100.0 * fp_128 / fp_total, 100.0 * fp_256 / fp_total, 100.0 * fp_512 / fp_total);
+			}
+			else{
+				snprintf(vector_mix, sizeof(vector_mix), "n/a");
+			}
+
+			// STREAMの帯域幅に近ければメモリー律速、そうでなければレイテンシーか演算の律速とする
+			const char *bound = (0.6 <= roof) ? "memory" : "latency/compute";
+
+			char busy_str[16], ipc_str[16], flop_str[16], llc_str[16];
+			double busy = count[(int)PerfEvent::TaskClock] * 1e-9 / kernel.thread_time;
+			double ipc = (0.0 < count[(int)PerfEvent::Cycles]) ? (count[(int)PerfEvent::Instructions] / count[(int)PerfEvent::Cycles]) : 0.0;
+			printf("  %-8s %9.4f %11.4e %8.1f %8s %5s %10.2f/%-10s %10.2f/%-9s %7.2f  %-21s  %s\n",
+				kernel.name.c_str(), kernel.time, cell_rate, 100.0 * roof,
+				formatValue(busy_str, sizeof(busy_str), "%.1f", 100.0 * busy, m_Available[(int)PerfEvent::TaskClock] && (0.0 < kernel.thread_time)),
+				formatValue(ipc_str, sizeof(ipc_str), "%.2f", ipc, has_cycles),
+				kernel.model_flop / cells, formatValue(flop_str, sizeof(flop_str), "%.2f", flop, has_fp),
+				model_bytes, formatValue(llc_str, sizeof(llc_str), "%.2f", llc_bytes, has_llc),
+				bandwidth * 1e-9, vector_mix, bound);
+		}
+		fflush(stdout);
+	}
+
+	// STREAM Triadでメモリー帯域幅[byte/s]を計測する
+	double FFPerfCounter::measureStreamBandwidth(void){
+		// 最終レベルキャッシュより十分大きな配列を使う
+		const int N = 16 * 1024 * 1024;
+		const int REPEAT = 5;
+		std::unique_ptr<float[]> a(new float[N]), b(new float[N]), c(new float[N]);
+		float *pa = a.get(), *pb = b.get(), *pc = c.get();
+#pragma omp parallel for
+		for (int i = 0; i < N; i++){
+			pa[i] = 0.0f;
+			pb[i] = 1.0f;
+			pc[i] = 2.0f;
+		}
+
+		// 最も速かった回の帯域幅を採用する
+		double best_time = 0.0;
+		const float scalar = 3.0f;
+		for (int n = 0; n < REPEAT; n++){
+			double start = FFTelemetry::now();
+#pragma omp parallel for
+			for (int i = 0; i < N; i++){
+				pa[i] = pb[i] + scalar * pc[i];
+			}
+			double time = FFTelemetry::now() - start;
+			if ((n == 0) || (time < best_time)){
+				best_time = time;
+			}
+		}
+		return (0.0 < best_time) ? (3.0 * sizeof(float) * N / best_time) : 0.0;
+	}
+
+	// 指定したスレッドのカウンターを開く
+	void FFPerfCounter::openThread(long tid){
+		Thread_t thread;
+		thread.tid = tid;
+		for (int e = 0; e < NUM_OF_EVENTS; e++){
+			thread.fd[e] = -1;
+		}
+#if defined(__linux__)
+		bool is_intel = isIntelCPU();
+		for (int e = 0; e < NUM_OF_EVENTS; e++){
+			const EventConfig_t &config = EVENT_CONFIG[e];
+			if ((config.intel_only == true) && (is_intel == false)){
+				continue;
+			}
+			perf_event_attr attr;
+			memset(&attr, 0, sizeof(attr));
+			attr.size = sizeof(attr);
+			attr.type = config.type;
+			attr.config = config.config;
+			attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+			attr.exclude_kernel = 1;
+			attr.exclude_hv = 1;
+			int fd = (int)syscall(SYS_perf_event_open, &attr, (pid_t)tid, -1, -1, 0);
+			if (0 <= fd){
+				thread.fd[e] = fd;
+			}
+			else if (m_Message.empty() && (e == (int)PerfEvent::Cycles)){
+				m_Message = std::string("Hardware counters are not available (perf_event_open: ") + strerror(errno) + ")";
+			}
+		}
+#endif
+		m_ThreadList.push_back(thread);
+	}
+
+	// 計測対象のスレッドのカウンターの値を読み出す
+	void FFPerfCounter::readValues(std::vector<Value_t> &values) const{
+		size_t first = (m_CurrentThread < 0) ? 0 : (size_t)m_CurrentThread;
+		size_t num_of_threads = (m_CurrentThread < 0) ? m_ThreadList.size() : 1;
+		values.resize(num_of_threads * NUM_OF_EVENTS);
+		for (size_t t = 0; t < num_of_threads; t++){
+			const Thread_t &thread = m_ThreadList[first + t];
+			for (int e = 0; e < NUM_OF_EVENTS; e++){
+				Value_t &value = values[t * NUM_OF_EVENTS + e];
+				value.value = value.enabled = value.running = 0;
+#if defined(__linux__)
+				if ((0 <= thread.fd[e]) && (read(thread.fd[e], &value, sizeof(value)) != (ssize_t)sizeof(value))){
+					value.value = value.enabled = value.running = 0;
+				}
+#endif
+			}
+		}
+	}
+}
@@ -0,0 +1,141 @@
+﻿#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+
+
+namespace FFFDTD{
+	// 計測するハードウェアカウンター
+	enum class PerfEvent : int{
+		TaskClock = 0,	// スレッドの実行時間[ns] (ソフトウェアイベント)
+		Cycles,			// CPUサイクル数
+		Instructions,	// 実行命令数
+		LLCReferences,	// 最終レベルキャッシュの参照数
+		LLCMisses,		// 最終レベルキャッシュのミス数
+		FPScalar,		// スカラーの単精度浮動小数点演算命令数 (Intelのみ)
+		FP128,			// 128bitパックの単精度浮動小数点演算命令数 (Intelのみ)
+		FP256,			// 256bitパックの単精度浮動小数点演算命令数 (Intelのみ)
+		FP512,			// 512bitパックの単精度浮動小数点演算命令数 (Intelのみ)
+		Count
+	};
+
+
+
+	// カーネルごとにハードウェアカウンターを集計し、ルーフラインモデル上の位置を表示するクラス
+	// Linuxのperf_event_openでスレッドごとにカウンターを開き、begin()からend()までの増分をカーネルに加算する
+	// 開けなかったカウンターは表示の際にn/aとなる
+	class FFPerfCounter{
+		/*** 定数 ***/
+	public:
+		// カウンターの数
+		static const int NUM_OF_EVENTS = (int)PerfEvent::Count;
+
+		// キャッシュラインのサイズ[byte]
+		static const int CACHE_LINE_SIZE = 64;
+
+	private:
+		// カーネルごとの集計値
+		struct Kernel_t{
+			std::string name;				// カーネル名
+			uint64_t calls;					// 計測回数
+			uint64_t cells;					// 更新したセル数 (レーンごとに数える)
+			double time;					// 経過時間[s]
+			double thread_time;				// 経過時間と計測したスレッド数の積[s]
+			double model_flop;				// モデル上の浮動小数点演算数
+			double model_bytes;				// モデル上のメモリー転送量[byte]
+			double count[NUM_OF_EVENTS];	// カウンターの増分
+		};
+
+		// スレッドごとのカウンター
+		struct Thread_t{
+			long tid;						// スレッドID
+			int fd[NUM_OF_EVENTS];			// ファイルディスクリプター (開けなかったときは-1)
+		};
+
+		// カウンターの読み出し値 (値, 有効時間, 実計測時間)
+		struct Value_t{
+			uint64_t value, enabled, running;
+		};
+
+
+
+		/*** メンバー変数 ***/
+	private:
+		// スレッドごとのカウンターのリスト
+		std::vector<Thread_t> m_ThreadList;
+
+		// カウンターが開けたか
+		bool m_Available[NUM_OF_EVENTS];
+
+		// カウンターが開けなかった理由
+		std::string m_Message;
+
+		// 浮動小数点数のサイズ[byte]
+		int m_ElementSize;
+
+		// 計測したメモリー帯域幅[byte/s]
+		double m_StreamBandwidth;
+
+		// カーネルのリスト
+		std::vector<Kernel_t> m_KernelList;
+
+		// 計測中のスレッド (-1のときは全スレッド)
+		int m_CurrentThread;
+
+		// 計測開始時刻[s]
+		double m_BeginTime;
+
+		// 計測開始時のカウンターの値
+		std::vector<Value_t> m_BeginValue;
+
+		// 計測終了時のカウンターの値
+		std::vector<Value_t> m_EndValue;
+
+
+
+		/*** メソッド ***/
+	public:
+		// コンストラクタ
+		FFPerfCounter(void);
+
+		// デストラクタ
+		~FFPerfCounter();
+
+		// OpenMPの全スレッドでカウンターを開き、メモリー帯域幅を計測する
+		// element_sizeは演算に使う浮動小数点数のサイズ[byte]
+		void open(int element_size);
+
+		// 演算に使う浮動小数点数のサイズ[byte]を変更する
+		void setElementSize(int element_size){
+			m_ElementSize = element_size;
+		}
+
+		// カーネルを登録してIDを取得する
+		int addKernel(const char *name);
+
+		// カーネルの計測を開始する
+		// 並列領域の中から呼ばれたときは呼び出したスレッドのみ、外から呼ばれたときは全スレッドのカウンターを読む
+		void begin(void);
+
+		// カーネルの計測を終了し、更新したセル数とモデル上の演算数・転送量とともに加算する
+		void end(int kernel, uint64_t cells, double model_flop, double model_bytes);
+
+		// 集計値をすべて0にする
+		void reset(void);
+
+		// カーネルごとの集計結果を表示する
+		void print(const char *title) const;
+
+		// STREAM Triadでメモリー帯域幅[byte/s]を計測する
+		static double measureStreamBandwidth(void);
+
+	private:
+		// 指定したスレッドのカウンターを開く
+		void openThread(long tid);
+
+		// 計測対象のスレッドのカウンターの値を読み出す
+		void readValues(std::vector<Value_t> &values) const;
+	};
+}
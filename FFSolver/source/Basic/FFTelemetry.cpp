@@ -0,0 +1,68 @@
+﻿#include "FFTelemetry.h"
+#include <chrono>
+
+
+
+namespace FFFDTD{
+	// 集計値をすべて0にする
+	void FFTelemetry::reset(void){
+		for (int i = 0; i < NUM_OF_PHASES; i++){
+			m_Time[i] = 0.0;
+			m_Calls[i] = 0;
+		}
+		m_Steps = 0;
+		m_CellUpdates = 0;
+		m_MemoryBytes = 0;
+		m_HaloBytes = 0;
+	}
+
+	// 別の集計値を加算する
+	FFTelemetry& FFTelemetry::operator+=(const FFTelemetry &telemetry){
+		for (int i = 0; i < NUM_OF_PHASES; i++){
+			m_Time[i] += telemetry.m_Time[i];
+			m_Calls[i] += telemetry.m_Calls[i];
+		}
+		m_Steps += telemetry.m_Steps;
+		m_CellUpdates += telemetry.m_CellUpdates;
+		m_MemoryBytes += telemetry.m_MemoryBytes;
+		m_HaloBytes += telemetry.m_HaloBytes;
+		return *this;
+	}
+
+	// 区分の名前を取得する
+	const char* FFTelemetry::getPhaseName(TelemetryPhase phase){
+		switch (phase){
+		case TelemetryPhase::Step1:
+			return "step1";
+		case TelemetryPhase::Step2:
+			return "step2";
+		case TelemetryPhase::Step3:
+			return "step3";
+		case TelemetryPhase::Step4:
+			return "step4";
+		case TelemetryPhase::Step5:
+			return "step5";
+		case TelemetryPhase::KernelE:
+			return "kernel_e";
+		case TelemetryPhase::KernelH:
+			return "kernel_h";
+		case TelemetryPhase::PMLE:
+			return "pml_e";
+		case TelemetryPhase::PMLH:
+			return "pml_h";
+		case TelemetryPhase::HaloPack:
+			return "halo_pack";
+		case TelemetryPhase::HaloUnpack:
+			return "halo_unpack";
+		case TelemetryPhase::MPIWait:
+			return "mpi_wait";
+		default:
+			return "unknown";
+		}
+	}
+
+	// 現在時刻[s]を取得する
+	double FFTelemetry::now(void){
+		return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+}
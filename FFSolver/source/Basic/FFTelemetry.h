@@ -0,0 +1,159 @@
+﻿#pragma once
+
+#include <stdint.h>
+#include "FFTrace.h"
+
+
+
+namespace FFFDTD{
+	// 処理時間を計測する区分
+	enum class TelemetryPhase : int{
+		Step1 = 0,		// 計算ステップ1 (給電・計測)
+		Step2,			// 計算ステップ2 (磁界の計算)
+		Step3,			// 計算ステップ3 (磁界の共有)
+		Step4,			// 計算ステップ4 (電界の計算)
+		Step5,			// 計算ステップ5 (電界の共有)
+		KernelE,		// 通常空間の電界の計算
+		KernelH,		// 通常空間の磁界の計算
+		PMLE,			// PML空間の電界の計算
+		PMLH,			// PML空間の磁界の計算
+		HaloPack,		// 端部の電磁界の取り出しと同一プロセス内の受け渡し
+		HaloUnpack,		// MPIで受信した端部の電磁界の書き込み
+		MPIWait,		// MPIでの送受信の完了待ち
+		Count
+	};
+
+
+
+	// 処理時間と処理量を集計するクラス
+	// 1つのFFSituationとそのソルバーから1スレッドずつ書き込まれる
+	class FFTelemetry{
+		/*** 定数 ***/
+	public:
+		// 区分の数
+		static const int NUM_OF_PHASES = (int)TelemetryPhase::Count;
+
+
+
+		/*** メンバー変数 ***/
+	private:
+		// 区分ごとの処理時間[s]
+		double m_Time[NUM_OF_PHASES];
+
+		// 区分ごとの計測回数
+		uint64_t m_Calls[NUM_OF_PHASES];
+
+		// 計算したステップ数
+		uint64_t m_Steps;
+
+		// 更新したセル数 (レーンごとに数える)
+		uint64_t m_CellUpdates;
+
+		// 電磁界の更新で読み書きしたメモリーの推定量[byte]
+		uint64_t m_MemoryBytes;
+
+		// 端部の電磁界の送受信量[byte]
+		uint64_t m_HaloBytes;
+
+
+
+		/*** メソッド ***/
+	public:
+		// コンストラクタ
+		FFTelemetry(void){
+			reset();
+		}
+
+		// 集計値をすべて0にする
+		void reset(void);
+
+		// 処理時間を加算する
+		void addTime(TelemetryPhase phase, double time){
+			m_Time[(int)phase] += time;
+			m_Calls[(int)phase]++;
+		}
+
+		// 1ステップ分の処理量を加算する
+		void addStep(uint64_t cell_updates, uint64_t memory_bytes){
+			m_Steps++;
+			m_CellUpdates += cell_updates;
+			m_MemoryBytes += memory_bytes;
+		}
+
+		// 端部の電磁界の送受信量を加算する
+		void addHaloBytes(uint64_t bytes){
+			m_HaloBytes += bytes;
+		}
+
+		// 別の集計値を加算する
+		FFTelemetry& operator+=(const FFTelemetry &telemetry);
+
+		// 区分ごとの処理時間[s]を取得する
+		double getTime(TelemetryPhase phase) const{
+			return m_Time[(int)phase];
+		}
+
+		// 区分ごとの計測回数を取得する
+		uint64_t getCalls(TelemetryPhase phase) const{
+			return m_Calls[(int)phase];
+		}
+
+		// 計算したステップ数を取得する
+		uint64_t getSteps(void) const{
+			return m_Steps;
+		}
+
+		// 更新したセル数を取得する
+		uint64_t getCellUpdates(void) const{
+			return m_CellUpdates;
+		}
+
+		// 読み書きしたメモリーの推定量[byte]を取得する
+		uint64_t getMemoryBytes(void) const{
+			return m_MemoryBytes;
+		}
+
+		// 端部の電磁界の送受信量[byte]を取得する
+		uint64_t getHaloBytes(void) const{
+			return m_HaloBytes;
+		}
+
+		// 区分の名前を取得する
+		static const char* getPhaseName(TelemetryPhase phase);
+
+		// 現在時刻[s]を取得する
+		static double now(void);
+	};
+
+
+
+	// スコープを抜けるまでの処理時間を計測するクラス
+	// タイムラインの記録中はイベントとしても記録する
+	class FFScopedTimer{
+	private:
+		// 加算先 (nullptrのときは計測しない)
+		FFTelemetry *m_Telemetry;
+
+		// 区分
+		TelemetryPhase m_Phase;
+
+		// 開始時刻[s]
+		double m_Start;
+
+	public:
+		// コンストラクタ
+		FFScopedTimer(FFTelemetry *telemetry, TelemetryPhase phase)
+			: m_Telemetry(telemetry), m_Phase(phase), m_Start((telemetry != nullptr) ? FFTelemetry::now() : 0.0)
+		{
+		}
+
+		// デストラクタ
+		~FFScopedTimer(){
+			if (m_Telemetry != nullptr){
+				double end = FFTelemetry::now();
+				m_Telemetry->addTime(m_Phase, end - m_Start);
+				FFTrace::record(FFTelemetry::getPhaseName(m_Phase), "situation", m_Start, end);
+			}
+		}
+	};
+}
@@ -0,0 +1,159 @@
+﻿#include "FFTrace.h"
+#include "FFTelemetry.h"
+#include <stdio.h>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+
+
+namespace FFFDTD{
+	// スレッドごとのリングバッファー
+	struct TraceBuffer_t{
+		int thread;									// スレッド番号 (登録順)
+		std::atomic<uint64_t> count;				// 書き込んだイベントの総数
+		TraceEvent_t events[FFTrace::BUFFER_SIZE];	// イベント
+	};
+
+	// 記録中か
+	std::atomic<bool> FFTrace::s_Active(false);
+
+	// 記録が有効か
+	static bool s_Enabled = false;
+
+	// 記録を開始しているか
+	static bool s_Started = false;
+
+	// 記録するステップの範囲
+	static uint64_t s_FirstStep = 0, s_LastStep = UINT64_MAX;
+
+	// 時刻の原点[s]
+	static double s_Origin = 0.0;
+
+	// 全スレッドのバッファーのリスト
+	static std::vector<std::unique_ptr<TraceBuffer_t>> s_BufferList;
+
+	// バッファーのリストを保護するミューテックス (スレッドの初回の記録時のみ使う)
+	static std::mutex s_BufferMutex;
+
+	// 呼び出したスレッドのバッファー
+	static thread_local TraceBuffer_t *t_Buffer = nullptr;
+
+
+
+	// 記録を有効にし、記録するステップの範囲を設定する
+	void FFTrace::enable(uint64_t first_step, uint64_t last_step){
+		s_Enabled = true;
+		s_FirstStep = first_step;
+		s_LastStep = last_step;
+	}
+
+	// 記録が有効か取得する
+	bool FFTrace::isEnabled(void){
+		return s_Enabled;
+	}
+
+	// 全スレッドのバッファーを空にして記録を開始する
+	void FFTrace::start(void){
+		if (s_Enabled == false){
+			return;
+		}
+		{
+			std::lock_guard<std::mutex> lock(s_BufferMutex);
+			for (auto &buffer : s_BufferList){
+				buffer->count.store(0, std::memory_order_relaxed);
+			}
+		}
+		s_Origin = FFTelemetry::now();
+		s_Started = true;
+		setStep(0);
+	}
+
+	// 記録を停止する
+	void FFTrace::stop(void){
+		s_Started = false;
+		s_Active.store(false, std::memory_order_release);
+	}
+
+	// 現在のステップを設定し、範囲内であれば記録する
+	void FFTrace::setStep(uint64_t step){
+		bool active = s_Started && (s_FirstStep <= step) && (step <= s_LastStep);
+		if (active != isActive()){
+			s_Active.store(active, std::memory_order_release);
+		}
+	}
+
+	// 全スレッドのイベントをChrome TraceのJSONオブジェクトをカンマで区切った文字列にする
+	std::string FFTrace::exportEvents(int pid, const char *process_name){
+		std::lock_guard<std::mutex> lock(s_BufferMutex);
+		std::string result;
+		char line[512];
+
+		// 失われたイベント数を数える
+		uint64_t dropped = 0;
+		for (auto &buffer : s_BufferList){
+			uint64_t count = buffer->count.load(std::memory_order_acquire);
+			if (BUFFER_SIZE < count){
+				dropped += count - BUFFER_SIZE;
+			}
+		}
+
+		// プロセス名とスレッド名を書き出す
+		snprintf(line, sizeof(line), "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,\"args\":{\"name\":\"%s\",\"dropped_events\":%llu}}", pid, process_name, (unsigned long long)dropped);
+		result += line;
+		for (auto &buffer : s_BufferList){
+			snprintf(line, sizeof(line), ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,\"args\":{\"name\":\"thread %d\"}}", pid, buffer->thread, buffer->thread);
+			result += line;
+		}
+
+		// 残っているイベントを古い順に書き出す
+		for (auto &buffer : s_BufferList){
+			uint64_t count = buffer->count.load(std::memory_order_acquire);
+			uint64_t first = (BUFFER_SIZE < count) ? (count - BUFFER_SIZE) : 0;
+			for (uint64_t n = first; n < count; n++){
+				const TraceEvent_t &event = buffer->events[n % BUFFER_SIZE];
+				snprintf(line, sizeof(line), ",\n{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"pid\":%d,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+					event.name, event.category, pid, buffer->thread,
+					(event.begin - s_Origin) * 1e6, (event.end - event.begin) * 1e6);
+				result += line;
+			}
+		}
+		return result;
+	}
+
+	// 呼び出したスレッドのバッファーにイベントを書き込む
+	void FFTrace::push(const char *name, const char *category, double begin, double end){
+		TraceBuffer_t *buffer = t_Buffer;
+		if (buffer == nullptr){
+			// スレッドの初回の記録時にバッファーを作成して登録する
+			std::lock_guard<std::mutex> lock(s_BufferMutex);
+			buffer = new TraceBuffer_t();
+			buffer->thread = (int)s_BufferList.size();
+			buffer->count.store(0, std::memory_order_relaxed);
+			s_BufferList.emplace_back(buffer);
+			t_Buffer = buffer;
+		}
+		uint64_t count = buffer->count.load(std::memory_order_relaxed);
+		TraceEvent_t &event = buffer->events[count % BUFFER_SIZE];
+		event.name = name;
+		event.category = category;
+		event.begin = begin;
+		event.end = end;
+		buffer->count.store(count + 1, std::memory_order_release);
+	}
+
+
+
+	// コンストラクタ
+	FFTraceScope::FFTraceScope(const char *name, const char *category)
+		: m_Name(name), m_Category(category), m_Begin(FFTrace::isActive() ? FFTelemetry::now() : -1.0)
+	{
+	}
+
+	// デストラクタ
+	FFTraceScope::~FFTraceScope(){
+		if (0.0 <= m_Begin){
+			FFTrace::record(m_Name, m_Category, m_Begin, FFTelemetry::now());
+		}
+	}
+}
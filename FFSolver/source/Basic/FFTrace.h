@@ -0,0 +1,98 @@
+﻿#pragma once
+
+#include <stdint.h>
+#include <atomic>
+#include <string>
+
+
+
+namespace FFFDTD{
+	// タイムラインに記録するイベント
+	struct TraceEvent_t{
+		const char *name;		// イベント名 (静的な文字列)
+		const char *category;	// 分類 (静的な文字列)
+		double begin;			// 開始時刻[s]
+		double end;				// 終了時刻[s]
+	};
+
+
+
+	// スレッドごとのリングバッファーにイベントを記録し、Chrome Trace形式で書き出すクラス
+	// 記録は呼び出したスレッドのバッファーへの書き込みのみでロックを取らない
+	// バッファーが一杯になったときは古いイベントから上書きする
+	class FFTrace{
+		/*** 定数 ***/
+	public:
+		// 1スレッドあたりに保持するイベント数
+		static const size_t BUFFER_SIZE = 65536;
+
+
+
+		/*** メンバー変数 ***/
+	private:
+		// 記録中か (記録するステップの範囲内のときのみtrue)
+		static std::atomic<bool> s_Active;
+
+
+
+		/*** メソッド ***/
+	public:
+		// 記録を有効にし、記録するステップの範囲を設定する
+		static void enable(uint64_t first_step, uint64_t last_step);
+
+		// 記録が有効か取得する
+		static bool isEnabled(void);
+
+		// 全スレッドのバッファーを空にして記録を開始する
+		// 時刻はここを原点とするため、全プロセスで同期してから呼び出すこと
+		static void start(void);
+
+		// 記録を停止する
+		static void stop(void);
+
+		// 現在のステップを設定し、範囲内であれば記録する
+		static void setStep(uint64_t step);
+
+		// 記録中か取得する
+		static bool isActive(void){
+			return s_Active.load(std::memory_order_relaxed);
+		}
+
+		// イベントを記録する
+		static void record(const char *name, const char *category, double begin, double end){
+			if (isActive()){
+				push(name, category, begin, end);
+			}
+		}
+
+		// 全スレッドのイベントをChrome TraceのJSONオブジェクトをカンマで区切った文字列にする
+		// 記録を停止してから呼び出すこと
+		static std::string exportEvents(int pid, const char *process_name);
+
+	private:
+		// 呼び出したスレッドのバッファーにイベントを書き込む
+		static void push(const char *name, const char *category, double begin, double end);
+	};
+
+
+
+	// スコープを抜けるまでをイベントとして記録するクラス
+	class FFTraceScope{
+	private:
+		// イベント名
+		const char *m_Name;
+
+		// 分類
+		const char *m_Category;
+
+		// 開始時刻[s] (記録しないときは負)
+		double m_Begin;
+
+	public:
+		// コンストラクタ
+		FFTraceScope(const char *name, const char *category);
+
+		// デストラクタ
+		~FFTraceScope();
+	};
+}
@@ -0,0 +1,78 @@
+﻿#include "FFTuneCache.h"
+#include "FFException.h"
+#include "../inih/ini.h"
+#include <stdio.h>
+
+
+
+namespace FFFDTD{
+	// ファイルを読み込む
+	bool FFTuneCache::load(const char *path){
+		m_Entries.clear();
+		m_Modified.clear();
+		return 0 <= ini_parse(path, iniCallback, &m_Entries);
+	}
+
+	// ファイルを読み直し、追加・変更したエントリーを反映して保存する
+	void FFTuneCache::save(const char *path){
+		if (m_Modified.empty()){
+			return;
+		}
+
+		// 他のプロセスが保存したエントリーを読み直す
+		std::map<std::string, std::map<std::string, std::string>> entries;
+		ini_parse(path, iniCallback, &entries);
+		for (auto &section : m_Modified){
+			for (auto &entry : section.second){
+				entries[section.first][entry.first] = entry.second;
+			}
+		}
+
+		FILE *fp = fopen(path, "w");
+		if (fp == nullptr){
+			throw FFException("failed to open '%s' for writing", path);
+		}
+		fprintf(fp, "; FFSolver kernel tuning cache\n");
+		fprintf(fp, "; [cpu name]\n");
+		fprintf(fp, "; <size_x>x<size_y>x<size_z>_L<lanes> = <variant> <threads> <tile_y> <tile_z> <schedule> <chunk>\n");
+		for (auto &section : entries){
+			fprintf(fp, "\n[%s]\n", section.first.c_str());
+			for (auto &entry : section.second){
+				fprintf(fp, "%s = %s\n", entry.first.c_str(), entry.second.c_str());
+			}
+		}
+		fclose(fp);
+
+		m_Entries = std::move(entries);
+		m_Modified.clear();
+	}
+
+	// エントリーを探す
+	bool FFTuneCache::find(const std::string &section, const std::string &key, std::string *value) const{
+		auto it_section = m_Entries.find(section);
+		if (it_section == m_Entries.end()){
+			return false;
+		}
+		auto it_entry = it_section->second.find(key);
+		if (it_entry == it_section->second.end()){
+			return false;
+		}
+		if (value != nullptr){
+			*value = it_entry->second;
+		}
+		return true;
+	}
+
+	// エントリーを追加・変更する
+	void FFTuneCache::store(const std::string &section, const std::string &key, const std::string &value){
+		m_Entries[section][key] = value;
+		m_Modified[section][key] = value;
+	}
+
+	// INIパーサーのコールバック関数
+	int FFTuneCache::iniCallback(void *user, const char *section, const char *name, const char *value){
+		auto *entries = reinterpret_cast<std::map<std::string, std::map<std::string, std::string>>*>(user);
+		(*entries)[section][name] = value;
+		return 1;
+	}
+}
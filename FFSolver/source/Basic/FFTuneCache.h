@@ -0,0 +1,48 @@
+﻿#pragma once
+
+#include <map>
+#include <string>
+
+
+
+namespace FFFDTD{
+	// カーネルの調整結果をホストごとに保存するキャッシュ
+	// INI形式でCPUの名前をセクション、領域の形状をキーとして調整結果の文字列を保持する
+	// 複数のプロセスで共有するときは、全プロセスが読み込んでから1プロセスずつ保存すること
+	class FFTuneCache{
+		/*** メンバー変数 ***/
+	private:
+		// セクションごとのキーと値
+		std::map<std::string, std::map<std::string, std::string>> m_Entries;
+
+		// 読み込んでから追加・変更したエントリー
+		std::map<std::string, std::map<std::string, std::string>> m_Modified;
+
+
+
+		/*** メソッド ***/
+	public:
+		// ファイルを読み込む
+		// ファイルが存在しないときは空のキャッシュとしてfalseを返す
+		bool load(const char *path);
+
+		// ファイルを読み直し、追加・変更したエントリーを反映して保存する
+		// 他のプロセスが先に保存したエントリーは保持される
+		void save(const char *path);
+
+		// エントリーを探す
+		bool find(const std::string &section, const std::string &key, std::string *value) const;
+
+		// エントリーを追加・変更する
+		void store(const std::string &section, const std::string &key, const std::string &value);
+
+		// 追加・変更したエントリーがあるか取得する
+		bool isModified(void) const{
+			return !m_Modified.empty();
+		}
+
+	private:
+		// INIパーサーのコールバック関数
+		static int iniCallback(void *user, const char *section, const char *name, const char *value);
+	};
+}
@@ -1,6 +1,7 @@
 ﻿#pragma once
 
 #include "FFType.h"
+#include <algorithm>
 
 
 
@@ -8,11 +9,11 @@ namespace FFFDTD{
 	// 回路部品の抽象クラス
 	class FFCircuit{
 	private:
-		// 端子電圧の履歴
-		std::vector<double> m_VoltageHistory;
+		// 端子電圧の履歴 (レーンごと)
+		std::vector<std::vector<double>> m_VoltageHistory;
 
-		// 端子電流の履歴
-		std::vector<double> m_CurrentHistory;
+		// 端子電流の履歴 (レーンごと)
+		std::vector<std::vector<double>> m_CurrentHistory;
 
 		// タイムステップ
 		double m_Timestep;
@@ -25,33 +26,41 @@ namespace FFFDTD{
 		virtual ~FFCircuit(){};
 
 		// メモリーを確保する
-		virtual void allocate(size_t size, double timestep){
-			m_VoltageHistory.resize(size, 0.0);
-			m_CurrentHistory.resize(size, 0.0);
+		virtual void allocate(size_t size, double timestep, index_t lanes = 1){
+			m_VoltageHistory.assign(lanes, std::vector<double>(size, 0.0));
+			m_CurrentHistory.assign(lanes, std::vector<double>(size, 0.0));
 			m_Timestep = timestep;
 		}
 
+		// 指定したレーンで励振するか設定する
+		virtual void setExcitation(index_t /*lane*/, bool /*excited*/){}
+
 		// 端子電圧V[n]を計算する
-		virtual double calcVoltage(size_t n, double current) = 0;
+		virtual double calcVoltage(size_t n, index_t lane, double current) = 0;
+
+		// レーン数を取得する
+		index_t lanes(void) const{
+			return (index_t)m_VoltageHistory.size();
+		}
 
 		// 端子電圧の履歴を取得する
-		const std::vector<double>& getVoltageHistory(void) const{
-			return m_VoltageHistory;
+		const std::vector<double>& getVoltageHistory(index_t lane = 0) const{
+			return m_VoltageHistory[lane];
 		}
 
 		// 端子電流の履歴を取得する
-		const std::vector<double>& getCurrentHistory(void) const{
-			return m_CurrentHistory;
+		const std::vector<double>& getCurrentHistory(index_t lane = 0) const{
+			return m_CurrentHistory[lane];
 		}
 
 		// 端子電圧V[n-m]を取得する
-		double voltage(size_t n, size_t m) const{
-			return (m <= n) ? m_VoltageHistory[n - m] : 0.0;
+		double voltage(size_t n, size_t m, index_t lane = 0) const{
+			return (m <= n) ? m_VoltageHistory[lane][n - m] : 0.0;
 		}
 
 		// 端子電流I[n-m-1/2]を取得する
-		double current(size_t n, size_t m) const{
-			return (m <= n) ? m_CurrentHistory[n - m] : 0.0;
+		double current(size_t n, size_t m, index_t lane = 0) const{
+			return (m <= n) ? m_CurrentHistory[lane][n - m] : 0.0;
 		}
 
 		// タイムステップを取得する
@@ -59,11 +68,22 @@ namespace FFFDTD{
 			return m_Timestep;
 		}
 
+		// 端子電圧・端子電流のステップn以降の履歴を、計算せずに求めた値 (打ち切り後の外挿値) で置き換える
+		void storeExtrapolation(size_t n, index_t lane, const std::vector<double> &voltage, const std::vector<double> &current){
+			std::vector<double> &voltage_history = m_VoltageHistory[lane];
+			std::vector<double> &current_history = m_CurrentHistory[lane];
+			if ((voltage_history.size() < n + voltage.size()) || (current_history.size() < n + current.size())){
+				throw;
+			}
+			std::copy(voltage.begin(), voltage.end(), voltage_history.begin() + n);
+			std::copy(current.begin(), current.end(), current_history.begin() + n);
+		}
+
 	protected:
 		// 端子電圧V[n]と端子電流I[n-1/2]を格納する
-		void storeValues(size_t n, double voltage, double current){
-			m_VoltageHistory[n] = voltage;
-			m_CurrentHistory[n] = current;
+		void storeValues(size_t n, index_t lane, double voltage, double current){
+			m_VoltageHistory[lane][n] = voltage;
+			m_CurrentHistory[lane][n] = current;
 		}
 	};
 }
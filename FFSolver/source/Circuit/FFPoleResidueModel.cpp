@@ -0,0 +1,338 @@
+﻿#include "FFPoleResidueModel.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+
+
+namespace FFFDTD{
+	// 実数の共役を取得する
+	static inline double conjugate(double value){
+		return value;
+	}
+
+	// 複素数の共役を取得する
+	static inline std::complex<double> conjugate(const std::complex<double> &value){
+		return std::conj(value);
+	}
+
+	// 実数の符号を取得する (0のときは1とする)
+	static inline double phase(double value){
+		return (value < 0.0) ? -1.0 : 1.0;
+	}
+
+	// 複素数の偏角の単位複素数を取得する (0のときは1とする)
+	static inline std::complex<double> phase(const std::complex<double> &value){
+		double r = std::abs(value);
+		return (0.0 < r) ? value / r : std::complex<double>(1.0, 0.0);
+	}
+
+
+
+	// コンストラクタ
+	FFPoleResidueModel::FFPoleResidueModel(void)
+		: m_Origin(0)
+		, m_PoleList(), m_ResidueList()
+	{
+
+	}
+
+	// 信号のリストのステップ[start, start + decimation * count)にモデルを当てはめる
+	bool FFPoleResidueModel::fit(const std::vector<const std::vector<double>*> &signal_list, size_t start, size_t count, size_t decimation, size_t order){
+		m_Origin = start;
+		m_PoleList.clear();
+		m_ResidueList.assign(signal_list.size(), complex_t(0.0, 0.0));
+		if ((decimation == 0) || (count == 0)){
+			return false;
+		}
+
+		// 極の数は方程式の数が未知数の2倍以上となるように制限する
+		size_t p = std::min(order, count / 3);
+		if (p == 0){
+			return false;
+		}
+
+		// decimationステップごとに平均して間引き、信号ごとに二乗平均平方根で正規化する
+		// 常に0の信号は極の推定に使わない
+		std::vector<std::vector<double>> sample_list;
+		std::vector<size_t> valid_list;
+		std::vector<double> scale_list;
+		for (size_t s = 0; s < signal_list.size(); s++){
+			const std::vector<double> &signal = *signal_list[s];
+			if (signal.size() < start + decimation * count){
+				return false;
+			}
+			std::vector<double> sample(count, 0.0);
+			double sum2 = 0.0;
+			for (size_t k = 0; k < count; k++){
+				double sum = 0.0;
+				for (size_t d = 0; d < decimation; d++){
+					sum += signal[start + k * decimation + d];
+				}
+				sample[k] = sum / decimation;
+				sum2 += sample[k] * sample[k];
+			}
+			if ((std::isfinite(sum2) == false)){
+				return false;
+			}
+			if (0.0 < sum2){
+				double scale = std::sqrt(sum2 / count);
+				for (double &value : sample){
+					value /= scale;
+				}
+				sample_list.push_back(sample);
+				valid_list.push_back(s);
+				scale_list.push_back(scale);
+			}
+		}
+		if (valid_list.empty()){
+			// 全ての信号が0のときは極のないモデルとする
+			return true;
+		}
+
+		// 全ての信号に共通の前向き線形予測の係数を求める
+		// y[k] + c[0] y[k-1] + ... + c[p-1] y[k-p] = 0 を最小二乗法で解く
+		size_t rows_per_signal = count - p;
+		size_t rows = rows_per_signal * valid_list.size();
+		std::vector<double> a(rows * p), b(rows);
+		double frobenius = 0.0;
+		for (size_t v = 0; v < valid_list.size(); v++){
+			const std::vector<double> &sample = sample_list[v];
+			for (size_t r = 0; r < rows_per_signal; r++){
+				size_t row = v * rows_per_signal + r;
+				size_t k = p + r;
+				for (size_t j = 0; j < p; j++){
+					a[row + rows * j] = sample[k - j - 1];
+					frobenius += sample[k - j - 1] * sample[k - j - 1];
+				}
+				b[row] = -sample[k];
+			}
+		}
+		std::vector<double> coef;
+		double ridge = 1.0e-6 * std::sqrt(frobenius / p);
+		if (solveLeastSquares(a, rows, p, b, 1, ridge, coef) == false){
+			return false;
+		}
+
+		// 特性多項式の根から、増大しない根を間引いたサンプルあたりの極とする
+		std::vector<complex_t> root_list = findRoots(coef);
+		std::vector<complex_t> sample_pole_list;
+		for (const complex_t &root : root_list){
+			if (std::isfinite(root.real()) && std::isfinite(root.imag()) && (std::abs(root) <= 1.0 + 1.0e-9)){
+				sample_pole_list.push_back(root);
+			}
+		}
+		size_t num_of_poles = sample_pole_list.size();
+		if (num_of_poles == 0){
+			return false;
+		}
+
+		// 極を固定し、信号ごとの留数をVandermonde行列の最小二乗法で求める
+		std::vector<complex_t> va(count * num_of_poles), vb(count * valid_list.size());
+		for (size_t i = 0; i < num_of_poles; i++){
+			complex_t power(1.0, 0.0);
+			for (size_t k = 0; k < count; k++){
+				va[k + count * i] = power;
+				power *= sample_pole_list[i];
+			}
+		}
+		for (size_t v = 0; v < valid_list.size(); v++){
+			for (size_t k = 0; k < count; k++){
+				vb[k + count * v] = sample_list[v][k];
+			}
+		}
+		std::vector<complex_t> residue;
+		if (solveLeastSquares(va, count, num_of_poles, vb, valid_list.size(), 1.0e-10 * std::sqrt((double)count), residue) == false){
+			return false;
+		}
+
+		// 間引いたサンプルの極と留数を1ステップあたりに変換する
+		// 平均したサンプルでは留数に (1/D) Σ_{d<D} z^d が掛かるため、これで割って戻す
+		m_PoleList.resize(num_of_poles);
+		m_ResidueList.assign(signal_list.size() * num_of_poles, complex_t(0.0, 0.0));
+		for (size_t i = 0; i < num_of_poles; i++){
+			const complex_t &w = sample_pole_list[i];
+			complex_t z = std::polar(std::pow(std::abs(w), 1.0 / decimation), std::arg(w) / decimation);
+			complex_t gain(0.0, 0.0), power(1.0, 0.0);
+			for (size_t d = 0; d < decimation; d++){
+				gain += power;
+				power *= z;
+			}
+			gain /= (double)decimation;
+			if (std::abs(gain) < 1.0e-12){
+				m_PoleList.clear();
+				m_ResidueList.assign(signal_list.size(), complex_t(0.0, 0.0));
+				return false;
+			}
+			m_PoleList[i] = z;
+			for (size_t v = 0; v < valid_list.size(); v++){
+				m_ResidueList[valid_list[v] * num_of_poles + i] = scale_list[v] * residue[i + num_of_poles * v] / gain;
+			}
+		}
+		return true;
+	}
+
+	// 最も遅く減衰する極の時定数[ステップ]を取得する
+	// |z|^n = exp(n log|z|) より、時定数は -1 / log|z| となる
+	double FFPoleResidueModel::getDecaySteps(void) const{
+		double max_abs = 0.0;
+		for (const complex_t &z : m_PoleList){
+			max_abs = std::max(max_abs, std::abs(z));
+		}
+		if (max_abs <= 0.0){
+			return 0.0;
+		}
+		if (1.0 <= max_abs){
+			return std::numeric_limits<double>::infinity();
+		}
+		return -1.0 / std::log(max_abs);
+	}
+
+	// 信号signalのステップ[start, start + count)の値を予測する
+	void FFPoleResidueModel::predict(size_t signal, size_t start, size_t count, std::vector<double> &value_list) const{
+		value_list.assign(count, 0.0);
+		size_t num_of_poles = m_PoleList.size();
+		double offset = (double)start - (double)m_Origin;
+		for (size_t i = 0; i < num_of_poles; i++){
+			const complex_t &z = m_PoleList[i];
+			complex_t term = m_ResidueList[signal * num_of_poles + i] * std::polar(std::pow(std::abs(z), offset), std::arg(z) * offset);
+			for (size_t n = 0; n < count; n++){
+				value_list[n] += term.real();
+				term *= z;
+			}
+		}
+	}
+
+	// 最小二乗法で a x = b を解く
+	// 正則化の行を追加した行列をHouseholder変換でQR分解し、後退代入で解く
+	template<typename T>
+	bool FFPoleResidueModel::solveLeastSquares(const std::vector<T> &a, size_t rows, size_t cols, const std::vector<T> &b, size_t rhs, double ridge, std::vector<T> &x){
+		size_t m = rows + cols;
+		std::vector<T> qa(m * cols, T(0.0)), qb(m * rhs, T(0.0));
+		for (size_t j = 0; j < cols; j++){
+			for (size_t i = 0; i < rows; i++){
+				qa[i + m * j] = a[i + rows * j];
+			}
+			qa[rows + j + m * j] = T(ridge);
+		}
+		for (size_t r = 0; r < rhs; r++){
+			for (size_t i = 0; i < rows; i++){
+				qb[i + m * r] = b[i + rows * r];
+			}
+		}
+
+		std::vector<T> diagonal(cols);
+		for (size_t k = 0; k < cols; k++){
+			T *column = &qa[m * k];
+			double norm2 = 0.0;
+			for (size_t i = k; i < m; i++){
+				norm2 += std::norm(column[i]);
+			}
+			if ((norm2 <= 0.0) || (std::isfinite(norm2) == false)){
+				return false;
+			}
+
+			// 列を (alpha, 0, ..., 0) に写す鏡映ベクトル v = x - alpha e1 を列に上書きする
+			T alpha = -phase(column[k]) * std::sqrt(norm2);
+			column[k] -= alpha;
+			double vnorm2 = 0.0;
+			for (size_t i = k; i < m; i++){
+				vnorm2 += std::norm(column[i]);
+			}
+			diagonal[k] = alpha;
+			if (vnorm2 <= 0.0){
+				continue;
+			}
+
+			// 残りの列と右辺に H = I - 2 v v^H / |v|^2 を掛ける
+			auto reflect = [&](T *target){
+				T dot(0.0);
+				for (size_t i = k; i < m; i++){
+					dot += conjugate(column[i]) * target[i];
+				}
+				T f = dot * (2.0 / vnorm2);
+				for (size_t i = k; i < m; i++){
+					target[i] -= f * column[i];
+				}
+			};
+			for (size_t j = k + 1; j < cols; j++){
+				reflect(&qa[m * j]);
+			}
+			for (size_t r = 0; r < rhs; r++){
+				reflect(&qb[m * r]);
+			}
+		}
+
+		// 後退代入
+		x.assign(cols * rhs, T(0.0));
+		for (size_t r = 0; r < rhs; r++){
+			for (size_t k = cols; 0 < k--;){
+				T sum = qb[k + m * r];
+				for (size_t j = k + 1; j < cols; j++){
+					sum -= qa[k + m * j] * x[j + cols * r];
+				}
+				x[k + cols * r] = sum / diagonal[k];
+				if (std::isfinite(std::abs(x[k + cols * r])) == false){
+					return false;
+				}
+			}
+		}
+		return true;
+	}
+
+	// 係数coefの多項式の根を求める (Aberth法)
+	std::vector<FFPoleResidueModel::complex_t> FFPoleResidueModel::findRoots(const std::vector<double> &coef){
+		const int MAX_ITERATION = 1000;
+		size_t p = coef.size();
+		std::vector<complex_t> root_list(p);
+		if (p == 0){
+			return root_list;
+		}
+
+		// 根の大きさの目安の円周上に初期値を並べる
+		double radius = 0.0;
+		for (size_t j = 0; j < p; j++){
+			radius = std::max(radius, std::pow(std::abs(coef[j]), 1.0 / (j + 1)));
+		}
+		if (radius == 0.0){
+			return root_list;
+		}
+		const double PI = 3.14159265358979323846;
+		for (size_t k = 0; k < p; k++){
+			root_list[k] = std::polar(radius, 2.0 * PI * k / p + 0.4);
+		}
+
+		for (int iteration = 0; iteration < MAX_ITERATION; iteration++){
+			double max_correction = 0.0;
+			for (size_t k = 0; k < p; k++){
+				// Horner法で多項式と導関数の値を求める
+				complex_t z = root_list[k];
+				complex_t value(1.0, 0.0), derivative(0.0, 0.0);
+				for (size_t j = 0; j < p; j++){
+					derivative = derivative * z + value;
+					value = value * z + coef[j];
+				}
+				if (value == complex_t(0.0, 0.0)){
+					continue;
+				}
+				complex_t ratio = value / derivative;
+				complex_t repulsion(0.0, 0.0);
+				for (size_t j = 0; j < p; j++){
+					if (j != k){
+						repulsion += 1.0 / (z - root_list[j]);
+					}
+				}
+				complex_t correction = ratio / (1.0 - ratio * repulsion);
+				if ((std::isfinite(correction.real()) == false) || (std::isfinite(correction.imag()) == false)){
+					continue;
+				}
+				root_list[k] = z - correction;
+				max_correction = std::max(max_correction, std::abs(correction) / std::max(std::abs(root_list[k]), 1.0e-3));
+			}
+			if (max_correction < 1.0e-14){
+				break;
+			}
+		}
+		return root_list;
+	}
+}
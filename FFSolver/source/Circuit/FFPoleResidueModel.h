@@ -0,0 +1,63 @@
+﻿#pragma once
+
+#include "FFType.h"
+
+
+
+namespace FFFDTD{
+	// 複数の信号を共通の極と信号ごとの留数で表す極・留数モデル
+	// 信号sのステップnの値を x_s[n] = Re Σ a_si z_i^(n - origin) とする
+	// 窓内のサンプルを一定のステップ数ごとに平均して間引き、線形予測の最小二乗法 (Prony法) で極を求め、
+	// 極を固定した最小二乗法で留数を求める
+	class FFPoleResidueModel{
+		/*** 定義 ***/
+	public:
+		using complex_t = std::complex<double>;
+
+
+
+		/*** メンバー変数 ***/
+	private:
+		// モデルの基準のステップ
+		size_t m_Origin;
+
+		// 1ステップあたりの極のリスト
+		std::vector<complex_t> m_PoleList;
+
+		// 信号ごとの留数のリスト (信号ごとに極の数分並べる)
+		std::vector<complex_t> m_ResidueList;
+
+
+
+		/*** メソッド ***/
+	public:
+		// コンストラクタ
+		FFPoleResidueModel(void);
+
+		// 信号のリストのステップ[start, start + decimation * count)にモデルを当てはめる
+		// decimationステップごとの平均を1サンプルとし、最大order個の極を求める
+		// 間引いたサンプルのナイキスト周波数より高い周波数の成分は含まないものとする
+		// 当てはめられないときはfalseを返す
+		bool fit(const std::vector<const std::vector<double>*> &signal_list, size_t start, size_t count, size_t decimation, size_t order);
+
+		// 極の数を取得する
+		size_t getNumberOfPoles(void) const{
+			return m_PoleList.size();
+		}
+
+		// 最も遅く減衰する極の時定数[ステップ]を取得する (減衰しない極があるときは無限大、極がないときは0)
+		double getDecaySteps(void) const;
+
+		// 信号signalのステップ[start, start + count)の値を予測する
+		void predict(size_t signal, size_t start, size_t count, std::vector<double> &value_list) const;
+
+	private:
+		// 最小二乗法で a x = b を解く (aはrows×colsの列優先の行列、bはrows×rhsの列優先の行列)
+		// 特異値の小さい方向に解が大きくならないよう、ridge倍の単位行列を追加した行で正則化する
+		template<typename T>
+		static bool solveLeastSquares(const std::vector<T> &a, size_t rows, size_t cols, const std::vector<T> &b, size_t rhs, double ridge, std::vector<T> &x);
+
+		// 係数coefの多項式 z^p + coef[0] z^(p-1) + ... + coef[p-1] の根を求める (Aberth法)
+		static std::vector<complex_t> findRoots(const std::vector<double> &coef);
+	};
+}
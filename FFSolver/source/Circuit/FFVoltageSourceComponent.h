@@ -15,10 +15,13 @@ namespace FFFDTD{
 		// 内部直列抵抗
 		double m_ESR;
 
+		// レーンごとの励振の有無
+		std::vector<bool> m_Excitation;
+
 	public:
 		// コンストラクタ
 		FFVoltageSourceComponent(FFWaveform *waveform, double esr = 0.0)
-			: m_Waveform(waveform), m_ESR(esr)
+			: m_Waveform(waveform), m_ESR(esr), m_Excitation()
 		{
 
 		}
@@ -28,11 +31,23 @@ namespace FFFDTD{
 			delete m_Waveform;
 		}
 
+		// メモリーを確保する
+		void allocate(size_t size, double timestep, index_t lanes = 1) override{
+			FFCircuit::allocate(size, timestep, lanes);
+			m_Excitation.assign(lanes, true);
+		}
+
+		// 指定したレーンで励振するか設定する
+		void setExcitation(index_t lane, bool excited) override{
+			m_Excitation[lane] = excited;
+		}
+
 		// 端子電圧V[n]を計算する
-		double calcVoltage(size_t n, double current) override{
-			double vinc = m_Waveform->getValue(dt() * n);
+		// 励振しないレーンでは内部抵抗のみの終端として振る舞う
+		double calcVoltage(size_t n, index_t lane, double current) override{
+			double vinc = m_Excitation[lane] ? m_Waveform->getValue(dt() * n) : 0.0;
 			double voltage = vinc - m_ESR * current;
-			storeValues(n, voltage, current);
+			storeValues(n, lane, voltage, current);
 			return voltage;
 		}
 	};
@@ -32,4 +32,27 @@ namespace FFFDTD{
 	// 材質IDの最大値
 	static const matid_t MAX_MATID = 65535;
 
+	// サブグリッドの細分化比 (粗いグリッドの1セルを各軸方向に等分する数)
+	// 細かいグリッドの面内の電界を最も近い粗いグリッドの電界に割り当てるため、奇数とする
+	static const index_t SUBGRID_RATIO = 3;
+
+	// 打ち切り判定で極・留数モデルを当てはめる窓のサンプル数 (間引いた後のサンプル数)
+	static const size_t EARLY_STOP_SAMPLES = 512;
+
+	// 打ち切り判定の極・留数モデルの極の数の最大値
+	static const size_t EARLY_STOP_ORDER = 128;
+
+	// 打ち切り判定を行う間隔 (間引いた後のサンプル数)
+	static const size_t EARLY_STOP_INTERVAL = 64;
+
+	// 打ち切り判定でモデルを検証するステップ数の、モデルの最も遅い極の時定数に対する倍率
+	static const double EARLY_STOP_HOLDOUT = 2.0;
+
+	// CPMLのκの最大値の既定値
+	// 1セルあたりの波長が短い広帯域のパルスでは、κを大きくすると層内の離散化による反射が増えるため1とする
+	static const double DEFAULT_CPML_KAPPA = 1.0;
+
+	// CPMLのαの最大値[S/m]の既定値
+	static const double DEFAULT_CPML_ALPHA = 0.3;
+
 }
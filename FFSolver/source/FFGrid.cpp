@@ -22,7 +22,7 @@ namespace FFFDTD{
 	}
 
 	// グリッドの付随情報を計算する
-	void FFGrid::precompute(bool periodic){
+	void FFGrid::precompute(bool periodic, bool pmc_lower){
 		// グリッド上でのセル間隔を計算する
 		m_MidWidth.resize(m_Width.size() + 1);
 		for (index_t i = 1; i < (index_t)m_Width.size(); i++){
@@ -36,6 +36,9 @@ namespace FFFDTD{
 			m_MidWidth[0] = (m_Width[0] + m_Width[m_Width.size() - 1]) * 0.5;
 			m_MidWidth[m_MidWidth.size() - 1] = m_MidWidth[0];
 		}
+		if (pmc_lower){
+			m_MidWidth[0] = m_Width[0] * 0.5;
+		}
 
 		// グリッドの座標を計算する
 		double p = 0.0;
@@ -34,7 +34,8 @@ namespace FFFDTD{
 		FFGrid(const std::vector<double> &width);
 
 		// グリッドの付随情報を計算する
-		void precompute(bool periodic);
+		// 負端がPMCの対称面のときは、負端のグリッド上の間隔を面の内側の半セルとする
+		void precompute(bool periodic, bool pmc_lower = false);
 
 		// グリッドの分割数を取得する
 		index_t count(void) const{
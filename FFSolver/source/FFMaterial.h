@@ -57,27 +57,27 @@ namespace FFFDTD{
 		}
 
 		// 電界の係数を計算する
-		rvec3 calcECoef(double dt, double dl1, double dl2) const{
+		dvec3 calcECoef(double dt, double dl1, double dl2) const{
 			return calcECoef(m_eps_r, m_sigma, dt, dl1, dl2);
 		}
 
 		// PML中の電界の係数を計算する
-		rvec2 calcECoefPML(double dt) const{
+		dvec2 calcECoefPML(double dt) const{
 			return calcECoefPML(m_eps_r, m_sigma, dt);
 		}
 
 		// PML中の電束密度の係数を計算する
-		rvec2 calcDCoefPML(double dt, double dl) const{
+		dvec2 calcDCoefPML(double dt, double dl) const{
 			return calcDCoefPML(m_eps_r, 0.0, dt, dl);
 		}
 
 		// 磁界の係数を計算する
-		rvec3 calcHCoef(double dt, double dl1, double dl2) const{
+		dvec3 calcHCoef(double dt, double dl1, double dl2) const{
 			return calcHCoef(m_mu_r, 0.0, dt, dl1, dl2);
 		}
 
 		// PML中の磁界の係数を計算する
-		rvec2 calcHCoefPML(double dt, double dl) const{
+		dvec2 calcHCoefPML(double dt, double dl) const{
 			return calcHCoefPML(m_mu_r, 0.0, dt, dl);
 		}
 
@@ -88,45 +88,58 @@ namespace FFFDTD{
 		}
 
 		// 電界の係数を計算する
-		static rvec3 calcECoef(double eps_r, double sigma, double dt, double dl1, double dl2){
+		static dvec3 calcECoef(double eps_r, double sigma, double dt, double dl1, double dl2){
 			double p1 = 2.0 * EPS_0 * eps_r;
 			double p2 = sigma * dt;
 			double r12 = 1.0 / (p1 + p2);
 			double s1 = 2.0 * dt * r12;
-			return rvec3((real)((p1 - p2) * r12), (real)(s1 / dl1), (real)(s1 / dl2));
+			return dvec3((p1 - p2) * r12, s1 / dl1, s1 / dl2);
 		}
 
 		// PML中の電界の係数を計算する
-		static rvec2 calcECoefPML(double eps_r, double sigma, double dt){
+		static dvec2 calcECoefPML(double eps_r, double sigma, double dt){
 			double p1 = 2.0 * EPS_0 * eps_r;
 			double p2 = sigma * dt;
 			double r12 = 1.0 / (p1 + p2);
-			return rvec2((real)((p1 - p2) * r12), (real)(2.0 * r12));
+			return dvec2((p1 - p2) * r12, 2.0 * r12);
 		}
 
 		// PML中の電束密度の係数を計算する
-		static rvec2 calcDCoefPML(double eps_r, double pml_sigma, double dt, double dl){
+		static dvec2 calcDCoefPML(double eps_r, double pml_sigma, double dt, double dl){
 			double p1 = 2.0 * EPS_0 * eps_r;
 			double p2 = pml_sigma * dt;
 			double r12 = 1.0 / (p1 + p2);
-			return rvec2((real)((p1 - p2) * r12), (real)(p1 * dt * r12 / dl));
+			return dvec2((p1 - p2) * r12, p1 * dt * r12 / dl);
 		}
 
 		// 磁界の係数を計算する
-		static rvec3 calcHCoef(double mu_r, double sigma_m, double dt, double dl1, double dl2){
+		static dvec3 calcHCoef(double mu_r, double sigma_m, double dt, double dl1, double dl2){
 			double p1 = 2.0 * MU_0 * mu_r;
 			double p2 = sigma_m * dt;
 			double r12 = 1.0 / (p1 + p2);
 			double s1 = 2.0 * dt * r12;
-			return rvec3((real)((p1 - p2) * r12), (real)(s1 / dl1), (real)(s1 / dl2));
+			return dvec3((p1 - p2) * r12, s1 / dl1, s1 / dl2);
 		}
 
 		// PML中の磁界の係数を計算する
-		static rvec2 calcHCoefPML(double mu_r, double pml_sigma_m, double dt, double dl){
+		static dvec2 calcHCoefPML(double mu_r, double pml_sigma_m, double dt, double dl){
 			double p1 = 2.0 * MU_0 * mu_r;
 			double p2 = pml_sigma_m * dt;
 			double r12 = 1.0 / (p1 + p2);
-			return rvec2((real)((p1 - p2) * r12), (real)(2.0 * dt * r12 / dl));
+			return dvec2((p1 - p2) * r12, 2.0 * dt * r12 / dl);
+		}
+
+		// CPMLの補助変数の係数(b, a)と差分の係数gを計算する
+		// sigma_nとalpha_nは導電率とαを誘電率 (磁界では透磁率) で割った値[1/s]
+		// 伸長係数の逆数1/(κ + σ/(α + jωε))を双一次変換で離散化し、差分にgを掛けた値に補助変数ψを加える
+		// 補助変数は電磁界の更新の後にψ = b * ψ + a * (差分) と更新する (κが1、αが0のときは分割型PMLと一致する)
+		static dvec3 calcCoefCPML(double sigma_n, double kappa, double alpha_n, double dt){
+			double ya = 0.5 * alpha_n * dt;
+			double yp = 0.5 * (alpha_n + sigma_n / kappa) * dt;
+			double ba = (1.0 - ya) / (1.0 + ya);
+			double bp = (1.0 - yp) / (1.0 + yp);
+			double g = (1.0 + ya) / (kappa * (1.0 + yp));
+			return dvec3(bp, g * (bp - ba), g);
 		}
 	};
 }
@@ -19,8 +19,13 @@ namespace FFFDTD{
 	}
 
 	// メモリーを確保する
-	void FFPort::allocate(size_t size, double timestep){
-		m_Circuit->allocate(size, timestep);
+	void FFPort::allocate(size_t size, double timestep, index_t lanes){
+		m_Circuit->allocate(size, timestep, lanes);
+	}
+
+	// 指定したレーンで励振するか設定する
+	void FFPort::setExcitation(index_t lane, bool excited){
+		m_Circuit->setExcitation(lane, excited);
 	}
 
 	// 電界プローブを割り当てる
@@ -37,15 +42,18 @@ namespace FFFDTD{
 
 	// 次の出力値を計算する
 	void FFPort::calcValue(FFSolver *solver, size_t n){
-		// 磁界の観測値から電流を計算する
-		double current = 0.0;
-		for (size_t i = 0; i < m_MProbeIDList.size(); i++){
-			current += solver->getProbeValue(m_MProbeIDList[i], n, ProbeType::TD) * m_MProbeCoefList[i];
+		index_t lanes = solver->getLanes();
+		for (index_t lane = 0; lane < lanes; lane++){
+			// 磁界の観測値から電流を計算する
+			double current = 0.0;
+			for (size_t i = 0; i < m_MProbeIDList.size(); i++){
+				current += solver->getProbeValue(m_MProbeIDList[i], n, lane, ProbeType::TD) * m_MProbeCoefList[i];
+			}
+
+			// 電圧を計算し、電界を励振する
+			double voltage = m_Circuit->calcVoltage(n, lane, current);
+			solver->setTDProbeValue(m_EProbeID, lane, -voltage * m_EProbeCoef);
 		}
-
-		// 電圧を計算し、電界を励振する
-		double voltage = m_Circuit->calcVoltage(n, current);
-		solver->setTDProbeValue(m_EProbeID, (real)(-voltage * m_EProbeCoef));
 	}
 	
 }
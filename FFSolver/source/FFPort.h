@@ -34,7 +34,10 @@ namespace FFFDTD{
 		~FFPort();
 
 		// メモリーを確保する
-		void allocate(size_t size, double timestep);
+		void allocate(size_t size, double timestep, index_t lanes = 1);
+
+		// 指定したレーンで励振するか設定する
+		void setExcitation(index_t lane, bool excited);
 
 		// 電界プローブを割り当てる
 		void attachEProbe(oindex_t probe_id, double iwidth);
@@ -49,6 +52,11 @@ namespace FFFDTD{
 		const FFCircuit* getCircuit(void) const{
 			return m_Circuit;
 		}
+
+		// 回路を取得する
+		FFCircuit* getCircuit(void){
+			return m_Circuit;
+		}
 	};
 }
 
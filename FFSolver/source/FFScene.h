@@ -0,0 +1,100 @@
+﻿#pragma once
+
+#include "FFSituation.h"
+#include <string>
+
+
+
+namespace FFFDTD{
+	// シミュレーションの入力をメモリー上に保持する構造体
+	// 入力ファイルを経由せずにFFSimulationへシミュレーション環境を渡すときに使う
+	struct FFScene{
+		// 直方体の物体
+		struct Cuboid_t{
+			bool pec;				// PECワイヤーとして配置するか
+			matid_t matid;			// 材質ID (PECワイヤーのときは無視する)
+			index3_t start, end;	// 始点と終点
+		};
+
+		// 電圧源のポート
+		struct Port_t{
+			index3_t pos;			// 位置
+			DIR_e dir;				// 方向
+			std::string waveform;	// 波形の式
+			double esr;				// 内部抵抗[Ω]
+		};
+
+		// 時間ドメインプローブ
+		struct Probe_t{
+			index3_t pos;			// 位置 (観測する成分のグリッド番号)
+			EMType type;			// 観測する成分
+		};
+
+		// 細分化したサブグリッド
+		// 物体と入れ子のサブグリッドは、直方体の始点を原点とした細かいグリッドの座標で指定する
+		struct Subgrid_t{
+			index3_t start, end;					// 直方体の始点と終点 (グリッド番号の閉区間)
+			std::vector<Cuboid_t> object_list;		// サブグリッドの中だけに配置する物体のリスト
+			std::vector<Subgrid_t> subgrid_list;	// 入れ子のサブグリッドのリスト
+		};
+
+		// グリッド
+		FFGrid grid_x, grid_y, grid_z;
+
+		// 境界条件
+		BC_t bc;
+
+		// 材質リスト (MATID=1から順に並べ、MATID=0の真空は含まない)
+		// 各材質はスイープするレーンごとの物性値を持つ (1件のときは全レーンで共有する)
+		std::vector<std::vector<FFMaterial>> material_list;
+
+		// 物体リスト
+		std::vector<Cuboid_t> object_list;
+
+		// ポートリスト
+		std::vector<Port_t> port_list;
+
+		// プローブリスト
+		std::vector<Probe_t> probe_list;
+
+		// サブグリッドのリスト (全体の物体はサブグリッドにも同じ範囲で配置する)
+		std::vector<Subgrid_t> subgrid_list;
+
+		// タイムステップ[s] (0以下のときは最適なタイムステップを使う)
+		double timestep;
+
+		// 計算ステップ数
+		size_t iteration;
+
+		// 周波数ドメインプローブの解析周波数のリスト
+		std::vector<double> freq_list;
+
+		// レーンごとに励振するポートの番号 (空のときは1レーンで全てのポートを励振する)
+		std::vector<oindex_t> excitation_list;
+
+		// 電磁界成分の精度
+		Precision precision;
+
+		// 空間差分の次数 (2または4。4のときは均一な材質とグリッドの領域だけ4次精度の差分を使う)
+		int spatial_order;
+
+		// Z方向の差分を陰的に扱うHIE法を使うか (タイムステップをX・Y方向のセル幅だけで決める)
+		bool implicit_z;
+
+		// 打ち切り判定の許容誤差 (0のときは打ち切らない)
+		// ポートの電圧・電流に当てはめた極・留数モデルで、最も遅い極の時定数の2倍のステップ数にわたって予測した誤差が、
+		// 全ての信号でその信号の外挿する残りの区間の大きさに対してこの相対誤差以内のときに計算を打ち切り、
+		// 残りのステップの電圧・電流の履歴をモデルで外挿する
+		double early_stop_tolerance;
+
+		// 打ち切り判定のモデルで扱う最大周波数[Hz] (0のときは解析周波数の最大値を使う)
+		double early_stop_max_freq;
+
+		// コンストラクタ
+		FFScene(void)
+			: timestep(0.0), iteration(0), precision(DEFAULT_PRECISION), spatial_order(2), implicit_z(false)
+			, early_stop_tolerance(0.0), early_stop_max_freq(0.0)
+		{
+		}
+	};
+}
@@ -0,0 +1,612 @@
+﻿#include "FFSimulation.h"
+#include "FFSubgrid.h"
+#include "Basic/FFException.h"
+#include "Basic/FFTuneCache.h"
+#include "Circuit/FFVoltageSourceComponent.h"
+#include <algorithm>
+#include <cmath>
+#include <exception>
+
+
+
+namespace FFFDTD{
+	// コンストラクタ
+	FFSimulation::FFSimulation(const std::vector<FFSolver*> &solver_list, const std::vector<uint64_t> &speed_list, MPI_Comm comm)
+		: m_Comm(comm), m_Rank(0)
+		, m_SolverList(solver_list)
+		, m_SlotList(), m_DivisionList()
+		, m_SituationList()
+		, m_BottomSituation(), m_TopSituation(), m_BottomRank(), m_TopRank()
+		, m_Size(0, 0, 0)
+		, m_OptimumTimestep(0.0)
+		, m_NT(0), m_IT(0)
+		, m_AutotuneCache()
+		, m_EarlyStopTolerance(0.0), m_Decimation(1)
+		, m_EarlyStopModel(), m_HasEarlyStopModel(false), m_EarlyStopStep(0)
+		, m_EarlyStopHoldout(0)
+		, m_ValidatedStep(0), m_ErrorList(), m_EnergyList()
+		, m_Extrapolated(false)
+		, m_ProbeSolverList(), m_ProbeIDList()
+	{
+		if (solver_list.size() != speed_list.size()){
+			throw FFException("The number of solvers (%d) and speeds (%d) are different", (int)solver_list.size(), (int)speed_list.size());
+		}
+
+		int num_of_processes;
+		MPI_Comm_rank(m_Comm, &m_Rank);
+		MPI_Comm_size(m_Comm, &num_of_processes);
+
+		// 全体のソルバー数を取得する
+		int num_of_solvers = (int)solver_list.size();
+		std::vector<int> solver_count(num_of_processes);
+		MPI_Allgather(&num_of_solvers, 1, MPI_INT, solver_count.data(), 1, MPI_INT, m_Comm);
+
+		// 全てのソルバーの処理速度を集める
+		int total_solvers = 0;
+		std::vector<int> disp_list(num_of_processes);
+		for (int p = 0; p < num_of_processes; p++){
+			disp_list[p] = total_solvers;
+			total_solvers += solver_count[p];
+		}
+		std::vector<uint64_t> whole_speed_list(total_solvers);
+		MPI_Allgatherv(speed_list.data(), num_of_solvers, MPI_UINT64_T, whole_speed_list.data(), solver_count.data(), disp_list.data(), MPI_UINT64_T, m_Comm);
+
+		// ソルバーの割り当て情報を作成する
+		m_SlotList.resize(total_solvers);
+		for (int p = 0; p < num_of_processes; p++){
+			for (int i = 0; i < solver_count[p]; i++){
+				Slot_t &slot = m_SlotList[disp_list[p] + i];
+				slot.rank = p;
+				slot.index = (uint32_t)i;
+				slot.speed = whole_speed_list[disp_list[p] + i];
+			}
+		}
+	}
+
+	// デストラクタ
+	FFSimulation::~FFSimulation(){
+		release();
+	}
+
+	// シミュレーション環境を構成する
+	void FFSimulation::setup(const FFScene &scene){
+		release();
+		m_SituationList.resize(m_SolverList.size());
+
+		// グリッドと境界条件を設定する
+		for (auto &situation : m_SituationList){
+			situation.setCommunicator(m_Comm);
+			situation.setGrids(scene.grid_x, scene.grid_y, scene.grid_z, scene.bc);
+			situation.setSpatialOrder(scene.spatial_order);
+			situation.setImplicitZ(scene.implicit_z);
+			placeSubgrids(situation, scene.subgrid_list);
+		}
+		m_Size = index3_t(scene.grid_x.count(), scene.grid_y.count(), scene.grid_z.count());
+
+		// 最適なタイムステップを計算する
+		m_OptimumTimestep = 0.0;
+		if (m_Rank == ROOT_RANK){
+			m_OptimumTimestep = m_SituationList[0].calcTimestep();
+		}
+		MPI_Bcast(&m_OptimumTimestep, 1, MPI_DOUBLE, ROOT_RANK, m_Comm);
+
+		// 計算能力で処理を割り振る
+		assignDivision();
+
+		// ソルバーの接続情報を取得する
+		getSolverConnection();
+
+		// 材質を登録する
+		size_t num_of_materials = scene.material_list.size();	// この材質リストにMATID=0は含まれない
+		if (MAX_MATID < (num_of_materials + 1)){
+			throw FFException("Material count is too much");
+		}
+		for (auto &situation : m_SituationList){
+			situation.initializeMaterialList(num_of_materials + 1);
+			for (size_t i = 0; i < num_of_materials; i++){
+				const std::vector<FFMaterial> &src_list = scene.material_list[i];
+				if (src_list.empty()){
+					throw FFException("Material %d has no values", (int)(i + 1));
+				}
+				std::vector<FFMaterial*> mat_list(src_list.size());
+				for (size_t k = 0; k < src_list.size(); k++){
+					mat_list[k] = new FFMaterial(src_list[k]);
+				}
+				situation.registerMaterial((matid_t)(i + 1), mat_list);
+			}
+		}
+
+		// 物体を配置する
+		for (auto &object : scene.object_list){
+			for (auto &situation : m_SituationList){
+				if (object.pec == true){
+					situation.placePECCuboid(object.start, object.end);
+				}
+				else{
+					situation.placeCuboid(object.matid, object.start, object.end);
+				}
+			}
+		}
+		for (auto &situation : m_SituationList){
+			placeSubgridObjects(situation, scene.subgrid_list);
+		}
+
+		// ポートを配置する
+		for (auto &port : scene.port_list){
+			for (auto &situation : m_SituationList){
+				situation.placePort(port.pos, port.dir, new FFVoltageSourceComponent(new FFWaveform(port.waveform), port.esr));
+			}
+		}
+
+		// プローブを配置する (全体で1つのソルバーだけが観測する)
+		m_ProbeSolverList.assign(scene.probe_list.size(), -1);
+		m_ProbeIDList.assign(scene.probe_list.size(), 0);
+		for (size_t p = 0; p < scene.probe_list.size(); p++){
+			for (size_t i = 0; i < m_SituationList.size(); i++){
+				oindex_t id = m_SituationList[i].placeTDProbe(scene.probe_list[p].pos, scene.probe_list[p].type);
+				if (id != ~(oindex_t)0){
+					m_ProbeSolverList[p] = (int)i;
+					m_ProbeIDList[p] = id;
+					break;
+				}
+			}
+		}
+
+		// 励振するポートを設定する
+		for (auto &situation : m_SituationList){
+			situation.setExcitation(scene.excitation_list);
+		}
+
+		// ソルバーを構成する
+		double timestep = (0.0 < scene.timestep) ? scene.timestep : m_OptimumTimestep;
+		// 例外は並列領域の外へ投げられないため、ソルバーごとに保持してからループの後で投げ直す
+		std::vector<std::exception_ptr> error_list(m_SituationList.size());
+#pragma omp parallel for
+		for (int i = 0; i < (int)m_SituationList.size(); i++){
+			try{
+				m_SituationList[i].configureSolver(m_SolverList[i], timestep, scene.iteration, scene.freq_list, scene.precision);
+			}
+			catch (...){
+				error_list[i] = std::current_exception();
+			}
+		}
+		for (auto &error : error_list){
+			if (error){
+				std::rethrow_exception(error);
+			}
+		}
+		m_NT = scene.iteration;
+		m_IT = 0;
+
+		// 打ち切り判定では、モデルで扱う最大周波数の1周期に4サンプル以上が入るようにステップを間引く
+		m_EarlyStopTolerance = scene.early_stop_tolerance;
+		m_Decimation = 1;
+		if (0.0 < m_EarlyStopTolerance){
+			double max_freq = scene.early_stop_max_freq;
+			if (max_freq <= 0.0){
+				for (double freq : scene.freq_list){
+					max_freq = std::max(max_freq, freq);
+				}
+			}
+			if (max_freq <= 0.0){
+				throw FFException("Early stop requires a max frequency");
+			}
+			m_Decimation = std::max((size_t)1, (size_t)(1.0 / (4.0 * timestep * max_freq)));
+		}
+		m_HasEarlyStopModel = false;
+		m_EarlyStopStep = 0;
+		m_EarlyStopHoldout = 0;
+		m_ValidatedStep = 0;
+		m_ErrorList.clear();
+		m_EnergyList.clear();
+		m_Extrapolated = false;
+
+		// カーネルの設定を調整する
+		if (m_AutotuneCache.empty() == false){
+			autotune();
+		}
+	}
+
+	// 1ステップ計算する
+	bool FFSimulation::step(void){
+		if ((m_NT <= m_IT) || m_Extrapolated){
+			return false;
+		}
+		FFTrace::setStep(m_IT);
+		FFTraceScope trace("step", "simulation");
+
+		int num_of_solvers = (int)m_SituationList.size();
+		bool result = true;
+		// ソルバーごとに1スレッドを割り当て、カーネル内の並列化はソルバーに任せる
+		// ソルバーが1つのときは並列領域を作らず、カーネルの並列化を入れ子にしない
+#pragma omp parallel num_threads(num_of_solvers) if(1 < num_of_solvers)
+		{
+#pragma omp for reduction(&& : result)
+			for (int i = 0; i < num_of_solvers; i++){
+				result &= m_SituationList[i].executeSolverStep1();
+			}
+			if (result == true){
+#pragma omp for
+				for (int i = 0; i < num_of_solvers; i++){
+					m_SituationList[i].executeSolverStep2();
+				}
+#pragma omp for
+				for (int i = 0; i < num_of_solvers; i++){
+					m_SituationList[i].executeSolverStep3(m_BottomSituation[i], m_TopSituation[i], m_BottomRank[i], m_TopRank[i]);
+				}
+#pragma omp for
+				for (int i = 0; i < num_of_solvers; i++){
+					m_SituationList[i].executeSolverStep4();
+				}
+#pragma omp for
+				for (int i = 0; i < num_of_solvers; i++){
+					m_SituationList[i].executeSolverStep5(m_BottomSituation[i], m_TopSituation[i], m_BottomRank[i], m_TopRank[i]);
+				}
+			}
+		}
+		m_IT++;
+
+		// 窓が埋まった後、一定の間隔で打ち切り判定を行う
+		if (result && (0.0 < m_EarlyStopTolerance) && (m_IT < m_NT)){
+			if ((EARLY_STOP_SAMPLES * m_Decimation <= m_IT) && ((m_IT % (EARLY_STOP_INTERVAL * m_Decimation)) == 0)){
+				checkEarlyStop();
+			}
+		}
+		return result && (m_IT < m_NT) && !m_Extrapolated;
+	}
+
+	// 最後のステップまで計算する
+	void FFSimulation::run(void){
+		while (step() == true);
+		MPI_Barrier(m_Comm);
+	}
+
+	// 全プロセスの電磁界の絶対合計値を計算する
+	dvec2 FFSimulation::calcTotalEM(void){
+		int num_of_solvers = (int)m_SituationList.size();
+		double total_e = 0.0, total_h = 0.0;
+#pragma omp parallel for reduction(+ : total_e, total_h)
+		for (int i = 0; i < num_of_solvers; i++){
+			dvec2 total = m_SituationList[i].calcTotalEM();
+			total_e += total.x;
+			total_h += total.y;
+		}
+		double buf[2] = {total_e, total_h};
+		double recv_buf[2];
+		MPI_Allreduce(buf, recv_buf, 2, MPI_DOUBLE, MPI_SUM, m_Comm);
+		return dvec2(recv_buf[0], recv_buf[1]);
+	}
+
+	// 自プロセスの処理時間と処理量の集計を取得する
+	FFTelemetry FFSimulation::getTelemetry(void) const{
+		FFTelemetry result;
+		for (auto &situation : m_SituationList){
+			result += situation.getTelemetry();
+		}
+		return result;
+	}
+
+	// 自プロセスの処理時間と処理量の集計を0にする
+	void FFSimulation::resetTelemetry(void){
+		for (auto &situation : m_SituationList){
+			situation.resetTelemetry();
+		}
+	}
+
+	// 全プロセスのソルバーのカーネルごとの計測結果をランク順に表示し、集計を0にする
+	void FFSimulation::printPerfReport(void){
+		int num_of_processes;
+		MPI_Comm_size(m_Comm, &num_of_processes);
+		for (int p = 0; p < num_of_processes; p++){
+			if (p == m_Rank){
+				for (size_t i = 0; i < m_SolverList.size(); i++){
+					char title[64];
+					snprintf(title, sizeof(title), "[rank %d, solver %d]", m_Rank, (int)i);
+					m_SolverList[i]->printPerfReport(title);
+				}
+			}
+			MPI_Barrier(m_Comm);
+		}
+	}
+
+	// 自プロセスのソルバーのカーネルの設定を調整し、結果をランク順に表示する
+	// 全プロセスがキャッシュを読み込んで調整した後、他のプロセスの結果を消さないよう1プロセスずつ保存する
+	void FFSimulation::autotune(void){
+		FFTuneCache cache;
+		cache.load(m_AutotuneCache.c_str());
+		std::vector<std::string> result_list(m_SolverList.size());
+		for (size_t i = 0; i < m_SolverList.size(); i++){
+			if (0 < m_SolverList[i]->getSize().z){
+				result_list[i] = m_SolverList[i]->autotune(cache);
+			}
+		}
+
+		int num_of_processes;
+		MPI_Comm_size(m_Comm, &num_of_processes);
+		for (int p = 0; p < num_of_processes; p++){
+			if (p == m_Rank){
+				cache.save(m_AutotuneCache.c_str());
+				for (size_t i = 0; i < result_list.size(); i++){
+					if (result_list[i].empty() == false){
+						printf("[rank %d, solver %d] Autotune: %s\n", m_Rank, (int)i, result_list[i].c_str());
+					}
+				}
+				fflush(stdout);
+			}
+			MPI_Barrier(m_Comm);
+		}
+	}
+
+	// 指定したポートの回路を取得する
+	const FFCircuit* FFSimulation::getPortCircuit(oindex_t port) const{
+		for (auto &situation : m_SituationList){
+			std::vector<const FFPort*> port_list = situation.getPortList();
+			if ((port < port_list.size()) && (port_list[port] != nullptr)){
+				return port_list[port]->getCircuit();
+			}
+		}
+		return nullptr;
+	}
+
+	// 指定したプローブの観測値を取得する
+	const double* FFSimulation::getProbeValues(oindex_t probe) const{
+		if ((m_ProbeSolverList.size() <= probe) || (m_ProbeSolverList[probe] < 0)){
+			return nullptr;
+		}
+		return m_SolverList[m_ProbeSolverList[probe]]->getTDProbeMeasurment(m_ProbeIDList[probe]).data();
+	}
+
+	// 打ち切り判定を行う
+	void FFSimulation::checkEarlyStop(void){
+		FFTraceScope trace("checkEarlyStop", "simulation");
+
+		// 自プロセスのポートの回路を集め、レーンごとの電圧と電流を信号のリストとする
+		std::vector<FFCircuit*> circuit_list;
+		for (size_t i = 0; i < getNumberOfPorts(); i++){
+			for (auto &situation : m_SituationList){
+				FFPort *port = situation.getPort((oindex_t)i);
+				if (port != nullptr){
+					circuit_list.push_back(port->getCircuit());
+				}
+			}
+		}
+		std::vector<const std::vector<double>*> signal_list;
+		for (FFCircuit *circuit : circuit_list){
+			for (index_t lane = 0; lane < circuit->lanes(); lane++){
+				signal_list.push_back(&circuit->getVoltageHistory(lane));
+				signal_list.push_back(&circuit->getCurrentHistory(lane));
+			}
+		}
+
+		// 前回のモデルで前回の判定から今回までの値を予測し、当てはめてからの信号ごとの誤差と実際の値の二乗和に加える
+		// 振幅の小さい信号も含め、いずれかの信号で相対誤差が許容誤差を超えたときは、検証の途中でもモデルを当てはめ直す
+		double failures = m_HasEarlyStopModel ? 0.0 : 1.0;
+		double reference2 = 0.0;
+		if (m_HasEarlyStopModel){
+			size_t count = m_IT - m_ValidatedStep;
+			std::vector<double> prediction;
+			for (size_t s = 0; s < signal_list.size(); s++){
+				const std::vector<double> &signal = *signal_list[s];
+				m_EarlyStopModel.predict(s, m_ValidatedStep, count, prediction);
+				double &error2 = m_ErrorList[s];
+				double &sum2 = m_EnergyList[s];
+				for (size_t n = 0; n < count; n++){
+					double actual = signal[m_ValidatedStep + n];
+					double diff = prediction[n] - actual;
+					error2 += diff * diff;
+					sum2 += actual * actual;
+				}
+				if ((m_EarlyStopTolerance * m_EarlyStopTolerance * sum2 < error2) || (std::isfinite(error2) == false)){
+					failures += 1.0;
+				}
+				reference2 += sum2;
+			}
+			m_ValidatedStep = m_IT;
+		}
+		double buf[2] = {failures, reference2};
+		double recv_buf[2];
+		MPI_Allreduce(buf, recv_buf, 2, MPI_DOUBLE, MPI_SUM, m_Comm);
+
+		// 予測が許容誤差以内のときは、検証するステップ数が経過するまでモデルを保持して次の判定を待つ
+		if ((recv_buf[0] == 0.0) && (m_IT < m_EarlyStopStep + m_EarlyStopHoldout)){
+			return;
+		}
+
+		// 検証が済んだら残りのステップを外挿し、信号ごとに検証した区間の誤差の二乗和を外挿した値の二乗和と比べる
+		// 減衰した信号ほど外挿する区間の値は小さくなるため、その信号自身の残りの大きさに対して誤差が許容誤差以内であることを求める
+		// 全ての信号がまだ0のときは打ち切らない
+		if ((recv_buf[0] == 0.0) && (0.0 < recv_buf[1])){
+			size_t count = m_NT - m_IT;
+			std::vector<std::vector<double>> tail_list(signal_list.size());
+			double tail_failures = 0.0;
+			for (size_t s = 0; s < signal_list.size(); s++){
+				m_EarlyStopModel.predict(s, m_IT, count, tail_list[s]);
+				double tail2 = 0.0;
+				for (double value : tail_list[s]){
+					tail2 += value * value;
+				}
+				if (m_EarlyStopTolerance * m_EarlyStopTolerance * tail2 < m_ErrorList[s]){
+					tail_failures += 1.0;
+				}
+			}
+			double tail_recv;
+			MPI_Allreduce(&tail_failures, &tail_recv, 1, MPI_DOUBLE, MPI_SUM, m_Comm);
+
+			// 全プロセスの全ての信号で誤差が許容誤差以内のときは、外挿した履歴を格納して打ち切る
+			if (tail_recv == 0.0){
+				size_t s = 0;
+				for (FFCircuit *circuit : circuit_list){
+					for (index_t lane = 0; lane < circuit->lanes(); lane++){
+						circuit->storeExtrapolation(m_IT, lane, tail_list[s], tail_list[s + 1]);
+						s += 2;
+					}
+				}
+				m_Extrapolated = true;
+				return;
+			}
+		}
+
+		// 直近の窓にモデルを当てはめ直す
+		size_t window = EARLY_STOP_SAMPLES * m_Decimation;
+		m_HasEarlyStopModel = m_EarlyStopModel.fit(signal_list, m_IT - window, EARLY_STOP_SAMPLES, m_Decimation, EARLY_STOP_ORDER);
+		m_EarlyStopStep = m_IT;
+		m_ValidatedStep = m_IT;
+		m_ErrorList.assign(signal_list.size(), 0.0);
+		m_EnergyList.assign(signal_list.size(), 0.0);
+
+		// 極の誤差による予測の誤差は時定数の程度の時間で最大となるため、全プロセスのモデルの最も遅い極の時定数の
+		// EARLY_STOP_HOLDOUT倍のステップ数で検証する
+		// 残りのステップ数を超えるときは打ち切らない
+		double decay = m_HasEarlyStopModel ? m_EarlyStopModel.getDecaySteps() : 0.0;
+		double max_decay;
+		MPI_Allreduce(&decay, &max_decay, 1, MPI_DOUBLE, MPI_MAX, m_Comm);
+		m_EarlyStopHoldout = (size_t)std::ceil(std::min(EARLY_STOP_HOLDOUT * max_decay, (double)(m_NT - m_IT)));
+	}
+
+	// シミュレーション環境を破棄する
+	void FFSimulation::release(void){
+		// ソルバーをFFSituationに解放させない
+		for (auto &situation : m_SituationList){
+			situation.detachSolver();
+		}
+		m_SituationList.clear();
+		m_ProbeSolverList.clear();
+		m_ProbeIDList.clear();
+		m_NT = 0;
+		m_IT = 0;
+		m_Extrapolated = false;
+	}
+
+	// 計算能力で処理を割り振る
+	void FFSimulation::assignDivision(void){
+		m_DivisionList.assign(m_SlotList.size(), 0);
+
+		// 処理速度の合計を求める
+		uint64_t total_cps = 0;
+		for (auto &slot : m_SlotList){
+			total_cps += slot.speed;
+		}
+		if (total_cps == 0){
+			throw FFException("No solver has processing speed");
+		}
+		index_t num_of_slices = m_Size.z;
+
+		// 処理速度の比率に従って処理スライス数を割り当てる
+		index_t num_of_division = 0;
+		for (size_t i = 0; i < m_SlotList.size(); i++){
+			uint64_t cps = m_SlotList[i].speed;
+			m_DivisionList[i] = (index_t)((num_of_slices * cps + total_cps / 2) / total_cps);
+			num_of_division += m_DivisionList[i];
+		}
+		while (num_of_division != num_of_slices){
+			for (size_t i = 0; i < m_SlotList.size(); i++){
+				if (num_of_slices < num_of_division){
+					if (0 < m_DivisionList[i]){
+						m_DivisionList[i]--;
+						num_of_division--;
+					}
+				}
+				else if ((num_of_division < num_of_slices) && (0 < m_SlotList[i].speed)){
+					m_DivisionList[i]++;
+					num_of_division++;
+				}
+				else if (num_of_division == num_of_slices){
+					break;
+				}
+			}
+		}
+
+		// メモリー容量に従って処理スライス数を調整する
+		//
+		// To Do
+		//
+
+		// シミュレーション空間の割り振りを決定する
+		index_t division_offset = 0;
+		for (size_t i = 0; i < m_SlotList.size(); i++){
+			auto &slot = m_SlotList[i];
+			if (slot.rank == m_Rank){
+				m_SituationList[slot.index].setDivision(division_offset, m_DivisionList[i]);
+				m_SituationList[slot.index].createVolumeData();
+			}
+			division_offset += m_DivisionList[i];
+		}
+	}
+
+	// ソルバーの接続情報を取得する
+	void FFSimulation::getSolverConnection(void){
+		size_t num_of_situations = m_SituationList.size();
+		m_BottomSituation.assign(num_of_situations, nullptr);
+		m_TopSituation.assign(num_of_situations, nullptr);
+		m_BottomRank.assign(num_of_situations, -1);
+		m_TopRank.assign(num_of_situations, -1);
+
+		for (size_t i = 0; i < m_SlotList.size(); i++){
+			auto &slot = m_SlotList[i];
+			if ((slot.rank == m_Rank) && (0 < m_DivisionList[i])){
+				uint32_t index = slot.index;
+
+				// 下に別のソルバーが接続されているか調べる
+				for (size_t j = i; 0 < j--;){
+					if (0 < m_DivisionList[j]){
+						auto &bottom_slot = m_SlotList[j];
+						if (bottom_slot.rank == m_Rank){
+							m_BottomSituation[index] = &m_SituationList[bottom_slot.index];
+						}
+						else{
+							m_BottomRank[index] = bottom_slot.rank;
+						}
+						break;
+					}
+				}
+
+				// 上に別のソルバーが接続されているか調べる
+				for (size_t j = i + 1; j < m_SlotList.size(); j++){
+					if (0 < m_DivisionList[j]){
+						auto &top_slot = m_SlotList[j];
+						if (top_slot.rank == m_Rank){
+							m_TopSituation[index] = &m_SituationList[top_slot.index];
+						}
+						else{
+							m_TopRank[index] = top_slot.rank;
+						}
+						break;
+					}
+				}
+			}
+		}
+	}
+
+	// サブグリッドを入れ子のものまで配置する
+	void FFSimulation::placeSubgrids(FFSituation &situation, const std::vector<FFScene::Subgrid_t> &subgrid_list){
+		const index3_t origin = FFSubgrid::getOrigin();
+		for (auto &scene_subgrid : subgrid_list){
+			FFSubgrid *subgrid = situation.placeSubgrid(scene_subgrid.start, scene_subgrid.end);
+
+			// 入れ子のサブグリッドは細かいグリッドの座標に変換する
+			std::vector<FFScene::Subgrid_t> child_list = scene_subgrid.subgrid_list;
+			for (auto &child : child_list){
+				child.start += origin;
+				child.end += origin;
+			}
+			placeSubgrids(subgrid->getSituation(), child_list);
+		}
+	}
+
+	// サブグリッドの中だけに配置する物体を、入れ子のサブグリッドまで配置する
+	void FFSimulation::placeSubgridObjects(FFSituation &situation, const std::vector<FFScene::Subgrid_t> &subgrid_list){
+		const index3_t origin = FFSubgrid::getOrigin();
+		for (size_t i = 0; i < subgrid_list.size(); i++){
+			FFSituation &child = situation.getSubgrid(i)->getSituation();
+			for (auto &object : subgrid_list[i].object_list){
+				if (object.pec == true){
+					child.placePECCuboid(object.start + origin, object.end + origin);
+				}
+				else{
+					child.placeCuboid(object.matid, object.start + origin, object.end + origin);
+				}
+			}
+			placeSubgridObjects(child, subgrid_list[i].subgrid_list);
+		}
+	}
+}
@@ -0,0 +1,238 @@
+﻿#pragma once
+
+#include "FFScene.h"
+#include "FFSituation.h"
+#include "FFSolver.h"
+#include "Circuit/FFPoleResidueModel.h"
+#include <mpi.h>
+
+
+
+namespace FFFDTD{
+	// シミュレーションを組み込みで実行するクラス
+	// 与えられたコミュニケーター内の全プロセスで同じ順にメソッドを呼び出すこと
+	// ソルバーは呼び出し側が所有し、シミュレーションの間で再利用できる
+	class FFSimulation{
+		/*** 定数 ***/
+	public:
+		// ルートランク
+		static const int ROOT_RANK = 0;
+
+
+
+		/*** 定義 ***/
+	public:
+		// ソルバーの割り当て情報
+		struct Slot_t{
+			int rank;			// ソルバーを持つプロセスのランク
+			uint32_t index;		// ランク内でのソルバー番号
+			uint64_t speed;		// 処理速度[cell/s]
+		};
+
+
+
+		/*** メンバー変数 ***/
+	private:
+		// コミュニケーター
+		MPI_Comm m_Comm;
+
+		// 自プロセスのランク
+		int m_Rank;
+
+		// 自プロセスのソルバーのリスト
+		std::vector<FFSolver*> m_SolverList;
+
+		// 全体のソルバーの割り当て情報のリスト
+		std::vector<Slot_t> m_SlotList;
+
+		// 全体のソルバーに割り当てたスライス数のリスト
+		std::vector<index_t> m_DivisionList;
+
+		// 自プロセスのソルバーごとのシミュレーション環境
+		std::vector<FFSituation> m_SituationList;
+
+		// ソルバーごとのZ方向の接続先
+		std::vector<FFSituation*> m_BottomSituation, m_TopSituation;
+		std::vector<int> m_BottomRank, m_TopRank;
+
+		// グローバル領域のサイズ
+		index3_t m_Size;
+
+		// 最適なタイムステップ
+		double m_OptimumTimestep;
+
+		// 最大ステップ数
+		size_t m_NT;
+
+		// 次のステップ
+		size_t m_IT;
+
+		// カーネルの調整結果のキャッシュファイルのパス (空のときは調整しない)
+		std::string m_AutotuneCache;
+
+		// 打ち切り判定の許容誤差 (0のときは打ち切らない)
+		double m_EarlyStopTolerance;
+
+		// 打ち切り判定で1サンプルとして平均するステップ数
+		size_t m_Decimation;
+
+		// 前回の判定で自プロセスのポートの電圧・電流に当てはめた極・留数モデル
+		FFPoleResidueModel m_EarlyStopModel;
+
+		// 極・留数モデルを当てはめられたか
+		bool m_HasEarlyStopModel;
+
+		// 極・留数モデルを当てはめたステップ
+		size_t m_EarlyStopStep;
+
+		// 前回の判定で当てはめたモデルを検証するステップ数 (全プロセスのモデルの最も遅い極の時定数のEARLY_STOP_HOLDOUT倍とする)
+		size_t m_EarlyStopHoldout;
+
+		// 前回のモデルを検証した最後のステップと、当てはめてから検証した区間の信号ごとの予測の誤差と実際の値の二乗和
+		size_t m_ValidatedStep;
+		std::vector<double> m_ErrorList;
+		std::vector<double> m_EnergyList;
+
+		// 打ち切った後の電圧・電流の履歴を外挿したか
+		bool m_Extrapolated;
+
+		// シーンのプローブごとの自プロセスのソルバー番号 (他のプロセスに属するときは-1) と時間ドメインプローブの番号
+		std::vector<int> m_ProbeSolverList;
+		std::vector<oindex_t> m_ProbeIDList;
+
+
+
+		/*** メソッド ***/
+	public:
+		// コンストラクタ
+		// 自プロセスのソルバーと処理速度[cell/s]を渡し、コミュニケーター内で共有する
+		// 単一プロセスで実行するときはMPI_COMM_SELFを渡す
+		// 自プロセスに複数のソルバーがあるときは、カーネルを並列に計算させるために呼び出し側で入れ子の並列化を有効にしておく
+		FFSimulation(const std::vector<FFSolver*> &solver_list, const std::vector<uint64_t> &speed_list, MPI_Comm comm = MPI_COMM_SELF);
+
+		// デストラクタ
+		~FFSimulation();
+
+		// シミュレーション環境を構成する
+		// 前回のシミュレーション環境は破棄し、ソルバーのメモリーを再利用する
+		void setup(const FFScene &scene);
+
+		// 構成したソルバーのカーネルの設定を調整するキャッシュファイルのパスを設定する
+		// 設定するとsetup()の最後でキャッシュを読み込み、結果がなければ調整して保存する
+		// 空文字列を渡すと調整しない
+		void setAutotuneCache(const std::string &path){
+			m_AutotuneCache = path;
+		}
+
+		// 1ステップ計算する
+		// 計算が終了したときにfalseを返す
+		bool step(void);
+
+		// 最後のステップまで計算する
+		void run(void);
+
+		// 全プロセスの電磁界の絶対合計値を計算する
+		dvec2 calcTotalEM(void);
+
+		// 自プロセスの処理時間と処理量の集計を取得する
+		FFTelemetry getTelemetry(void) const;
+
+		// 自プロセスの処理時間と処理量の集計を0にする
+		void resetTelemetry(void);
+
+		// 全プロセスのソルバーのカーネルごとの計測結果をランク順に表示し、集計を0にする
+		// コミュニケーター内の全プロセスで呼び出すこと
+		void printPerfReport(void);
+
+		// 指定したポートの回路を取得する
+		// ポートが他のプロセスに属するときはnullptrを返す
+		// 回路の電圧・電流の履歴はコピーせずに参照できる
+		const FFCircuit* getPortCircuit(oindex_t port) const;
+
+		// ポートの数を取得する
+		size_t getNumberOfPorts(void) const{
+			return m_SituationList.empty() ? 0 : m_SituationList[0].getNumberOfPorts();
+		}
+
+		// 指定したプローブの観測値を取得する
+		// プローブが他のプロセスに属するときはnullptrを返す
+		// 観測値はステップごとにレーン数分を並べた配列で、コピーせずに参照できる
+		const double* getProbeValues(oindex_t probe) const;
+
+		// プローブの数を取得する
+		size_t getNumberOfProbes(void) const{
+			return m_ProbeSolverList.size();
+		}
+
+		// Bloch周期境界か取得する (回路のレーンの後半が虚部となる)
+		bool isBloch(void) const{
+			return m_SituationList.empty() ? false : m_SituationList[0].isBloch();
+		}
+
+		// 自プロセスのランクを取得する
+		int getRank(void) const{
+			return m_Rank;
+		}
+
+		// 全体のソルバーの割り当て情報のリストを取得する
+		const std::vector<Slot_t>& getSlotList(void) const{
+			return m_SlotList;
+		}
+
+		// 全体のソルバーに割り当てたスライス数のリストを取得する
+		const std::vector<index_t>& getDivisionList(void) const{
+			return m_DivisionList;
+		}
+
+		// グローバル領域のサイズを取得する
+		const index3_t& getGlobalSize(void) const{
+			return m_Size;
+		}
+
+		// 最適なタイムステップを取得する
+		double getOptimumTimestep(void) const{
+			return m_OptimumTimestep;
+		}
+
+		// 最大ステップ数を取得する
+		size_t getMaxIteration(void) const{
+			return m_NT;
+		}
+
+		// 次のステップを取得する
+		size_t getIteration(void) const{
+			return m_IT;
+		}
+
+		// 打ち切り判定で計算を打ち切ったか取得する
+		// 打ち切ったときはgetIteration()のステップ以降のポートの電圧・電流の履歴が極・留数モデルの外挿値となる
+		// プローブの観測値は打ち切ったステップまでの値となる
+		bool isExtrapolated(void) const{
+			return m_Extrapolated;
+		}
+
+	private:
+		// シミュレーション環境を破棄する
+		void release(void);
+
+		// 計算能力で処理を割り振る
+		void assignDivision(void);
+
+		// 自プロセスのソルバーのカーネルの設定を調整し、結果をランク順に表示する
+		void autotune(void);
+
+		// ソルバーの接続情報を取得する
+		void getSolverConnection(void);
+
+		// 打ち切り判定を行う
+		// 前回のモデルが今回までの全プロセスのポートの電圧・電流を許容誤差以内で予測できたら、
+		// 残りのステップの履歴をモデルで外挿して打ち切る。そうでなければ直近の窓にモデルを当てはめ直す
+		void checkEarlyStop(void);
+
+		// サブグリッドを入れ子のものまで配置する
+		static void placeSubgrids(FFSituation &situation, const std::vector<FFScene::Subgrid_t> &subgrid_list);
+
+		// サブグリッドの中だけに配置する物体を、入れ子のサブグリッドまで配置する
+		static void placeSubgridObjects(FFSituation &situation, const std::vector<FFScene::Subgrid_t> &subgrid_list);
+	};
+}
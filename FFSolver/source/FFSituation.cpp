@@ -1,5 +1,7 @@
 ﻿#include "FFSituation.h"
+#include "FFSubgrid.h"
 #include "FFConst.h"
+#include "Basic/FFException.h"
 #include <algorithm>
 #include <iterator>
 #include <mutex>
@@ -14,22 +16,32 @@ namespace FFFDTD{
 		, m_Size(0, 0, 0)
 		, m_LocalOffsetZ(0), m_LocalSizeZ(0)
 		, m_GridX(), m_GridY(), m_GridZ()
-		, m_BC()
+		, m_BC(), m_SpatialOrder(2), m_ImplicitZ(false)
 		, m_Volume(), m_PECX(), m_PECY(), m_PECZ()
-		, m_MaterialList()
+		, m_MaterialList(), m_SweepCount(1)
 		, m_PortList()
+		, m_HasSource(false), m_SourceStart(0, 0, 0), m_SourceEnd(0, 0, 0)
 		, m_TDProbeList(), m_FDProbeList()
 		, m_Solver(nullptr)
 		, m_NT(0), m_IT(0)
 		, m_FreqList()
+		, m_Lanes(1), m_ExcitationList()
 		, m_CountPerSlice(0)
-		, m_MPIBufferX(), m_MPIBufferY(), m_MPIBufferZ()
+		, m_Comm(MPI_COMM_WORLD)
+		, m_MPIBufferX(), m_MPIBufferY(), m_MPIBufferZ(), m_MPIBufferOuter()
+		, m_Telemetry(), m_CellsPerStep(0), m_BytesPerStep(0)
+		, m_SubgridList()
 	{
 
 	}
 
 	// デストラクタ
 	FFSituation::~FFSituation(){
+		// サブグリッドを削除する
+		for (FFSubgrid *subgrid : m_SubgridList){
+			delete subgrid;
+		}
+
 		// 材質リストを削除する
 		initializeMaterialList(0);
 		
@@ -39,7 +51,7 @@ namespace FFFDTD{
 		}
 
 		// ソルバーを削除する
-		configureSolver(nullptr, 0.0, 0, std::vector<double>());
+		configureSolver(nullptr, 0.0, 0, std::vector<double>(), DEFAULT_PRECISION);
 	}
 
 #pragma region 初期化関連のメソッド
@@ -53,24 +65,50 @@ namespace FFFDTD{
 		m_GridY = grid_y;
 		m_GridZ = grid_z;
 		m_BC = bc;
-		if (bc.x != BoundaryCondition::PML){
-			m_BC.pmlL.x = 0;
-		}
-		if (bc.y != BoundaryCondition::PML){
-			m_BC.pmlL.y = 0;
-		}
-		if (bc.z != BoundaryCondition::PML){
-			m_BC.pmlL.z = 0;
-		}
-		if ((m_Size.x <= (m_BC.pmlL.x * 2)) || (m_Size.y <= (m_BC.pmlL.y * 2)) || ((m_Size.z <= m_BC.pmlL.z * 2))){
-			// 空間サイズが境界条件の層数より小さい
-			throw;
+		for (int axis = 0; axis < 3; axis++){
+			if ((bc.lower[axis] == BoundaryCondition::Periodic) != (bc.upper[axis] == BoundaryCondition::Periodic)){
+				// 周期境界条件は片側の面だけには設定できない
+				throw FFException("Periodic boundary condition must be set on both faces of axis %d", axis);
+			}
+			if ((bc.upper[axis] == BoundaryCondition::PMC) || (bc.upper[axis] == BoundaryCondition::PECSymmetry)){
+				// 正側の面上の辺のPEC情報は格納しないため、対称面は負側の面だけに設定できる
+				throw FFException("Symmetry plane must be set on the lower face of axis %d", axis);
+			}
+			if (bc.lower[axis] != BoundaryCondition::PML){
+				m_BC.pmlLower[axis] = 0;
+			}
+			if (bc.upper[axis] != BoundaryCondition::PML){
+				m_BC.pmlUpper[axis] = 0;
+			}
+			if ((bc.phase[axis] != 0.0) && (bc.lower[axis] != BoundaryCondition::Periodic)){
+				// 位相差は周期境界条件の軸にだけ設定できる
+				throw FFException("Phase shift requires periodic boundary condition on axis %d", axis);
+			}
+			if ((bc.phase[axis] != 0.0) && (axis == 2)){
+				// Z方向の周期境界はプロセス間の共有と兼ねるため、位相差に対応しない
+				throw FFException("Phase shift is not supported on Z axis");
+			}
+			if (m_Size[axis] <= (m_BC.pmlLower[axis] + m_BC.pmlUpper[axis])){
+				// 空間サイズが境界条件の層数より小さい
+				throw;
+			}
 		}
 
 		// グリッドの付随情報を計算する
-		m_GridX.precompute(bc.x == BoundaryCondition::Periodic);
-		m_GridY.precompute(bc.y == BoundaryCondition::Periodic);
-		m_GridZ.precompute(bc.z == BoundaryCondition::Periodic);
+		m_GridX.precompute(isConnectedX(), isPMC(Axis::X));
+		m_GridY.precompute(isConnectedY(), isPMC(Axis::Y));
+		m_GridZ.precompute(bc.lower[2] == BoundaryCondition::Periodic, isPMC(Axis::Z));
+
+		// Bloch周期境界ではレーン数が変わる
+		updateLanes();
+	}
+
+	// 空間差分の次数を設定する
+	void FFSituation::setSpatialOrder(int order){
+		if ((order != 2) && (order != 4)){
+			throw FFException("Spatial order must be 2 or 4 (%d)", order);
+		}
+		m_SpatialOrder = order;
 	}
 
 	// 処理の分割を設定する
@@ -81,7 +119,7 @@ namespace FFFDTD{
 		}
 
 		// 接続元の座標を設定する
-		if ((m_BC.z == BoundaryCondition::Periodic) && ((offset + size) == m_GridZ.count())){
+		if ((m_BC.lower[2] == BoundaryCondition::Periodic) && ((offset + size) == m_GridZ.count())){
 			// ローカル領域は周期境界条件の正端
 			m_ConnectionZ = 0;
 		}
@@ -107,11 +145,16 @@ namespace FFFDTD{
 		m_PECZ = FFBitVolumeData(m_Size.x, m_Size.y, m_Size.z);
 
 		// スライスを作成する
-		m_Volume.createSlices(m_LocalOffsetZ, m_LocalOffsetZ + m_LocalSizeZ - 1, MATID_VACUUM);
-		m_PECX.createSlices(m_LocalOffsetZ, m_LocalOffsetZ + m_LocalSizeZ - 1, false);
-		m_PECY.createSlices(m_LocalOffsetZ, m_LocalOffsetZ + m_LocalSizeZ - 1, false);
-		m_PECZ.createSlices(m_LocalOffsetZ, m_LocalOffsetZ + m_LocalSizeZ - 1, false);
-		if (isConnectedZ()){
+		// 4次精度の差分ではローカル領域の1面外側の成分までZ方向に2セル離れた材質を調べるため、ローカル領域の上下のスライスも作成する
+		// (下側は3スライス、上側は接続される面を含めて4スライスとし、全体の範囲の外は作成しない)
+		const index_t margin = (m_SpatialOrder == 4) ? 3 : 0;
+		const index_t z_start = (m_LocalOffsetZ < margin) ? 0 : (m_LocalOffsetZ - margin);
+		const index_t z_end = std::min(m_LocalOffsetZ + m_LocalSizeZ + ((m_SpatialOrder == 4) ? 4 : 0), m_Size.z) - 1;
+		m_Volume.createSlices(z_start, z_end, MATID_VACUUM);
+		m_PECX.createSlices(z_start, z_end, false);
+		m_PECY.createSlices(z_start, z_end, false);
+		m_PECZ.createSlices(z_start, z_end, false);
+		if (isConnectedZ() && ((m_ConnectionZ < z_start) || (z_end < m_ConnectionZ))){
 			m_Volume.createSlices(m_ConnectionZ, m_ConnectionZ, MATID_VACUUM);
 			m_PECX.createSlices(m_ConnectionZ, m_ConnectionZ, false);
 			m_PECY.createSlices(m_ConnectionZ, m_ConnectionZ, false);
@@ -122,9 +165,11 @@ namespace FFFDTD{
 #pragma region 材質関連のメソッド
 	// 材質リストを初期化する
 	void FFSituation::initializeMaterialList(size_t count){
-		for (FFMaterial *&mat : m_MaterialList){
-			delete mat;
-			mat = nullptr;
+		for (std::vector<FFMaterial*> &mat_list : m_MaterialList){
+			for (FFMaterial *mat : mat_list){
+				delete mat;
+			}
+			mat_list.clear();
 		}
 		if (((size_t)MAX_MATID + 1) < count){
 			// 材質データの数が上限に達している
@@ -134,9 +179,11 @@ namespace FFFDTD{
 			count = MATID_VACUUM + 1;
 		}
 		m_MaterialList.resize(count);
+		m_SweepCount = 1;
+		updateLanes();
 
 		// 真空の材質IDを登録する
-		m_MaterialList[MATID_VACUUM] = new FFMaterial();
+		m_MaterialList[MATID_VACUUM].push_back(new FFMaterial());
 	}
 
 	// 新しく材質データを登録する
@@ -145,30 +192,46 @@ namespace FFFDTD{
 			// 材質データの数が上限に達している
 			throw;
 		}
-		m_MaterialList.push_back(mat);
+		m_MaterialList.push_back(std::vector<FFMaterial*>(1, mat));
 		return (matid_t)(m_MaterialList.size() - 1);
 	}
 
 	// 指定した材質IDで材質データを登録する
 	void FFSituation::registerMaterial(matid_t matid, FFMaterial *mat){
+		registerMaterial(matid, std::vector<FFMaterial*>(1, mat));
+	}
+
+	// 指定した材質IDでスイープするレーンごとの材質データを登録する
+	void FFSituation::registerMaterial(matid_t matid, const std::vector<FFMaterial*> &mat_list){
+		if (mat_list.empty()){
+			throw FFException("Material[%u] has no value", matid);
+		}
+		if ((1 < mat_list.size()) && (1 < m_SweepCount) && (mat_list.size() != m_SweepCount)){
+			// スイープ数が他の材質と一致しない
+			throw FFException("Material[%u] has %u sweep values but other materials have %u", matid, (unsigned int)mat_list.size(), (unsigned int)m_SweepCount);
+		}
 		if (m_MaterialList.size() <= matid){
 			// 範囲外の材質IDが指定された場合は材質リストを拡張する
 			if (MAX_MATID < matid){
 				// 指定された材質IDが大きすぎる
 				throw;
 			}
-			m_MaterialList.resize((size_t)matid + 1, nullptr);
-		}else if (m_MaterialList[matid] != nullptr){
+			m_MaterialList.resize((size_t)matid + 1);
+		}else if (!m_MaterialList[matid].empty()){
 			// 同じ材質IDの材質データがすでに存在する
 			throw;
 		}
-		m_MaterialList[matid] = mat;
+		m_MaterialList[matid] = mat_list;
+		if (1 < mat_list.size()){
+			m_SweepCount = (index_t)mat_list.size();
+			updateLanes();
+		}
 	}
 
 	// 材質リストのすべての材質の物性値が指定されているか調べる
 	bool FFSituation::isMaterialListFilled(void){
-		for (FFMaterial *mat : m_MaterialList){
-			if (mat == nullptr){
+		for (const std::vector<FFMaterial*> &mat_list : m_MaterialList){
+			if (mat_list.empty()){
 				return false;
 			}
 		}
@@ -176,16 +239,30 @@ namespace FFFDTD{
 	}
 
 	// 指定した材質IDの材質データを取得する
-	const FFMaterial* FFSituation::getMaterialByID(matid_t matid){
+	const FFMaterial* FFSituation::getMaterialByID(matid_t matid, index_t lane){
 		if (MAX_MATID < matid){
 			// 無効な材質IDを参照しようとしている
 			throw;
 		}
-		if (m_MaterialList.size() <= matid){
+		if ((m_MaterialList.size() <= matid) || m_MaterialList[matid].empty()){
 			// 材質データは存在しない
 			return nullptr;
 		}
-		return m_MaterialList[matid];
+		return getLaneMaterial(matid, lane);
+	}
+
+	// スイープ数と励振ポート数からレーン数を決定する
+	void FFSituation::updateLanes(void){
+		index_t excitation_count = (index_t)m_ExcitationList.size();
+		if ((1 < m_SweepCount) && (0 < excitation_count) && (excitation_count != m_SweepCount)){
+			// 材質のスイープ数と励振ポート数が一致しない
+			throw FFException("Number of excitation ports (%u) does not match number of sweep values (%u)", (unsigned int)excitation_count, (unsigned int)m_SweepCount);
+		}
+		m_Lanes = std::max(std::max(excitation_count, m_SweepCount), (index_t)1);
+		if (isBloch()){
+			// 実部と虚部のレーンを持つ
+			m_Lanes *= 2;
+		}
 	}
 #pragma endregion
 
@@ -196,20 +273,30 @@ namespace FFFDTD{
 		double min_dx_2 = pow(m_GridX.minimumWidth(), 2);
 		double min_dy_2 = pow(m_GridY.minimumWidth(), 2);
 		double min_dz_2 = pow(m_GridZ.minimumWidth(), 2);
-		return 1.0 / (C * sqrt(1.0 / min_dx_2 + 1.0 / min_dy_2 + 1.0 / min_dz_2));
-	}
-
-	// 境界条件を取得する
-	BoundaryCondition FFSituation::getBC(Axis axis) const{
-		if (axis == Axis::X){
-			return m_BC.x;
+		double dt = 1.0 / (C * sqrt(1.0 / min_dx_2 + 1.0 / min_dy_2 + 1.0 / min_dz_2));
+		if (m_ImplicitZ){
+			// HIE法ではX・Y方向だけでクーラン条件を満たせばよい
+			// ただしZ方向のPMLのセルはZ方向の差分を陽的に扱う部分 (分割型PMLの成分とCPMLの補助変数) を持つため、Z方向のセル幅も含める
+			dt = 1.0 / (C * sqrt(1.0 / min_dx_2 + 1.0 / min_dy_2));
+			const index_t NZ = m_GridZ.count();
+			for (index_t i = 0; i < NZ; i++){
+				if ((m_BC.pmlLower.z <= i) && (i < NZ - m_BC.pmlUpper.z)){
+					continue;
+				}
+				dt = std::min(dt, 1.0 / (C * sqrt(1.0 / min_dx_2 + 1.0 / min_dy_2 + 1.0 / pow(m_GridZ.width(i), 2))));
+			}
 		}
-		else if (axis == Axis::Y){
-			return m_BC.y;
+
+		// 4次精度の差分は差分の係数の絶対値の和が9/8 + 1/24 = 7/6倍になるため、安定条件も6/7倍になる
+		if (m_SpatialOrder == 4){
+			dt *= 6.0 / 7.0;
 		}
-		else{
-			return m_BC.z;
+
+		// サブグリッドは同じタイムステップで計算するため、細かいグリッドのクーラン条件も満たす
+		for (const FFSubgrid *subgrid : m_SubgridList){
+			dt = std::min(dt, subgrid->getSituation().calcTimestep());
 		}
+		return dt;
 	}
 
 	// ポートのリストを取得する
@@ -224,6 +311,11 @@ namespace FFFDTD{
 #pragma region シミュレーション環境を作成するメソッド
 	// 指定した材質IDの直方体を配置する
 	bool FFSituation::placeCuboid(matid_t matid, const index3_t &pos1, const index3_t &pos2){
+		// サブグリッドにも配置する
+		for (FFSubgrid *subgrid : m_SubgridList){
+			subgrid->placeCuboid(matid, pos1, pos2);
+		}
+
 		// 座標の順序を正す
 		index_t ix1 = (pos1.x < pos2.x) ? pos1.x : pos2.x;
 		index_t ix2 = (pos1.x < pos2.x) ? pos2.x : pos1.x;
@@ -259,6 +351,11 @@ namespace FFFDTD{
 
 	// PECワイヤーの直方体を配置する
 	bool FFSituation::placePECCuboid(const index3_t &pos1, const index3_t &pos2){
+		// サブグリッドにも配置する
+		for (FFSubgrid *subgrid : m_SubgridList){
+			subgrid->placePECCuboid(pos1, pos2);
+		}
+
 		// 座標の順序を正す
 		index_t ix1 = (pos1.x < pos2.x) ? pos1.x : pos2.x;
 		index_t ix2 = (pos1.x < pos2.x) ? pos2.x : pos1.x;
@@ -312,6 +409,42 @@ namespace FFFDTD{
 		return true;
 	}
 
+	// サブグリッドの直方体[start, end]の内部 (表面を除く) の電界をPECとする
+	// 内部の粗いグリッドの電界は常に0となり、周囲の電界が全て0の磁界とともに計算から除かれる
+	// 表面の電界は細かいグリッドとの結合で書き込むため、そのままとする
+	void FFSituation::excludeSubgridInterior(const index3_t &start, const index3_t &end){
+		for (index_t iz = start.z + 1; iz < end.z; iz++){
+			FFBitSliceData *slice = m_PECX.getSliceRepeat(iz);
+			if (slice != nullptr){
+				for (index_t iy = start.y + 1; iy < end.y; iy++){
+					for (index_t ix = start.x; ix < end.x; ix++){
+						slice->setPointRepeat(ix, iy, true);
+					}
+				}
+			}
+		}
+		for (index_t iz = start.z + 1; iz < end.z; iz++){
+			FFBitSliceData *slice = m_PECY.getSliceRepeat(iz);
+			if (slice != nullptr){
+				for (index_t iy = start.y; iy < end.y; iy++){
+					for (index_t ix = start.x + 1; ix < end.x; ix++){
+						slice->setPointRepeat(ix, iy, true);
+					}
+				}
+			}
+		}
+		for (index_t iz = start.z; iz < end.z; iz++){
+			FFBitSliceData *slice = m_PECZ.getSliceRepeat(iz);
+			if (slice != nullptr){
+				for (index_t iy = start.y + 1; iy < end.y; iy++){
+					for (index_t ix = start.x + 1; ix < end.x; ix++){
+						slice->setPointRepeat(ix, iy, true);
+					}
+				}
+			}
+		}
+	}
+
 	/*// PECデータをストリームから読み込む
 	void FFSituation::loadPECData(FFIStream &stream){
 	// ボリュームデータを読み込む
@@ -447,25 +580,25 @@ namespace FFFDTD{
 		index3_t pos;
 		if ((dir == X_PLUS) || (dir == X_MINUS)){
 			pos.x = pos_.x;
-			pos.y = (pos_.y != 0) ? pos_.y : m_Size.y;
-			pos.z = (pos_.z != 0) ? pos_.z : m_Size.z;
+			pos.y = ((pos_.y != 0) || isPMC(Axis::Y)) ? pos_.y : m_Size.y;
+			pos.z = ((pos_.z != 0) || isPMC(Axis::Z)) ? pos_.z : m_Size.z;
 			out_of_bounding  = (m_Size.x <= pos.x);
 			out_of_bounding |= isConnectedY() ? (m_Size.y < pos.y) : (m_Size.y <= pos.y);
 			out_of_bounding |= isConnectedZ() ? (m_Size.z < pos.z) : (m_Size.z <= pos.z);
-			out_of_local = (pos.z <= m_LocalOffsetZ) || (isConnectedZ() ? ((m_LocalOffsetZ + m_LocalSizeZ) < pos.z) : ((m_LocalOffsetZ + m_LocalSizeZ) <= pos.z));
+			out_of_local = (pos.z < m_LocalOffsetZ + getValidStartN(Axis::Z)) || (isConnectedZ() ? ((m_LocalOffsetZ + m_LocalSizeZ) < pos.z) : ((m_LocalOffsetZ + m_LocalSizeZ) <= pos.z));
 		}
 		else if ((dir == Y_PLUS) || (dir == Y_MINUS)){
-			pos.x = (pos_.x != 0) ? pos_.x : m_Size.x;
+			pos.x = ((pos_.x != 0) || isPMC(Axis::X)) ? pos_.x : m_Size.x;
 			pos.y = pos_.y;
-			pos.z = (pos_.z != 0) ? pos_.z : m_Size.z;
+			pos.z = ((pos_.z != 0) || isPMC(Axis::Z)) ? pos_.z : m_Size.z;
 			out_of_bounding  = isConnectedX() ? (m_Size.x < pos.x) : (m_Size.x <= pos.x);
 			out_of_bounding |= (m_Size.y <= pos.y);
 			out_of_bounding |= isConnectedZ() ? (m_Size.z < pos.z) : (m_Size.z <= pos.z);
-			out_of_local = (pos.z <= m_LocalOffsetZ) || (isConnectedZ() ? ((m_LocalOffsetZ + m_LocalSizeZ) < pos.z) : ((m_LocalOffsetZ + m_LocalSizeZ) <= pos.z));
+			out_of_local = (pos.z < m_LocalOffsetZ + getValidStartN(Axis::Z)) || (isConnectedZ() ? ((m_LocalOffsetZ + m_LocalSizeZ) < pos.z) : ((m_LocalOffsetZ + m_LocalSizeZ) <= pos.z));
 		}
 		else if ((dir == Z_PLUS) || (dir == Z_MINUS)){
-			pos.x = (pos_.x != 0) ? pos_.x : m_Size.x;
-			pos.y = (pos_.y != 0) ? pos_.y : m_Size.y;
+			pos.x = ((pos_.x != 0) || isPMC(Axis::X)) ? pos_.x : m_Size.x;
+			pos.y = ((pos_.y != 0) || isPMC(Axis::Y)) ? pos_.y : m_Size.y;
 			pos.z = pos_.z;
 			out_of_bounding  = isConnectedX() ? (m_Size.x < pos.x) : (m_Size.x <= pos.x);
 			out_of_bounding |= isConnectedY() ? (m_Size.y < pos.y) : (m_Size.y <= pos.y);
@@ -479,30 +612,50 @@ namespace FFFDTD{
 			throw;
 		}
 
+		// 他のプロセスのポートも含めて励振源の範囲を広げる
+		for (int axis = 0; axis < 3; axis++){
+			m_SourceStart[axis] = m_HasSource ? std::min(m_SourceStart[axis], pos[axis]) : pos[axis];
+			m_SourceEnd[axis] = m_HasSource ? std::max(m_SourceEnd[axis], pos[axis]) : pos[axis];
+		}
+		m_HasSource = true;
+
 		if (out_of_local == false){
 			// ポートを作成する
+			// PMCの対称面上のポートは、面の外側の磁界を0として面の内側の半分の電流を測るため、全体モデルの電流となるように倍にする
 			FFPort *port = new FFPort(circuit);
 			double sign = ((dir == X_PLUS) || (dir == Y_PLUS) || (dir == Z_PLUS)) ? 1.0 : -1.0;
+			int port_axis = ((dir == X_PLUS) || (dir == X_MINUS)) ? 0 : ((dir == Y_PLUS) || (dir == Y_MINUS)) ? 1 : 2;
+			double scale = 1.0;
+			for (int axis = 0; axis < 3; axis++){
+				if ((axis != port_axis) && isPMC((Axis)axis) && (pos[axis] == 0)){
+					scale *= 2.0;
+				}
+			}
+			auto attachMProbe = [&](const index3_t &probe_pos, EMType type, double width){
+				if ((probe_pos.x != ~(index_t)0) && (probe_pos.y != ~(index_t)0) && (probe_pos.z != ~(index_t)0)){
+					port->attachMProbe(placeProbe(probe_pos, type, ProbeType::TD), width * scale);
+				}
+			};
 			if ((dir == X_PLUS) || (dir == X_MINUS)){
 				port->attachEProbe(placeProbe(pos, EMType::Ex, ProbeType::TD), sign * m_GridX.iwidth(pos.x));
-				port->attachMProbe(placeProbe(index3_t(pos.x, pos.y, pos.z), EMType::Hz, ProbeType::TD), sign * m_GridZ.mwidth(pos.z));
-				port->attachMProbe(placeProbe(index3_t(pos.x, pos.y - 1, pos.z), EMType::Hz, ProbeType::TD), -sign * m_GridZ.mwidth(pos.z));
-				port->attachMProbe(placeProbe(index3_t(pos.x, pos.y, pos.z), EMType::Hy, ProbeType::TD), -sign * m_GridY.mwidth(pos.y));
-				port->attachMProbe(placeProbe(index3_t(pos.x, pos.y, pos.z - 1), EMType::Hy, ProbeType::TD), sign * m_GridY.mwidth(pos.y));
+				attachMProbe(index3_t(pos.x, pos.y, pos.z), EMType::Hz, sign * m_GridZ.mwidth(pos.z));
+				attachMProbe(index3_t(pos.x, pos.y - 1, pos.z), EMType::Hz, -sign * m_GridZ.mwidth(pos.z));
+				attachMProbe(index3_t(pos.x, pos.y, pos.z), EMType::Hy, -sign * m_GridY.mwidth(pos.y));
+				attachMProbe(index3_t(pos.x, pos.y, pos.z - 1), EMType::Hy, sign * m_GridY.mwidth(pos.y));
 			}
 			else if ((dir == Y_PLUS) || (dir == Y_MINUS)){
 				port->attachEProbe(placeProbe(pos, EMType::Ey, ProbeType::TD), sign * m_GridY.iwidth(pos.y));
-				port->attachMProbe(placeProbe(index3_t(pos.x, pos.y, pos.z), EMType::Hx, ProbeType::TD), sign * m_GridX.mwidth(pos.x));
-				port->attachMProbe(placeProbe(index3_t(pos.x, pos.y, pos.z - 1), EMType::Hx, ProbeType::TD), -sign * m_GridX.mwidth(pos.x));
-				port->attachMProbe(placeProbe(index3_t(pos.x, pos.y, pos.z), EMType::Hz, ProbeType::TD), -sign * m_GridZ.mwidth(pos.z));
-				port->attachMProbe(placeProbe(index3_t(pos.x - 1, pos.y, pos.z), EMType::Hz, ProbeType::TD), sign * m_GridZ.mwidth(pos.z));
+				attachMProbe(index3_t(pos.x, pos.y, pos.z), EMType::Hx, sign * m_GridX.mwidth(pos.x));
+				attachMProbe(index3_t(pos.x, pos.y, pos.z - 1), EMType::Hx, -sign * m_GridX.mwidth(pos.x));
+				attachMProbe(index3_t(pos.x, pos.y, pos.z), EMType::Hz, -sign * m_GridZ.mwidth(pos.z));
+				attachMProbe(index3_t(pos.x - 1, pos.y, pos.z), EMType::Hz, sign * m_GridZ.mwidth(pos.z));
 			}
 			else if ((dir == Z_PLUS) || (dir == Z_MINUS)){
 				port->attachEProbe(placeProbe(pos, EMType::Ez, ProbeType::TD), sign * m_GridZ.iwidth(pos.z));
-				port->attachMProbe(placeProbe(index3_t(pos.x, pos.y, pos.z), EMType::Hy, ProbeType::TD), sign * m_GridY.mwidth(pos.y));
-				port->attachMProbe(placeProbe(index3_t(pos.x - 1, pos.y, pos.z), EMType::Hy, ProbeType::TD), -sign * m_GridY.mwidth(pos.y));
-				port->attachMProbe(placeProbe(index3_t(pos.x, pos.y, pos.z), EMType::Hx, ProbeType::TD), -sign * m_GridX.mwidth(pos.x));
-				port->attachMProbe(placeProbe(index3_t(pos.x, pos.y - 1, pos.z), EMType::Hx, ProbeType::TD), sign * m_GridX.mwidth(pos.x));
+				attachMProbe(index3_t(pos.x, pos.y, pos.z), EMType::Hy, sign * m_GridY.mwidth(pos.y));
+				attachMProbe(index3_t(pos.x - 1, pos.y, pos.z), EMType::Hy, -sign * m_GridY.mwidth(pos.y));
+				attachMProbe(index3_t(pos.x, pos.y, pos.z), EMType::Hx, -sign * m_GridX.mwidth(pos.x));
+				attachMProbe(index3_t(pos.x, pos.y - 1, pos.z), EMType::Hx, sign * m_GridX.mwidth(pos.x));
 			}
 			m_PortList.push_back(port);
 		}
@@ -514,6 +667,46 @@ namespace FFFDTD{
 		return (oindex_t)(m_PortList.size() - 1);
 	}
 
+	// 時間ドメインプローブを配置する
+	oindex_t FFSituation::placeTDProbe(const index3_t &pos, EMType em_type){
+		if ((m_Size.x < pos.x) || (m_Size.y < pos.y) || (m_Size.z < pos.z)){
+			throw FFException("Probe (%u, %u, %u) is out of the region", pos.x, pos.y, pos.z);
+		}
+		const bool cell_z = (em_type == EMType::Ez) || (em_type == EMType::Hx) || (em_type == EMType::Hy);
+		const index_t start = m_LocalOffsetZ + (cell_z ? 0 : getValidStartN(Axis::Z));
+		const index_t end = m_LocalOffsetZ + m_LocalSizeZ + (cell_z ? 0 : 1);
+		if ((pos.z < start) || (end <= pos.z)){
+			return ~(oindex_t)0;
+		}
+		return placeProbe(pos, em_type, ProbeType::TD);
+	}
+
+	// 直方体を細分化したサブグリッドを配置する
+	FFSubgrid* FFSituation::placeSubgrid(const index3_t &start, const index3_t &end){
+		for (int axis = 0; axis < 3; axis++){
+			if (end[axis] <= start[axis]){
+				throw FFException("Subgrid must have at least one cell on axis %d", axis);
+			}
+			// 結合に使う外側の磁界と、その磁界が読む電界は通常空間に置く
+			if ((start[axis] < m_BC.pmlLower[axis] + 2) || (m_Size[axis] < end[axis] + m_BC.pmlUpper[axis] + 2)){
+				throw FFException("Subgrid must be at least 2 cells away from the boundary on axis %d", axis);
+			}
+		}
+		for (const FFSubgrid *subgrid : m_SubgridList){
+			// ゴーストセルを含めて重なると、外側の磁界を2つのサブグリッドで補正・参照することになる
+			bool overlap = true;
+			for (int axis = 0; axis < 3; axis++){
+				overlap &= (start[axis] <= subgrid->getEnd()[axis] + 1) && (subgrid->getStart()[axis] <= end[axis] + 1);
+			}
+			if (overlap){
+				throw FFException("Subgrids must not overlap including their ghost cells");
+			}
+		}
+		FFSubgrid *subgrid = new FFSubgrid(this, start, end);
+		m_SubgridList.push_back(subgrid);
+		return subgrid;
+	}
+
 	// プローブを配置する
 	oindex_t FFSituation::placeProbe(const index3_t &pos, EMType em_type, ProbeType probe_type){
 		// プローブの位置をチェックする
@@ -575,12 +768,12 @@ namespace FFFDTD{
 #pragma endregion
 
 #pragma region 係数を計算するメソッド
-	// Exに作用する物性値を取得する
-	bool FFSituation::getMaterialEx(const index3_t &pos, FFMaterial *material) const{
-		const FFMaterial *mat1 = m_MaterialList[m_Volume.getPointRepeat(pos.x, pos.y, pos.z)];
-		const FFMaterial *mat2 = m_MaterialList[m_Volume.getPointRepeat(pos.x, pos.y - 1, pos.z)];
-		const FFMaterial *mat3 = m_MaterialList[m_Volume.getPointRepeat(pos.x, pos.y, pos.z - 1)];
-		const FFMaterial *mat4 = m_MaterialList[m_Volume.getPointRepeat(pos.x, pos.y - 1, pos.z - 1)];
+	// 指定したレーンのExに作用する物性値を取得する
+	bool FFSituation::getMaterialEx(const index3_t &pos, index_t lane, FFMaterial *material) const{
+		const FFMaterial *mat1 = getLaneMaterial(m_Volume.getPointRepeat(pos.x, pos.y, pos.z), lane);
+		const FFMaterial *mat2 = getLaneMaterial(m_Volume.getPointRepeat(pos.x, getLowerCell(Axis::Y, pos.y), pos.z), lane);
+		const FFMaterial *mat3 = getLaneMaterial(m_Volume.getPointRepeat(pos.x, pos.y, getLowerCell(Axis::Z, pos.z)), lane);
+		const FFMaterial *mat4 = getLaneMaterial(m_Volume.getPointRepeat(pos.x, getLowerCell(Axis::Y, pos.y), getLowerCell(Axis::Z, pos.z)), lane);
 		if ((mat1 == nullptr) || (mat2 == nullptr) || (mat3 == nullptr) || (mat4 == nullptr)){
 			throw;
 		}
@@ -591,12 +784,12 @@ namespace FFFDTD{
 		return m_PECX.getPointRepeat(pos.x, pos.y, pos.z);
 	}
 
-	// Eyに作用する物性値を取得する
-	bool FFSituation::getMaterialEy(const index3_t &pos, FFMaterial *material) const{
-		const FFMaterial *mat1 = m_MaterialList[m_Volume.getPointRepeat(pos.x, pos.y, pos.z)];
-		const FFMaterial *mat2 = m_MaterialList[m_Volume.getPointRepeat(pos.x - 1, pos.y, pos.z)];
-		const FFMaterial *mat3 = m_MaterialList[m_Volume.getPointRepeat(pos.x, pos.y, pos.z - 1)];
-		const FFMaterial *mat4 = m_MaterialList[m_Volume.getPointRepeat(pos.x - 1, pos.y, pos.z - 1)];
+	// 指定したレーンのEyに作用する物性値を取得する
+	bool FFSituation::getMaterialEy(const index3_t &pos, index_t lane, FFMaterial *material) const{
+		const FFMaterial *mat1 = getLaneMaterial(m_Volume.getPointRepeat(pos.x, pos.y, pos.z), lane);
+		const FFMaterial *mat2 = getLaneMaterial(m_Volume.getPointRepeat(getLowerCell(Axis::X, pos.x), pos.y, pos.z), lane);
+		const FFMaterial *mat3 = getLaneMaterial(m_Volume.getPointRepeat(pos.x, pos.y, getLowerCell(Axis::Z, pos.z)), lane);
+		const FFMaterial *mat4 = getLaneMaterial(m_Volume.getPointRepeat(getLowerCell(Axis::X, pos.x), pos.y, getLowerCell(Axis::Z, pos.z)), lane);
 		if ((mat1 == nullptr) || (mat2 == nullptr) || (mat3 == nullptr) || (mat4 == nullptr)){
 			throw;
 		}
@@ -607,12 +800,12 @@ namespace FFFDTD{
 		return m_PECY.getPointRepeat(pos.x, pos.y, pos.z);
 	}
 
-	// Ezに作用する物性値を取得する
-	bool FFSituation::getMaterialEz(const index3_t &pos, FFMaterial *material) const{
-		const FFMaterial *mat1 = m_MaterialList[m_Volume.getPointRepeat(pos.x, pos.y, pos.z)];
-		const FFMaterial *mat2 = m_MaterialList[m_Volume.getPointRepeat(pos.x - 1, pos.y, pos.z)];
-		const FFMaterial *mat3 = m_MaterialList[m_Volume.getPointRepeat(pos.x, pos.y - 1, pos.z)];
-		const FFMaterial *mat4 = m_MaterialList[m_Volume.getPointRepeat(pos.x - 1, pos.y - 1, pos.z)];
+	// 指定したレーンのEzに作用する物性値を取得する
+	bool FFSituation::getMaterialEz(const index3_t &pos, index_t lane, FFMaterial *material) const{
+		const FFMaterial *mat1 = getLaneMaterial(m_Volume.getPointRepeat(pos.x, pos.y, pos.z), lane);
+		const FFMaterial *mat2 = getLaneMaterial(m_Volume.getPointRepeat(getLowerCell(Axis::X, pos.x), pos.y, pos.z), lane);
+		const FFMaterial *mat3 = getLaneMaterial(m_Volume.getPointRepeat(pos.x, getLowerCell(Axis::Y, pos.y), pos.z), lane);
+		const FFMaterial *mat4 = getLaneMaterial(m_Volume.getPointRepeat(getLowerCell(Axis::X, pos.x), getLowerCell(Axis::Y, pos.y), pos.z), lane);
 		if ((mat1 == nullptr) || (mat2 == nullptr) || (mat3 == nullptr) || (mat4 == nullptr)){
 			throw;
 		}
@@ -623,10 +816,10 @@ namespace FFFDTD{
 		return m_PECZ.getPointRepeat(pos.x, pos.y, pos.z);
 	}
 
-	// Hxに作用する物性値を取得する
-	void FFSituation::getMaterialHx(const index3_t &pos, FFMaterial *material) const{
-		const FFMaterial *mat1 = m_MaterialList[m_Volume.getPointRepeat(pos.x, pos.y, pos.z)];
-		const FFMaterial *mat2 = m_MaterialList[m_Volume.getPointRepeat(pos.x - 1, pos.y, pos.z)];
+	// 指定したレーンのHxに作用する物性値を取得する
+	void FFSituation::getMaterialHx(const index3_t &pos, index_t lane, FFMaterial *material) const{
+		const FFMaterial *mat1 = getLaneMaterial(m_Volume.getPointRepeat(pos.x, pos.y, pos.z), lane);
+		const FFMaterial *mat2 = getLaneMaterial(m_Volume.getPointRepeat(getLowerCell(Axis::X, pos.x), pos.y, pos.z), lane);
 		if ((mat1 == nullptr) || (mat2 == nullptr)){
 			throw;
 		}
@@ -636,10 +829,10 @@ namespace FFFDTD{
 			(mat1->mu_r() + mat2->mu_r()) * 0.5);
 	}
 
-	// Hyに作用する物性値を取得する
-	void FFSituation::getMaterialHy(const index3_t &pos, FFMaterial *material) const{
-		const FFMaterial *mat1 = m_MaterialList[m_Volume.getPointRepeat(pos.x, pos.y, pos.z)];
-		const FFMaterial *mat2 = m_MaterialList[m_Volume.getPointRepeat(pos.x, pos.y - 1, pos.z)];
+	// 指定したレーンのHyに作用する物性値を取得する
+	void FFSituation::getMaterialHy(const index3_t &pos, index_t lane, FFMaterial *material) const{
+		const FFMaterial *mat1 = getLaneMaterial(m_Volume.getPointRepeat(pos.x, pos.y, pos.z), lane);
+		const FFMaterial *mat2 = getLaneMaterial(m_Volume.getPointRepeat(pos.x, getLowerCell(Axis::Y, pos.y), pos.z), lane);
 		if ((mat1 == nullptr) || (mat2 == nullptr)){
 			throw;
 		}
@@ -649,10 +842,10 @@ namespace FFFDTD{
 			(mat1->mu_r() + mat2->mu_r()) * 0.5);
 	}
 
-	// Hzに作用する物性値を取得する
-	void FFSituation::getMaterialHz(const index3_t &pos, FFMaterial *material) const{
-		const FFMaterial *mat1 = m_MaterialList[m_Volume.getPointRepeat(pos.x, pos.y, pos.z)];
-		const FFMaterial *mat2 = m_MaterialList[m_Volume.getPointRepeat(pos.x, pos.y, pos.z - 1)];
+	// 指定したレーンのHzに作用する物性値を取得する
+	void FFSituation::getMaterialHz(const index3_t &pos, index_t lane, FFMaterial *material) const{
+		const FFMaterial *mat1 = getLaneMaterial(m_Volume.getPointRepeat(pos.x, pos.y, pos.z), lane);
+		const FFMaterial *mat2 = getLaneMaterial(m_Volume.getPointRepeat(pos.x, pos.y, getLowerCell(Axis::Z, pos.z)), lane);
 		if ((mat1 == nullptr) || (mat2 == nullptr)){
 			throw;
 		}
@@ -665,8 +858,19 @@ namespace FFFDTD{
 
 	
 #pragma region ソルバーを操作するメソッド
+	// レーンごとに励振するポートを設定する
+	void FFSituation::setExcitation(const std::vector<oindex_t> &port_list){
+		for (oindex_t port : port_list){
+			if (m_PortList.size() <= port){
+				throw FFException("Port[%u] for excitation does not exist", port);
+			}
+		}
+		m_ExcitationList = port_list;
+		updateLanes();
+	}
+
 	// ソルバーにシミュレーション環境を構成する
-	void FFSituation::configureSolver(FFSolver *solver, double timestep, size_t max_iteration, const std::vector<double> &measure_freq){
+	void FFSituation::configureSolver(FFSolver *solver, double timestep, size_t max_iteration, const std::vector<double> &measure_freq, Precision precision){
 		// ソルバーを上書きする
 		delete m_Solver;
 		m_Solver = solver;
@@ -678,6 +882,59 @@ namespace FFFDTD{
 		if ((timestep <= 0.0) || (max_iteration <= 0)){
 			throw;
 		}
+		if ((m_SpatialOrder == 4) && (m_LocalSizeZ != m_Size.z) && (m_LocalSizeZ < 2)){
+			// 隣接する領域へ送る端部から2面目がローカル領域で計算されない
+			throw FFException("Fourth-order spatial stencil requires at least 2 cells per division in Z (%u)", (unsigned int)m_LocalSizeZ);
+		}
+		if (m_ImplicitZ){
+			// Z方向の3重対角方程式は列の全体を1つの領域で解く
+			if ((m_LocalSizeZ != m_Size.z) || isConnectedZ()){
+				throw FFException("HIE scheme requires an undivided, non-periodic Z axis");
+			}
+			// X・Y方向の分割型PMLは分割成分の和で電磁界を求めるため、増分の補正と整合しない
+			const bvec3 &cpml = getPmlCPML();
+			for (int axis = 0; axis < 2; axis++){
+				if ((cpml[axis] == false) && ((0 < m_BC.pmlLower[axis]) || (0 < m_BC.pmlUpper[axis]))){
+					throw FFException("HIE scheme requires CPML on the X and Y boundaries");
+				}
+			}
+			if (m_SpatialOrder == 4){
+				throw FFException("HIE scheme cannot be combined with the fourth-order spatial stencil");
+			}
+		}
+		if (m_SubgridList.empty() == false){
+			// 結合はグローバル領域のグリッド番号で成分を読み書きし、境界面の電界・磁界は2次精度の差分で同じタイムステップに更新する
+			if (m_LocalSizeZ != m_Size.z){
+				throw FFException("Subgrids require an undivided Z axis");
+			}
+			if (m_ImplicitZ || (m_SpatialOrder == 4)){
+				throw FFException("Subgrids cannot be combined with the HIE scheme or the fourth-order spatial stencil");
+			}
+			// 直方体の内側の粗いグリッドの電磁界は計算に使わないため、観測点を置けない
+			for (const FFSubgrid *subgrid : m_SubgridList){
+				auto isInside = [subgrid](const index3_t &pos) -> bool{
+					for (int axis = 0; axis < 3; axis++){
+						if ((pos[axis] < subgrid->getStart()[axis]) || (subgrid->getEnd()[axis] < pos[axis])){
+							return false;
+						}
+					}
+					return true;
+				};
+				for (const Probe_t &probe : m_TDProbeList){
+					if (isInside(probe.pos)){
+						throw FFException("Port or probe cannot be placed inside a subgrid");
+					}
+				}
+				for (const Probe_t &probe : m_FDProbeList){
+					if (isInside(probe.pos)){
+						throw FFException("Port or probe cannot be placed inside a subgrid");
+					}
+				}
+			}
+			for (const FFSubgrid *subgrid : m_SubgridList){
+				excludeSubgridInterior(subgrid->getStart(), subgrid->getEnd());
+			}
+		}
 		m_Timestep = timestep;
 		m_NT = max_iteration;
 		m_IT = 0;
@@ -689,7 +946,9 @@ namespace FFFDTD{
 		// WNxyz : グローバル領域のグリッド本数
 		// Mxyz  : ローカル領域のセル数
 		// Nxyz  : ローカル領域のグリッド本数(Mxyz+1)
+		// VSxyz : ローカル領域でn型の成分を計算する範囲の始点 (PMCの対称面では面上の成分も計算する)
 		// VNxyz : ローカル領域の有効なグリッド本数
+		// GVNz  : 全領域のZ方向の有効なグリッド本数
 		const index_t GNx = m_Size.x + 1;
 		const index_t GNy = m_Size.y + 1;
 		const index_t GNz = m_Size.z + 1;
@@ -699,63 +958,107 @@ namespace FFFDTD{
 		const index_t Nx = Mx + 1;
 		const index_t Ny = My + 1;
 		const index_t Nz = Mz + 1;
+		const index_t VSx = getValidStartN(Axis::X);
+		const index_t VSy = getValidStartN(Axis::Y);
+		const index_t VSz = getValidStartN(Axis::Z);
 		const index_t VNx = Nx - (isConnectedX() ? 0 : 1);
 		const index_t VNy = Ny - (isConnectedY() ? 0 : 1);
 		const index_t VNz = Nz - (isConnectedZ() ? 0 : 1);
-		const index_t Lx = m_BC.pmlL.x, Ly = m_BC.pmlL.y, Lz = m_BC.pmlL.z;
-		m_CountPerSlice = (Mx + 1) * (My + 1);
-
-		// 通常空間の計算領域を求める
-		const index_t x_start_m = Lx;
-		const index_t y_start_m = Ly;
-		const index_t z_start_m = (m_LocalOffsetZ < Lz) ? (Lz - m_LocalOffsetZ) : 0;
-		const index_t x_start_n = x_start_m + 1;
-		const index_t y_start_n = y_start_m + 1;
-		const index_t z_start_n = z_start_m + 1;
-		const index_t x_end_m = Mx - Lx;
-		const index_t x_end_n = Nx - Lx - (isConnectedX() ? 0 : 1);
-		const index_t y_end_m = My - Ly;
-		const index_t y_end_n = Ny - Ly - (isConnectedY() ? 0 : 1);
-		const index_t z_end_m = std::min(m_LocalSizeZ, m_Size.z - Lz - m_LocalOffsetZ);
-		const index_t z_end_n = std::min(m_LocalSizeZ + 1, m_Size.z + 1 - Lz - m_LocalOffsetZ) - (isConnectedZ() ? 0 : 1);
+		const index_t GVNz = GNz - ((m_BC.lower[2] == BoundaryCondition::Periodic) ? 0 : 1);
+		const index3_t &L1 = m_BC.pmlLower, &L2 = m_BC.pmlUpper;
+		m_CountPerSlice = (size_t)(Mx + 1) * (My + 1) * m_Lanes;
+
+		// 負側 (1) と正側 (2) の面ごとの分割型PMLとCPMLの層数
+		// CPMLの層は通常空間として計算し、補助変数による補正を加える
+		const bvec3 &cpml = getPmlCPML();
+		const index3_t SL1(cpml.x ? 0 : L1.x, cpml.y ? 0 : L1.y, cpml.z ? 0 : L1.z);
+		const index3_t SL2(cpml.x ? 0 : L2.x, cpml.y ? 0 : L2.y, cpml.z ? 0 : L2.z);
+		const index3_t CL1(cpml.x ? L1.x : 0, cpml.y ? L1.y : 0, cpml.z ? L1.z : 0);
+		const index3_t CL2(cpml.x ? L2.x : 0, cpml.y ? L2.y : 0, cpml.z ? L2.z : 0);
+
+		// 通常空間の計算領域を求める (プロセスの担当範囲が全てPMLのときは空の範囲とする)
+		const index_t x_start_m = SL1.x;
+		const index_t y_start_m = SL1.y;
+		const index_t z_start_m = (m_LocalOffsetZ < SL1.z) ? std::min(SL1.z - m_LocalOffsetZ, m_LocalSizeZ) : 0;
+		const index_t x_start_n = x_start_m + VSx;
+		const index_t y_start_n = y_start_m + VSy;
+		const index_t z_start_n = z_start_m + VSz;
+		const index_t x_end_m = Mx - SL2.x;
+		const index_t x_end_n = Nx - SL2.x - (isConnectedX() ? 0 : 1);
+		const index_t y_end_m = My - SL2.y;
+		const index_t y_end_n = Ny - SL2.y - (isConnectedY() ? 0 : 1);
+		const index_t z_end_m = std::max(std::min(m_LocalOffsetZ + m_LocalSizeZ, m_Size.z - SL2.z), m_LocalOffsetZ + z_start_m) - m_LocalOffsetZ;
+		const index_t z_end_n = std::max(std::min(m_LocalOffsetZ + VNz, GVNz - SL2.z), m_LocalOffsetZ + z_start_n) - m_LocalOffsetZ;
+
+		// CPMLの層を除いた内側の領域を求める (同じ規則で、CPMLでない軸は全域とする)
+		const index_t cx_start_m = CL1.x;
+		const index_t cy_start_m = CL1.y;
+		const index_t cz_start_m = (m_LocalOffsetZ < CL1.z) ? std::min(CL1.z - m_LocalOffsetZ, m_LocalSizeZ) : 0;
+		const index_t cx_start_n = cx_start_m + VSx;
+		const index_t cy_start_n = cy_start_m + VSy;
+		const index_t cz_start_n = cz_start_m + VSz;
+		const index_t cx_end_m = Mx - CL2.x;
+		const index_t cx_end_n = Nx - CL2.x - (isConnectedX() ? 0 : 1);
+		const index_t cy_end_m = My - CL2.y;
+		const index_t cy_end_n = Ny - CL2.y - (isConnectedY() ? 0 : 1);
+		const index_t cz_end_m = std::max(std::min(m_LocalOffsetZ + m_LocalSizeZ, m_Size.z - CL2.z), m_LocalOffsetZ + cz_start_m) - m_LocalOffsetZ;
+		const index_t cz_end_n = std::max(std::min(m_LocalOffsetZ + VNz, GVNz - CL2.z), m_LocalOffsetZ + cz_start_n) - m_LocalOffsetZ;
 		
 		// ソルバーにメモリーを確保させる
+		solver->setSpatialOrder(m_SpatialOrder);
+		solver->setImplicitZ(m_ImplicitZ);
 		solver->initializeMemory(
 			index3_t(Mx, My, Mz),
 			index3_t(x_start_m, y_start_m, z_start_m),
 			index3_t(x_start_n, y_start_n, z_start_n),
 			index3_t(x_end_m - x_start_m, y_end_m - y_start_m, z_end_m - z_start_m),
-			index3_t(x_end_n - x_start_n, y_end_n - y_start_n, z_end_n - z_start_n));
+			index3_t(x_end_n - x_start_n, y_end_n - y_start_n, z_end_n - z_start_n),
+			m_Lanes, precision);
+		solver->setPeriodic(isConnectedX(), isConnectedY(), dvec2(m_BC.phase.x, m_BC.phase.y));
 		
 		// 係数リスト
-		std::vector<rvec2> coef2_list(1, rvec2(0.0, 0.0));
-		std::vector<rvec3> coef3_list(1, rvec3(0.0, 0.0, 0.0));
+		// 各エントリーはCL組の係数からなり、材質をスイープするときはレーンごとに異なる係数を持つ
+		// 係数は倍精度で計算し、単精度で演算するときは登録の前に丸めて、丸めた後の値で同じ係数をまとめる
+		const index_t CL = (1 < m_SweepCount) ? m_Lanes : 1;
+		const bool round_coef = (getComputeSize(precision) == sizeof(float));
+		std::vector<dvec2> coef2_list(CL, dvec2(0.0, 0.0));
+		std::vector<dvec3> coef3_list(CL, dvec3(0.0, 0.0, 0.0));
 		const cindex_t pec_id = 0;
 		std::mutex coef2_mutex, coef3_mutex;
 
 		// 2組係数を登録する関数
-		auto registerCoef2 = [&](const rvec2 &coef) -> cindex_t{
+		auto registerCoef2 = [&](std::vector<dvec2> coef) -> cindex_t{
+			if (round_coef){
+				for (dvec2 &c : coef){
+					c = dvec2(fvec2(c));
+				}
+			}
 			std::lock_guard<std::mutex> lock(coef2_mutex);
-			size_t index;
-			for (index = 0; index < coef2_list.size(); index++){
-				if (coef2_list[index] == coef){
+			size_t index, count = coef2_list.size() / CL;
+			for (index = 0; index < count; index++){
+				if (std::equal(coef.begin(), coef.end(), coef2_list.begin() + index * CL)){
 					return static_cast<cindex_t>(index);
 				}
 			}
-			coef2_list.push_back(coef);
+			coef2_list.insert(coef2_list.end(), coef.begin(), coef.end());
 			return static_cast<cindex_t>(index);
 		};
 
 		// 3組係数を登録する関数
-		auto registerCoef3 = [&](const rvec3 &coef) -> cindex_t{
+		auto registerCoef3 = [&](std::vector<dvec3> coef) -> cindex_t{
+			if (round_coef){
+				for (dvec3 &c : coef){
+					c = dvec3(fvec3(c));
+				}
+			}
 			std::lock_guard<std::mutex> lock(coef3_mutex);
-			size_t index;
-			for (index = 0; index < coef3_list.size(); index++){
-				if (coef3_list[index] == coef){
+			size_t index, count = coef3_list.size() / CL;
+			for (index = 0; index < count; index++){
+				if (std::equal(coef.begin(), coef.end(), coef3_list.begin() + index * CL)){
 					return static_cast<cindex_t>(index);
 				}
 			}
-			coef3_list.push_back(coef);
+			coef3_list.insert(coef3_list.end(), coef.begin(), coef.end());
 			return static_cast<cindex_t>(index);
 		};
 
@@ -769,18 +1072,50 @@ namespace FFFDTD{
 		};
 
 		// PMLの導電率を計算する関数
-		auto calcSigma = [pml_m](double sigma_max, double i1, double i2, double i, int pml_l) -> double{
-			if (i <= i1){
-				return sigma_max * pow((i1 - i) / pml_l, pml_m);
+		// 負側と正側の面の層数l1, l2 (0のときはPMLなし) ごとに、その面の層数で最大導電率を求める
+		auto calcSigma = [&](double eps, double width, index_t l1, index_t l2, index_t grid_count, double i) -> double{
+			double i1 = l1, i2 = grid_count - l2 - 1;
+			if ((0 < l1) && (i <= i1)){
+				return calcSigmaMax(eps, width, l1) * pow((i1 - i) / l1, pml_m);
 			}
-			else if (i2 <= i){
-				return sigma_max * pow((i - i2) / pml_l, pml_m);
+			else if ((0 < l2) && (i2 <= i)){
+				return calcSigmaMax(eps, width, l2) * pow((i - i2) / l2, pml_m);
 			}
 			else{
 				return 0.0;
 			}
 		};
 
+		// CPMLの補助変数の係数(b, a)と差分の係数gを計算する関数
+		// 導電率とαは誘電率 (磁界では透磁率) に比例させるため、係数は材質によらない
+		// 層の外やCPMLでない面 (層数が0) では補助変数を使わない係数(1, 0, 1)とする
+		// 分割型PMLの軸と混在するときは、両方の層が重なる角を分割型PMLで計算するため、
+		// 角との境界で反射しないようにκを1、αを0として分割型PMLと同じ吸収特性とする
+		const bool has_split = (SL1 != index3_t(0, 0, 0)) || (SL2 != index3_t(0, 0, 0));
+		const double kappa_max = has_split ? 1.0 : getPmlKappa();
+		const double alpha_n_max = has_split ? 0.0 : (getPmlAlpha() / EPS_0);
+		auto calcCPMLCoef = [&](double width, index_t l1, index_t l2, index_t grid_count, double i) -> dvec3{
+			double i1 = l1, i2 = grid_count - l2 - 1;
+			double depth = 0.0;
+			index_t pml_l = 0;
+			if ((0 < l1) && (i <= i1)){
+				depth = (i1 - i) / l1;
+				pml_l = l1;
+			}
+			else if ((0 < l2) && (i2 <= i)){
+				depth = (i - i2) / l2;
+				pml_l = l2;
+			}
+			if (depth <= 0.0){
+				return dvec3(1.0, 0.0, 1.0);
+			}
+			double grade = pow(depth, pml_m);
+			double sigma_n = calcSigmaMax(1.0, width, pml_l) * grade;
+			double alpha_n = alpha_n_max * (1.0 - depth);
+			double kappa = 1.0 + (kappa_max - 1.0) * grade;
+			return FFMaterial::calcCoefCPML(sigma_n, kappa, alpha_n, Dt);
+		};
+
 		// 係数を計算する
 #pragma omp parallel sections num_threads(6)
 		{
@@ -788,229 +1123,655 @@ namespace FFFDTD{
 #pragma omp section
 			{
 				std::vector<cindex_t> normal_cindex(Nx * Ny * Nz, pec_id);
-				std::vector<cindex2_t> pml_cindex;
-				std::vector<index_t> pml_index;
-				for (index_t ilz = 1; ilz < VNz; ilz++){
+				std::vector<PMLBox_t> pml_box_list = createPMLBoxList(index3_t(0, VSy, VSz), index3_t(Mx, VNy, VNz), index3_t(x_start_m, y_start_n, z_start_n), index3_t(x_end_m, y_end_n, z_end_n));
+				std::vector<PMLBox_t> cpml_box_list = createPMLBoxList(index3_t(x_start_m, y_start_n, z_start_n), index3_t(x_end_m, y_end_n, z_end_n),
+					index3_t(x_start_m, cy_start_n, cz_start_n), index3_t(x_end_m, cy_end_n, cz_end_n));
+				std::vector<dvec2> coef_pml1(CL), coef_pml2(CL), coef2(CL);
+				std::vector<dvec3> coef3(CL);
+				for (index_t ilz = VSz; ilz < VNz; ilz++){
 					index_t iz = m_LocalOffsetZ + ilz;
-					for (index_t iy = 1; iy < VNy; iy++){
+					for (index_t iy = VSy; iy < VNy; iy++){
 						for (index_t ix = 0; ix < Mx; ix++){
 							double dy = m_GridY.mwidth(iy);
 							double dz = m_GridZ.mwidth(iz);
-							FFMaterial mat;
-							bool pec = getMaterialEx(index3_t(ix, iy, iz), &mat);
-							if ((ilz < z_start_n) || (z_end_n <= ilz) ||
+							bool pml = ((ilz < z_start_n) || (z_end_n <= ilz) ||
 								(iy < y_start_n) || (y_end_n <= iy) ||
-								(ix < x_start_m) || (x_end_m <= ix))
-							{
-								double sigma_y = (0 < Ly) ? calcSigma(calcSigmaMax(mat.eps(), dy, Ly), Ly, GNy - Ly - 1, iy, Ly) : 0.0;
-								double sigma_z = (0 < Lz) ? calcSigma(calcSigmaMax(mat.eps(), dz, Lz), Lz, GNz - Lz - 1, iz, Lz) : 0.0;
-								pml_cindex.push_back(cindex2_t(
-									registerCoef2(FFMaterial::calcDCoefPML(mat.eps_r(), sigma_y, Dt, dy)),
-									registerCoef2(FFMaterial::calcDCoefPML(mat.eps_r(), sigma_z, Dt, dz))));
-								pml_index.push_back(ix + Nx * (iy + Ny * ilz));
-								normal_cindex[ix + Nx * (iy + Ny * ilz)] = pec ? pec_id : registerCoef2(mat.calcECoefPML(Dt));
+								(ix < x_start_m) || (x_end_m <= ix));
+							bool cpml = !pml && ((iy < cy_start_n) || (cy_end_n <= iy) ||
+								(ilz < cz_start_n) || (cz_end_n <= ilz));
+							bool pec = false;
+							for (index_t lane = 0; lane < CL; lane++){
+								FFMaterial mat;
+								pec = getMaterialEx(index3_t(ix, iy, iz), lane, &mat);
+								if (pml){
+									double sigma_y = calcSigma(mat.eps(), dy, L1.y, L2.y, GNy, iy);
+									double sigma_z = calcSigma(mat.eps(), dz, L1.z, L2.z, GNz, iz);
+									coef_pml1[lane] = FFMaterial::calcDCoefPML(mat.eps_r(), sigma_y, Dt, dy);
+									coef_pml2[lane] = FFMaterial::calcDCoefPML(mat.eps_r(), sigma_z, Dt, dz);
+									coef2[lane] = mat.calcECoefPML(Dt);
+								}
+								else if (cpml){
+									dvec3 cpml_y = calcCPMLCoef(dy, CL1.y, CL2.y, GNy, iy);
+									dvec3 cpml_z = calcCPMLCoef(dz, CL1.z, CL2.z, GNz, iz);
+									dvec3 coef = mat.calcECoef(Dt, dy, dz);
+									coef3[lane] = mat.calcECoef(Dt, dy / cpml_y.z, dz / cpml_z.z);
+									coef_pml1[lane] = dvec2(cpml_y.x, coef.y * cpml_y.y);
+									coef_pml2[lane] = dvec2(cpml_z.x, coef.z * cpml_z.y);
+								}
+								else{
+									coef3[lane] = mat.calcECoef(Dt, dy, dz);
+								}
+							}
+							if (pml){
+								getPMLCIndex(pml_box_list, ix, iy, ilz) = cindex2_t(registerCoef2(coef_pml1), registerCoef2(coef_pml2));
+								normal_cindex[ix + Nx * (iy + Ny * ilz)] = pec ? pec_id : registerCoef2(coef2);
 							}
 							else{
-								normal_cindex[ix + Nx * (iy + Ny * ilz)] = pec ? pec_id : registerCoef3(mat.calcECoef(Dt, dy, dz));
+								if (cpml){
+									getPMLCIndex(cpml_box_list, ix, iy, ilz) = pec ? cindex2_t(pec_id, pec_id) : cindex2_t(registerCoef2(coef_pml1), registerCoef2(coef_pml2));
+								}
+								normal_cindex[ix + Nx * (iy + Ny * ilz)] = pec ? pec_id : registerCoef3(coef3);
 							}
 						}
 					}
 				}
 
 #pragma omp critical
-				m_Solver->storeCoefficientIndex(EMType::Ex, normal_cindex, pml_cindex, pml_index);
+				m_Solver->storeCoefficientIndex(EMType::Ex, normal_cindex, pml_box_list, cpml_box_list);
 			}
 
 			// Dy,Eyに対する係数を計算する
 #pragma omp section
 			{
 				std::vector<cindex_t> normal_cindex(Nx * Ny * Nz, pec_id);
-				std::vector<cindex2_t> pml_cindex;
-				std::vector<index_t> pml_index;
-				for (index_t ilz = 1; ilz < VNz; ilz++){
+				std::vector<PMLBox_t> pml_box_list = createPMLBoxList(index3_t(VSx, 0, VSz), index3_t(VNx, My, VNz), index3_t(x_start_n, y_start_m, z_start_n), index3_t(x_end_n, y_end_m, z_end_n));
+				std::vector<PMLBox_t> cpml_box_list = createPMLBoxList(index3_t(x_start_n, y_start_m, z_start_n), index3_t(x_end_n, y_end_m, z_end_n),
+					index3_t(cx_start_n, y_start_m, cz_start_n), index3_t(cx_end_n, y_end_m, cz_end_n));
+				std::vector<dvec2> coef_pml1(CL), coef_pml2(CL), coef2(CL);
+				std::vector<dvec3> coef3(CL);
+				for (index_t ilz = VSz; ilz < VNz; ilz++){
 					index_t iz = m_LocalOffsetZ + ilz;
 					for (index_t iy = 0; iy < My; iy++){
-						for (index_t ix = 1; ix < VNx; ix++){
+						for (index_t ix = VSx; ix < VNx; ix++){
 							double dz = m_GridZ.mwidth(iz);
 							double dx = m_GridX.mwidth(ix);
-							FFMaterial mat;
-							bool pec = getMaterialEy(index3_t(ix, iy, iz), &mat);
-							if ((ilz < z_start_n) || (z_end_n <= ilz) ||
+							bool pml = ((ilz < z_start_n) || (z_end_n <= ilz) ||
 								(iy < y_start_m) || (y_end_m <= iy) ||
-								(ix < x_start_n) || (x_end_n <= ix))
-							{
-								double sigma_z = (0 < Lz) ? calcSigma(calcSigmaMax(mat.eps(), dz, Lz), Lz, GNz - Lz - 1, iz, Lz) : 0.0;
-								double sigma_x = (0 < Lx) ? calcSigma(calcSigmaMax(mat.eps(), dx, Lx), Lx, GNx - Lx - 1, ix, Lx) : 0.0;
-								pml_cindex.push_back(cindex2_t(
-									registerCoef2(FFMaterial::calcDCoefPML(mat.eps_r(), sigma_z, Dt, dz)),
-									registerCoef2(FFMaterial::calcDCoefPML(mat.eps_r(), sigma_x, Dt, dx))));
-								pml_index.push_back(ix + Nx * (iy + Ny * ilz));
-								normal_cindex[ix + Nx * (iy + Ny * ilz)] = pec ? pec_id : registerCoef2(mat.calcECoefPML(Dt));
+								(ix < x_start_n) || (x_end_n <= ix));
+							bool cpml = !pml && ((ilz < cz_start_n) || (cz_end_n <= ilz) ||
+								(ix < cx_start_n) || (cx_end_n <= ix));
+							bool pec = false;
+							for (index_t lane = 0; lane < CL; lane++){
+								FFMaterial mat;
+								pec = getMaterialEy(index3_t(ix, iy, iz), lane, &mat);
+								if (pml){
+									double sigma_z = calcSigma(mat.eps(), dz, L1.z, L2.z, GNz, iz);
+									double sigma_x = calcSigma(mat.eps(), dx, L1.x, L2.x, GNx, ix);
+									coef_pml1[lane] = FFMaterial::calcDCoefPML(mat.eps_r(), sigma_z, Dt, dz);
+									coef_pml2[lane] = FFMaterial::calcDCoefPML(mat.eps_r(), sigma_x, Dt, dx);
+									coef2[lane] = mat.calcECoefPML(Dt);
+								}
+								else if (cpml){
+									dvec3 cpml_z = calcCPMLCoef(dz, CL1.z, CL2.z, GNz, iz);
+									dvec3 cpml_x = calcCPMLCoef(dx, CL1.x, CL2.x, GNx, ix);
+									dvec3 coef = mat.calcECoef(Dt, dz, dx);
+									coef3[lane] = mat.calcECoef(Dt, dz / cpml_z.z, dx / cpml_x.z);
+									coef_pml1[lane] = dvec2(cpml_z.x, coef.y * cpml_z.y);
+									coef_pml2[lane] = dvec2(cpml_x.x, coef.z * cpml_x.y);
+								}
+								else{
+									coef3[lane] = mat.calcECoef(Dt, dz, dx);
+								}
+							}
+							if (pml){
+								getPMLCIndex(pml_box_list, ix, iy, ilz) = cindex2_t(registerCoef2(coef_pml1), registerCoef2(coef_pml2));
+								normal_cindex[ix + Nx * (iy + Ny * ilz)] = pec ? pec_id : registerCoef2(coef2);
 							}
 							else{
-								normal_cindex[ix + Nx * (iy + Ny * ilz)] = pec ? pec_id : registerCoef3(mat.calcECoef(Dt, dz, dx));
+								if (cpml){
+									getPMLCIndex(cpml_box_list, ix, iy, ilz) = pec ? cindex2_t(pec_id, pec_id) : cindex2_t(registerCoef2(coef_pml1), registerCoef2(coef_pml2));
+								}
+								normal_cindex[ix + Nx * (iy + Ny * ilz)] = pec ? pec_id : registerCoef3(coef3);
 							}
 						}
 					}
 				}
 
 #pragma omp critical
-				m_Solver->storeCoefficientIndex(EMType::Ey, normal_cindex, pml_cindex, pml_index);
+				m_Solver->storeCoefficientIndex(EMType::Ey, normal_cindex, pml_box_list, cpml_box_list);
 			}
 
 			// Dz,Ezに対する係数を計算する
 #pragma omp section
 			{
 				std::vector<cindex_t> normal_cindex(Nx * Ny * Nz, pec_id);
-				std::vector<cindex2_t> pml_cindex;
-				std::vector<index_t> pml_index;
+				std::vector<PMLBox_t> pml_box_list = createPMLBoxList(index3_t(VSx, VSy, 0), index3_t(VNx, VNy, Mz), index3_t(x_start_n, y_start_n, z_start_m), index3_t(x_end_n, y_end_n, z_end_m));
+				std::vector<PMLBox_t> cpml_box_list = createPMLBoxList(index3_t(x_start_n, y_start_n, z_start_m), index3_t(x_end_n, y_end_n, z_end_m),
+					index3_t(cx_start_n, cy_start_n, z_start_m), index3_t(cx_end_n, cy_end_n, z_end_m));
+				std::vector<dvec2> coef_pml1(CL), coef_pml2(CL), coef2(CL);
+				std::vector<dvec3> coef3(CL);
 				for (index_t ilz = 0; ilz < Mz; ilz++){
 					index_t iz = m_LocalOffsetZ + ilz;
-					for (index_t iy = 1; iy < VNy; iy++){
-						for (index_t ix = 1; ix < VNx; ix++){
+					for (index_t iy = VSy; iy < VNy; iy++){
+						for (index_t ix = VSx; ix < VNx; ix++){
 							double dx = m_GridX.mwidth(ix);
 							double dy = m_GridY.mwidth(iy);
-							FFMaterial mat;
-							bool pec = getMaterialEz(index3_t(ix, iy, iz), &mat);
-							if ((ilz < z_start_m) || (z_end_m <= ilz) ||
+							bool pml = ((ilz < z_start_m) || (z_end_m <= ilz) ||
 								(iy < y_start_n) || (y_end_n <= iy) ||
-								(ix < x_start_n) || (x_end_n <= ix))
-							{
-								double sigma_x = (0 < Lx) ? calcSigma(calcSigmaMax(mat.eps(), dx, Lx), Lx, GNx - Lx - 1, ix, Lx) : 0.0;
-								double sigma_y = (0 < Ly) ? calcSigma(calcSigmaMax(mat.eps(), dy, Ly), Ly, GNy - Ly - 1, iy, Ly) : 0.0;
-								pml_cindex.push_back(cindex2_t(
-									registerCoef2(FFMaterial::calcDCoefPML(mat.eps_r(), sigma_x, Dt, dx)),
-									registerCoef2(FFMaterial::calcDCoefPML(mat.eps_r(), sigma_y, Dt, dy))));
-								pml_index.push_back(ix + Nx * (iy + Ny * ilz));
-								normal_cindex[ix + Nx * (iy + Ny * ilz)] = pec ? pec_id : registerCoef2(mat.calcECoefPML(Dt));
+								(ix < x_start_n) || (x_end_n <= ix));
+							bool cpml = !pml && ((ix < cx_start_n) || (cx_end_n <= ix) ||
+								(iy < cy_start_n) || (cy_end_n <= iy));
+							bool pec = false;
+							for (index_t lane = 0; lane < CL; lane++){
+								FFMaterial mat;
+								pec = getMaterialEz(index3_t(ix, iy, iz), lane, &mat);
+								if (pml){
+									double sigma_x = calcSigma(mat.eps(), dx, L1.x, L2.x, GNx, ix);
+									double sigma_y = calcSigma(mat.eps(), dy, L1.y, L2.y, GNy, iy);
+									coef_pml1[lane] = FFMaterial::calcDCoefPML(mat.eps_r(), sigma_x, Dt, dx);
+									coef_pml2[lane] = FFMaterial::calcDCoefPML(mat.eps_r(), sigma_y, Dt, dy);
+									coef2[lane] = mat.calcECoefPML(Dt);
+								}
+								else if (cpml){
+									dvec3 cpml_x = calcCPMLCoef(dx, CL1.x, CL2.x, GNx, ix);
+									dvec3 cpml_y = calcCPMLCoef(dy, CL1.y, CL2.y, GNy, iy);
+									dvec3 coef = mat.calcECoef(Dt, dx, dy);
+									coef3[lane] = mat.calcECoef(Dt, dx / cpml_x.z, dy / cpml_y.z);
+									coef_pml1[lane] = dvec2(cpml_x.x, coef.y * cpml_x.y);
+									coef_pml2[lane] = dvec2(cpml_y.x, coef.z * cpml_y.y);
+								}
+								else{
+									coef3[lane] = mat.calcECoef(Dt, dx, dy);
+								}
+							}
+							if (pml){
+								getPMLCIndex(pml_box_list, ix, iy, ilz) = cindex2_t(registerCoef2(coef_pml1), registerCoef2(coef_pml2));
+								normal_cindex[ix + Nx * (iy + Ny * ilz)] = pec ? pec_id : registerCoef2(coef2);
 							}
 							else{
-								normal_cindex[ix + Nx * (iy + Ny * ilz)] = pec ? pec_id : registerCoef3(mat.calcECoef(Dt, dx, dy));
+								if (cpml){
+									getPMLCIndex(cpml_box_list, ix, iy, ilz) = pec ? cindex2_t(pec_id, pec_id) : cindex2_t(registerCoef2(coef_pml1), registerCoef2(coef_pml2));
+								}
+								normal_cindex[ix + Nx * (iy + Ny * ilz)] = pec ? pec_id : registerCoef3(coef3);
 							}
 						}
 					}
 				}
 
 #pragma omp critical
-				m_Solver->storeCoefficientIndex(EMType::Ez, normal_cindex, pml_cindex, pml_index);
+				m_Solver->storeCoefficientIndex(EMType::Ez, normal_cindex, pml_box_list, cpml_box_list);
 			}
 
 			// Hxに対する係数を計算する
 #pragma omp section
 			{
 				std::vector<cindex_t> normal_cindex(Nx * Ny * Nz, pec_id);
-				std::vector<cindex2_t> pml_cindex;
-				std::vector<index_t> pml_index;
+				std::vector<PMLBox_t> pml_box_list = createPMLBoxList(index3_t(VSx, 0, 0), index3_t(VNx, My, Mz), index3_t(x_start_n, y_start_m, z_start_m), index3_t(x_end_n, y_end_m, z_end_m));
+				std::vector<PMLBox_t> cpml_box_list = createPMLBoxList(index3_t(x_start_n, y_start_m, z_start_m), index3_t(x_end_n, y_end_m, z_end_m),
+					index3_t(x_start_n, cy_start_m, cz_start_m), index3_t(x_end_n, cy_end_m, cz_end_m));
+				std::vector<dvec2> coef_pml1(CL), coef_pml2(CL), coef2(CL);
+				std::vector<dvec3> coef3(CL);
 				for (index_t ilz = 0; ilz < Mz; ilz++){
 					index_t iz = m_LocalOffsetZ + ilz;
 					for (index_t iy = 0; iy < My; iy++){
-						for (index_t ix = 1; ix < VNx; ix++){
+						for (index_t ix = VSx; ix < VNx; ix++){
 							double dy = m_GridY.width(iy);
 							double dz = m_GridZ.width(iz);
-							FFMaterial mat;
-							getMaterialHx(index3_t(ix, iy, iz), &mat);
-							if ((ilz < z_start_m) || (z_end_m <= ilz) ||
+							bool pml = ((ilz < z_start_m) || (z_end_m <= ilz) ||
 								(iy < y_start_m) || (y_end_m <= iy) ||
-								(ix < x_start_n) || (x_end_n <= ix))
-							{
-								double sigma_m_y = (0 < Ly) ? calcSigma(calcSigmaMax(mat.mu(), dy, Ly), Ly, GNy - Ly - 1, iy + 0.5, Ly) : 0.0;
-								double sigma_m_z = (0 < Lz) ? calcSigma(calcSigmaMax(mat.mu(), dz, Lz), Lz, GNz - Lz - 1, iz + 0.5, Lz) : 0.0;
-								pml_cindex.push_back(cindex2_t(
-									registerCoef2(FFMaterial::calcHCoefPML(mat.mu_r(), sigma_m_y, Dt, dy)),
-									registerCoef2(FFMaterial::calcHCoefPML(mat.mu_r(), sigma_m_z, Dt, dz))));
-								pml_index.push_back(ix + Nx * (iy + Ny * ilz));
+								(ix < x_start_n) || (x_end_n <= ix));
+							bool cpml = !pml && ((iy < cy_start_m) || (cy_end_m <= iy) ||
+								(ilz < cz_start_m) || (cz_end_m <= ilz));
+							for (index_t lane = 0; lane < CL; lane++){
+								FFMaterial mat;
+								getMaterialHx(index3_t(ix, iy, iz), lane, &mat);
+								if (pml){
+									double sigma_m_y = calcSigma(mat.mu(), dy, L1.y, L2.y, GNy, iy + 0.5);
+									double sigma_m_z = calcSigma(mat.mu(), dz, L1.z, L2.z, GNz, iz + 0.5);
+									coef_pml1[lane] = FFMaterial::calcHCoefPML(mat.mu_r(), sigma_m_y, Dt, dy);
+									coef_pml2[lane] = FFMaterial::calcHCoefPML(mat.mu_r(), sigma_m_z, Dt, dz);
+								}
+								if (cpml){
+									dvec3 cpml_y = calcCPMLCoef(dy, CL1.y, CL2.y, GNy, iy + 0.5);
+									dvec3 cpml_z = calcCPMLCoef(dz, CL1.z, CL2.z, GNz, iz + 0.5);
+									dvec3 coef = mat.calcHCoef(Dt, dy, dz);
+									coef3[lane] = mat.calcHCoef(Dt, dy / cpml_y.z, dz / cpml_z.z);
+									coef_pml1[lane] = dvec2(cpml_y.x, coef.y * cpml_y.y);
+									coef_pml2[lane] = dvec2(cpml_z.x, coef.z * cpml_z.y);
+								}
+								else{
+									coef3[lane] = mat.calcHCoef(Dt, dy, dz);
+								}
+							}
+							if (pml){
+								getPMLCIndex(pml_box_list, ix, iy, ilz) = cindex2_t(registerCoef2(coef_pml1), registerCoef2(coef_pml2));
 							}
-							normal_cindex[ix + Nx * (iy + Ny * ilz)] = registerCoef3(mat.calcHCoef(Dt, dy, dz));
+							if (cpml){
+								getPMLCIndex(cpml_box_list, ix, iy, ilz) = cindex2_t(registerCoef2(coef_pml1), registerCoef2(coef_pml2));
+							}
+							normal_cindex[ix + Nx * (iy + Ny * ilz)] = registerCoef3(coef3);
 						}
 					}
 				}
 
 #pragma omp critical
-				m_Solver->storeCoefficientIndex(EMType::Hx, normal_cindex, pml_cindex, pml_index);
+				m_Solver->storeCoefficientIndex(EMType::Hx, normal_cindex, pml_box_list, cpml_box_list);
 			}
 
 			// Hyに対する係数を計算する
 #pragma omp section
 			{
 				std::vector<cindex_t> normal_cindex(Nx * Ny * Nz, pec_id);
-				std::vector<cindex2_t> pml_cindex;
-				std::vector<index_t> pml_index;
+				std::vector<PMLBox_t> pml_box_list = createPMLBoxList(index3_t(0, VSy, 0), index3_t(Mx, VNy, Mz), index3_t(x_start_m, y_start_n, z_start_m), index3_t(x_end_m, y_end_n, z_end_m));
+				std::vector<PMLBox_t> cpml_box_list = createPMLBoxList(index3_t(x_start_m, y_start_n, z_start_m), index3_t(x_end_m, y_end_n, z_end_m),
+					index3_t(cx_start_m, y_start_n, cz_start_m), index3_t(cx_end_m, y_end_n, cz_end_m));
+				std::vector<dvec2> coef_pml1(CL), coef_pml2(CL), coef2(CL);
+				std::vector<dvec3> coef3(CL);
 				for (index_t ilz = 0; ilz < Mz; ilz++){
 					index_t iz = m_LocalOffsetZ + ilz;
-					for (index_t iy = 1; iy < VNy; iy++){
+					for (index_t iy = VSy; iy < VNy; iy++){
 						for (index_t ix = 0; ix < Mx; ix++){
 							double dz = m_GridZ.width(iz);
 							double dx = m_GridX.width(ix);
-							FFMaterial mat;
-							getMaterialHy(index3_t(ix, iy, iz), &mat);
-							if ((ilz < z_start_m) || (z_end_m <= ilz) ||
+							bool pml = ((ilz < z_start_m) || (z_end_m <= ilz) ||
 								(iy < y_start_n) || (y_end_n <= iy) ||
-								(ix < x_start_m) || (x_end_m <= ix))
-							{
-								double sigma_m_z = (0 < Lz) ? calcSigma(calcSigmaMax(mat.mu(), dz, Lz), Lz, GNz - Lz - 1, iz + 0.5, Lz) : 0.0;
-								double sigma_m_x = (0 < Lx) ? calcSigma(calcSigmaMax(mat.mu(), dx, Lx), Lx, GNx - Lx - 1, ix + 0.5, Lx) : 0.0;
-								pml_cindex.push_back(cindex2_t(
-									registerCoef2(FFMaterial::calcHCoefPML(mat.mu_r(), sigma_m_z, Dt, dz)),
-									registerCoef2(FFMaterial::calcHCoefPML(mat.mu_r(), sigma_m_x, Dt, dx))));
-								pml_index.push_back(ix + Nx * (iy + Ny * ilz));
+								(ix < x_start_m) || (x_end_m <= ix));
+							bool cpml = !pml && ((ilz < cz_start_m) || (cz_end_m <= ilz) ||
+								(ix < cx_start_m) || (cx_end_m <= ix));
+							for (index_t lane = 0; lane < CL; lane++){
+								FFMaterial mat;
+								getMaterialHy(index3_t(ix, iy, iz), lane, &mat);
+								if (pml){
+									double sigma_m_z = calcSigma(mat.mu(), dz, L1.z, L2.z, GNz, iz + 0.5);
+									double sigma_m_x = calcSigma(mat.mu(), dx, L1.x, L2.x, GNx, ix + 0.5);
+									coef_pml1[lane] = FFMaterial::calcHCoefPML(mat.mu_r(), sigma_m_z, Dt, dz);
+									coef_pml2[lane] = FFMaterial::calcHCoefPML(mat.mu_r(), sigma_m_x, Dt, dx);
+								}
+								if (cpml){
+									dvec3 cpml_z = calcCPMLCoef(dz, CL1.z, CL2.z, GNz, iz + 0.5);
+									dvec3 cpml_x = calcCPMLCoef(dx, CL1.x, CL2.x, GNx, ix + 0.5);
+									dvec3 coef = mat.calcHCoef(Dt, dz, dx);
+									coef3[lane] = mat.calcHCoef(Dt, dz / cpml_z.z, dx / cpml_x.z);
+									coef_pml1[lane] = dvec2(cpml_z.x, coef.y * cpml_z.y);
+									coef_pml2[lane] = dvec2(cpml_x.x, coef.z * cpml_x.y);
+								}
+								else{
+									coef3[lane] = mat.calcHCoef(Dt, dz, dx);
+								}
+							}
+							if (pml){
+								getPMLCIndex(pml_box_list, ix, iy, ilz) = cindex2_t(registerCoef2(coef_pml1), registerCoef2(coef_pml2));
+							}
+							if (cpml){
+								getPMLCIndex(cpml_box_list, ix, iy, ilz) = cindex2_t(registerCoef2(coef_pml1), registerCoef2(coef_pml2));
 							}
-							normal_cindex[ix + Nx * (iy + Ny * ilz)] = registerCoef3(mat.calcHCoef(Dt, dz, dx));
+							normal_cindex[ix + Nx * (iy + Ny * ilz)] = registerCoef3(coef3);
 						}
 					}
 				}
 				
 #pragma omp critical
-				m_Solver->storeCoefficientIndex(EMType::Hy, normal_cindex, pml_cindex, pml_index);
+				m_Solver->storeCoefficientIndex(EMType::Hy, normal_cindex, pml_box_list, cpml_box_list);
 			}
 
 			// Hzに対する係数を計算する
 #pragma omp section
 			{
 				std::vector<cindex_t> normal_cindex(Nx * Ny * Nz, pec_id);
-				std::vector<cindex2_t> pml_cindex;
-				std::vector<index_t> pml_index;
-				for (index_t ilz = 1; ilz < VNz; ilz++){
+				std::vector<PMLBox_t> pml_box_list = createPMLBoxList(index3_t(0, 0, VSz), index3_t(Mx, My, VNz), index3_t(x_start_m, y_start_m, z_start_n), index3_t(x_end_m, y_end_m, z_end_n));
+				std::vector<PMLBox_t> cpml_box_list = createPMLBoxList(index3_t(x_start_m, y_start_m, z_start_n), index3_t(x_end_m, y_end_m, z_end_n),
+					index3_t(cx_start_m, cy_start_m, z_start_n), index3_t(cx_end_m, cy_end_m, z_end_n));
+				std::vector<dvec2> coef_pml1(CL), coef_pml2(CL), coef2(CL);
+				std::vector<dvec3> coef3(CL);
+				for (index_t ilz = VSz; ilz < VNz; ilz++){
 					index_t iz = m_LocalOffsetZ + ilz;
 					for (index_t iy = 0; iy < My; iy++){
 						for (index_t ix = 0; ix < Mx; ix++){
 							double dx = m_GridX.width(ix);
 							double dy = m_GridY.width(iy);
-							FFMaterial mat;
-							getMaterialHz(index3_t(ix, iy, iz), &mat);
-							if ((ilz < z_start_n) || (z_end_n <= ilz) ||
+							bool pml = ((ilz < z_start_n) || (z_end_n <= ilz) ||
 								(iy < y_start_m) || (y_end_m <= iy) ||
-								(ix < x_start_m) || (x_end_m <= ix))
-							{
-								double sigma_m_x = (0 < Lx) ? calcSigma(calcSigmaMax(mat.mu(), dx, Lx), Lx, GNx - Lx - 1, ix + 0.5, Lx) : 0.0;
-								double sigma_m_y = (0 < Ly) ? calcSigma(calcSigmaMax(mat.mu(), dy, Ly), Ly, GNy - Ly - 1, iy + 0.5, Ly) : 0.0;
-								pml_cindex.push_back(cindex2_t(
-									registerCoef2(FFMaterial::calcHCoefPML(mat.mu_r(), sigma_m_x, Dt, dx)),
-									registerCoef2(FFMaterial::calcHCoefPML(mat.mu_r(), sigma_m_y, Dt, dy))));
-								pml_index.push_back(ix + Nx * (iy + Ny * ilz));
+								(ix < x_start_m) || (x_end_m <= ix));
+							bool cpml = !pml && ((ix < cx_start_m) || (cx_end_m <= ix) ||
+								(iy < cy_start_m) || (cy_end_m <= iy));
+							for (index_t lane = 0; lane < CL; lane++){
+								FFMaterial mat;
+								getMaterialHz(index3_t(ix, iy, iz), lane, &mat);
+								if (pml){
+									double sigma_m_x = calcSigma(mat.mu(), dx, L1.x, L2.x, GNx, ix + 0.5);
+									double sigma_m_y = calcSigma(mat.mu(), dy, L1.y, L2.y, GNy, iy + 0.5);
+									coef_pml1[lane] = FFMaterial::calcHCoefPML(mat.mu_r(), sigma_m_x, Dt, dx);
+									coef_pml2[lane] = FFMaterial::calcHCoefPML(mat.mu_r(), sigma_m_y, Dt, dy);
+								}
+								if (cpml){
+									dvec3 cpml_x = calcCPMLCoef(dx, CL1.x, CL2.x, GNx, ix + 0.5);
+									dvec3 cpml_y = calcCPMLCoef(dy, CL1.y, CL2.y, GNy, iy + 0.5);
+									dvec3 coef = mat.calcHCoef(Dt, dx, dy);
+									coef3[lane] = mat.calcHCoef(Dt, dx / cpml_x.z, dy / cpml_y.z);
+									coef_pml1[lane] = dvec2(cpml_x.x, coef.y * cpml_x.y);
+									coef_pml2[lane] = dvec2(cpml_y.x, coef.z * cpml_y.y);
+								}
+								else{
+									coef3[lane] = mat.calcHCoef(Dt, dx, dy);
+								}
 							}
-							normal_cindex[ix + Nx * (iy + Ny * ilz)] = registerCoef3(mat.calcHCoef(Dt, dx, dy));
+							if (pml){
+								getPMLCIndex(pml_box_list, ix, iy, ilz) = cindex2_t(registerCoef2(coef_pml1), registerCoef2(coef_pml2));
+							}
+							if (cpml){
+								getPMLCIndex(cpml_box_list, ix, iy, ilz) = cindex2_t(registerCoef2(coef_pml1), registerCoef2(coef_pml2));
+							}
+							normal_cindex[ix + Nx * (iy + Ny * ilz)] = registerCoef3(coef3);
 						}
 					}
 				}
 				
 #pragma omp critical
-				m_Solver->storeCoefficientIndex(EMType::Hz, normal_cindex, pml_cindex, pml_index);
+				m_Solver->storeCoefficientIndex(EMType::Hz, normal_cindex, pml_box_list, cpml_box_list);
 			}
 		}
 
 		// 係数リストをコピーする
-		m_Solver->storeCoefficientList(coef2_list, coef3_list);
+		m_Solver->storeCoefficientList(coef2_list, coef3_list, CL);
 		
 		// 観測点・観測面・ポートの情報をコピーする
 		m_Solver->storeMeasurementInfo(m_FreqList, m_NT, m_TDProbeList, m_FDProbeList);
 		m_Solver->storePortList(m_PortList);
 
-		// ポートの使うメモリーを確保する
-		for (auto port : m_PortList){
+		// 周囲が均一な成分は4次精度の差分で計算する
+		if (m_SpatialOrder == 4){
+			storeHighOrderMask();
+		}
+
+		// PECの内部など常に0のままの成分を計算から除く
+		m_Solver->updateStaticMask();
+
+		// 処理時間の集計先を設定し、1ステップの処理量を求めておく
+		m_Telemetry.reset();
+		m_Solver->setTelemetry(&m_Telemetry);
+		m_CellsPerStep = (uint64_t)m_Size.x * m_Size.y * m_LocalSizeZ * m_Lanes;
+		m_BytesPerStep = m_Solver->estimateBytesPerStep();
+
+		// ポートの使うメモリーを確保し、レーンごとの励振の有無を設定する
+		for (size_t i = 0; i < m_PortList.size(); i++){
+			FFPort *port = m_PortList[i];
 			if (port != nullptr){
-				port->allocate(m_NT, m_Timestep);
+				port->allocate(m_NT, m_Timestep, m_Lanes);
+				// Bloch周期境界では虚部のレーンは励振しない
+				const index_t real_lanes = isBloch() ? (m_Lanes / 2) : m_Lanes;
+				for (index_t lane = 0; lane < m_Lanes; lane++){
+					port->setExcitation(lane, (lane < real_lanes) && (m_ExcitationList.empty() || (m_ExcitationList[lane] == i)));
+				}
+			}
+		}
+
+		// サブグリッドのソルバーを構成し、1ステップの処理量に含める
+		for (FFSubgrid *subgrid : m_SubgridList){
+			subgrid->configureSolver(solver->createSubSolver(), precision);
+			m_CellsPerStep += subgrid->getSituation().m_CellsPerStep;
+			m_BytesPerStep += subgrid->getSituation().m_BytesPerStep;
+		}
+	}
+
+	// 励振源から指定した距離[セル]までの範囲を活性領域としてソルバーに設定する
+	// 電界・磁界の1回の更新で0でない成分は各方向に1セルずつしか広がらないため、励振を始めてからの更新回数より遠い成分は0のままである
+	// 周期境界の軸は、範囲が端に届いた時点で軸全体を活性とする
+	// 4次精度の差分では1回の更新で2セルずつ広がる
+	void FFSituation::updateActiveRegion(index_t reach){
+		reach *= m_SpatialOrder / 2;
+		index3_t start(0, 0, 0);
+		index3_t end(m_Size.x + 1, m_Size.y + 1, m_Size.z + 1);
+		if (m_HasSource == false){
+			// 励振源がなければ電磁界は0のまま
+			end = start;
+		}
+		else{
+			for (int axis = 0; axis < 3; axis++){
+				const bool wrapped = (m_SourceStart[axis] < reach) || (m_Size[axis] < m_SourceEnd[axis] + reach);
+				if (wrapped && (m_BC.lower[axis] == BoundaryCondition::Periodic)){
+					continue;
+				}
+				if ((axis == 2) && m_ImplicitZ){
+					// HIE法ではZ方向の列の全体に一度に伝わる
+					continue;
+				}
+				start[axis] = (m_SourceStart[axis] < reach) ? 0 : (m_SourceStart[axis] - reach);
+				end[axis] = std::min(m_SourceEnd[axis] + reach + 1, m_Size[axis] + 1);
+			}
+		}
+
+		// Z方向をローカル領域のグリッド番号に変換する
+		const index_t NZ = m_LocalSizeZ + 1;
+		const index_t start_z = (start.z < m_LocalOffsetZ) ? 0 : std::min(start.z - m_LocalOffsetZ, NZ);
+		const index_t end_z = (end.z < m_LocalOffsetZ) ? 0 : std::min(end.z - m_LocalOffsetZ, NZ);
+		m_Solver->setActiveRegion(index3_t(start.x, start.y, start_z), index3_t(end.x, end.y, std::max(end_z, start_z)));
+	}
+
+	// 4次精度の差分を使える成分を軸方向ごとに求め、ソルバーに設定する
+	// 成分の位置のセルを中心に、差分を取る2軸の方向に±2セル、成分の方向に負側の1セルを含めた直方体の全セルが、
+	// PML空間の外で同じ材質であり、PECの辺を持たないときに4次精度の差分を使う (差分を取る2軸のグリッドも均一とする)
+	// 判定するのは電界成分で、実際に補正する項は差分の方向に隣り合う2つの電界成分の判定からソルバーが求める
+	// X・Y方向の周期境界やZ方向の領域の接続をまたぐ成分は2次精度のままとする
+	void FFSituation::storeHighOrderMask(void){
+		const uint32_t NO_KEY = ~(uint32_t)0;
+		const FFGrid *grid_list[3] = { &m_GridX, &m_GridY, &m_GridZ };
+		const index3_t &L1 = m_BC.pmlLower, &L2 = m_BC.pmlUpper;
+		const index_t Mx = m_Size.x;
+		const index_t My = m_Size.y;
+		const index_t Nx = Mx + 1;
+		const index_t Ny = My + 1;
+		const index_t Nz = m_LocalSizeZ + 3;
+
+		// ローカル領域の1面下から1面上までの成分から2セルの範囲のセルを調べる (スライスはcreateVolumeData()で作成済み)
+		// 各成分の判定は全体の位置だけで決まり、隣接する領域と重なる成分は同じ結果になる
+		const index_t wz_start = (m_LocalOffsetZ < 3) ? 0 : (m_LocalOffsetZ - 3);
+		const index_t wz_end = std::min(m_LocalOffsetZ + m_LocalSizeZ + 4, m_Size.z);
+		const index_t Wz = wz_end - wz_start;
+		const index_t window_start[3] = { 0, 0, wz_start };
+		const index_t window_size[3] = { Mx, My, Wz };
+		const ptrdiff_t stride[3] = { 1, (ptrdiff_t)Mx, (ptrdiff_t)Mx * My };
+
+		// 軸ごとに前後2セルのグリッド幅が等しいか求める
+		std::vector<uint8_t> uniform[3];
+		for (int axis = 0; axis < 3; axis++){
+			const FFGrid &grid = *grid_list[axis];
+			uniform[axis].assign(m_Size[axis], 0);
+			for (index_t i = 2; i + 2 < m_Size[axis]; i++){
+				bool same = true;
+				for (index_t k = i - 2; k <= i + 2; k++){
+					same = same && (fabs(grid.width(k) - grid.width(i)) <= 1e-9 * grid.width(i));
+				}
+				uniform[axis][i] = same ? 1 : 0;
+			}
+		}
+
+		// セルごとに材質IDをキーとする (PML空間のセルとPECの辺を持つセルはキーなしとする)
+		// セルの持つ辺は、セルの負側の頂点から出る3本とする
+		std::vector<uint32_t> key((size_t)Mx * My * Wz, NO_KEY);
+#pragma omp parallel for
+		for (int rz = 0; rz < (int)Wz; rz++){
+			const index_t iz = wz_start + rz;
+			if ((iz < L1.z) || (m_Size.z - L2.z <= iz)){
+				continue;
+			}
+			for (index_t iy = L1.y; iy < My - L2.y; iy++){
+				for (index_t ix = L1.x; ix < Mx - L2.x; ix++){
+					bool pec = m_PECX.getPoint(ix, iy, iz) || m_PECY.getPoint(ix, iy, iz) || m_PECZ.getPoint(ix, iy, iz);
+					key[ix + Mx * (iy + My * (index_t)rz)] = pec ? NO_KEY : m_Volume.getPoint(ix, iy, iz);
+				}
+			}
+		}
+
+		// srcが0でなく、軸axisの方向に相対位置lo〜hiのセルが全てsrcで0でなく同じキーを持つセルを求める
+		// check_uniformがtrueのときは、その軸のグリッドが均一なセルに限る
+		auto spread = [&](const std::vector<uint8_t> &src, int axis, int lo, int hi, bool check_uniform) -> std::vector<uint8_t>{
+			std::vector<uint8_t> dst(key.size(), 0);
+#pragma omp parallel for
+			for (int rz = 0; rz < (int)Wz; rz++){
+				for (index_t iy = 0; iy < My; iy++){
+					for (index_t ix = 0; ix < Mx; ix++){
+						const index_t pos[3] = { ix, iy, (index_t)rz };
+						const size_t cell = ix + Mx * (iy + My * (index_t)rz);
+						if ((key[cell] == NO_KEY) || ((sindex_t)pos[axis] + lo < 0) || (window_size[axis] <= pos[axis] + hi)){
+							continue;
+						}
+						if (check_uniform && (uniform[axis][window_start[axis] + pos[axis]] == 0)){
+							continue;
+						}
+						bool same = true;
+						for (int k = lo; (k <= hi) && same; k++){
+							const size_t other = cell + k * stride[axis];
+							same = (src[other] != 0) && (key[other] == key[cell]);
+						}
+						dst[cell] = same ? 1 : 0;
+					}
+				}
+			}
+			return dst;
+		};
+
+		std::vector<uint8_t> has_key(key.size());
+		for (size_t i = 0; i < key.size(); i++){
+			has_key[i] = (key[i] != NO_KEY) ? 1 : 0;
+		}
+		for (int axis = 0; axis < 3; axis++){
+			// 差分を取る2軸の方向に±2セル、成分の方向に負側の1セルを含めて調べる
+			const int axis_a = (axis + 1) % 3;
+			const int axis_b = (axis + 2) % 3;
+			std::vector<uint8_t> cell_mask = spread(has_key, axis_a, -2, 2, true);
+			cell_mask = spread(cell_mask, axis_b, -2, 2, true);
+			cell_mask = spread(cell_mask, axis, -1, 0, false);
+
+			// ローカル領域の1面下からのグリッド番号に並べ替える (各軸の正端の面の成分は2次精度のまま)
+			std::vector<uint8_t> mask((size_t)Nx * Ny * Nz, 0);
+			for (index_t ilz = 0; ilz < Nz; ilz++){
+				const index_t iz = m_LocalOffsetZ + ilz - 1;
+				if ((m_LocalOffsetZ + ilz < 1) || (iz < wz_start) || (wz_end <= iz)){
+					continue;
+				}
+				for (index_t iy = 0; iy < My; iy++){
+					for (index_t ix = 0; ix < Mx; ix++){
+						mask[ix + Nx * (iy + Ny * ilz)] = cell_mask[ix + Mx * (iy + My * (iz - wz_start))];
+					}
+				}
+			}
+			m_Solver->storeHighOrderMask((Axis)axis, mask);
+		}
+	}
+
+	// 4次精度の差分で読むZ端部の外側の面 (接線成分) を隣接する領域と共有する
+	// 下端から2面目を下側の領域の上端の1面上へ、上端から2面目を上側の領域の下端の1面下へ写す
+	void FFSituation::exchangeOuterEdge(bool is_e, FFSituation *bottom, FFSituation *top, int bottom_rank, int top_rank){
+		const EMType type_list[2] = { is_e ? EMType::Ex : EMType::Hx, is_e ? EMType::Ey : EMType::Hy };
+		const Precision precision = m_Solver->getPrecision();
+		const MPI_Datatype datatype = getMPIDatatype(precision);
+		const size_t slice_bytes = m_CountPerSlice * getRealSize(precision);
+		const void *tx_bottom[2], *tx_top[2];
+		for (int c = 0; c < 2; c++){
+			m_Solver->getOuterEdge(type_list[c], &tx_bottom[c], &tx_top[c]);
+		}
+
+		// 送受信する
+		MPI_Request mpi_request[8];
+		MPI_Request *req = mpi_request;
+		for (int c = 0; c < 2; c++){
+			if (bottom != nullptr){
+				bottom->m_Solver->setOuterEdge(type_list[c], nullptr, tx_bottom[c]);
+			}
+			else if (0 <= bottom_rank){
+				m_MPIBufferOuter[c].resize(slice_bytes);
+				FFTraceScope trace("MPI_Isend/Irecv", "mpi");
+				MPI_Isend(tx_bottom[c], (int)m_CountPerSlice, datatype, bottom_rank, (int)MPITag::OuterDownX + c, m_Comm, req++);
+				MPI_Irecv(m_MPIBufferOuter[c].data(), (int)m_CountPerSlice, datatype, bottom_rank, (int)MPITag::OuterUpX + c, m_Comm, req++);
+			}
+			if (top != nullptr){
+				top->m_Solver->setOuterEdge(type_list[c], tx_top[c], nullptr);
+			}
+			else if (0 <= top_rank){
+				m_MPIBufferOuter[2 + c].resize(slice_bytes);
+				FFTraceScope trace("MPI_Isend/Irecv", "mpi");
+				MPI_Isend(tx_top[c], (int)m_CountPerSlice, datatype, top_rank, (int)MPITag::OuterUpX + c, m_Comm, req++);
+				MPI_Irecv(m_MPIBufferOuter[2 + c].data(), (int)m_CountPerSlice, datatype, top_rank, (int)MPITag::OuterDownX + c, m_Comm, req++);
+			}
+		}
+
+		// MPIでの送受信の完了を待つ
+		size_t mpi_count = req - mpi_request;
+		if (0 < mpi_count){
+			MPI_Status mpi_status[8];
+			{
+				FFScopedTimer wait_timer(&m_Telemetry, TelemetryPhase::MPIWait);
+				FFTraceScope trace("MPI_Waitall", "mpi");
+				MPI_Waitall((int)mpi_count, mpi_request, mpi_status);
+			}
+			m_Telemetry.addHaloBytes(mpi_count * slice_bytes);
+			FFScopedTimer unpack_timer(&m_Telemetry, TelemetryPhase::HaloUnpack);
+
+			for (int c = 0; c < 2; c++){
+				if (0 <= bottom_rank){
+					m_Solver->setOuterEdge(type_list[c], m_MPIBufferOuter[c].data(), nullptr);
+				}
+				if (0 <= top_rank){
+					m_Solver->setOuterEdge(type_list[c], nullptr, m_MPIBufferOuter[2 + c].data());
+				}
+			}
+		}
+	}
+
+	// 有効な範囲から通常空間の範囲を除いたPML空間を直方体に分割する
+	std::vector<PMLBox_t> FFSituation::createPMLBoxList(const index3_t &valid_start, const index3_t &valid_end, const index3_t &normal_start, const index3_t &normal_end){
+		// 通常空間の範囲を有効な範囲に収める (通常空間を含まないときは空の範囲とする)
+		index3_t inner_start, inner_end;
+		for (int axis = 0; axis < 3; axis++){
+			inner_start[axis] = std::min(std::max(normal_start[axis], valid_start[axis]), valid_end[axis]);
+			inner_end[axis] = std::min(std::max(normal_end[axis], inner_start[axis]), valid_end[axis]);
+		}
+
+		// 直方体を追加する関数
+		std::vector<PMLBox_t> box_list;
+		index_t offset = 0;
+		auto addBox = [&](const index3_t &start, const index3_t &end){
+			if ((start.x < end.x) && (start.y < end.y) && (start.z < end.z)){
+				PMLBox_t box;
+				box.start = start;
+				box.size = end - start;
+				box.offset = offset;
+				box.cindex.assign((size_t)box.size.x * box.size.y * box.size.z, cindex2_t(0, 0));
+				offset += box.size.x * box.size.y * box.size.z;
+				box_list.push_back(std::move(box));
+			}
+		};
+
+		// Z方向の両端はXY全面、Y方向の両端は通常空間のZ範囲でX全幅、X方向の両端は通常空間のYZ範囲とする
+		addBox(valid_start, index3_t(valid_end.x, valid_end.y, inner_start.z));
+		addBox(index3_t(valid_start.x, valid_start.y, inner_end.z), valid_end);
+		addBox(index3_t(valid_start.x, valid_start.y, inner_start.z), index3_t(valid_end.x, inner_start.y, inner_end.z));
+		addBox(index3_t(valid_start.x, inner_end.y, inner_start.z), index3_t(valid_end.x, valid_end.y, inner_end.z));
+		addBox(index3_t(valid_start.x, inner_start.y, inner_start.z), index3_t(inner_start.x, inner_end.y, inner_end.z));
+		addBox(index3_t(inner_end.x, inner_start.y, inner_start.z), index3_t(valid_end.x, inner_end.y, inner_end.z));
+		return box_list;
+	}
+
+	// 指定した座標を含むPML空間の直方体から係数インデックスを取得する
+	cindex2_t& FFSituation::getPMLCIndex(std::vector<PMLBox_t> &box_list, index_t x, index_t y, index_t z){
+		for (PMLBox_t &box : box_list){
+			// 始点より手前の座標は符号なしの差が大きな値となり、範囲外と判定される
+			index_t rx = x - box.start.x, ry = y - box.start.y, rz = z - box.start.z;
+			if ((rx < box.size.x) && (ry < box.size.y) && (rz < box.size.z)){
+				return box.cindex[rx + box.size.x * (ry + box.size.y * rz)];
 			}
 		}
+		throw FFException("PML cell (%u, %u, %u) is outside of PML boxes", x, y, z);
+	}
+
+	// ソルバーの所有権を手放す
+	FFSolver* FFSituation::detachSolver(void){
+		FFSolver *solver = m_Solver;
+		if (solver != nullptr){
+			solver->setTelemetry(nullptr);
+		}
+		m_Solver = nullptr;
+		return solver;
 	}
 
 	// 電磁界の絶対合計値を計算する
@@ -1018,7 +1779,30 @@ namespace FFFDTD{
 		if (m_Solver == nullptr){
 			throw;
 		}
-		return m_Solver->calcTotalEM();
+		// 対称面で切り出した領域の合計値を全体モデルに換算する (対称面上の成分も倍にするため、その分だけ多めに数える)
+		dvec2 total = m_Solver->calcTotalEM() + calcSubgridTotalEM();
+		return total * getSymmetryFactor();
+	}
+
+	// サブグリッドの直方体の粗いグリッドの電磁界の絶対合計値を、細かいグリッドの値で置き換える差分を計算する
+	dvec2 FFSituation::calcSubgridTotalEM(void){
+		dvec2 total(0.0, 0.0);
+		for (FFSubgrid *subgrid : m_SubgridList){
+			total -= m_Solver->calcTotalEM(subgrid->getStart(), subgrid->getEnd());
+			total += subgrid->calcTotalEM();
+		}
+		return total;
+	}
+
+	// 対称面で切り出した領域から全体モデルへの倍率を取得する
+	double FFSituation::getSymmetryFactor(void) const{
+		double factor = 1.0;
+		for (int axis = 0; axis < 3; axis++){
+			if ((m_BC.lower[axis] == BoundaryCondition::PMC) || (m_BC.lower[axis] == BoundaryCondition::PECSymmetry)){
+				factor *= 2.0;
+			}
+		}
+		return factor;
 	}
 
 	// 計算ステップ1を実行する (給電・計測)
@@ -1029,26 +1813,46 @@ namespace FFFDTD{
 		if (m_NT <= m_IT){
 			throw;
 		}
+		FFScopedTimer timer(&m_Telemetry, TelemetryPhase::Step1);
 
 		// 給電・計測を行う
 		m_Solver->feedAndMeasure(m_IT);
 		m_IT++;
+		for (FFSubgrid *subgrid : m_SubgridList){
+			subgrid->feedAndMeasure();
+		}
 
 		return m_IT < m_NT;
 	}
 
 	// 計算ステップ2を実行する (磁界の計算)
 	void FFSituation::executeSolverStep2(void){
-		// 磁界を計算する
-		m_Solver->calcHField();
-
-		// 端部の磁界をコピーする
-		if (isConnectedX()){
-			m_Solver->exchangeEdgeH(Axis::X);
+		FFScopedTimer timer(&m_Telemetry, TelemetryPhase::Step2);
+
+		// 励振源から電磁界が届き得る範囲だけ磁界を計算する
+		updateActiveRegion(2 * (index_t)m_IT);
+		if (m_SubgridList.empty() == false){
+			// サブグリッドは独立したソルバーで、粗いグリッドと並行して計算する
+			const int N = (int)m_SubgridList.size();
+#pragma omp parallel for num_threads(N + 1) schedule(dynamic, 1)
+			for (int i = -1; i < N; i++){
+				if (i < 0){
+					m_Solver->calcHField();
+				}
+				else{
+					m_SubgridList[i]->calcHField();
+				}
+			}
+			for (FFSubgrid *subgrid : m_SubgridList){
+				subgrid->coupleHField();
+			}
 		}
-		if (isConnectedY()){
-			m_Solver->exchangeEdgeH(Axis::Y);
+		else{
+			m_Solver->calcHField();
 		}
+
+		// 端部の磁界をコピーする
+		// X・Y方向の周期境界の端部は、ソルバーが磁界の計算に続けて埋める
 		if (isConnectedZ() && (m_LocalSizeZ == m_Size.z)){
 			m_Solver->exchangeEdgeH(Axis::Z);
 		}
@@ -1056,11 +1860,17 @@ namespace FFFDTD{
 
 	// 計算ステップ3を実行する (磁界の共有)
 	void FFSituation::executeSolverStep3(FFSituation *bottom, FFSituation *top, int bottom_rank, int top_rank){
+		FFScopedTimer timer(&m_Telemetry, TelemetryPhase::Step3);
+
 		// Z端部の磁界を共有する
 		if (m_LocalSizeZ != m_Size.z){
 			// 端部の磁界を取得する
-			const real *tx_hx, *tx_hy, *tx_hz;
-			real *rx_hx = nullptr, *rx_hy = nullptr, *rx_hz = nullptr;
+			double pack_start = FFTelemetry::now();
+			const Precision precision = m_Solver->getPrecision();
+			const MPI_Datatype datatype = getMPIDatatype(precision);
+			const size_t slice_bytes = m_CountPerSlice * getRealSize(precision);
+			const void *tx_hx, *tx_hy, *tx_hz;
+			void *rx_hx = nullptr, *rx_hy = nullptr, *rx_hz = nullptr;
 			m_Solver->getEdgeH(nullptr, nullptr, &tx_hz);
 			m_Solver->getEdgeH(&tx_hx, &tx_hy, nullptr);
 
@@ -1071,30 +1881,42 @@ namespace FFFDTD{
 				bottom->m_Solver->setEdgeH(tx_hx, tx_hy, nullptr);
 			}
 			else if (0 <= bottom_rank){
-				m_MPIBufferZ.resize(m_CountPerSlice);
+				m_MPIBufferZ.resize(slice_bytes);
 				rx_hz = m_MPIBufferZ.data();
-				MPI_Isend(tx_hx, (int)m_CountPerSlice, MPI_FLOAT, bottom_rank, (int)MPITag::Hx, MPI_COMM_WORLD, req++);
-				MPI_Isend(tx_hy, (int)m_CountPerSlice, MPI_FLOAT, bottom_rank, (int)MPITag::Hy, MPI_COMM_WORLD, req++);
-				MPI_Irecv(rx_hz, (int)m_CountPerSlice, MPI_FLOAT, bottom_rank, (int)MPITag::Hz, MPI_COMM_WORLD, req++);
+				FFTraceScope trace("MPI_Isend/Irecv", "mpi");
+				MPI_Isend(tx_hx, (int)m_CountPerSlice, datatype, bottom_rank, (int)MPITag::Hx, m_Comm, req++);
+				MPI_Isend(tx_hy, (int)m_CountPerSlice, datatype, bottom_rank, (int)MPITag::Hy, m_Comm, req++);
+				MPI_Irecv(rx_hz, (int)m_CountPerSlice, datatype, bottom_rank, (int)MPITag::Hz, m_Comm, req++);
 			}
 			if (top != nullptr){
 				top->m_Solver->setEdgeH(nullptr, nullptr, tx_hz);
 			}
 			else if (0 <= top_rank){
-				m_MPIBufferX.resize(m_CountPerSlice);
-				m_MPIBufferY.resize(m_CountPerSlice);
+				m_MPIBufferX.resize(slice_bytes);
+				m_MPIBufferY.resize(slice_bytes);
 				rx_hx = m_MPIBufferX.data();
 				rx_hy = m_MPIBufferY.data();
-				MPI_Irecv(rx_hx, (int)m_CountPerSlice, MPI_FLOAT, top_rank, (int)MPITag::Hx, MPI_COMM_WORLD, req++);
-				MPI_Irecv(rx_hy, (int)m_CountPerSlice, MPI_FLOAT, top_rank, (int)MPITag::Hy, MPI_COMM_WORLD, req++);
-				MPI_Isend(tx_hz, (int)m_CountPerSlice, MPI_FLOAT, top_rank, (int)MPITag::Hz, MPI_COMM_WORLD, req++);
+				FFTraceScope trace("MPI_Isend/Irecv", "mpi");
+				MPI_Irecv(rx_hx, (int)m_CountPerSlice, datatype, top_rank, (int)MPITag::Hx, m_Comm, req++);
+				MPI_Irecv(rx_hy, (int)m_CountPerSlice, datatype, top_rank, (int)MPITag::Hy, m_Comm, req++);
+				MPI_Isend(tx_hz, (int)m_CountPerSlice, datatype, top_rank, (int)MPITag::Hz, m_Comm, req++);
 			}
 
+			double pack_end = FFTelemetry::now();
+			m_Telemetry.addTime(TelemetryPhase::HaloPack, pack_end - pack_start);
+			FFTrace::record(FFTelemetry::getPhaseName(TelemetryPhase::HaloPack), "situation", pack_start, pack_end);
+
 			// MPIでの送受信の完了を待つ
 			size_t mpi_count = req - mpi_request;
 			if (0 < mpi_count){
 				MPI_Status mpi_status[6];
-				MPI_Waitall((int)mpi_count, mpi_request, mpi_status);
+				{
+					FFScopedTimer wait_timer(&m_Telemetry, TelemetryPhase::MPIWait);
+					FFTraceScope trace("MPI_Waitall", "mpi");
+					MPI_Waitall((int)mpi_count, mpi_request, mpi_status);
+				}
+				m_Telemetry.addHaloBytes(mpi_count * slice_bytes);
+				FFScopedTimer unpack_timer(&m_Telemetry, TelemetryPhase::HaloUnpack);
 
 				if (0 <= bottom_rank){
 					m_Solver->setEdgeH(nullptr, nullptr, rx_hz);
@@ -1103,21 +1925,43 @@ namespace FFFDTD{
 					m_Solver->setEdgeH(rx_hx, rx_hy, nullptr);
 				}
 			}
+
+			// 4次精度の差分で読む外側の面を共有する
+			if (m_SpatialOrder == 4){
+				exchangeOuterEdge(false, bottom, top, bottom_rank, top_rank);
+			}
 		}
 	}
 
 	// 計算ステップ4を実行する (電界の計算)
 	void FFSituation::executeSolverStep4(void){
-		// 電界を計算する
-		m_Solver->calcEField();
-
-		// 端部の電界をコピーする
-		if (isConnectedX()){
-			m_Solver->exchangeEdgeE(Axis::X);
+		FFScopedTimer timer(&m_Telemetry, TelemetryPhase::Step4);
+
+		// 励振源から電磁界が届き得る範囲だけ電界を計算する
+		updateActiveRegion(2 * (index_t)m_IT + 1);
+		if (m_SubgridList.empty() == false){
+			// サブグリッドは独立したソルバーで、粗いグリッドと並行して計算する
+			const int N = (int)m_SubgridList.size();
+#pragma omp parallel for num_threads(N + 1) schedule(dynamic, 1)
+			for (int i = -1; i < N; i++){
+				if (i < 0){
+					m_Solver->calcEField();
+				}
+				else{
+					m_SubgridList[i]->calcEField();
+				}
+			}
+			for (FFSubgrid *subgrid : m_SubgridList){
+				subgrid->coupleEField();
+			}
 		}
-		if (isConnectedY()){
-			m_Solver->exchangeEdgeE(Axis::Y);
+		else{
+			m_Solver->calcEField();
 		}
+		m_Telemetry.addStep(m_CellsPerStep, m_BytesPerStep);
+
+		// 端部の電界をコピーする
+		// X・Y方向の周期境界の端部は、ソルバーが電界の計算に続けて埋める
 		if (isConnectedZ()){
 			if (m_LocalSizeZ == m_Size.z){
 				m_Solver->exchangeEdgeE(Axis::Z);
@@ -1127,11 +1971,17 @@ namespace FFFDTD{
 
 	// 計算ステップ5を実行する (電界の共有)
 	void FFSituation::executeSolverStep5(FFSituation *bottom, FFSituation *top, int bottom_rank, int top_rank){
+		FFScopedTimer timer(&m_Telemetry, TelemetryPhase::Step5);
+
 		// Z端部の電界を共有する
 		if (m_LocalSizeZ != m_Size.z){
 			// 端部の磁界を取得する
-			const real *tx_ex, *tx_ey, *tx_ez;
-			real *rx_ex = nullptr, *rx_ey = nullptr, *rx_ez = nullptr;
+			double pack_start = FFTelemetry::now();
+			const Precision precision = m_Solver->getPrecision();
+			const MPI_Datatype datatype = getMPIDatatype(precision);
+			const size_t slice_bytes = m_CountPerSlice * getRealSize(precision);
+			const void *tx_ex, *tx_ey, *tx_ez;
+			void *rx_ex = nullptr, *rx_ey = nullptr, *rx_ez = nullptr;
 			m_Solver->getEdgeE(nullptr, nullptr, &tx_ez);
 			m_Solver->getEdgeE(&tx_ex, &tx_ey, nullptr);
 
@@ -1142,30 +1992,42 @@ namespace FFFDTD{
 				bottom->m_Solver->setEdgeE(nullptr, nullptr, tx_ez);
 			}
 			else if (0 <= bottom_rank){
-				m_MPIBufferX.resize(m_CountPerSlice);
-				m_MPIBufferY.resize(m_CountPerSlice);
+				m_MPIBufferX.resize(slice_bytes);
+				m_MPIBufferY.resize(slice_bytes);
 				rx_ex = m_MPIBufferX.data();
 				rx_ey = m_MPIBufferY.data();
-				MPI_Irecv(rx_ex, (int)m_CountPerSlice, MPI_FLOAT, bottom_rank, (int)MPITag::Ex, MPI_COMM_WORLD, req++);
-				MPI_Irecv(rx_ey, (int)m_CountPerSlice, MPI_FLOAT, bottom_rank, (int)MPITag::Ey, MPI_COMM_WORLD, req++);
-				MPI_Isend(tx_ez, (int)m_CountPerSlice, MPI_FLOAT, bottom_rank, (int)MPITag::Ez, MPI_COMM_WORLD, req++);
+				FFTraceScope trace("MPI_Isend/Irecv", "mpi");
+				MPI_Irecv(rx_ex, (int)m_CountPerSlice, datatype, bottom_rank, (int)MPITag::Ex, m_Comm, req++);
+				MPI_Irecv(rx_ey, (int)m_CountPerSlice, datatype, bottom_rank, (int)MPITag::Ey, m_Comm, req++);
+				MPI_Isend(tx_ez, (int)m_CountPerSlice, datatype, bottom_rank, (int)MPITag::Ez, m_Comm, req++);
 			}
 			if (top != nullptr){
 				top->m_Solver->setEdgeE(tx_ex, tx_ey, nullptr);
 			}
 			else if (0 <= top_rank){
-				m_MPIBufferZ.resize(m_CountPerSlice);
+				m_MPIBufferZ.resize(slice_bytes);
 				rx_ez = m_MPIBufferZ.data();
-				MPI_Isend(tx_ex, (int)m_CountPerSlice, MPI_FLOAT, top_rank, (int)MPITag::Ex, MPI_COMM_WORLD, req++);
-				MPI_Isend(tx_ey, (int)m_CountPerSlice, MPI_FLOAT, top_rank, (int)MPITag::Ey, MPI_COMM_WORLD, req++);
-				MPI_Irecv(rx_ez, (int)m_CountPerSlice, MPI_FLOAT, top_rank, (int)MPITag::Ez, MPI_COMM_WORLD, req++);
+				FFTraceScope trace("MPI_Isend/Irecv", "mpi");
+				MPI_Isend(tx_ex, (int)m_CountPerSlice, datatype, top_rank, (int)MPITag::Ex, m_Comm, req++);
+				MPI_Isend(tx_ey, (int)m_CountPerSlice, datatype, top_rank, (int)MPITag::Ey, m_Comm, req++);
+				MPI_Irecv(rx_ez, (int)m_CountPerSlice, datatype, top_rank, (int)MPITag::Ez, m_Comm, req++);
 			}
 
+			double pack_end = FFTelemetry::now();
+			m_Telemetry.addTime(TelemetryPhase::HaloPack, pack_end - pack_start);
+			FFTrace::record(FFTelemetry::getPhaseName(TelemetryPhase::HaloPack), "situation", pack_start, pack_end);
+
 			// MPIでの送受信の完了を待つ
 			size_t mpi_count = req - mpi_request;
 			if (0 < mpi_count){
 				MPI_Status mpi_status[6];
-				MPI_Waitall((int)mpi_count, mpi_request, mpi_status);
+				{
+					FFScopedTimer wait_timer(&m_Telemetry, TelemetryPhase::MPIWait);
+					FFTraceScope trace("MPI_Waitall", "mpi");
+					MPI_Waitall((int)mpi_count, mpi_request, mpi_status);
+				}
+				m_Telemetry.addHaloBytes(mpi_count * slice_bytes);
+				FFScopedTimer unpack_timer(&m_Telemetry, TelemetryPhase::HaloUnpack);
 
 				if (0 <= bottom_rank){
 					m_Solver->setEdgeE(rx_ex, rx_ey, nullptr);
@@ -1174,6 +2036,11 @@ namespace FFFDTD{
 					m_Solver->setEdgeE(nullptr, nullptr, rx_ez);
 				}
 			}
+
+			// 4次精度の差分で読む外側の面を共有する
+			if (m_SpatialOrder == 4){
+				exchangeOuterEdge(true, bottom, top, bottom_rank, top_rank);
+			}
 		}
 	}
 #pragma endregion
@@ -7,22 +7,42 @@
 #include "Format/FFVolumeData.h"
 #include "Format/FFBitVolumeData.h"
 #include "Basic/FFIStream.h"
+#include <mpi.h>
 
 
 
 namespace FFFDTD{
+	class FFSubgrid;
+
 	// 境界条件を格納する構造体
+	// 境界条件とPMLの層数は各軸の負側 (lower) と正側 (upper) の面ごとに持つ (周期境界条件は両面で同じとする)
 	struct BC_t{
-		BoundaryCondition x, y, z;
-		index3_t pmlL;
+		BoundaryCondition lower[3];		// 各軸の負側の面の境界条件
+		BoundaryCondition upper[3];		// 各軸の正側の面の境界条件
+		index3_t pmlLower;				// 各軸の負側の面のPMLの層数
+		index3_t pmlUpper;				// 各軸の正側の面のPMLの層数
 		double pmlM;
 		double pmlR0;
+		bvec3 pmlCPML;		// 軸ごとにCPMLを使うか (falseのときは分割型PML)
+		double pmlKappa;	// CPMLのκの最大値
+		double pmlAlpha;	// CPMLのαの最大値[S/m] (比誘電率1のときの値)
+		dvec3 phase;		// 各軸の周期境界の位相差[rad] (0以外の軸はBloch周期境界とする)
 
 		// コンストラクタ
 		BC_t(void)
-			: x(BoundaryCondition::PEC), y(BoundaryCondition::PEC), z(BoundaryCondition::PEC)
-			, pmlL(0, 0, 0), pmlM(0.0), pmlR0(0.0)
+			: pmlLower(0, 0, 0), pmlUpper(0, 0, 0), pmlM(0.0), pmlR0(0.0)
+			, pmlCPML(false, false, false), pmlKappa(DEFAULT_CPML_KAPPA), pmlAlpha(DEFAULT_CPML_ALPHA)
+			, phase(0.0, 0.0, 0.0)
 		{
+			for (int axis = 0; axis < 3; axis++){
+				lower[axis] = upper[axis] = BoundaryCondition::PEC;
+			}
+		}
+
+		// 軸の両面に同じ境界条件とPMLの層数を設定する
+		void set(Axis axis, BoundaryCondition bc, index_t pml_l = 0){
+			lower[(int)axis] = upper[(int)axis] = bc;
+			pmlLower[(int)axis] = pmlUpper[(int)axis] = pml_l;
 		}
 	};
 
@@ -30,6 +50,8 @@ namespace FFFDTD{
 
 	// シミュレーション環境を作成するクラス
 	class FFSituation{
+		friend class FFSubgrid;
+
 		/*** 定数 ***/
 	public:
 		// 真空の材質ID
@@ -77,6 +99,12 @@ namespace FFFDTD{
 		// 境界条件
 		BC_t m_BC;
 
+		// 空間差分の次数 (2または4)
+		int m_SpatialOrder;
+
+		// Z方向の差分を陰的に扱うHIE法を使うか
+		bool m_ImplicitZ;
+
 		// ボリュームデータ
 		FFVolumeData m_Volume;
 
@@ -84,7 +112,11 @@ namespace FFFDTD{
 		FFBitVolumeData m_PECX, m_PECY, m_PECZ;
 
 		// 材質リスト
-		std::vector<FFMaterial*> m_MaterialList;
+		// 各材質はスイープするレーンごとの材質データを持つ (1件のときは全レーンで共有する)
+		std::vector<std::vector<FFMaterial*>> m_MaterialList;
+
+		// 材質のスイープ数
+		index_t m_SweepCount;
 
 		// 観測点リスト(電界成分の位置)
 		//std::vector<FFPointObject> m_ProbePointList;
@@ -95,6 +127,10 @@ namespace FFFDTD{
 		// ポートリスト
 		std::vector<FFPort*> m_PortList;
 
+		// 励振源 (全プロセスのポートの電界) を含む範囲 (全体のグリッド番号の閉区間。m_HasSourceがfalseのときは無効)
+		bool m_HasSource;
+		index3_t m_SourceStart, m_SourceEnd;
+
 		// 時間ドメインプローブのリスト
 		std::vector<Probe_t> m_TDProbeList;
 
@@ -113,11 +149,35 @@ namespace FFFDTD{
 		// 周波数ドメインプローブの解析周波数
 		std::vector<double> m_FreqList;
 
+		// レーン数
+		index_t m_Lanes;
+
+		// レーンごとに励振するポートの番号 (空のときは全てのポートを励振する)
+		std::vector<oindex_t> m_ExcitationList;
+
 		// 1スライスに含まれる電磁界成分数
 		size_t m_CountPerSlice;
 
-		// MPI用の一時メモリー
-		std::vector<real> m_MPIBufferX, m_MPIBufferY, m_MPIBufferZ;
+		// Z端部の電磁界を交換するコミュニケーター
+		MPI_Comm m_Comm;
+
+		// MPI用の一時メモリー (ソルバーの精度の値を1スライス分格納する)
+		std::vector<uint8_t> m_MPIBufferX, m_MPIBufferY, m_MPIBufferZ;
+
+		// 4次精度の差分でZ端部の外側の面を受け取るMPI用の一時メモリー (下側のX・Y成分、上側のX・Y成分の順)
+		std::vector<uint8_t> m_MPIBufferOuter[4];
+
+		// 処理時間と処理量の集計
+		FFTelemetry m_Telemetry;
+
+		// 1ステップで更新するセル数 (レーンごとに数える)
+		uint64_t m_CellsPerStep;
+
+		// 1ステップの電磁界の更新で読み書きするメモリーの推定量[byte]
+		uint64_t m_BytesPerStep;
+
+		// 埋め込んだサブグリッドのリスト
+		std::vector<FFSubgrid*> m_SubgridList;
 
 
 
@@ -134,9 +194,27 @@ namespace FFFDTD{
 		// グリッドを設定する
 		void setGrids(const FFGrid &grid_x, const FFGrid &grid_y, const FFGrid &grid_z, const BC_t &bc);
 
+		// 空間差分の次数 (2または4) を設定する
+		// 4次精度の差分は周囲が均一な材質とグリッドの通常空間の成分だけに使い、PECや材質の境界の近くは2次精度の差分とする
+		// 材質を参照する範囲とタイムステップが変わるため、createVolumeData()とcalcTimestep()の前に呼ぶこと
+		void setSpatialOrder(int order);
+
+		// Z方向の差分を陰的に扱うHIE法を使うかを設定する
+		// タイムステップはX・Y方向のセル幅 (とZ方向のPMLのセル幅) だけで決まり、Z方向の薄い層でステップ数が増えない
+		// Z方向に分割しない計算と、X・Y方向がCPMLか分割型PMLのない境界条件でのみ使える (configureSolver()で確認する)
+		// タイムステップが変わるため、calcTimestep()の前に呼ぶこと
+		void setImplicitZ(bool implicit_z){
+			m_ImplicitZ = implicit_z;
+		}
+
 		// 処理の分割を設定する
 		void setDivision(index_t offset, index_t size);
 
+		// Z端部の電磁界を交換するコミュニケーターを設定する
+		void setCommunicator(MPI_Comm comm){
+			m_Comm = comm;
+		}
+
 		// ボリュームデータを作成する
 		void createVolumeData(void);
 #pragma endregion
@@ -151,6 +229,9 @@ namespace FFFDTD{
 		// 指定した材質IDで材質データを登録する
 		void registerMaterial(matid_t matid, FFMaterial *mat);
 
+		// 指定した材質IDでスイープするレーンごとの材質データを登録する
+		void registerMaterial(matid_t matid, const std::vector<FFMaterial*> &mat_list);
+
 		// 材質リストのすべての材質の物性値が指定されているか調べる
 		bool isMaterialListFilled(void);
 
@@ -160,7 +241,26 @@ namespace FFFDTD{
 		}
 
 		// 指定した材質IDの材質データを取得する
-		const FFMaterial* getMaterialByID(matid_t matid);
+		const FFMaterial* getMaterialByID(matid_t matid, index_t lane = 0);
+
+		// 材質のスイープ数を取得する
+		index_t getSweepCount(void) const{
+			return m_SweepCount;
+		}
+
+	private:
+		// 指定したレーンで使う材質データを取得する
+		const FFMaterial* getLaneMaterial(matid_t matid, index_t lane) const{
+			const std::vector<FFMaterial*> &mat_list = m_MaterialList[matid];
+			if (mat_list.empty()){
+				return nullptr;
+			}
+			// Bloch周期境界の虚部のレーンは、対応する実部のレーンと同じ材質とする
+			return (mat_list.size() == 1) ? mat_list[0] : mat_list[lane % mat_list.size()];
+		}
+
+		// スイープ数と励振ポート数からレーン数を決定する
+		void updateLanes(void);
 #pragma endregion
 
 #pragma region シミュレーション環境の情報を取得するメソッド
@@ -173,6 +273,16 @@ namespace FFFDTD{
 			return m_Timestep;
 		}
 
+		// 空間差分の次数を取得する
+		int getSpatialOrder(void) const{
+			return m_SpatialOrder;
+		}
+
+		// Z方向の差分を陰的に扱うHIE法を使うか取得する
+		bool getImplicitZ(void) const{
+			return m_ImplicitZ;
+		}
+
 		// グローバル領域の大きさを取得する
 		const index3_t& getGlobalSize(void) const{
 			return m_Size;
@@ -188,12 +298,19 @@ namespace FFFDTD{
 			return m_LocalOffsetZ;
 		}
 
-		// 境界条件を取得する
-		BoundaryCondition getBC(Axis axis) const;
+		// 境界条件を取得する (upperがtrueのときは正側の面)
+		BoundaryCondition getBC(Axis axis, bool upper) const{
+			return upper ? m_BC.upper[(int)axis] : m_BC.lower[(int)axis];
+		}
+
+		// 負側の面のPML吸収境界条件の層数を取得する
+		const index3_t& getPmlLower(void) const{
+			return m_BC.pmlLower;
+		}
 
-		// PML吸収境界条件の層数を取得する
-		const index3_t& getPmlL(void) const{
-			return m_BC.pmlL;
+		// 正側の面のPML吸収境界条件の層数を取得する
+		const index3_t& getPmlUpper(void) const{
+			return m_BC.pmlUpper;
 		}
 
 		// PML吸収境界条件の次数を取得する
@@ -206,6 +323,21 @@ namespace FFFDTD{
 			return m_BC.pmlR0;
 		}
 
+		// 軸ごとにCPMLを使うか取得する
+		const bvec3& getPmlCPML(void) const{
+			return m_BC.pmlCPML;
+		}
+
+		// CPMLのκの最大値を取得する
+		double getPmlKappa(void) const{
+			return m_BC.pmlKappa;
+		}
+
+		// CPMLのαの最大値[S/m]を取得する
+		double getPmlAlpha(void) const{
+			return m_BC.pmlAlpha;
+		}
+
 		/*// 観測点のリストを取得する
 		const std::vector<FFPointObject>& getProbePointList(void) const{
 			return m_ProbePointList;
@@ -219,6 +351,32 @@ namespace FFFDTD{
 		// ポートのリストを取得する
 		std::vector<const FFPort*> getPortList(void) const;
 
+		// 指定したポートを取得する (自分の領域にないときはnullptr)
+		FFPort* getPort(oindex_t port){
+			return m_PortList[port];
+		}
+
+		// ポートの数を取得する
+		size_t getNumberOfPorts(void) const{
+			return m_PortList.size();
+		}
+
+		// レーン数を取得する
+		index_t getLanes(void) const{
+			return m_Lanes;
+		}
+
+		// Bloch周期境界か取得する
+		// Bloch周期境界ではレーン数を倍にし、前半のレーンを実部、後半のレーンを虚部として計算する
+		bool isBloch(void) const{
+			return (m_BC.phase.x != 0.0) || (m_BC.phase.y != 0.0);
+		}
+
+		// レーンごとに励振するポートの番号を取得する
+		const std::vector<oindex_t>& getExcitationList(void) const{
+			return m_ExcitationList;
+		}
+
 
 
 #pragma endregion
@@ -253,43 +411,92 @@ namespace FFFDTD{
 		// ポートを配置する
 		oindex_t placePort(const index3_t &pos, DIR_e dir, FFCircuit *circuit);
 
+		// 時間ドメインプローブを配置する
+		// 成分が自分の領域にないときは配置せずに~0を返す (Z方向の接続面のN型の成分は、値を計算する下側の領域に属する)
+		oindex_t placeTDProbe(const index3_t &pos, EMType em_type);
+
+		// 直方体[start, end] (グリッド番号の閉区間) を細分化したサブグリッドを配置する
+		// 直方体はPMLから2セル以上離し、ゴーストセルを含めて他のサブグリッドと重ならないようにすること
+		// 以降に配置する物体はサブグリッドにも同じ範囲で配置するため、物体より先に配置すること
+		FFSubgrid* placeSubgrid(const index3_t &start, const index3_t &end);
+
+		// サブグリッドの数を取得する
+		size_t getNumberOfSubgrids(void) const{
+			return m_SubgridList.size();
+		}
+
+		// サブグリッドを取得する
+		FFSubgrid* getSubgrid(size_t i) const{
+			return m_SubgridList[i];
+		}
+
 	private:
 		// プローブを配置する
 		oindex_t placeProbe(const index3_t &pos, EMType em_type, ProbeType probe_type);
+
+		// サブグリッドの直方体[start, end]の内部 (表面を除く) の電界をPECとし、粗いグリッドの計算から除く
+		void excludeSubgridInterior(const index3_t &start, const index3_t &end);
 #pragma endregion
 
 #pragma region 係数を計算するメソッド
 	public:
-		// Exに作用する物性値を取得する
+		// 指定したレーンのExに作用する物性値を取得する
 		// PECワイヤーがあるときtrueを返す
-		bool getMaterialEx(const index3_t &pos, FFMaterial *material) const;
+		bool getMaterialEx(const index3_t &pos, index_t lane, FFMaterial *material) const;
 
-		// Eyに作用する物性値を取得する
+		// 指定したレーンのEyに作用する物性値を取得する
 		// PECワイヤーがあるときtrueを返す
-		bool getMaterialEy(const index3_t &pos, FFMaterial *material) const;
+		bool getMaterialEy(const index3_t &pos, index_t lane, FFMaterial *material) const;
 
-		// Ezに作用する物性値を取得する
+		// 指定したレーンのEzに作用する物性値を取得する
 		// PECワイヤーがあるときtrueを返す
-		bool getMaterialEz(const index3_t &pos, FFMaterial *material) const;
+		bool getMaterialEz(const index3_t &pos, index_t lane, FFMaterial *material) const;
 
-		// Hxに作用する物性値を取得する
-		void getMaterialHx(const index3_t &pos, FFMaterial *material) const;
+		// 指定したレーンのHxに作用する物性値を取得する
+		void getMaterialHx(const index3_t &pos, index_t lane, FFMaterial *material) const;
 
-		// Hyに作用する物性値を取得する
-		void getMaterialHy(const index3_t &pos, FFMaterial *material) const;
+		// 指定したレーンのHyに作用する物性値を取得する
+		void getMaterialHy(const index3_t &pos, index_t lane, FFMaterial *material) const;
 
-		// Hzに作用する物性値を取得する
-		void getMaterialHz(const index3_t &pos, FFMaterial *material) const;
+		// 指定したレーンのHzに作用する物性値を取得する
+		void getMaterialHz(const index3_t &pos, index_t lane, FFMaterial *material) const;
 #pragma endregion
 
 #pragma region ソルバーを操作するメソッド
 	public:
+		// レーンごとに励振するポートを設定する
+		// ポート番号のリストの要素数がレーン数となる
+		// 材質をスイープするときはスイープ数と一致しなければならない
+		void setExcitation(const std::vector<oindex_t> &port_list);
+
 		// ソルバーにシミュレーション環境を構成する
-		void configureSolver(FFSolver *solver, double timestep, size_t max_iteration, const std::vector<double> &measure_freq);
+		// 電磁界成分はprecisionの精度で確保し、端部の交換もその精度で行う
+		void configureSolver(FFSolver *solver, double timestep, size_t max_iteration, const std::vector<double> &measure_freq, Precision precision);
+
+		// ソルバーの所有権を手放す
+		// 次のシミュレーションでソルバーとそのメモリーを再利用するときに使う
+		FFSolver* detachSolver(void);
 
 		// 電磁界の絶対合計値を計算する
+		// サブグリッドの直方体の内側は、粗いグリッドの値の代わりに細かいグリッドの値を粗いセルあたりに換算して数える
 		dvec2 calcTotalEM(void);
 
+	private:
+		// サブグリッドの直方体の粗いグリッドの電磁界の絶対合計値を、細かいグリッドの値で置き換える差分を計算する
+		dvec2 calcSubgridTotalEM(void);
+
+	public:
+
+		// 処理時間と処理量の集計を取得する
+		const FFTelemetry& getTelemetry(void) const{
+			return m_Telemetry;
+		}
+
+		// 処理時間と処理量の集計を0にする
+		void resetTelemetry(void){
+			m_Telemetry.reset();
+		}
+
 		// 計算ステップ1を実行する (給電・計測)
 		// 計算が終了したときにfalseを返す
 		bool executeSolverStep1(void);
@@ -313,12 +520,12 @@ namespace FFFDTD{
 	private:
 		// X方向の領域の端に別の領域が接続されているか取得する
 		bool isConnectedX(void) const{
-			return m_BC.x == BoundaryCondition::Periodic;
+			return m_BC.lower[0] == BoundaryCondition::Periodic;
 		}
 
 		// Y方向の領域の端に別の領域が接続されているか取得する
 		bool isConnectedY(void) const{
-			return m_BC.y == BoundaryCondition::Periodic;
+			return m_BC.lower[1] == BoundaryCondition::Periodic;
 		}
 
 		// Z方向の領域の端に別の領域が接続されているか取得する
@@ -326,6 +533,56 @@ namespace FFFDTD{
 			return m_ConnectionZ < m_Size.z;
 		}
 
+		// 負側の面がPMCの対称面か取得する
+		bool isPMC(Axis axis) const{
+			return m_BC.lower[(int)axis] == BoundaryCondition::PMC;
+		}
+
+		// ローカル領域でn型の成分を計算する範囲の始点を取得する
+		// PMCの対称面では面上の成分も計算する (Z方向は最下端のローカル領域だけが面を持つ)
+		index_t getValidStartN(Axis axis) const{
+			bool on_face = (axis != Axis::Z) || (m_LocalOffsetZ == 0);
+			return (on_face && isPMC(axis)) ? 0 : 1;
+		}
+
+		// 負側に隣接するセルの座標を取得する
+		// PMCの対称面の外側のセルは、面に対して鏡像の位置のセルとする
+		index_t getLowerCell(Axis axis, index_t i) const{
+			return ((i == 0) && isPMC(axis)) ? 0 : (i - 1);
+		}
+
+		// 対称面で切り出した領域から全体モデルへの倍率を取得する
+		double getSymmetryFactor(void) const;
+
+		// 有効な範囲から通常空間の範囲を除いたPML空間を直方体に分割する
+		// Z方向の下端・上端、Y方向の下端・上端、X方向の下端・上端の順に並べ、空の直方体は含めない
+		static std::vector<PMLBox_t> createPMLBoxList(const index3_t &valid_start, const index3_t &valid_end, const index3_t &normal_start, const index3_t &normal_end);
+
+		// 励振源から指定した距離[セル]までの範囲を活性領域としてソルバーに設定する
+		void updateActiveRegion(index_t reach);
+
+		// 4次精度の差分を使える成分を軸方向ごとに求め、ソルバーに設定する
+		void storeHighOrderMask(void);
+
+		// 4次精度の差分で読むZ端部の外側の面 (接線成分) を隣接する領域と共有する
+		void exchangeOuterEdge(bool is_e, FFSituation *bottom, FFSituation *top, int bottom_rank, int top_rank);
+
+		// 指定した座標を含むPML空間の直方体から係数インデックスを取得する
+		static cindex2_t& getPMLCIndex(std::vector<PMLBox_t> &box_list, index_t x, index_t y, index_t z);
+
+		// 精度に対応するMPIのデータ型を取得する
+		static MPI_Datatype getMPIDatatype(Precision precision){
+			switch (precision){
+			case Precision::Double:
+				return MPI_DOUBLE;
+			case Precision::Half:
+			case Precision::BFloat16:
+				return MPI_UNSIGNED_SHORT;
+			default:
+				return MPI_FLOAT;
+			}
+		}
+
 
 	};
 }
@@ -7,46 +7,102 @@ namespace FFFDTD{
 
 	// コンストラクタ
 	FFSolver::FFSolver(void)
-		: m_Size(0, 0, 0), m_NormalOffset(0, 0, 0), m_NormalSize(0, 0, 0)
+		: m_Size(0, 0, 0), m_Lanes(1), m_Precision(DEFAULT_PRECISION), m_SpatialOrder(2), m_ImplicitZ(false), m_NormalOffset(0, 0, 0), m_NormalSize(0, 0, 0)
 		, m_StartM(0, 0, 0), m_StartN(0, 0, 0), m_RangeM(0, 0, 0), m_RangeN(0, 0, 0)
 		, m_NumOfPMLD(0, 0, 0), m_NumOfPMLH(0, 0, 0)
+		, m_NumOfCPMLD(0, 0, 0), m_NumOfCPMLH(0, 0, 0)
+		, m_PeriodicX(false), m_PeriodicY(false)
+		, m_ActiveStart(0, 0, 0), m_ActiveEnd(0, 0, 0)
+		, m_BlochPhase(0.0, 0.0)
 		, m_OmegaList()
 		, m_PortList()
 		, m_TDProbeList(), m_FDProbeList()
 		, m_TDProbeMeasurment(), m_FDProbeMeasurment()
+		, m_Telemetry(nullptr)
 	{
 
 	}
 
 	// 電磁界成分を格納するメモリーを確保し初期化する
-	void FFSolver::initializeMemory(const index3_t &size, const index3_t &offset_m, const index3_t &offset_n, const index3_t &range_m, const index3_t &range_n){
+	void FFSolver::initializeMemory(const index3_t &size, const index3_t &offset_m, const index3_t &offset_n, const index3_t &range_m, const index3_t &range_n, index_t lanes, Precision precision){
 		m_Size = size;
+		m_Lanes = lanes;
+		m_Precision = precision;
 		m_StartM = offset_m;
 		m_StartN = offset_n;
 		m_RangeM = range_m;
 		m_RangeN = range_n;
+
+		// 活性領域は空間全体とする
+		m_ActiveStart = index3_t(0, 0, 0);
+		m_ActiveEnd = size + index3_t(1, 1, 1);
+	}
+
+	// 1ステップの電磁界の更新で読み書きするメモリー量[byte]を推定する
+	uint64_t FFSolver::estimateBytesPerStep(void) const{
+		// 通常空間の成分数
+		uint64_t normal_count = 0;
+		normal_count += (uint64_t)m_RangeM.x * m_RangeN.y * m_RangeN.z;
+		normal_count += (uint64_t)m_RangeN.x * m_RangeM.y * m_RangeN.z;
+		normal_count += (uint64_t)m_RangeN.x * m_RangeN.y * m_RangeM.z;
+		normal_count += (uint64_t)m_RangeN.x * m_RangeM.y * m_RangeM.z;
+		normal_count += (uint64_t)m_RangeM.x * m_RangeN.y * m_RangeM.z;
+		normal_count += (uint64_t)m_RangeM.x * m_RangeM.y * m_RangeN.z;
+
+		// PML空間の成分数
+		uint64_t pml_count = 0;
+		pml_count += (uint64_t)m_NumOfPMLD.x + m_NumOfPMLD.y + m_NumOfPMLD.z;
+		pml_count += (uint64_t)m_NumOfPMLH.x + m_NumOfPMLH.y + m_NumOfPMLH.z;
+
+		// CPMLの補正を行う成分数
+		uint64_t cpml_count = 0;
+		cpml_count += (uint64_t)m_NumOfCPMLD.x + m_NumOfCPMLD.y + m_NumOfCPMLD.z;
+		cpml_count += (uint64_t)m_NumOfCPMLH.x + m_NumOfCPMLH.y + m_NumOfCPMLH.z;
+
+		// 通常空間は自成分の読み書きと回転の2成分の読み出し、PML空間はさらに分割成分の読み書きを行う
+		// PML空間の分割成分と係数インデックスは直方体ごとに連続して読むため、セルの位置のインデックスは含まない
+		// CPMLの補正は通常空間の計算に加えて、自成分・回転の2成分・補助変数を再び読み書きする
+		const uint64_t RealSize = getRealSize(m_Precision);
+		const uint64_t ComputeSize = getComputeSize(m_Precision);
+		uint64_t normal_bytes = 4 * RealSize * m_Lanes + sizeof(cindex_t);
+		uint64_t pml_bytes = (4 * RealSize + 4 * ComputeSize) * m_Lanes + sizeof(cindex2_t) + sizeof(cindex_t);
+		uint64_t cpml_bytes = (4 * RealSize + 4 * ComputeSize) * m_Lanes + sizeof(cindex2_t);
+		return normal_count * normal_bytes + pml_count * pml_bytes + cpml_count * cpml_bytes;
 	}
 
 	// 係数インデックスを格納する
-	void FFSolver::storeCoefficientIndex(EMType type, const std::vector<cindex_t> &normal_cindex, const std::vector<cindex2_t> &pml_cindex, const std::vector<index_t> &pml_index){
+	void FFSolver::storeCoefficientIndex(EMType type, const std::vector<cindex_t> &normal_cindex, const std::vector<PMLBox_t> &pml_box_list, const std::vector<PMLBox_t> &cpml_box_list){
+		index_t pml_count = 0, cpml_count = 0;
+		for (const PMLBox_t &box : pml_box_list){
+			pml_count += (index_t)box.cindex.size();
+		}
+		for (const PMLBox_t &box : cpml_box_list){
+			cpml_count += (index_t)box.cindex.size();
+		}
 		switch (type){
 		case EMType::Ex:
-			m_NumOfPMLD.x = (index_t)pml_cindex.size();
+			m_NumOfPMLD.x = pml_count;
+			m_NumOfCPMLD.x = cpml_count;
 			break;
 		case EMType::Ey:
-			m_NumOfPMLD.y = (index_t)pml_cindex.size();
+			m_NumOfPMLD.y = pml_count;
+			m_NumOfCPMLD.y = cpml_count;
 			break;
 		case EMType::Ez:
-			m_NumOfPMLD.z = (index_t)pml_cindex.size();
+			m_NumOfPMLD.z = pml_count;
+			m_NumOfCPMLD.z = cpml_count;
 			break;
 		case EMType::Hx:
-			m_NumOfPMLH.x = (index_t)pml_cindex.size();
+			m_NumOfPMLH.x = pml_count;
+			m_NumOfCPMLH.x = cpml_count;
 			break;
 		case EMType::Hy:
-			m_NumOfPMLH.y = (index_t)pml_cindex.size();
+			m_NumOfPMLH.y = pml_count;
+			m_NumOfCPMLH.y = cpml_count;
 			break;
 		case EMType::Hz:
-			m_NumOfPMLH.z = (index_t)pml_cindex.size();
+			m_NumOfPMLH.z = pml_count;
+			m_NumOfCPMLH.z = cpml_count;
 			break;
 		}
 	}
@@ -63,12 +119,12 @@ namespace FFFDTD{
 
 		m_TDProbeMeasurment.resize(td_probe_list.size());
 		for (auto &it : m_TDProbeMeasurment){
-			it.resize(max_iteration, 0.0);
+			it.assign(max_iteration * m_Lanes, 0.0);
 		}
 
 		m_FDProbeMeasurment.resize(fd_probe_list.size());
 		for (auto &it : m_FDProbeMeasurment){
-			it.resize(freq_list.size(), 0.0);
+			it.assign(freq_list.size() * m_Lanes, 0.0);
 		}
 	}
 
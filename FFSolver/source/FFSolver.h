@@ -4,10 +4,13 @@
 #include "FFGrid.h"
 #include "FFMaterial.h"
 #include "FFPort.h"
+#include "Basic/FFTelemetry.h"
 
 
 
 namespace FFFDTD{
+	class FFTuneCache;
+
 	// シミュレーションを行う基底クラス
 	class FFSolver{
 		friend class FFPort;
@@ -27,6 +30,18 @@ namespace FFFDTD{
 		// 空間のサイズ
 		index3_t m_Size;
 
+		// レーン数 (同時に計算する電磁界の組数)
+		index_t m_Lanes;
+
+		// 電磁界成分の精度
+		Precision m_Precision;
+
+		// 空間差分の次数 (4のときはstoreHighOrderMask()で指定した成分だけ4次精度の差分を使う)
+		int m_SpatialOrder;
+
+		// Z方向の差分を陰的に扱うHIE法を使うか (電界・磁界のX・Y成分の増分をZ方向の3重対角方程式で補正する)
+		bool m_ImplicitZ;
+
 		// 通常空間のオフセット
 		index3_t m_NormalOffset;
 
@@ -39,6 +54,19 @@ namespace FFFDTD{
 		// PML空間の成分数
 		index3_t m_NumOfPMLD, m_NumOfPMLH;
 
+		// CPMLの補正を行う成分数
+		index3_t m_NumOfCPMLD, m_NumOfCPMLH;
+
+		// X・Y方向が周期境界か (電界・磁界の計算で端部のゴーストも埋める)
+		bool m_PeriodicX, m_PeriodicY;
+
+		// 活性領域 (電磁界が0でない可能性のある範囲。ローカル領域のグリッド番号の半開区間)
+		// 範囲外の成分は0のままであるため、更新を省く
+		index3_t m_ActiveStart, m_ActiveEnd;
+
+		// X・Y方向の周期境界の位相差[rad] (0以外のときはBloch周期境界とし、レーンの前半を実部、後半を虚部とする)
+		dvec2 m_BlochPhase;
+
 		// 解析角周波数のリスト
 		std::vector<double> m_OmegaList;
 		
@@ -52,11 +80,14 @@ namespace FFFDTD{
 		std::vector<Probe_t> m_FDProbeList;
 
 		// 時間ドメインプローブの測定値
-		std::vector<std::vector<real>> m_TDProbeMeasurment;
+		std::vector<std::vector<double>> m_TDProbeMeasurment;
 
 		// 周波数ドメインプローブの測定値
 		std::vector<std::vector<double>> m_FDProbeMeasurment;
 
+		// 処理時間の集計先 (nullptrのときは計測しない)
+		FFTelemetry *m_Telemetry;
+
 
 
 		/*** メソッド ***/
@@ -82,14 +113,111 @@ namespace FFFDTD{
 		// 電界・磁界の絶対合計値を計算する
 		virtual dvec2 calcTotalEM(void) = 0;
 
+		// 直方体[start, end] (グリッド番号の閉区間) の内部と表面の電界・磁界の絶対合計値を計算する
+		// 成分がセルの中心にある方向は、セルの範囲[start, end)とする
+		virtual dvec2 calcTotalEM(const index3_t &start, const index3_t &end) = 0;
+
+		// レーン数を取得する
+		index_t getLanes(void) const{
+			return m_Lanes;
+		}
+
+		// 電磁界成分の精度を取得する
+		Precision getPrecision(void) const{
+			return m_Precision;
+		}
+
+		// 空間差分の次数を設定する
+		// 4次精度の差分ではZ方向の端部から2面分の電磁界を読むため、initializeMemory()の前に呼ぶこと
+		void setSpatialOrder(int order){
+			m_SpatialOrder = order;
+		}
+
+		// 空間差分の次数を取得する
+		int getSpatialOrder(void) const{
+			return m_SpatialOrder;
+		}
+
+		// Z方向の差分を陰的に扱うHIE法を使うかを設定する
+		// 更新前の値を保持する作業領域を確保するため、initializeMemory()の前に呼ぶこと
+		void setImplicitZ(bool implicit_z){
+			m_ImplicitZ = implicit_z;
+		}
+
+		// Z方向の差分を陰的に扱うHIE法を使うか取得する
+		bool getImplicitZ(void) const{
+			return m_ImplicitZ;
+		}
+
+		// X・Y方向が周期境界かと、その位相差[rad]を設定する
+		void setPeriodic(bool periodic_x, bool periodic_y, const dvec2 &phase = dvec2(0.0, 0.0)){
+			m_PeriodicX = periodic_x;
+			m_PeriodicY = periodic_y;
+			m_BlochPhase = phase;
+		}
+
+		// 活性領域を設定する
+		// 範囲外の成分は全て0であり、1回の更新で0でなくなることがない範囲を指定すること
+		void setActiveRegion(const index3_t &start, const index3_t &end){
+			m_ActiveStart = start;
+			m_ActiveEnd = end;
+		}
+
+		// Bloch周期境界か取得する
+		bool isBloch(void) const{
+			return (m_BlochPhase.x != 0.0) || (m_BlochPhase.y != 0.0);
+		}
+
+		// 時間ドメインプローブの測定値を取得する (ステップごとにレーン数分を並べる)
+		const std::vector<double>& getTDProbeMeasurment(oindex_t id) const{
+			return m_TDProbeMeasurment[id];
+		}
+
+		// 処理時間の集計先を設定する
+		void setTelemetry(FFTelemetry *telemetry){
+			m_Telemetry = telemetry;
+		}
+
+		// ハードウェアカウンターによるカーネルごとの計測を有効にする (対応しないソルバーでは何もしない)
+		virtual void enablePerfCounter(void){}
+
+		// カーネルごとの計測結果をルーフラインモデルとともに表示し、集計を0にする
+		virtual void printPerfReport(const char * /*title*/){}
+
+		// 現在の空間のサイズに対してカーネルの設定を調整し、結果をキャッシュに保存する
+		// 選択した設定の説明を返す (調整に対応しないソルバーでは何もせず空文字列を返す)
+		virtual std::string autotune(FFTuneCache & /*cache*/){
+			return std::string();
+		}
+
+		// 1ステップの電磁界の更新で読み書きするメモリー量[byte]を推定する
+		// 各成分を1回ずつ読み書きするものとし、キャッシュに収まる係数リストは含めない
+		uint64_t estimateBytesPerStep(void) const;
+
 		// 電磁界成分を格納するメモリーを確保し初期化する
-		virtual void initializeMemory(const index3_t &size, const index3_t &offset_m, const index3_t &offset_n, const index3_t &range_m, const index3_t &range_n);
+		// 精度を変えたときは以前の精度のメモリーを解放する
+		virtual void initializeMemory(const index3_t &size, const index3_t &offset_m, const index3_t &offset_n, const index3_t &range_m, const index3_t &range_n, index_t lanes, Precision precision);
 
 		// 係数インデックスを格納する
-		virtual void storeCoefficientIndex(EMType type, const std::vector<cindex_t> &normal_cindex, const std::vector<cindex2_t> &pml_cindex, const std::vector<index_t> &pml_index);
+		// PML空間は直方体のリストで渡し、各直方体がセルごとの分割成分の係数インデックスを持つ
+		// CPMLの層は通常空間に含め、補助変数の係数インデックスを同じ形式の直方体のリストで渡す
+		virtual void storeCoefficientIndex(EMType type, const std::vector<cindex_t> &normal_cindex, const std::vector<PMLBox_t> &pml_box_list, const std::vector<PMLBox_t> &cpml_box_list);
 
 		// 係数リストを格納する
-		virtual void storeCoefficientList(const std::vector<rvec2> &coef2_list, const std::vector<rvec3> &coef3_list) = 0;
+		// 係数リストの各エントリーはcoef_lanes組の係数からなる (1のときは全レーンで共有する)
+		// 係数は倍精度で渡し、ソルバーが電磁界成分の精度に丸めて保持する
+		virtual void storeCoefficientList(const std::vector<dvec2> &coef2_list, const std::vector<dvec3> &coef3_list, index_t coef_lanes) = 0;
+
+		// 更新しても常に0のままの成分 (PECの電界と、PECの電界だけに囲まれた磁界) を求め、計算から除く
+		// 係数インデックス、4次精度の差分で計算する成分と観測に関する情報を格納した後に呼ぶこと (対応しないソルバーでは何もしない)
+		// 計算から除いた成分の係数インデックスと電磁界成分のメモリーは解放してよい
+		virtual void updateStaticMask(void){}
+
+		// 指定した軸方向の電界・磁界のうち、4次精度の差分で計算する成分を格納する
+		// maskはローカル領域の1面下から1面上までのグリッド番号ごとに、周囲が均一な材質とグリッドで4次精度の差分を使えるとき0以外とする
+		// 磁界は差分の方向に隣り合う2つの電界成分のmaskがともに0でない項だけを4次精度の差分で補正する
+		// 指定しなかった成分と通常空間以外の成分は2次精度の差分のまま計算する
+		virtual void storeHighOrderMask(Axis axis, const std::vector<uint8_t> &mask) = 0;
 
 		// 観測に関する情報を格納する
 		virtual void storeMeasurementInfo(const std::vector<double> &freq_list, size_t max_iteration, const std::vector<Probe_t> &td_probe_list, const std::vector<Probe_t> &fd_probe_list);
@@ -117,25 +245,44 @@ namespace FFFDTD{
 		virtual void exchangeEdgeH(Axis axis) = 0;
 
 		// Z端部の電界を取得する
-		virtual void getEdgeE(const real **top_ex, const real **top_ey, const real **bottom_ez) const = 0;
+		// 端部は電磁界成分の精度の値を(Size.x + 1) * (Size.y + 1) * Lanes個並べたもの
+		virtual void getEdgeE(const void **top_ex, const void **top_ey, const void **bottom_ez) const = 0;
 		
 		// Z端部の電界を設定する
-		virtual void setEdgeE(const real *bottom_ex, const real *bottom_ey, const real *top_ez) = 0;
+		virtual void setEdgeE(const void *bottom_ex, const void *bottom_ey, const void *top_ez) = 0;
 
 		// Z端部の磁界を取得する
-		virtual void getEdgeH(const real **bottom_hx, const real **bottom_hy, const real **top_hz) const = 0;
+		virtual void getEdgeH(const void **bottom_hx, const void **bottom_hy, const void **top_hz) const = 0;
 
 		// Z端部の磁界を設定する
-		virtual void setEdgeH(const real *top_hx, const real *top_hy, const real *bottom_hz) = 0;
+		virtual void setEdgeH(const void *top_hx, const void *top_hy, const void *bottom_hz) = 0;
+
+		// 4次精度の差分で隣接する領域へ送る接線成分 (Ex, Ey, Hx, Hy) を取得する
+		// bottomは下端から2面目、topは上端から2面目で、それぞれ下側・上側の領域の外側の面となる
+		virtual void getOuterEdge(EMType type, const void **bottom, const void **top) const = 0;
+
+		// 4次精度の差分で読む接線成分 (Ex, Ey, Hx, Hy) の外側の面を設定する
+		// bottomは下端の1面下、topは上端の1面上に書き込む
+		virtual void setOuterEdge(EMType type, const void *bottom, const void *top) = 0;
+
+		// 同じ種類のソルバーを作成する (サブグリッドの計算に使う)
+		virtual FFSolver* createSubSolver(void) const = 0;
+
+		// 指定した成分の値を位置のリストの順に読み出す
+		// 位置はローカル領域のグリッド番号から求めた x + (Size.x + 1) * (y + (Size.y + 1) * z) とし、値は位置ごとにレーン数分を倍精度で並べる
+		virtual void readFieldValues(EMType type, const std::vector<index_t> &index_list, std::vector<double> &value_list) const = 0;
+
+		// 指定した成分の値を位置のリストの順に書き込む (値の並びはreadFieldValues()と同じ)
+		virtual void writeFieldValues(EMType type, const std::vector<index_t> &index_list, const std::vector<double> &value_list) = 0;
 
 	protected:
 		// プローブの観測値を取得する
-		double getProbeValue(oindex_t id, size_t n, ProbeType type) const{
+		double getProbeValue(oindex_t id, size_t n, index_t lane, ProbeType type) const{
 			if (type == ProbeType::TD){
-				return m_TDProbeMeasurment[id][n];
+				return m_TDProbeMeasurment[id][n * m_Lanes + lane];
 			}
 			else if (type == ProbeType::FD){
-				return m_FDProbeMeasurment[id][n];
+				return m_FDProbeMeasurment[id][n * m_Lanes + lane];
 			}
 			else{
 				throw;
@@ -143,7 +290,7 @@ namespace FFFDTD{
 		}
 
 		// 時間ドメインプローブの位置の電磁界を励振する
-		virtual void setTDProbeValue(oindex_t id, real value) = 0;
+		virtual void setTDProbeValue(oindex_t id, index_t lane, double value) = 0;
 
 
 
@@ -1,5 +1,9 @@
 ﻿#include "FFSolverCPU.h"
+#include "Basic/FFException.h"
+#include "Basic/FFTuneCache.h"
+#include <stdio.h>
 #include <string.h>
+#include <math.h>
 #include <algorithm>
 #ifdef _OPENMP
 #include <omp.h>
@@ -13,9 +17,50 @@
 #include <unistd.h>
 #endif
 
+// レーンのループをSIMD化する (レーン間に依存はない)
+// OpenMP 4.0以降ではsimd指示文を使い、OpenMP 2.0のMSVCではループに依存がないことだけを指示する
+#if defined(_OPENMP) && (_OPENMP >= 201307)
+#ifdef _MSC_VER
+#define FFFDTD_SIMD __pragma(omp simd)
+#else
+#define FFFDTD_SIMD _Pragma("omp simd")
+#endif
+#elif defined(_MSC_VER)
+#define FFFDTD_SIMD __pragma(loop(ivdep))
+#else
+#define FFFDTD_SIMD
+#endif
+
 
 
 namespace FFFDTD{
+	// 調整で1つの設定を計測する最短時間[s]
+	const double FFSolverCPU::TUNE_MIN_TIME = 0.02;
+
+	// 単精度の電磁界成分と係数リストを取得する
+	template<>
+	FFSolverCPU::Fields_t<float>& FFSolverCPU::getFields<float>(void){
+		return m_Single;
+	}
+
+	// 倍精度の電磁界成分と係数リストを取得する
+	template<>
+	FFSolverCPU::Fields_t<double>& FFSolverCPU::getFields<double>(void){
+		return m_Double;
+	}
+
+	// 半精度の電磁界成分と係数リストを取得する
+	template<>
+	FFSolverCPU::Fields_t<half_t>& FFSolverCPU::getFields<half_t>(void){
+		return m_Half;
+	}
+
+	// bfloat16の電磁界成分と係数リストを取得する
+	template<>
+	FFSolverCPU::Fields_t<bfloat16_t>& FFSolverCPU::getFields<bfloat16_t>(void){
+		return m_BFloat16;
+	}
+
 	// ソルバーを作成する
 	FFSolverCPU* FFSolverCPU::createSolver(int number_of_threads){
 		return new FFSolverCPU(number_of_threads);
@@ -23,7 +68,7 @@ namespace FFFDTD{
 
 	// コンストラクタ
 	FFSolverCPU::FFSolverCPU(int number_of_threads)
-		: FFSolver()
+		: FFSolver(), m_CoefLanes(1), m_PerfCounter(nullptr), m_KernelConfig(getDefaultKernelConfig()), m_KernelMask(ALL_KERNELS)
 	{
 #ifdef _OPENMP
 		// 並列スレッド数を指定する
@@ -35,7 +80,7 @@ namespace FFFDTD{
 
 	// デストラクタ
 	FFSolverCPU::~FFSolverCPU(){
-		
+		delete m_PerfCounter;
 	}
 
 	// ソルバーの名前を取得する
@@ -86,139 +131,371 @@ namespace FFFDTD{
 #else
 		result = SIZE_MAX;
 #endif
-		return std::min(result, SIZE_MAX);;
+		return std::min(result, SIZE_MAX);
 	}
 
 	// 電界・磁界の絶対合計値を計算する
 	dvec2 FFSolverCPU::calcTotalEM(void){
+		switch (m_Precision){
+		case Precision::Double:
+			return calcTotalEMT<double>();
+		case Precision::Half:
+			return calcTotalEMT<half_t>();
+		case Precision::BFloat16:
+			return calcTotalEMT<bfloat16_t>();
+		default:
+			return calcTotalEMT<float>();
+		}
+	}
+
+	// 格納型Tで電界・磁界の絶対合計値を計算する
+	template<typename T>
+	dvec2 FFSolverCPU::calcTotalEMT(void){
+		using C = typename Fields_t<T>::compute_t;
+		Fields_t<T> &fields = getFields<T>();
 		const index_t Nx = m_Size.x + 1;
 		const index_t Ny = m_Size.y + 1;
 		const index_t Nz = m_Size.z + 1;
-		const index_t Y = Nx;
-		const index_t Z = Nx * Ny;
-		real *Ex = m_Ex.data();
-		real *Ey = m_Ey.data();
-		real *Ez = m_Ez.data();
-		real *Hx = m_Hx.data();
-		real *Hy = m_Hy.data();
-		real *Hz = m_Hz.data();
+		const size_t X = m_Lanes;
+		const size_t Y = Nx * X;
+		const size_t Z = Ny * Y;
+		const T *Ex = fields.ex.data() + fields.e_origin;
+		const T *Ey = fields.ey.data() + fields.e_origin;
+		const T *Ez = fields.ez.data() + fields.e_origin;
+		const T *Hx = fields.hx.data() + fields.h_origin;
+		const T *Hy = fields.hy.data() + fields.h_origin;
+		const T *Hz = fields.hz.data() + fields.h_origin;
+
+		// 常に0の行は読まない (0を加えても合計値は変わらない)
+		const uint8_t *LiveEx = m_ExLiveRow.data();
+		const uint8_t *LiveEy = m_EyLiveRow.data();
+		const uint8_t *LiveEz = m_EzLiveRow.data();
+		const uint8_t *LiveHx = m_HxLiveRow.data();
+		const uint8_t *LiveHy = m_HyLiveRow.data();
+		const uint8_t *LiveHz = m_HzLiveRow.data();
 
 		double e_total = 0.0, h_total = 0.0;
 #pragma omp parallel for reduction(+ : e_total, h_total)
-		for (int iz_ = 0; (index_t)iz_ < Nz; iz_++){
+		for (int iz_ = 0; iz_ < (int)Nz; iz_++){
 			index_t iz = (index_t)iz_;
 			for (index_t iy = 0; iy < Ny; iy++){
-				for (index_t ix = 0; ix < Nx; ix++){
-					e_total += abs(Ex[ix + Y * iy + Z * iz]);
-					e_total += abs(Ey[ix + Y * iy + Z * iz]);
-					e_total += abs(Ez[ix + Y * iy + Z * iz]);
-					h_total += abs(Hx[ix + Y * iy + Z * iz]);
-					h_total += abs(Hy[ix + Y * iy + Z * iz]);
-					h_total += abs(Hz[ix + Y * iy + Z * iz]);
+				const size_t row = iy + Ny * iz;
+				const bool ex = LiveEx[row] != 0, ey = LiveEy[row] != 0, ez = LiveEz[row] != 0;
+				const bool hx = LiveHx[row] != 0, hy = LiveHy[row] != 0, hz = LiveHz[row] != 0;
+				if (!(ex || ey || ez || hx || hy || hz)){
+					continue;
+				}
+				for (size_t i = 0; i < Y; i++){
+					e_total += ex ? abs((C)Ex[i + Y * iy + Z * iz]) : (C)0;
+					e_total += ey ? abs((C)Ey[i + Y * iy + Z * iz]) : (C)0;
+					e_total += ez ? abs((C)Ez[i + Y * iy + Z * iz]) : (C)0;
+					h_total += hx ? abs((C)Hx[i + Y * iy + Z * iz]) : (C)0;
+					h_total += hy ? abs((C)Hy[i + Y * iy + Z * iz]) : (C)0;
+					h_total += hz ? abs((C)Hz[i + Y * iy + Z * iz]) : (C)0;
 				}
 			}
 		}
 
 		return dvec2(e_total, h_total);
 	}
+
+	// 直方体[start, end]の内部と表面の電界・磁界の絶対合計値を計算する
+	dvec2 FFSolverCPU::calcTotalEM(const index3_t &start, const index3_t &end){
+		switch (m_Precision){
+		case Precision::Double:
+			return calcTotalEMT<double>(start, end);
+		case Precision::Half:
+			return calcTotalEMT<half_t>(start, end);
+		case Precision::BFloat16:
+			return calcTotalEMT<bfloat16_t>(start, end);
+		default:
+			return calcTotalEMT<float>(start, end);
+		}
+	}
+
+	// 格納型Tで直方体[start, end]の内部と表面の電界・磁界の絶対合計値を計算する
+	template<typename T>
+	dvec2 FFSolverCPU::calcTotalEMT(const index3_t &start, const index3_t &end){
+		using C = typename Fields_t<T>::compute_t;
+		Fields_t<T> &fields = getFields<T>();
+		const size_t L = m_Lanes;
+		const size_t Y = (size_t)(m_Size.x + 1) * L;
+		const size_t Z = (size_t)(m_Size.y + 1) * Y;
+		const size_t Ny = m_Size.y + 1;
+
+		// 成分fieldの絶対合計値を求める関数 (cellが1の方向はセルの範囲[start, end)、0の方向はグリッドの範囲[start, end]とする)
+		// 常に0の行は読まない
+		auto sum = [&](const T *field, const std::vector<uint8_t> &live, const index3_t &cell) -> double{
+			const index3_t last = end - cell;
+			double total = 0.0;
+#pragma omp parallel for reduction(+ : total)
+			for (int iz_ = (int)start.z; iz_ <= (int)last.z; iz_++){
+				index_t iz = (index_t)iz_;
+				for (index_t iy = start.y; iy <= last.y; iy++){
+					if (live[iy + Ny * iz] == 0){
+						continue;
+					}
+					const T *row = field + Y * iy + Z * iz;
+					for (size_t i = L * start.x; i < L * (last.x + 1); i++){
+						total += abs((C)row[i]);
+					}
+				}
+			}
+			return total;
+		};
+
+		double e_total = 0.0, h_total = 0.0;
+		e_total += sum(fields.ex.data() + fields.e_origin, m_ExLiveRow, index3_t(1, 0, 0));
+		e_total += sum(fields.ey.data() + fields.e_origin, m_EyLiveRow, index3_t(0, 1, 0));
+		e_total += sum(fields.ez.data() + fields.e_origin, m_EzLiveRow, index3_t(0, 0, 1));
+		h_total += sum(fields.hx.data() + fields.h_origin, m_HxLiveRow, index3_t(0, 1, 1));
+		h_total += sum(fields.hy.data() + fields.h_origin, m_HyLiveRow, index3_t(1, 0, 1));
+		h_total += sum(fields.hz.data() + fields.h_origin, m_HzLiveRow, index3_t(1, 1, 0));
+		return dvec2(e_total, h_total);
+	}
 	
 	// 電磁界成分を格納するメモリーを確保し初期化する
-	void FFSolverCPU::initializeMemory(const index3_t &size, const index3_t &offset_m, const index3_t &offset_n, const index3_t &range_m, const index3_t &range_n){
-		FFSolver::initializeMemory(size, offset_m, offset_n, range_m, range_n);
+	void FFSolverCPU::initializeMemory(const index3_t &size, const index3_t &offset_m, const index3_t &offset_n, const index3_t &range_m, const index3_t &range_n, index_t lanes, Precision precision){
+		FFSolver::initializeMemory(size, offset_m, offset_n, range_m, range_n, lanes, precision);
 
-		// メモリーを確保する
-		size_t volume = (size_t)(size.x + 1) * (size_t)(size.y + 1) * (size_t)(size.z + 1);
-		m_Ex.resize(volume, 0.0);
-		m_Ey.resize(volume, 0.0);
-		m_Ez.resize(volume, 0.0);
-		m_Hx.resize(volume, 0.0);
-		m_Hy.resize(volume, 0.0);
-		m_Hz.resize(volume, 0.0);
+		// 使う精度のメモリーを確保し、他の精度のメモリーは解放する
+		// 各成分はセルごとにレーン数分の値を連続して格納する
+		// 磁界はPMCの対称面で原点の1面下を読むため、先頭に0の面を1面分余分に確保する
+		// 4次精度の差分ではZ端部の外側の面も読むため、電界の先頭と電磁界の末尾にも1面ずつ余分に確保する (磁界の先頭の面は兼用する)
+		// メモリーは0で初期化したページとし、書き込むまで物理メモリーを割り当てない
+		size_t volume = (size_t)(size.x + 1) * (size_t)(size.y + 1) * (size_t)(size.z + 1) * lanes;
+		size_t pad = (size_t)(size.x + 1) * (size_t)(size.y + 1) * lanes;
+		size_t halo = (m_SpatialOrder == 4) ? pad : 0;
+		m_Single = Fields_t<float>();
+		m_Double = Fields_t<double>();
+		m_Half = Fields_t<half_t>();
+		m_BFloat16 = Fields_t<bfloat16_t>();
+		switch (m_Precision){
+		case Precision::Double:
+			allocateFields<double>(volume, pad, halo);
+			break;
+		case Precision::Half:
+			allocateFields<half_t>(volume, pad, halo);
+			break;
+		case Precision::BFloat16:
+			allocateFields<bfloat16_t>(volume, pad, halo);
+			break;
+		default:
+			allocateFields<float>(volume, pad, halo);
+			break;
+		}
+
+		// 行ごとの計算区間は通常空間の全体とする (updateStaticMask()で常に0の成分を除く)
+		m_ExMask = createFullRowMask(range_m.x, range_n.y, range_n.z);
+		m_EyMask = createFullRowMask(range_n.x, range_m.y, range_n.z);
+		m_EzMask = createFullRowMask(range_n.x, range_n.y, range_m.z);
+		m_HxMask = createFullRowMask(range_n.x, range_m.y, range_m.z);
+		m_HyMask = createFullRowMask(range_m.x, range_n.y, range_m.z);
+		m_HzMask = createFullRowMask(range_m.x, range_m.y, range_n.z);
+		const size_t rows = (size_t)(size.y + 1) * (size.z + 1);
+		m_ExLiveRow.assign(rows, 1);
+		m_EyLiveRow.assign(rows, 1);
+		m_EzLiveRow.assign(rows, 1);
+		m_HxLiveRow.assign(rows, 1);
+		m_HyLiveRow.assign(rows, 1);
+		m_HzLiveRow.assign(rows, 1);
+
+		// 4次精度の差分で補正する成分はstoreHighOrderMask()で指定する (指定するまでは補正しない)
+		m_ExHighOrderMask = RowMask_t{std::vector<int>(range_n.y * range_n.z + 1, 0), std::vector<RowSpan_t>()};
+		m_EyHighOrderMask = RowMask_t{std::vector<int>(range_m.y * range_n.z + 1, 0), std::vector<RowSpan_t>()};
+		m_EzHighOrderMask = RowMask_t{std::vector<int>(range_n.y * range_m.z + 1, 0), std::vector<RowSpan_t>()};
+		m_HxHighOrderMask = RowMask_t{std::vector<int>(range_m.y * range_m.z + 1, 0), std::vector<RowSpan_t>()};
+		m_HyHighOrderMask = RowMask_t{std::vector<int>(range_n.y * range_m.z + 1, 0), std::vector<RowSpan_t>()};
+		m_HzHighOrderMask = RowMask_t{std::vector<int>(range_m.y * range_n.z + 1, 0), std::vector<RowSpan_t>()};
+		const size_t flag_count = (size_t)(size.x + 1) * (size.y + 1) * (size.z + 3);
+		m_ExHighOrderFlag.assign(flag_count, 0);
+		m_EyHighOrderFlag.assign(flag_count, 0);
+		m_EzHighOrderFlag.assign(flag_count, 0);
+
+		if (m_PerfCounter != nullptr){
+			m_PerfCounter->setElementSize((int)getComputeSize(precision));
+		}
+	}
+
+	// 格納型Tの電磁界成分と係数リストを確保し初期化する
+	template<typename T>
+	void FFSolverCPU::allocateFields(size_t volume, size_t pad, size_t halo){
+		Fields_t<T> &fields = getFields<T>();
+		assignLazyZero(fields.ex, halo + volume + halo);
+		assignLazyZero(fields.ey, halo + volume + halo);
+		assignLazyZero(fields.ez, halo + volume + halo);
+		assignLazyZero(fields.hx, pad + volume + halo);
+		assignLazyZero(fields.hy, pad + volume + halo);
+		assignLazyZero(fields.hz, pad + volume + halo);
+		fields.e_origin = halo;
+		fields.h_origin = pad;
+		if (m_ImplicitZ){
+			assignLazyZero(fields.prev_x, volume);
+			assignLazyZero(fields.prev_y, volume);
+		}
+	}
+
+	// 格納型TのPMLの分割成分とCPMLの補助変数を確保し初期化する
+	// 常に0のままの区間はupdateStaticMask()で計算から除くため、その区間のページには物理メモリーを割り当てない
+	template<typename T>
+	void FFSolverCPU::allocatePML(EMType type, size_t pml_count, size_t cpml_count){
+		Fields_t<T> &fields = getFields<T>();
+		switch (type){
+		case EMType::Ex:
+			assignLazyZero(fields.pml_dx, pml_count);
+			assignLazyZero(fields.cpml_ex, cpml_count);
+			break;
+		case EMType::Ey:
+			assignLazyZero(fields.pml_dy, pml_count);
+			assignLazyZero(fields.cpml_ey, cpml_count);
+			break;
+		case EMType::Ez:
+			assignLazyZero(fields.pml_dz, pml_count);
+			assignLazyZero(fields.cpml_ez, cpml_count);
+			break;
+		case EMType::Hx:
+			assignLazyZero(fields.pml_hx, pml_count);
+			assignLazyZero(fields.cpml_hx, cpml_count);
+			break;
+		case EMType::Hy:
+			assignLazyZero(fields.pml_hy, pml_count);
+			assignLazyZero(fields.cpml_hy, cpml_count);
+			break;
+		case EMType::Hz:
+			assignLazyZero(fields.pml_hz, pml_count);
+			assignLazyZero(fields.cpml_hz, cpml_count);
+			break;
+		}
 	}
 
 	// 係数インデックスを格納する
-	void FFSolverCPU::storeCoefficientIndex(EMType type, const std::vector<cindex_t> &normal_cindex, const std::vector<cindex2_t> &pml_cindex, const std::vector<index_t> &pml_index){
-		FFSolver::storeCoefficientIndex(type, normal_cindex, pml_cindex, pml_index);
+	void FFSolverCPU::storeCoefficientIndex(EMType type, const std::vector<cindex_t> &normal_cindex, const std::vector<PMLBox_t> &pml_box_list, const std::vector<PMLBox_t> &cpml_box_list){
+		FFSolver::storeCoefficientIndex(type, normal_cindex, pml_box_list, cpml_box_list);
 		
+		// 分割成分と補助変数は全直方体を連結した配列に、直方体ごとに連続して格納する
+		size_t pml_count = 0, cpml_count = 0;
+		for (const PMLBox_t &box : pml_box_list){
+			pml_count += box.cindex.size() * m_Lanes;
+		}
+		for (const PMLBox_t &box : cpml_box_list){
+			cpml_count += box.cindex.size() * m_Lanes;
+		}
 		switch (type){
 		case EMType::Ex:
-			m_ExCIndex = normal_cindex;
-			m_PMLDxCIndex = pml_cindex;
-			m_PMLDxIndex = pml_index;
-			m_PMLDx.resize(pml_cindex.size(), rvec2(0.0, 0.0));
+			m_ExCIndex.assign(normal_cindex.begin(), normal_cindex.end());
+			m_PMLDxBoxList = pml_box_list;
+			m_PMLDxRunList = createPMLRunList(pml_box_list, m_ExCIndex.data());
+			m_CPMLExRunList = createPMLRunList(cpml_box_list, nullptr);
 			break;
 
 		case EMType::Ey:
-			m_EyCIndex = normal_cindex;
-			m_PMLDyCIndex = pml_cindex;
-			m_PMLDyIndex = pml_index;
-			m_PMLDy.resize(pml_cindex.size(), rvec2(0.0, 0.0));
+			m_EyCIndex.assign(normal_cindex.begin(), normal_cindex.end());
+			m_PMLDyBoxList = pml_box_list;
+			m_PMLDyRunList = createPMLRunList(pml_box_list, m_EyCIndex.data());
+			m_CPMLEyRunList = createPMLRunList(cpml_box_list, nullptr);
 			break;
 
 		case EMType::Ez:
-			m_EzCIndex = normal_cindex;
-			m_PMLDzCIndex = pml_cindex;
-			m_PMLDzIndex = pml_index;
-			m_PMLDz.resize(pml_cindex.size(), rvec2(0.0, 0.0));
+			m_EzCIndex.assign(normal_cindex.begin(), normal_cindex.end());
+			m_PMLDzBoxList = pml_box_list;
+			m_PMLDzRunList = createPMLRunList(pml_box_list, m_EzCIndex.data());
+			m_CPMLEzRunList = createPMLRunList(cpml_box_list, nullptr);
 			break;
 
 		case EMType::Hx:
-			m_HxCIndex = normal_cindex;
-			m_PMLHxCIndex = pml_cindex;
-			m_PMLHxIndex = pml_index;
-			m_PMLHx.resize(pml_cindex.size(), rvec2(0.0, 0.0));
+			m_HxCIndex.assign(normal_cindex.begin(), normal_cindex.end());
+			m_PMLHxRunList = createPMLRunList(pml_box_list, nullptr);
+			m_CPMLHxRunList = createPMLRunList(cpml_box_list, nullptr);
 			break;
 
 		case EMType::Hy:
-			m_HyCIndex = normal_cindex;
-			m_PMLHyCIndex = pml_cindex;
-			m_PMLHyIndex = pml_index;
-			m_PMLHy.resize(pml_cindex.size(), rvec2(0.0, 0.0));
+			m_HyCIndex.assign(normal_cindex.begin(), normal_cindex.end());
+			m_PMLHyRunList = createPMLRunList(pml_box_list, nullptr);
+			m_CPMLHyRunList = createPMLRunList(cpml_box_list, nullptr);
 			break;
 
 		case EMType::Hz:
-			m_HzCIndex = normal_cindex;
-			m_PMLHzCIndex = pml_cindex;
-			m_PMLHzIndex = pml_index;
-			m_PMLHz.resize(pml_cindex.size(), rvec2(0.0, 0.0));
+			m_HzCIndex.assign(normal_cindex.begin(), normal_cindex.end());
+			m_PMLHzRunList = createPMLRunList(pml_box_list, nullptr);
+			m_CPMLHzRunList = createPMLRunList(cpml_box_list, nullptr);
+			break;
+		}
+
+		switch (m_Precision){
+		case Precision::Double:
+			allocatePML<double>(type, pml_count, cpml_count);
+			break;
+		case Precision::Half:
+			allocatePML<half_t>(type, pml_count, cpml_count);
+			break;
+		case Precision::BFloat16:
+			allocatePML<bfloat16_t>(type, pml_count, cpml_count);
+			break;
+		default:
+			allocatePML<float>(type, pml_count, cpml_count);
 			break;
 		}
 	}
 
 	// 係数リストを格納する
-	void FFSolverCPU::storeCoefficientList(const std::vector<rvec2> &coef2_list, const std::vector<rvec3> &coef3_list){
-		m_Coef2List = coef2_list;
-		m_Coef3List = coef3_list;
+	void FFSolverCPU::storeCoefficientList(const std::vector<dvec2> &coef2_list, const std::vector<dvec3> &coef3_list, index_t coef_lanes){
+		m_CoefLanes = coef_lanes;
+
+		// 全レーンの係数が0のエントリーを求めておく
+		m_ZeroCoef2.assign(coef2_list.size() / coef_lanes, true);
+		for (size_t i = 0; i < coef2_list.size(); i++){
+			if (coef2_list[i] != dvec2(0.0, 0.0)){
+				m_ZeroCoef2[i / coef_lanes] = false;
+			}
+		}
+		m_ZeroCoef3.assign(coef3_list.size() / coef_lanes, true);
+		for (size_t i = 0; i < coef3_list.size(); i++){
+			if (coef3_list[i] != dvec3(0.0, 0.0, 0.0)){
+				m_ZeroCoef3[i / coef_lanes] = false;
+			}
+		}
+
+		switch (m_Precision){
+		case Precision::Double:
+			storeCoefficientListT<double>(coef2_list, coef3_list);
+			break;
+		case Precision::Half:
+			storeCoefficientListT<half_t>(coef2_list, coef3_list);
+			break;
+		case Precision::BFloat16:
+			storeCoefficientListT<bfloat16_t>(coef2_list, coef3_list);
+			break;
+		default:
+			storeCoefficientListT<float>(coef2_list, coef3_list);
+			break;
+		}
+	}
+
+	// 格納型Tの係数リストを格納する
+	// 係数は演算型に丸めて保持する
+	template<typename T>
+	void FFSolverCPU::storeCoefficientListT(const std::vector<dvec2> &coef2_list, const std::vector<dvec3> &coef3_list){
+		Fields_t<T> &fields = getFields<T>();
+		fields.coef2_list.assign(coef2_list.begin(), coef2_list.end());
+		fields.coef3_list.assign(coef3_list.begin(), coef3_list.end());
 	}
 
 	// 給電と観測を行う
 	void FFSolverCPU::feedAndMeasure(size_t n){
 		// 時間ドメインプローブの測定を行う
-		for (int i = 0; i < (int)m_TDProbeList.size(); i++){
-			Probe_t &probe = m_TDProbeList[i];
-			index_t index = probe.index;
-			real value;
-			switch (probe.type){
-			case EMType::Ex:
-				value = m_Ex[index];
-				break;
-			case EMType::Ey:
-				value = m_Ey[index];
-				break;
-			case EMType::Ez:
-				value = m_Ez[index];
-				break;
-			case EMType::Hx:
-				value = m_Hx[index];
-				break;
-			case EMType::Hy:
-				value = m_Hy[index];
-				break;
-			case EMType::Hz:
-				value = m_Hz[index];
-				break;
-			}
-			m_TDProbeMeasurment[i][n] = value;
+		switch (m_Precision){
+		case Precision::Double:
+			measureTDProbes<double>(n);
+			break;
+		case Precision::Half:
+			measureTDProbes<half_t>(n);
+			break;
+		case Precision::BFloat16:
+			measureTDProbes<bfloat16_t>(n);
+			break;
+		default:
+			measureTDProbes<float>(n);
+			break;
 		}
 
 		// ポートの出力値を計算する
@@ -230,447 +507,2019 @@ namespace FFFDTD{
 		}
 	}
 
-	// 電界を計算する
-	void FFSolverCPU::calcEField(void){
-		const rvec2 *Coef2List = m_Coef2List.data();
-		const rvec3 *Coef3List = m_Coef3List.data();
-		const cindex_t *ExCIndex = m_ExCIndex.data();
-		const cindex_t *EyCIndex = m_EyCIndex.data();
-		const cindex_t *EzCIndex = m_EzCIndex.data();
-		real *Ex = m_Ex.data();
-		real *Ey = m_Ey.data();
-		real *Ez = m_Ez.data();
-		const real *Hx = m_Hx.data();
-		const real *Hy = m_Hy.data();
-		const real *Hz = m_Hz.data();
-		const int X = 1;
-		const int Y = m_Size.x + 1;
-		const int Z = (m_Size.x + 1) * (m_Size.y + 1);
-		const int RangeMx = m_RangeM.x;
-		const int RangeMy = m_RangeM.y;
-		const int RangeMz = m_RangeM.z;
-		const int RangeNx = m_RangeN.x;
-		const int RangeNy = m_RangeN.y;
-		const int RangeNz = m_RangeN.z;
-		const int ExOffset = X * m_StartM.x + Y * m_StartN.y + Z * m_StartN.z;
-		const int EyOffset = X * m_StartN.x + Y * m_StartM.y + Z * m_StartN.z;
-		const int EzOffset = X * m_StartN.x + Y * m_StartN.y + Z * m_StartM.z;
-
-		// Dx,Exを計算する
-#pragma omp parallel for
-		for (int riz = 0; riz < RangeNz; riz++){
-			for (int riy = 0; riy < RangeNy; riy++){
-				int index = ExOffset + Y * riy + Z * riz;
-				for (int rix = 0; rix < RangeMx; rix++){
-					const rvec3 &coef = Coef3List[ExCIndex[index]];
-					Ex[index]
-						= coef.x * Ex[index]
-						+ coef.y * (Hz[index] - Hz[index - Y])
-						- coef.z * (Hy[index] - Hy[index - Z]);
-					index++;
-				}
-			}
-		}
-
-		// Dy,Eyを計算する
-#pragma omp parallel for
-		for (int riz = 0; riz < RangeNz; riz++){
-			for (int riy = 0; riy < RangeMy; riy++){
-				int index = EyOffset + Y * riy + Z * riz;
-				for (int rix = 0; rix < RangeNx; rix++){
-					const rvec3 &coef = Coef3List[EyCIndex[index]];
-					Ey[index]
-						= coef.x * Ey[index]
-						+ coef.y * (Hx[index] - Hx[index - Z])
-						- coef.z * (Hz[index] - Hz[index - X]);
-					index++;
-				}
+	// 格納型Tで時間ドメインプローブの値を測定値に書き写す
+	template<typename T>
+	void FFSolverCPU::measureTDProbes(size_t n){
+		const index_t L = m_Lanes;
+		for (int i = 0; i < (int)m_TDProbeList.size(); i++){
+			Probe_t &probe = m_TDProbeList[i];
+			const T *field = (const T*)getFieldData(probe.type);
+			const size_t index = (size_t)probe.index * L;
+			for (index_t k = 0; k < L; k++){
+				m_TDProbeMeasurment[i][n * L + k] = field[index + k];
 			}
 		}
-
-		// Dz,Ezを計算する
-#pragma omp parallel for
-		for (int riz = 0; riz < RangeMz; riz++){
-			for (int riy = 0; riy < RangeNy; riy++){
-				int index = EzOffset + Y * riy + Z * riz;
-				for (int rix = 0; rix < RangeNx; rix++){
-					const rvec3 &coef = Coef3List[EzCIndex[index]];
-					Ez[index]
-						= coef.x * Ez[index]
-						+ coef.y * (Hy[index] - Hy[index - X])
-						- coef.z * (Hx[index] - Hx[index - Y]);
-					index++;
-				}
-			}
-		}
-
-		rvec2 *PmlDx = m_PMLDx.data();
-		rvec2 *PmlDy = m_PMLDy.data();
-		rvec2 *PmlDz = m_PMLDz.data();
-		const cindex2_t *PmlDxCIndex = m_PMLDxCIndex.data();
-		const cindex2_t *PmlDyCIndex = m_PMLDyCIndex.data();
-		const cindex2_t *PmlDzCIndex = m_PMLDzCIndex.data();
-		const index_t *PmlDxIndex = m_PMLDxIndex.data();
-		const index_t *PmlDyIndex = m_PMLDyIndex.data();
-		const index_t *PmlDzIndex = m_PMLDzIndex.data();
-
-		// PML Dx,Exを計算する
-		const int NumOfPMLDx = m_NumOfPMLD.x;
-#pragma omp parallel for
-		for (int i = 0; i < NumOfPMLDx; i++){
-			const cindex2_t &pml_cindex = PmlDxCIndex[i];
-			int index = PmlDxIndex[i];
-			const rvec2 &coef_dxy = Coef2List[pml_cindex.x];
-			const rvec2 &coef_dxz = Coef2List[pml_cindex.y];
-			const rvec2 &coef_ex = Coef2List[ExCIndex[index]];
-			real dx_prev = PmlDx[i].x + PmlDx[i].y;
-			PmlDx[i].x
-				= coef_dxy.x * PmlDx[i].x
-				+ coef_dxy.y * (Hz[index] - Hz[index - Y]);
-			PmlDx[i].y
-				= coef_dxz.x * PmlDx[i].y
-				- coef_dxz.y * (Hy[index] - Hy[index - Z]);
-			real dx_next = PmlDx[i].x + PmlDx[i].y;
-			Ex[index] = coef_ex.x * Ex[index] + coef_ex.y * (dx_next - dx_prev);
-		}
-
-		// PML Dy,Eyを計算する
-		const int NumOfPMLDy = m_NumOfPMLD.y;
-#pragma omp parallel for
-		for (int i = 0; i < NumOfPMLDy; i++){
-			const cindex2_t &pml_cindex = m_PMLDyCIndex[i];
-			int index = m_PMLDyIndex[i];
-			const rvec2 &coef_dyz = Coef2List[pml_cindex.x];
-			const rvec2 &coef_dyx = Coef2List[pml_cindex.y];
-			const rvec2 &coef_ey = Coef2List[EyCIndex[index]];
-			real dy_prev = PmlDy[i].x + PmlDy[i].y;
-			PmlDy[i].x
-				= coef_dyz.x * PmlDy[i].x
-				+ coef_dyz.y * (Hx[index] - Hx[index - Z]);
-			PmlDy[i].y
-				= coef_dyx.x * PmlDy[i].y
-				- coef_dyx.y * (Hz[index] - Hz[index - X]);
-			real dy_next = PmlDy[i].x + PmlDy[i].y;
-			Ey[index] = coef_ey.x * Ey[index] + coef_ey.y * (dy_next - dy_prev);
-		}
-
-		// PML Dz,Ezを計算する
-		const int NumOfPMLDz = m_NumOfPMLD.z;
-#pragma omp parallel for
-		for (int i = 0; i < NumOfPMLDz; i++){
-			const cindex2_t &pml_cindex = PmlDzCIndex[i];
-			int index = m_PMLDzIndex[i];
-			const rvec2 &coef_dzx = Coef2List[pml_cindex.x];
-			const rvec2 &coef_dzy = Coef2List[pml_cindex.y];
-			const rvec2 &coef_ez = Coef2List[EzCIndex[index]];
-			real dz_prev = PmlDz[i].x + PmlDz[i].y;
-			PmlDz[i].x
-				= coef_dzx.x * PmlDz[i].x
-				+ coef_dzx.y * (Hy[index] - Hy[index - X]);
-			PmlDz[i].y
-				= coef_dzy.x * PmlDz[i].y
-				- coef_dzy.y * (Hx[index] - Hx[index - Y]);
-			real dz_next = PmlDz[i].x + PmlDz[i].y;
-			Ez[index] = coef_ez.x * Ez[index] + coef_ez.y * (dz_next - dz_prev);
-		}
 	}
 
-	// 磁界を計算する
-	void FFSolverCPU::calcHField(void){
-		const rvec2 *Coef2List = m_Coef2List.data();
-		const rvec3 *Coef3List = m_Coef3List.data();
-		const cindex_t *HxCIndex = m_HxCIndex.data();
-		const cindex_t *HyCIndex = m_HyCIndex.data();
-		const cindex_t *HzCIndex = m_HzCIndex.data();
-		const real *Ex = m_Ex.data();
-		const real *Ey = m_Ey.data();
-		const real *Ez = m_Ez.data();
-		real *Hx = m_Hx.data();
-		real *Hy = m_Hy.data();
-		real *Hz = m_Hz.data();
-		const int X = 1;
-		const int Y = m_Size.x + 1;
-		const int Z = (m_Size.x + 1) * (m_Size.y + 1);
-		const int RangeMx = m_RangeM.x;
-		const int RangeMy = m_RangeM.y;
-		const int RangeMz = m_RangeM.z;
-		const int RangeNx = m_RangeN.x;
-		const int RangeNy = m_RangeN.y;
-		const int RangeNz = m_RangeN.z;
-		const int HxOffset = X * m_StartN.x + Y * m_StartM.y + Z * m_StartM.z;
-		const int HyOffset = X * m_StartM.x + Y * m_StartN.y + Z * m_StartM.z;
-		const int HzOffset = X * m_StartM.x + Y * m_StartM.y + Z * m_StartN.z;
-
-		// Hxを計算する
-#pragma omp parallel for
-		for (int riz = 0; riz < RangeMz; riz++){
-			for (int riy = 0; riy < RangeMy; riy++){
-				int index = HxOffset + Y * riy + Z * riz;
-				for (int rix = 0; rix < RangeNx; rix++){
-					const rvec3 &coef = Coef3List[HxCIndex[index]];
-					Hx[index]
-						= coef.x * Hx[index]
-						- coef.y * (Ez[index + Y] - Ez[index])
-						+ coef.z * (Ey[index + Z] - Ey[index]);
-					index++;
-				}
-			}
+	// 電界を計算する
+	void FFSolverCPU::calcEField(void){
+		switch (m_Precision){
+		case Precision::Double:
+			calcEFieldT<double>();
+			break;
+		case Precision::Half:
+			calcEFieldT<half_t>();
+			break;
+		case Precision::BFloat16:
+			calcEFieldT<bfloat16_t>();
+			break;
+		default:
+			calcEFieldT<float>();
+			break;
 		}
 
-		// Hyを計算する
-#pragma omp parallel for
-		for (int riz = 0; riz < RangeMz; riz++){
-			for (int riy = 0; riy < RangeNy; riy++){
-				int index = HyOffset + Y * riy + Z * riz;
-				for (int rix = 0; rix < RangeMx; rix++){
-					const rvec3 &coef = Coef3List[HyCIndex[index]];
-					Hy[index]
-						= coef.x * Hy[index]
-						- coef.y * (Ex[index + Z] - Ex[index])
-						+ coef.z * (Ez[index + X] - Ez[index]);
-					index++;
-				}
-			}
+		// 周期境界の端部のゴーストを埋める
+		if (m_PeriodicX || m_PeriodicY){
+			copyPeriodicEdge(true, m_PeriodicX, m_PeriodicY);
 		}
+	}
 
-		// Hzを計算する
-#pragma omp parallel for
-		for (int riz = 0; riz < RangeNz; riz++){
-			for (int riy = 0; riy < RangeMy; riy++){
-				int index = HzOffset + Y * riy + Z * riz;
-				for (int rix = 0; rix < RangeMx; rix++){
-					const rvec3 &coef = Coef3List[HzCIndex[index]];
-					Hz[index]
-						= coef.x * Hz[index]
-						- coef.y * (Ey[index + X] - Ey[index])
-						+ coef.z * (Ex[index + Y] - Ex[index]);
-					index++;
-				}
-			}
-		}
-
-		rvec2 *PmlHx = m_PMLHx.data();
-		rvec2 *PmlHy = m_PMLHy.data();
-		rvec2 *PmlHz = m_PMLHz.data();
-		const cindex2_t *PmlHxCIndex = m_PMLHxCIndex.data();
-		const cindex2_t *PmlHyCIndex = m_PMLHyCIndex.data();
-		const cindex2_t *PmlHzCIndex = m_PMLHzCIndex.data();
-		const index_t *PmlHxIndex = m_PMLHxIndex.data();
-		const index_t *PmlHyIndex = m_PMLHyIndex.data();
-		const index_t *PmlHzIndex = m_PMLHzIndex.data();
-
-		// PML Hxを計算する
-		const int NumOfPMLHx = m_NumOfPMLH.x;
-#pragma omp parallel for
-		for (int i = 0; i < NumOfPMLHx; i++){
-			const cindex2_t &pml_cindex = PmlHxCIndex[i];
-			int index = PmlHxIndex[i];
-			const rvec2 &coef_hxy = Coef2List[pml_cindex.x];
-			const rvec2 &coef_hxz = Coef2List[pml_cindex.y];
-			PmlHx[i].x
-				= coef_hxy.x * PmlHx[i].x
-				- coef_hxy.y * (Ez[index + Y] - Ez[index]);
-			PmlHx[i].y
-				= coef_hxz.x * PmlHx[i].y
-				+ coef_hxz.y * (Ey[index + Z] - Ey[index]);
-			Hx[index] = PmlHx[i].x + PmlHx[i].y;
+	// 格納型Tで電界を計算する
+	template<typename T>
+	void FFSolverCPU::calcEFieldT(void){
+		if (m_Lanes == 1){
+			calcEFieldLanes<T, 0, 1>();
 		}
-
-		// PML Hyを計算する
-		const int NumOfPMLHy = m_NumOfPMLH.y;
-#pragma omp parallel for
-		for (int i = 0; i < NumOfPMLHy; i++){
-			const cindex2_t &pml_cindex = PmlHyCIndex[i];
-			int index = PmlHyIndex[i];
-			const rvec2 &coef_hyz = Coef2List[pml_cindex.x];
-			const rvec2 &coef_hyx = Coef2List[pml_cindex.y];
-			PmlHy[i].x
-				= coef_hyz.x * PmlHy[i].x
-				- coef_hyz.y * (Ex[index + Z] - Ex[index]);
-			PmlHy[i].y
-				= coef_hyx.x * PmlHy[i].y
-				+ coef_hyx.y * (Ez[index + X] - Ez[index]);
-			Hy[index] = PmlHy[i].x + PmlHy[i].y;
+		else if (m_CoefLanes == 1){
+			calcEFieldLanes<T, 0, 0>();
 		}
-
-		// PML Hzを計算する
-		const int NumOfPMLHz = m_NumOfPMLH.z;
-#pragma omp parallel for
-		for (int i = 0; i < NumOfPMLHz; i++){
-			const cindex2_t &pml_cindex = PmlHzCIndex[i];
-			int index = PmlHzIndex[i];
-			const rvec2 &coef_hzx = Coef2List[pml_cindex.x];
-			const rvec2 &coef_hzy = Coef2List[pml_cindex.y];
-			PmlHz[i].x
-				= coef_hzx.x * PmlHz[i].x
-				- coef_hzx.y * (Ey[index + X] - Ey[index]);
-			PmlHz[i].y
-				= coef_hzy.x * PmlHz[i].y
-				+ coef_hzy.y * (Ex[index + Y] - Ex[index]);
-			Hz[index] = PmlHz[i].x + PmlHz[i].y;
+		else{
+			calcEFieldLanes<T, 1, 0>();
 		}
 	}
-	
-	// 時間ドメインプローブの位置の電磁界を励振する
-	void FFSolverCPU::setTDProbeValue(oindex_t id, real value){
-		// 電磁界の値を反映する
-		Probe_t &probe = m_TDProbeList[id];
-		switch (probe.type){
-		case EMType::Ex:
-			m_Ex[probe.index] = value;
-			break;
 
-		case EMType::Ey:
-			m_Ey[probe.index] = value;
+	// 磁界を計算する
+	void FFSolverCPU::calcHField(void){
+		switch (m_Precision){
+		case Precision::Double:
+			calcHFieldT<double>();
 			break;
-
-		case EMType::Ez:
-			m_Ez[probe.index] = value;
+		case Precision::Half:
+			calcHFieldT<half_t>();
 			break;
-
-		case EMType::Hx:
-			m_Hx[probe.index] = value;
+		case Precision::BFloat16:
+			calcHFieldT<bfloat16_t>();
 			break;
-
-		case EMType::Hy:
-			m_Hy[probe.index] = value;
+		default:
+			calcHFieldT<float>();
 			break;
+		}
 
-		case EMType::Hz:
-			m_Hz[probe.index] = value;
-			break;
+		// 周期境界の端部のゴーストを埋める
+		if (m_PeriodicX || m_PeriodicY){
+			copyPeriodicEdge(false, m_PeriodicX, m_PeriodicY);
 		}
 	}
 
-	// 端部の電界を交換する
-	void FFSolverCPU::exchangeEdgeE(Axis axis){
-		const index_t Mx = m_Size.x;
-		const index_t My = m_Size.y;
-		const index_t Mz = m_Size.z;
-		const index_t Nx = m_Size.x + 1;
-		const index_t Ny = m_Size.y + 1;
-		const index_t Nz = m_Size.z + 1;
-		const index_t Y = Nx;
-		const index_t Z = Nx * Ny;
-		real *Ex = m_Ex.data();
-		real *Ey = m_Ey.data();
-		real *Ez = m_Ez.data();
-		if (axis == Axis::X){
-			for (index_t iz = 0; iz < Nz; iz++){
-				for (index_t iy = 0; iy < Ny; iy++){
-					Ex[Mx + Y * iy + Z * iz] = Ex[0 + Y * iy + Z * iz];
-					Ey[0 + Y * iy + Z * iz] = Ey[Mx + Y * iy + Z * iz];
-					Ez[0 + Y * iy + Z * iz] = Ez[Mx + Y * iy + Z * iz];
-				}
-			}
+	// 格納型Tで磁界を計算する
+	template<typename T>
+	void FFSolverCPU::calcHFieldT(void){
+		if (m_Lanes == 1){
+			calcHFieldLanes<T, 0, 1>();
 		}
-		else if (axis == Axis::Y){
-			for (index_t iz = 0; iz < Nz; iz++){
-				for (index_t ix = 0; ix < Nx; ix++){
-					Ex[ix + Y * 0 + Z * iz] = Ex[ix + Y * My + Z * iz];
-					Ey[ix + Y * My + Z * iz] = Ey[ix + Y * 0 + Z * iz];
-					Ez[ix + Y * 0 + Z * iz] = Ez[ix + Y * My + Z * iz];
-				}
-			}
+		else if (m_CoefLanes == 1){
+			calcHFieldLanes<T, 0, 0>();
 		}
-		else if (axis == Axis::Z){
-			memcpy(Ex, Ex + Z * Mz, sizeof(real) * Nx * Ny);
-			memcpy(Ey, Ey + Z * Mz, sizeof(real) * Nx * Ny);
-			memcpy(Ez + Z * Mz, Ez, sizeof(real) * Nx * Ny);
+		else{
+			calcHFieldLanes<T, 1, 0>();
 		}
 	}
 
-	// 端部の磁界を交換する
-	void FFSolverCPU::exchangeEdgeH(Axis axis){
-		const index_t Mx = m_Size.x;
-		const index_t My = m_Size.y;
-		const index_t Mz = m_Size.z;
-		const index_t Nx = m_Size.x + 1;
-		const index_t Ny = m_Size.y + 1;
-		const index_t Nz = m_Size.z + 1;
-		const index_t Y = Nx;
-		const index_t Z = Nx * Ny;
-		real *Hx = m_Hx.data();
-		real *Hy = m_Hy.data();
-		real *Hz = m_Hz.data();
-		if (axis == Axis::X){
-			for (index_t iz = 0; iz < Nz; iz++){
-				for (index_t iy = 0; iy < Ny; iy++){
-					Hx[0 + Y * iy + Z * iz] = Hx[Mx + Y * iy + Z * iz];
-					Hy[Mx + Y * iy + Z * iz] = Hy[0 + Y * iy + Z * iz];
-					Hz[Mx + Y * iy + Z * iz] = Hz[0 + Y * iy + Z * iz];
-				}
-			}
-		}
-		else if (axis == Axis::Y){
-			for (index_t iz = 0; iz < Nz; iz++){
-				for (index_t ix = 0; ix < Nx; ix++){
-					Hx[ix + Y * My + Z * iz] = Hx[ix + Y * 0 + Z * iz];
-					Hy[ix + Y * 0 + Z * iz] = Hy[ix + Y * My + Z * iz];
-					Hz[ix + Y * My + Z * iz] = Hz[ix + Y * 0 + Z * iz];
-				}
-			}
+	// ハードウェアカウンターによるカーネルごとの計測を有効にする
+	void FFSolverCPU::enablePerfCounter(void){
+		if (m_PerfCounter != nullptr){
+			return;
 		}
-		else if (axis == Axis::Z){
-			memcpy(Hx + Z * Mz, Hx, sizeof(real) * Z);
-			memcpy(Hy + Z * Mz, Hy, sizeof(real) * Z);
-			memcpy(Hz, Hz + Z * Mz, sizeof(real) * Z);
+		static const char *KERNEL_NAMES[NUM_OF_PERF_KERNELS] = {
+			"Ex", "Ey", "Ez", "PML Ex", "PML Ey", "PML Ez",
+			"Hx", "Hy", "Hz", "PML Hx", "PML Hy", "PML Hz",
+		};
+		m_PerfCounter = new FFPerfCounter();
+		m_PerfCounter->open((int)getComputeSize(m_Precision));
+		for (int i = 0; i < NUM_OF_PERF_KERNELS; i++){
+			m_PerfCounter->addKernel(KERNEL_NAMES[i]);
 		}
 	}
 
-	// Z端部の電界を取得する
-	void FFSolverCPU::getEdgeE(const real **top_ex, const real **top_ey, const real **bottom_ez) const{
-		const index_t Z = (m_Size.x + 1) * (m_Size.y + 1);
-		if (top_ex != nullptr){
-			*top_ex = m_Ex.data() + Z * m_Size.z;
-		}
-		if (top_ey != nullptr){
-			*top_ey = m_Ey.data() + Z * m_Size.z;
-		}
-		if (bottom_ez != nullptr){
-			*bottom_ez = m_Ez.data();
+	// カーネルごとの計測結果をルーフラインモデルとともに表示し、集計を0にする
+	void FFSolverCPU::printPerfReport(const char *title){
+		if (m_PerfCounter != nullptr){
+			m_PerfCounter->print(title);
+			m_PerfCounter->reset();
 		}
 	}
 
-	// Z端部の電界を設定する
-	void FFSolverCPU::setEdgeE(const real *bottom_ex, const real *bottom_ey, const real *top_ez){
-		const index_t Z = (m_Size.x + 1) * (m_Size.y + 1);
-		if (bottom_ex != nullptr){
-			memcpy(m_Ex.data(), bottom_ex, sizeof(real) * Z);
-		}
-		if (bottom_ey != nullptr){
-			memcpy(m_Ey.data(), bottom_ey, sizeof(real) * Z);
-		}
-		if (top_ez != nullptr){
-			memcpy(m_Ez.data() + Z * m_Size.z, top_ez, sizeof(real) * Z);
+	// カーネルの実装を選択する
+	void FFSolverCPU::setKernelVariant(int variant){
+		if ((variant < 0) || (NUM_OF_KERNEL_VARIANTS <= variant)){
+			throw FFException("Unknown kernel variant %d", variant);
 		}
+		m_KernelConfig.variant = variant;
 	}
 
-	// Z端部の磁界を取得する
-	void FFSolverCPU::getEdgeH(const real **bottom_hx, const real **bottom_hy, const real **top_hz) const{
-		const index_t Z = (m_Size.x + 1) * (m_Size.y + 1);
-		if (bottom_hx != nullptr){
-			*bottom_hx = m_Hx.data();
+	// カーネルの実装の名前を取得する
+	const char* FFSolverCPU::getKernelVariantName(int variant){
+		static const char *VARIANT_NAMES[NUM_OF_KERNEL_VARIANTS] = {
+			"reference", "blocked",
+		};
+		return ((0 <= variant) && (variant < NUM_OF_KERNEL_VARIANTS)) ? VARIANT_NAMES[variant] : "unknown";
+	}
+
+	// カーネルの実装と並列化・ブロッキングの設定を行う
+	void FFSolverCPU::setKernelConfig(const KernelConfig_t &config){
+		if ((config.variant < 0) || (NUM_OF_KERNEL_VARIANTS <= config.variant)){
+			throw FFException("Unknown kernel variant %d", config.variant);
 		}
-		if (bottom_hy != nullptr){
-			*bottom_hy = m_Hy.data();
+		if ((config.schedule < 0) || (NUM_OF_KERNEL_SCHEDULES <= config.schedule)){
+			throw FFException("Unknown kernel schedule %d", config.schedule);
 		}
-		if (top_hz != nullptr){
-			*top_hz = m_Hz.data() + Z * m_Size.z;
+		if ((config.threads < 0) || (config.tile_y < 1) || (config.tile_z < 1) || (config.chunk < 1)){
+			throw FFException("Invalid kernel config (threads=%d, tile=%dx%d, chunk=%d)", config.threads, config.tile_y, config.tile_z, config.chunk);
 		}
+		m_KernelConfig = config;
 	}
 
-	// Z端部の磁界を設定する
-	void FFSolverCPU::setEdgeH(const real *top_hx, const real *top_hy, const real *bottom_hz){
-		const index_t Z = (m_Size.x + 1) * (m_Size.y + 1);
-		if (top_hx != nullptr){
-			memcpy(m_Hx.data() + Z * m_Size.z, top_hx, sizeof(real) * Z);
+	// 既定のカーネルの設定を取得する
+	FFSolverCPU::KernelConfig_t FFSolverCPU::getDefaultKernelConfig(void){
+		KernelConfig_t config;
+		config.variant = KERNEL_REFERENCE;
+		config.threads = 0;
+		config.tile_y = 16;
+		config.tile_z = 4;
+		config.schedule = SCHEDULE_STATIC;
+		config.chunk = 1;
+		return config;
+	}
+
+	// 設定に従ってY・Z方向の範囲をタイル分割する
+	// 基準の実装ではZ方向の1スライスを1タイルとし、ブロッキングした実装ではtile_y×tile_zの行を1タイルとする
+	FFSolverCPU::Tiling_t FFSolverCPU::getTiling(int range_y, int range_z) const{
+		Tiling_t tiling;
+		tiling.tile_y = std::max(range_y, 1);
+		tiling.tile_z = 1;
+		if (m_KernelConfig.variant == KERNEL_BLOCKED){
+			tiling.tile_y = std::max(std::min(m_KernelConfig.tile_y, range_y), 1);
+			tiling.tile_z = m_KernelConfig.tile_z;
 		}
-		if (top_hy != nullptr){
-			memcpy(m_Hy.data() + Z * m_Size.z, top_hy, sizeof(real) * Z);
+		tiling.num_of_tiles_y = (range_y + tiling.tile_y - 1) / tiling.tile_y;
+		tiling.count = tiling.num_of_tiles_y * ((range_z + tiling.tile_z - 1) / tiling.tile_z);
+		tiling.chunk = getChunk(tiling.count);
+		tiling.threads = getThreads();
+		return tiling;
+	}
+
+	// 始点startから範囲range_x×range_y×range_zの計算範囲を活性領域に制限する
+	// 活性領域の外の成分は0のままであるため、制限した範囲の外の更新は省いても結果は変わらない
+	FFSolverCPU::ActiveRange_t FFSolverCPU::getActiveRange(const index3_t &start, int range_x, int range_y, int range_z) const{
+		auto clip = [](index_t start, int range, index_t active_start, index_t active_end, int &r0, int &r1){
+			r0 = std::min(std::max((int)active_start - (int)start, 0), range);
+			r1 = std::max(std::min((int)active_end - (int)start, range), r0);
+		};
+		ActiveRange_t active;
+		clip(start.x, range_x, m_ActiveStart.x, m_ActiveEnd.x, active.x0, active.x1);
+		clip(start.y, range_y, m_ActiveStart.y, m_ActiveEnd.y, active.y0, active.y1);
+		clip(start.z, range_z, m_ActiveStart.z, m_ActiveEnd.z, active.z0, active.z1);
+		return active;
+	}
+
+	// PML空間の直方体のリストを、係数インデックスの等しいX方向に連続したセルの計算区間に分ける
+	// 直方体の行 (X方向) ごとに区間を並べ、行は直方体の順、直方体の中ではZ方向の座標が外側のループとなる順とする
+	FFSolverCPU::PMLRunList_t FFSolverCPU::createPMLRunList(const std::vector<PMLBox_t> &box_list, const cindex_t *normal_cindex) const{
+		const int X = 1;
+		const int Y = m_Size.x + 1;
+		const int Z = (m_Size.x + 1) * (m_Size.y + 1);
+		PMLRunList_t list;
+		for (const PMLBox_t &box : box_list){
+			size_t i = 0;
+			for (index_t rz = 0; rz < box.size.z; rz++){
+				for (index_t ry = 0; ry < box.size.y; ry++){
+					PMLRow_t row;
+					row.x0 = box.start.x;
+					row.x1 = box.start.x + box.size.x;
+					row.y = box.start.y + ry;
+					row.z = box.start.z + rz;
+					row.run_start = (int)list.run_list.size();
+					int index = X * box.start.x + Y * row.y + Z * row.z;
+					for (index_t rx = 0; rx < box.size.x; rx++){
+						const cindex2_t &cindex2 = box.cindex[i];
+						const cindex_t cindex = (normal_cindex != nullptr) ? normal_cindex[index] : 0;
+						if ((0 < rx) && (list.run_list.back().cindex2 == cindex2) && (list.run_list.back().cindex == cindex)){
+							list.run_list.back().count++;
+						}
+						else{
+							PMLRun_t run;
+							run.index = index;
+							run.offset = (int)(box.offset + i);
+							run.count = 1;
+							run.cindex2 = cindex2;
+							run.cindex = cindex;
+							list.run_list.push_back(run);
+						}
+						index++;
+						i++;
+					}
+					row.run_end = (int)list.run_list.size();
+					list.row_list.push_back(row);
+				}
+			}
+		}
+		return list;
+	}
+
+	// 更新しても常に0のままの成分を求め、行ごとの計算区間から除く
+	// 電界は係数が全レーンで0 (PEC) のもののうち、励振で値を書き込まれないものを常に0とする
+	// 磁界は回転で参照する4つの電界が全て常に0のものを常に0とする (初期値が0で、更新で加わる値も0のため)
+	// 電界は通常空間とPML空間で自カーネルが更新する成分だけを判定し、ゴーストは0でないものとして扱う
+	// 常に0の成分だけのPML空間の区間も除き、計算しない行の電磁界成分・分割成分・係数インデックスのページには物理メモリーを割り当てないままとする
+	void FFSolverCPU::updateStaticMask(void){
+		const int X = 1;
+		const int Y = m_Size.x + 1;
+		const int Z = (m_Size.x + 1) * (m_Size.y + 1);
+		const int Ny = m_Size.y + 1;
+		const int Nz = m_Size.z + 1;
+		const size_t Volume = (size_t)Z * (m_Size.z + 1);
+
+		// 通常空間の常に0の電界成分を求める関数
+		auto markNormal = [&](std::vector<uint8_t> &zero, const FFLazyVector<cindex_t> &cindex, const index3_t &start, const index3_t &range){
+#pragma omp parallel for
+			for (int riz = 0; riz < (int)range.z; riz++){
+				for (index_t riy = 0; riy < range.y; riy++){
+					size_t index = X * start.x + Y * (start.y + riy) + Z * (start.z + riz);
+					for (index_t rix = 0; rix < range.x; rix++){
+						zero[index] = m_ZeroCoef3[cindex[index]] ? 1 : 0;
+						index++;
+					}
+				}
+			}
+		};
+
+		// PML空間の常に0の電界成分を求める関数 (PML空間の係数インデックスは2組係数を指す)
+		auto markPML = [&](std::vector<uint8_t> &zero, const FFLazyVector<cindex_t> &cindex, const std::vector<PMLBox_t> &box_list){
+			for (const PMLBox_t &box : box_list){
+#pragma omp parallel for
+				for (int rz = 0; rz < (int)box.size.z; rz++){
+					for (index_t ry = 0; ry < box.size.y; ry++){
+						size_t index = X * box.start.x + Y * (box.start.y + ry) + Z * (box.start.z + rz);
+						for (index_t rx = 0; rx < box.size.x; rx++){
+							zero[index] = m_ZeroCoef2[cindex[index]] ? 1 : 0;
+							index++;
+						}
+					}
+				}
+			}
+		};
+
+		std::vector<uint8_t> zero_ex(Volume, 0), zero_ey(Volume, 0), zero_ez(Volume, 0);
+		markNormal(zero_ex, m_ExCIndex, index3_t(m_StartM.x, m_StartN.y, m_StartN.z), index3_t(m_RangeM.x, m_RangeN.y, m_RangeN.z));
+		markNormal(zero_ey, m_EyCIndex, index3_t(m_StartN.x, m_StartM.y, m_StartN.z), index3_t(m_RangeN.x, m_RangeM.y, m_RangeN.z));
+		markNormal(zero_ez, m_EzCIndex, index3_t(m_StartN.x, m_StartN.y, m_StartM.z), index3_t(m_RangeN.x, m_RangeN.y, m_RangeM.z));
+		markPML(zero_ex, m_ExCIndex, m_PMLDxBoxList);
+		markPML(zero_ey, m_EyCIndex, m_PMLDyBoxList);
+		markPML(zero_ez, m_EzCIndex, m_PMLDzBoxList);
+
+		// ポートが励振する電界は係数によらず0でなくなる
+		for (const Probe_t &probe : m_TDProbeList){
+			switch (probe.type){
+			case EMType::Ex:
+				zero_ex[probe.index] = 0;
+				break;
+			case EMType::Ey:
+				zero_ey[probe.index] = 0;
+				break;
+			case EMType::Ez:
+				zero_ez[probe.index] = 0;
+				break;
+			default:
+				break;
+			}
+		}
+
+		// 行ごとの計算区間を求める
+		const uint8_t *Ex = zero_ex.data();
+		const uint8_t *Ey = zero_ey.data();
+		const uint8_t *Ez = zero_ez.data();
+		m_ExMask = createRowMask(index3_t(m_StartM.x, m_StartN.y, m_StartN.z), m_RangeM.x, m_RangeN.y, m_RangeN.z, Y, Z, MASK_MIN_GAP, [=](int i){
+			return Ex[i] != 0;
+		});
+		m_EyMask = createRowMask(index3_t(m_StartN.x, m_StartM.y, m_StartN.z), m_RangeN.x, m_RangeM.y, m_RangeN.z, Y, Z, MASK_MIN_GAP, [=](int i){
+			return Ey[i] != 0;
+		});
+		m_EzMask = createRowMask(index3_t(m_StartN.x, m_StartN.y, m_StartM.z), m_RangeN.x, m_RangeN.y, m_RangeM.z, Y, Z, MASK_MIN_GAP, [=](int i){
+			return Ez[i] != 0;
+		});
+		auto is_zero_hx = [=](int i){
+			return (Ez[i] != 0) && (Ez[i + Y] != 0) && (Ey[i] != 0) && (Ey[i + Z] != 0);
+		};
+		auto is_zero_hy = [=](int i){
+			return (Ex[i] != 0) && (Ex[i + Z] != 0) && (Ez[i] != 0) && (Ez[i + X] != 0);
+		};
+		auto is_zero_hz = [=](int i){
+			return (Ey[i] != 0) && (Ey[i + X] != 0) && (Ex[i] != 0) && (Ex[i + Y] != 0);
+		};
+		m_HxMask = createRowMask(index3_t(m_StartN.x, m_StartM.y, m_StartM.z), m_RangeN.x, m_RangeM.y, m_RangeM.z, Y, Z, MASK_MIN_GAP, is_zero_hx);
+		m_HyMask = createRowMask(index3_t(m_StartM.x, m_StartN.y, m_StartM.z), m_RangeM.x, m_RangeN.y, m_RangeM.z, Y, Z, MASK_MIN_GAP, is_zero_hy);
+		m_HzMask = createRowMask(index3_t(m_StartM.x, m_StartM.y, m_StartN.z), m_RangeM.x, m_RangeM.y, m_RangeN.z, Y, Z, MASK_MIN_GAP, is_zero_hz);
+
+		// 常に0の成分だけのPML空間・CPML空間の区間を除く
+		// PML空間の電界は通常空間の係数が0のため分割成分によらず0のままとなる
+		// CPMLの電界の補正は補助変数を加えるため、補助変数の係数も0の区間だけを除く
+		auto is_zero_ex = [=](int i){
+			return Ex[i] != 0;
+		};
+		auto is_zero_ey = [=](int i){
+			return Ey[i] != 0;
+		};
+		auto is_zero_ez = [=](int i){
+			return Ez[i] != 0;
+		};
+		m_PMLDxRunList = removeZeroPMLRuns(m_PMLDxRunList, false, is_zero_ex);
+		m_PMLDyRunList = removeZeroPMLRuns(m_PMLDyRunList, false, is_zero_ey);
+		m_PMLDzRunList = removeZeroPMLRuns(m_PMLDzRunList, false, is_zero_ez);
+		m_PMLHxRunList = removeZeroPMLRuns(m_PMLHxRunList, false, is_zero_hx);
+		m_PMLHyRunList = removeZeroPMLRuns(m_PMLHyRunList, false, is_zero_hy);
+		m_PMLHzRunList = removeZeroPMLRuns(m_PMLHzRunList, false, is_zero_hz);
+		m_CPMLExRunList = removeZeroPMLRuns(m_CPMLExRunList, true, is_zero_ex);
+		m_CPMLEyRunList = removeZeroPMLRuns(m_CPMLEyRunList, true, is_zero_ey);
+		m_CPMLEzRunList = removeZeroPMLRuns(m_CPMLEzRunList, true, is_zero_ez);
+		m_CPMLHxRunList = removeZeroPMLRuns(m_CPMLHxRunList, false, is_zero_hx);
+		m_CPMLHyRunList = removeZeroPMLRuns(m_CPMLHyRunList, false, is_zero_hy);
+		m_CPMLHzRunList = removeZeroPMLRuns(m_CPMLHzRunList, false, is_zero_hz);
+
+		// 値が0でなくなりうる行を求める
+		// 計算区間・4次精度の補正の区間・PML空間の区間・ポートが励振する観測点を含む行と、端部の交換と周期境界のゴーストで書き込まれるY・Z方向の端の行とする
+		// HIE法ではZ方向の方程式で全ての成分を更新するため、全ての行とする
+		auto markLiveRows = [&](std::vector<uint8_t> &live, const index3_t &start, const index3_t &range, const RowMask_t &mask, const RowMask_t &high_order_mask, const PMLRunList_t &pml, const PMLRunList_t &cpml){
+			live.assign((size_t)Ny * Nz, m_ImplicitZ ? 1 : 0);
+			for (int iz = 0; iz < Nz; iz++){
+				live[Ny * iz] = 1;
+				live[(Ny - 1) + Ny * iz] = 1;
+			}
+			for (int iy = 0; iy < Ny; iy++){
+				live[iy] = 1;
+				live[iy + Ny * (Nz - 1)] = 1;
+			}
+			for (int row = 0; row < (int)(range.y * range.z); row++){
+				if ((mask.row_start[row] < mask.row_start[row + 1]) || (high_order_mask.row_start[row] < high_order_mask.row_start[row + 1])){
+					live[(start.y + row % range.y) + Ny * (start.z + row / range.y)] = 1;
+				}
+			}
+			for (const PMLRow_t &row : pml.row_list){
+				live[row.y + Ny * row.z] = 1;
+			}
+			for (const PMLRow_t &row : cpml.row_list){
+				live[row.y + Ny * row.z] = 1;
+			}
+		};
+		markLiveRows(m_ExLiveRow, index3_t(m_StartM.x, m_StartN.y, m_StartN.z), index3_t(m_RangeM.x, m_RangeN.y, m_RangeN.z), m_ExMask, m_ExHighOrderMask, m_PMLDxRunList, m_CPMLExRunList);
+		markLiveRows(m_EyLiveRow, index3_t(m_StartN.x, m_StartM.y, m_StartN.z), index3_t(m_RangeN.x, m_RangeM.y, m_RangeN.z), m_EyMask, m_EyHighOrderMask, m_PMLDyRunList, m_CPMLEyRunList);
+		markLiveRows(m_EzLiveRow, index3_t(m_StartN.x, m_StartN.y, m_StartM.z), index3_t(m_RangeN.x, m_RangeN.y, m_RangeM.z), m_EzMask, m_EzHighOrderMask, m_PMLDzRunList, m_CPMLEzRunList);
+		markLiveRows(m_HxLiveRow, index3_t(m_StartN.x, m_StartM.y, m_StartM.z), index3_t(m_RangeN.x, m_RangeM.y, m_RangeM.z), m_HxMask, m_HxHighOrderMask, m_PMLHxRunList, m_CPMLHxRunList);
+		markLiveRows(m_HyLiveRow, index3_t(m_StartM.x, m_StartN.y, m_StartM.z), index3_t(m_RangeM.x, m_RangeN.y, m_RangeM.z), m_HyMask, m_HyHighOrderMask, m_PMLHyRunList, m_CPMLHyRunList);
+		markLiveRows(m_HzLiveRow, index3_t(m_StartM.x, m_StartM.y, m_StartN.z), index3_t(m_RangeM.x, m_RangeM.y, m_RangeN.z), m_HzMask, m_HzHighOrderMask, m_PMLHzRunList, m_CPMLHzRunList);
+		for (const Probe_t &probe : m_TDProbeList){
+			getLiveRow(probe.type)[probe.index / Y] = 1;
+		}
+
+		// 係数インデックスは計算区間と4次精度の補正の区間の成分だけを残し、他は0とする
+		// 新しい配列には残す成分だけを書き込むため、計算しない行のページには物理メモリーを割り当てない
+		// HIE法ではZ方向の方程式で全ての成分の係数を参照するため残す
+		auto compactCIndex = [&](FFLazyVector<cindex_t> &cindex, const index3_t &start, const index3_t &range, const RowMask_t &mask, const RowMask_t &high_order_mask){
+			FFLazyVector<cindex_t> result;
+			assignLazyZero(result, cindex.size());
+			const int Rows = (int)(range.y * range.z);
+#pragma omp parallel for
+			for (int row = 0; row < Rows; row++){
+				const size_t offset = X * start.x + Y * (start.y + row % range.y) + Z * (start.z + row / range.y);
+				for (const RowMask_t *m : {&mask, &high_order_mask}){
+					for (int n = m->row_start[row]; n < m->row_start[row + 1]; n++){
+						const RowSpan_t &span = m->span_list[n];
+						std::copy(cindex.begin() + offset + span.x0, cindex.begin() + offset + span.x1, result.begin() + offset + span.x0);
+					}
+				}
+			}
+			cindex.swap(result);
+		};
+		if (m_ImplicitZ == false){
+			compactCIndex(m_ExCIndex, index3_t(m_StartM.x, m_StartN.y, m_StartN.z), index3_t(m_RangeM.x, m_RangeN.y, m_RangeN.z), m_ExMask, m_ExHighOrderMask);
+			compactCIndex(m_EyCIndex, index3_t(m_StartN.x, m_StartM.y, m_StartN.z), index3_t(m_RangeN.x, m_RangeM.y, m_RangeN.z), m_EyMask, m_EyHighOrderMask);
+			compactCIndex(m_EzCIndex, index3_t(m_StartN.x, m_StartN.y, m_StartM.z), index3_t(m_RangeN.x, m_RangeN.y, m_RangeM.z), m_EzMask, m_EzHighOrderMask);
+			compactCIndex(m_HxCIndex, index3_t(m_StartN.x, m_StartM.y, m_StartM.z), index3_t(m_RangeN.x, m_RangeM.y, m_RangeM.z), m_HxMask, m_HxHighOrderMask);
+			compactCIndex(m_HyCIndex, index3_t(m_StartM.x, m_StartN.y, m_StartM.z), index3_t(m_RangeM.x, m_RangeN.y, m_RangeM.z), m_HyMask, m_HyHighOrderMask);
+			compactCIndex(m_HzCIndex, index3_t(m_StartM.x, m_StartM.y, m_StartN.z), index3_t(m_RangeM.x, m_RangeM.y, m_RangeN.z), m_HzMask, m_HzHighOrderMask);
+		}
+	}
+
+	// PML空間の区間のリストから、全てのセルでis_zeroがtrueとなる区間を除く
+	// zero_coefがtrueのときは、分割成分・補助変数の2組の係数がともに全レーンで0の区間だけを除く
+	template<typename F>
+	FFSolverCPU::PMLRunList_t FFSolverCPU::removeZeroPMLRuns(const PMLRunList_t &list, bool zero_coef, F is_zero) const{
+		PMLRunList_t result;
+		for (const PMLRow_t &row : list.row_list){
+			PMLRow_t new_row = row;
+			new_row.run_start = (int)result.run_list.size();
+			for (int n = row.run_start; n < row.run_end; n++){
+				const PMLRun_t &run = list.run_list[n];
+				bool removable = !zero_coef || (m_ZeroCoef2[run.cindex2.x] && m_ZeroCoef2[run.cindex2.y]);
+				for (int c = 0; removable && (c < run.count); c++){
+					removable = is_zero(run.index + c);
+				}
+				if (removable == false){
+					result.run_list.push_back(run);
+				}
+			}
+			new_row.run_end = (int)result.run_list.size();
+			if (new_row.run_start < new_row.run_end){
+				result.row_list.push_back(new_row);
+			}
+		}
+		return result;
+	}
+
+	// 成分typeの行ごとの値が0でなくなりうるかのフラグを取得する
+	std::vector<uint8_t>& FFSolverCPU::getLiveRow(EMType type){
+		switch (type){
+		case EMType::Ex:
+			return m_ExLiveRow;
+		case EMType::Ey:
+			return m_EyLiveRow;
+		case EMType::Ez:
+			return m_EzLiveRow;
+		case EMType::Hx:
+			return m_HxLiveRow;
+		case EMType::Hy:
+			return m_HyLiveRow;
+		default:
+			return m_HzLiveRow;
+		}
+	}
+
+	// 指定した軸方向の電界のうち、4次精度の差分で補正する成分を格納し、磁界の補正する成分を求め直す
+	// 磁界の補正は電界の補正の転置とするため、差分の方向に隣り合う2つの補正する電界成分を差分の4点で参照する成分を全て補正する
+	// 補正しない成分を区間に含めると結果が変わるため、行の途中の隙間は1成分でも除く
+	void FFSolverCPU::storeHighOrderMask(Axis axis, const std::vector<uint8_t> &mask){
+		const int X = 1;
+		const int Y = m_Size.x + 1;
+		const int Z = (m_Size.x + 1) * (m_Size.y + 1);
+		if (mask.size() != (size_t)Z * (m_Size.z + 3)){
+			throw FFException("High-order mask has %u elements (expected %u)", (unsigned int)mask.size(), (unsigned int)Z * (m_Size.z + 3));
+		}
+		const uint8_t *M = mask.data() + Z;
+		auto is_zero = [=](int i){
+			return M[i] == 0;
+		};
+		switch (axis){
+		case Axis::X:
+			m_ExHighOrderFlag = mask;
+			m_ExHighOrderMask = createRowMask(index3_t(m_StartM.x, m_StartN.y, m_StartN.z), m_RangeM.x, m_RangeN.y, m_RangeN.z, Y, Z, 1, is_zero);
+			break;
+		case Axis::Y:
+			m_EyHighOrderFlag = mask;
+			m_EyHighOrderMask = createRowMask(index3_t(m_StartN.x, m_StartM.y, m_StartN.z), m_RangeN.x, m_RangeM.y, m_RangeN.z, Y, Z, 1, is_zero);
+			break;
+		case Axis::Z:
+			m_EzHighOrderFlag = mask;
+			m_EzHighOrderMask = createRowMask(index3_t(m_StartN.x, m_StartN.y, m_StartM.z), m_RangeN.x, m_RangeN.y, m_RangeM.z, Y, Z, 1, is_zero);
+			break;
+		}
+
+		// 磁界の前進差分が参照する電界成分 (相対位置-1〜+2) のうち、隣り合う2つのフラグがともに0でない組がある成分を補正する
+		const uint8_t *Fx = m_ExHighOrderFlag.data() + Z;
+		const uint8_t *Fy = m_EyHighOrderFlag.data() + Z;
+		const uint8_t *Fz = m_EzHighOrderFlag.data() + Z;
+		auto is_unused = [](const uint8_t *F, int i, int S){
+			return !(F[i - S] && F[i]) && !(F[i] && F[i + S]) && !(F[i + S] && F[i + 2 * S]);
+		};
+		m_HxHighOrderMask = createRowMask(index3_t(m_StartN.x, m_StartM.y, m_StartM.z), m_RangeN.x, m_RangeM.y, m_RangeM.z, Y, Z, 1, [=](int i){
+			return is_unused(Fz, i, Y) && is_unused(Fy, i, Z);
+		});
+		m_HyHighOrderMask = createRowMask(index3_t(m_StartM.x, m_StartN.y, m_StartM.z), m_RangeM.x, m_RangeN.y, m_RangeM.z, Y, Z, 1, [=](int i){
+			return is_unused(Fx, i, Z) && is_unused(Fz, i, X);
+		});
+		m_HzHighOrderMask = createRowMask(index3_t(m_StartM.x, m_StartM.y, m_StartN.z), m_RangeM.x, m_RangeM.y, m_RangeN.z, Y, Z, 1, [=](int i){
+			return is_unused(Fy, i, X) && is_unused(Fx, i, Y);
+		});
+	}
+
+	// 範囲range_x×range_y×range_zの計算範囲の全体を計算する行ごとの計算区間を作成する
+	FFSolverCPU::RowMask_t FFSolverCPU::createFullRowMask(int range_x, int range_y, int range_z){
+		const int Rows = range_y * range_z;
+		RowMask_t mask;
+		mask.row_start.resize(Rows + 1);
+		for (int row = 0; row <= Rows; row++){
+			mask.row_start[row] = row;
+		}
+		mask.span_list.assign(Rows, RowSpan_t{0, range_x});
+		return mask;
+	}
+
+	// 始点startから範囲range_x×range_y×range_zの計算範囲について、is_zeroがtrueの成分を除いた行ごとの計算区間を作成する
+	// is_zeroには成分の位置のインデックス (レーンを含めない) を渡す
+	// 行の途中でis_zeroがtrueの成分はmin_gap個以上連続するときだけ除く
+	template<typename F>
+	FFSolverCPU::RowMask_t FFSolverCPU::createRowMask(const index3_t &start, int range_x, int range_y, int range_z, int stride_y, int stride_z, int min_gap, F is_zero){
+		const int Rows = range_y * range_z;
+		std::vector<std::vector<RowSpan_t>> row_list(Rows);
+#pragma omp parallel for
+		for (int row = 0; row < Rows; row++){
+			const int offset = start.x + stride_y * (start.y + row % range_y) + stride_z * (start.z + row / range_y);
+			std::vector<RowSpan_t> &span_list = row_list[row];
+			int rx = 0;
+			while (rx < range_x){
+				// 次の計算する成分まで進める
+				while ((rx < range_x) && is_zero(offset + rx)){
+					rx++;
+				}
+				if (range_x <= rx){
+					break;
+				}
+
+				// 短い隙間は区間に含めて、min_gap個以上連続する除く成分の手前までを区間とする
+				RowSpan_t span{rx, rx};
+				int gap = 0;
+				for (; (rx < range_x) && (gap < min_gap); rx++){
+					gap = is_zero(offset + rx) ? (gap + 1) : 0;
+					if (gap == 0){
+						span.x1 = rx + 1;
+					}
+				}
+				span_list.push_back(span);
+			}
+		}
+
+		// 行ごとの区間を連結する
+		RowMask_t mask;
+		mask.row_start.resize(Rows + 1);
+		mask.row_start[0] = 0;
+		for (int row = 0; row < Rows; row++){
+			mask.row_start[row + 1] = mask.row_start[row] + (int)row_list[row].size();
+			mask.span_list.insert(mask.span_list.end(), row_list[row].begin(), row_list[row].end());
+		}
+		return mask;
+	}
+
+	// 並列ループのスレッド数を取得する
+	int FFSolverCPU::getThreads(void) const{
+#ifdef _OPENMP
+		return (0 < m_KernelConfig.threads) ? m_KernelConfig.threads : omp_get_max_threads();
+#else
+		return 1;
+#endif
+	}
+
+	// count回の並列ループで1スレッドが一度に取るチャンクサイズを取得する
+	// OpenMP 2.0ではスケジューリングを実行時に変えられないため、ループは常にdynamicとし、
+	// SCHEDULE_STATICではスレッドごとに1チャンクずつ等分する大きさにする
+	int FFSolverCPU::getChunk(int count) const{
+		if (m_KernelConfig.schedule == SCHEDULE_STATIC){
+			int threads = getThreads();
+			return std::max((count + threads - 1) / threads, 1);
+		}
+		return std::max(m_KernelConfig.chunk, 1);
+	}
+
+	// 現在の空間のサイズに対してカーネルの設定を調整し、結果をキャッシュに保存する
+	// 電磁界が0の状態 (構成した直後) で呼び出すこと
+	std::string FFSolverCPU::autotune(FFTuneCache &cache){
+		static const char *SCHEDULE_NAMES[NUM_OF_KERNEL_SCHEDULES] = {
+			"static", "dynamic",
+		};
+
+		// CPUの名前をセクション、空間のサイズとレーン数と精度をキーとする
+		std::string section = getName();
+		size_t first = section.find_first_not_of(" \t");
+		size_t last = section.find_last_not_of(" \t");
+		section = (first != std::string::npos) ? section.substr(first, last - first + 1) : std::string("Generic CPU");
+		static const char *PRECISION_NAMES[] = {
+			"F32", "F64", "F16", "BF16",
+		};
+		char key[64];
+		snprintf(key, sizeof(key), "%ux%ux%u_L%u_%s", m_Size.x, m_Size.y, m_Size.z, m_Lanes, PRECISION_NAMES[(int)m_Precision]);
+
+		// キャッシュに結果があればそれを使う
+		std::string value;
+		bool cached = false;
+		if (cache.find(section, key, &value) == true){
+			KernelConfig_t config;
+			int count = sscanf(value.c_str(), "%d %d %d %d %d %d", &config.variant, &config.threads, &config.tile_y, &config.tile_z, &config.schedule, &config.chunk);
+			if (count == 6){
+				try{
+					setKernelConfig(config);
+					cached = true;
+				}
+				catch (FFException&){
+					// 読めないエントリーは調整し直して上書きする
+				}
+			}
+		}
+
+		if (cached == false){
+			// 調整の間は計測と集計を止める
+			FFTelemetry *telemetry = m_Telemetry;
+			FFPerfCounter *perf_counter = m_PerfCounter;
+			m_Telemetry = nullptr;
+			m_PerfCounter = nullptr;
+
+			KernelConfig_t best = getDefaultKernelConfig();
+#ifdef _OPENMP
+			const int MaxThreads = omp_get_max_threads();
+#else
+			const int MaxThreads = 1;
+#endif
+			best.threads = MaxThreads;
+			setKernelConfig(best);
+			double best_time = measureStepTime();
+
+			// 候補を計測し、速ければ採用する
+			auto evaluate = [&](const KernelConfig_t &config){
+				setKernelConfig(config);
+				double time = measureStepTime();
+				if (time < best_time){
+					best_time = time;
+					best = config;
+				}
+			};
+
+			// ブロッキングしたときのタイルの大きさを探す
+			// タイルが空間の範囲を覆った後の大きさは試さない
+			const int MaxY = (int)std::max(m_RangeM.y, m_RangeN.y);
+			const int MaxZ = (int)std::max(m_RangeM.z, m_RangeN.z);
+			static const int TILE_Y_LIST[] = {4, 8, 16, 32, 64};
+			static const int TILE_Z_LIST[] = {1, 4, 16};
+			for (int tile_z : TILE_Z_LIST){
+				for (int tile_y : TILE_Y_LIST){
+					KernelConfig_t config = best;
+					config.variant = KERNEL_BLOCKED;
+					config.tile_y = tile_y;
+					config.tile_z = tile_z;
+					evaluate(config);
+					if (MaxY <= tile_y){
+						break;
+					}
+				}
+				if (MaxZ <= tile_z){
+					break;
+				}
+			}
+
+			// スケジューリングを探す
+			static const struct{
+				int schedule, chunk;
+			} SCHEDULE_LIST[] = {
+				{SCHEDULE_DYNAMIC, 1}, {SCHEDULE_DYNAMIC, 2}, {SCHEDULE_DYNAMIC, 4}, {SCHEDULE_DYNAMIC, 16},
+			};
+			for (auto &candidate : SCHEDULE_LIST){
+				KernelConfig_t config = best;
+				config.schedule = candidate.schedule;
+				config.chunk = candidate.chunk;
+				evaluate(config);
+			}
+
+			// スレッド数を探す (メモリー帯域で律速するときは全スレッドより少ない方が速いことがある)
+			for (int threads = 1; threads < MaxThreads; threads *= 2){
+				KernelConfig_t config = best;
+				config.threads = threads;
+				evaluate(config);
+			}
+
+			setKernelConfig(best);
+			m_Telemetry = telemetry;
+			m_PerfCounter = perf_counter;
+
+			char buf[64];
+			snprintf(buf, sizeof(buf), "%d %d %d %d %d %d", best.variant, best.threads, best.tile_y, best.tile_z, best.schedule, best.chunk);
+			cache.store(section, key, buf);
+		}
+
+		char result[256];
+		const KernelConfig_t &config = m_KernelConfig;
+		snprintf(result, sizeof(result), "%s %s: variant=%s threads=%d tile=%dx%d schedule=%s,%d (%s)",
+			section.c_str(), key, getKernelVariantName(config.variant), config.threads, config.tile_y, config.tile_z,
+			SCHEDULE_NAMES[config.schedule], config.chunk, (cached == true) ? "cached" : "tuned");
+		return std::string(result);
+	}
+
+	// 電界と磁界の計算1ステップの処理時間[s]を計測する
+	// 1回空回しした後、最短回数と最短時間の両方を満たすまで繰り返して平均する
+	double FFSolverCPU::measureStepTime(void){
+		calcEField();
+		calcHField();
+		int count = 0;
+		double start = FFTelemetry::now();
+		double elapsed;
+		do{
+			calcEField();
+			calcHField();
+			count++;
+			elapsed = FFTelemetry::now() - start;
+		} while ((count < TUNE_MIN_REPS) || (elapsed < TUNE_MIN_TIME));
+		return elapsed / count;
+	}
+
+	// 電磁界成分の配列を取得する
+	void* FFSolverCPU::getFieldData(EMType type){
+		switch (m_Precision){
+		case Precision::Double:
+			return getFieldDataT<double>(type);
+		case Precision::Half:
+			return getFieldDataT<half_t>(type);
+		case Precision::BFloat16:
+			return getFieldDataT<bfloat16_t>(type);
+		default:
+			return getFieldDataT<float>(type);
+		}
+	}
+
+	// 格納型Tの電磁界成分の配列を取得する
+	template<typename T>
+	void* FFSolverCPU::getFieldDataT(EMType type){
+		Fields_t<T> &fields = getFields<T>();
+		switch (type){
+		case EMType::Ex:
+			return fields.ex.data() + fields.e_origin;
+		case EMType::Ey:
+			return fields.ey.data() + fields.e_origin;
+		case EMType::Ez:
+			return fields.ez.data() + fields.e_origin;
+		case EMType::Hx:
+			return fields.hx.data() + fields.h_origin;
+		case EMType::Hy:
+			return fields.hy.data() + fields.h_origin;
+		case EMType::Hz:
+			return fields.hz.data() + fields.h_origin;
+		}
+		return nullptr;
+	}
+
+	// デバッグ用に指定した成分・座標の値を取得する
+	double FFSolverCPU::getValueDebug(EMType type, index_t x, index_t y, index_t z, index_t lane) const{
+		const index_t Y = m_Size.x + 1;
+		const index_t Z = (m_Size.x + 1) * (m_Size.y + 1);
+		const size_t index = (size_t)(x + Y * y + Z * z) * m_Lanes + lane;
+		const void *field = getFieldData(type);
+		switch (m_Precision){
+		case Precision::Double:
+			return ((const double*)field)[index];
+		case Precision::Half:
+			return ((const half_t*)field)[index];
+		case Precision::BFloat16:
+			return ((const bfloat16_t*)field)[index];
+		default:
+			return ((const float*)field)[index];
+		}
+	}
+
+	// カーネルの計測結果をモデル上の演算数・転送量とともに加算する
+	// 演算数は更新式の加減乗算を数え、転送量はestimateBytesPerStep()と同じく各成分を1回ずつ読み書きするものとする
+	void FFSolverCPU::recordKernel(PerfKernel kernel, uint64_t count){
+		bool is_pml = ((PERF_PML_EX <= kernel) && (kernel <= PERF_PML_EZ)) || (PERF_PML_HX <= kernel);
+		const double RealSize = (double)getRealSize(m_Precision);
+		const double ComputeSize = (double)getComputeSize(m_Precision);
+		double flop, bytes;
+		if (is_pml == false){
+			flop = 7.0;
+			bytes = 4.0 * RealSize * m_Lanes + sizeof(cindex_t);
+		}
+		else{
+			flop = (kernel <= PERF_PML_EZ) ? 14.0 : 9.0;
+			bytes = (4.0 * RealSize + 4.0 * ComputeSize) * m_Lanes + sizeof(cindex2_t) + sizeof(cindex_t);
+		}
+		uint64_t cells = count * m_Lanes;
+		m_PerfCounter->end(kernel, cells, flop * cells, bytes * count);
+	}
+
+	// 並列領域の中で、PML空間の行のうち活性領域に重なるものを分担して計算する
+	// 行の中ではX方向に活性領域を制限しない (区間ごとの範囲の制限でループが遅くなるため)
+	// 区間の係数は1度だけ読み出し、CSが0のときは区間の全レーンの成分を1つの連続したループで計算する
+	template<typename V, int CS, int LN, typename F>
+	void FFSolverCPU::updatePMLRuns(const PMLRunList_t &list, const V *coef2_list, F update) const{
+		const PMLRow_t *RowList = list.row_list.data();
+		const PMLRun_t *RunList = list.run_list.data();
+		const int NumOfRows = (int)list.row_list.size();
+		const int L = (LN == 0) ? m_Lanes : LN;
+		const int CL = (CS == 0) ? 1 : m_CoefLanes;
+		const index3_t ActiveStart = m_ActiveStart;
+		const index3_t ActiveEnd = m_ActiveEnd;
+#pragma omp for schedule(dynamic, getChunk(NumOfRows)) nowait
+		for (int r = 0; r < NumOfRows; r++){
+			const PMLRow_t &row = RowList[r];
+			if ((row.y < ActiveStart.y) || (ActiveEnd.y <= row.y) || (row.z < ActiveStart.z) || (ActiveEnd.z <= row.z)){
+				continue;
+			}
+			if ((row.x1 <= ActiveStart.x) || (ActiveEnd.x <= row.x0)){
+				continue;
+			}
+			for (int n = row.run_start; n < row.run_end; n++){
+				const PMLRun_t &run = RunList[n];
+				const ptrdiff_t J = (ptrdiff_t)run.index * L;
+				const ptrdiff_t S = (ptrdiff_t)run.offset * L;
+				const V *coef1 = &coef2_list[run.cindex2.x * CL];
+				const V *coef2 = &coef2_list[run.cindex2.y * CL];
+				const V *coef3 = &coef2_list[run.cindex * CL];
+				if (CS == 0){
+					const V c1 = coef1[0], c2 = coef2[0], c3 = coef3[0];
+					for (ptrdiff_t m = 0; m < (ptrdiff_t)run.count * L; m++){
+						update(J + m, S + m, c1, c2, c3);
+					}
+				}
+				else{
+					for (int c = 0; c < run.count; c++){
+						FFFDTD_SIMD
+						for (int k = 0; k < L; k++){
+							const ptrdiff_t m = (ptrdiff_t)c * L + k;
+							update(J + m, S + m, coef1[k], coef2[k], coef3[k]);
+						}
+					}
+				}
+			}
+		}
+	}
+
+	// 並列領域を開いてPML空間の計算updateを呼び出し、カーネルとして計測する
+	template<typename F>
+	void FFSolverCPU::runPMLKernel(PerfKernel kernel, uint64_t count, F update){
+		beginKernel();
+		if (0 < count){
+#pragma omp parallel num_threads(getThreads())
+			update();
+		}
+		endKernel(kernel, count);
+	}
+
+	// 格納型Tと係数リストのレーン間のストライドCS、レーン数LNを指定して電界を計算する
+	// 電磁界成分はセルごとにレーンが連続しているため、CSが0のとき係数の読み出しはレーン間で共有される
+	// CSが1のときは係数リストがレーンごとの値を持ち、係数もレーンごとに連続して読み出す
+	// LNが0のときはレーン数が実行時に決まるため、レーンのループをSIMD化する (LNが1のときはレーンのループがなくなる)
+	template<typename T, int CS, int LN>
+	void FFSolverCPU::calcEFieldLanes(void){
+		using C = typename Fields_t<T>::compute_t;
+		using vec2_t = typename Fields_t<T>::vec2_t;
+		using vec3_t = typename Fields_t<T>::vec3_t;
+		Fields_t<T> &fields = getFields<T>();
+		const vec2_t *Coef2List = fields.coef2_list.data();
+		const vec3_t *Coef3List = fields.coef3_list.data();
+		const cindex_t *ExCIndex = m_ExCIndex.data();
+		const cindex_t *EyCIndex = m_EyCIndex.data();
+		const cindex_t *EzCIndex = m_EzCIndex.data();
+		const int *ExRowStart = m_ExMask.row_start.data();
+		const RowSpan_t *ExSpanList = m_ExMask.span_list.data();
+		const int *EyRowStart = m_EyMask.row_start.data();
+		const RowSpan_t *EySpanList = m_EyMask.span_list.data();
+		const int *EzRowStart = m_EzMask.row_start.data();
+		const RowSpan_t *EzSpanList = m_EzMask.span_list.data();
+		T *Ex = fields.ex.data() + fields.e_origin;
+		T *Ey = fields.ey.data() + fields.e_origin;
+		T *Ez = fields.ez.data() + fields.e_origin;
+		const T *Hx = fields.hx.data() + fields.h_origin;
+		const T *Hy = fields.hy.data() + fields.h_origin;
+		const T *Hz = fields.hz.data() + fields.h_origin;
+		const int L = (LN == 0) ? m_Lanes : LN;
+		const int CL = (CS == 0) ? 1 : m_CoefLanes;
+		const int X = 1;
+		const int Y = m_Size.x + 1;
+		const int Z = (m_Size.x + 1) * (m_Size.y + 1);
+		const ptrdiff_t XL = (ptrdiff_t)X * L;
+		const ptrdiff_t YL = (ptrdiff_t)Y * L;
+		const ptrdiff_t ZL = (ptrdiff_t)Z * L;
+		const int RangeMx = m_RangeM.x;
+		const int RangeMy = m_RangeM.y;
+		const int RangeMz = m_RangeM.z;
+		const int RangeNx = m_RangeN.x;
+		const int RangeNy = m_RangeN.y;
+		const int RangeNz = m_RangeN.z;
+		const int ExOffset = X * m_StartM.x + Y * m_StartN.y + Z * m_StartN.z;
+		const int EyOffset = X * m_StartN.x + Y * m_StartM.y + Z * m_StartN.z;
+		const int EzOffset = X * m_StartN.x + Y * m_StartN.y + Z * m_StartM.z;
+
+		// 除外されたカーネルはZ方向の範囲を0として飛ばす
+		const int ExRangeZ = isKernelEnabled(PERF_EX) ? RangeNz : 0;
+		const int EyRangeZ = isKernelEnabled(PERF_EY) ? RangeNz : 0;
+		const int EzRangeZ = isKernelEnabled(PERF_EZ) ? RangeMz : 0;
+
+		// HIE法では更新前のEx・Eyを保持し、全ての計算の後で増分を補正する
+		if (m_ImplicitZ){
+			copyImplicitPrev(Ex, Ey);
+		}
+
+		// 通常空間とPML空間の処理時間をそれぞれ計測する
+		double kernel_start = (m_Telemetry != nullptr) ? FFTelemetry::now() : 0.0;
+
+		// Dx,Exを計算する
+		beginKernel();
+		const Tiling_t ExTiling = getTiling(RangeNy, ExRangeZ);
+		const ActiveRange_t ExActive = getActiveRange(index3_t(m_StartM.x, m_StartN.y, m_StartN.z), RangeMx, RangeNy, ExRangeZ);
+#pragma omp parallel for schedule(dynamic, ExTiling.chunk) num_threads(ExTiling.threads)
+		for (int tile = 0; tile < ExTiling.count; tile++){
+			const int TileY = (tile % ExTiling.num_of_tiles_y) * ExTiling.tile_y;
+			const int TileZ = (tile / ExTiling.num_of_tiles_y) * ExTiling.tile_z;
+			const int StartY = std::max(TileY, ExActive.y0);
+			const int StartZ = std::max(TileZ, ExActive.z0);
+			const int EndY = std::min(TileY + ExTiling.tile_y, ExActive.y1);
+			const int EndZ = std::min(TileZ + ExTiling.tile_z, ExActive.z1);
+			for (int riz = StartZ; riz < EndZ; riz++){
+				for (int riy = StartY; riy < EndY; riy++){
+					const int Row = riy + RangeNy * riz;
+					for (int span = ExRowStart[Row]; span < ExRowStart[Row + 1]; span++){
+						const int StartX = std::max(ExSpanList[span].x0, ExActive.x0);
+						const int EndX = std::min(ExSpanList[span].x1, ExActive.x1);
+						int index = ExOffset + X * StartX + Y * riy + Z * riz;
+						for (int rix = StartX; rix < EndX; rix++){
+							const vec3_t *coef = &Coef3List[ExCIndex[index] * CL];
+							const ptrdiff_t i = (ptrdiff_t)index * L;
+							FFFDTD_SIMD
+							for (int k = 0; k < L; k++){
+								const ptrdiff_t j = i + k;
+								Ex[j]
+									= coef[k * CS].x * Ex[j]
+									+ coef[k * CS].y * (Hz[j] - Hz[j - YL])
+									- coef[k * CS].z * (Hy[j] - Hy[j - ZL]);
+							}
+							index++;
+						}
+					}
+				}
+			}
+		}
+		endKernel(PERF_EX, (uint64_t)RangeMx * RangeNy * ExRangeZ);
+
+		// Dy,Eyを計算する
+		beginKernel();
+		const Tiling_t EyTiling = getTiling(RangeMy, EyRangeZ);
+		const ActiveRange_t EyActive = getActiveRange(index3_t(m_StartN.x, m_StartM.y, m_StartN.z), RangeNx, RangeMy, EyRangeZ);
+#pragma omp parallel for schedule(dynamic, EyTiling.chunk) num_threads(EyTiling.threads)
+		for (int tile = 0; tile < EyTiling.count; tile++){
+			const int TileY = (tile % EyTiling.num_of_tiles_y) * EyTiling.tile_y;
+			const int TileZ = (tile / EyTiling.num_of_tiles_y) * EyTiling.tile_z;
+			const int StartY = std::max(TileY, EyActive.y0);
+			const int StartZ = std::max(TileZ, EyActive.z0);
+			const int EndY = std::min(TileY + EyTiling.tile_y, EyActive.y1);
+			const int EndZ = std::min(TileZ + EyTiling.tile_z, EyActive.z1);
+			for (int riz = StartZ; riz < EndZ; riz++){
+				for (int riy = StartY; riy < EndY; riy++){
+					const int Row = riy + RangeMy * riz;
+					for (int span = EyRowStart[Row]; span < EyRowStart[Row + 1]; span++){
+						const int StartX = std::max(EySpanList[span].x0, EyActive.x0);
+						const int EndX = std::min(EySpanList[span].x1, EyActive.x1);
+						int index = EyOffset + X * StartX + Y * riy + Z * riz;
+						for (int rix = StartX; rix < EndX; rix++){
+							const vec3_t *coef = &Coef3List[EyCIndex[index] * CL];
+							const ptrdiff_t i = (ptrdiff_t)index * L;
+							FFFDTD_SIMD
+							for (int k = 0; k < L; k++){
+								const ptrdiff_t j = i + k;
+								Ey[j]
+									= coef[k * CS].x * Ey[j]
+									+ coef[k * CS].y * (Hx[j] - Hx[j - ZL])
+									- coef[k * CS].z * (Hz[j] - Hz[j - XL]);
+							}
+							index++;
+						}
+					}
+				}
+			}
+		}
+		endKernel(PERF_EY, (uint64_t)RangeNx * RangeMy * EyRangeZ);
+
+		// Dz,Ezを計算する
+		beginKernel();
+		const Tiling_t EzTiling = getTiling(RangeNy, EzRangeZ);
+		const ActiveRange_t EzActive = getActiveRange(index3_t(m_StartN.x, m_StartN.y, m_StartM.z), RangeNx, RangeNy, EzRangeZ);
+#pragma omp parallel for schedule(dynamic, EzTiling.chunk) num_threads(EzTiling.threads)
+		for (int tile = 0; tile < EzTiling.count; tile++){
+			const int TileY = (tile % EzTiling.num_of_tiles_y) * EzTiling.tile_y;
+			const int TileZ = (tile / EzTiling.num_of_tiles_y) * EzTiling.tile_z;
+			const int StartY = std::max(TileY, EzActive.y0);
+			const int StartZ = std::max(TileZ, EzActive.z0);
+			const int EndY = std::min(TileY + EzTiling.tile_y, EzActive.y1);
+			const int EndZ = std::min(TileZ + EzTiling.tile_z, EzActive.z1);
+			for (int riz = StartZ; riz < EndZ; riz++){
+				for (int riy = StartY; riy < EndY; riy++){
+					const int Row = riy + RangeNy * riz;
+					for (int span = EzRowStart[Row]; span < EzRowStart[Row + 1]; span++){
+						const int StartX = std::max(EzSpanList[span].x0, EzActive.x0);
+						const int EndX = std::min(EzSpanList[span].x1, EzActive.x1);
+						int index = EzOffset + X * StartX + Y * riy + Z * riz;
+						for (int rix = StartX; rix < EndX; rix++){
+							const vec3_t *coef = &Coef3List[EzCIndex[index] * CL];
+							const ptrdiff_t i = (ptrdiff_t)index * L;
+							FFFDTD_SIMD
+							for (int k = 0; k < L; k++){
+								const ptrdiff_t j = i + k;
+								Ez[j]
+									= coef[k * CS].x * Ez[j]
+									+ coef[k * CS].y * (Hy[j] - Hy[j - XL])
+									- coef[k * CS].z * (Hx[j] - Hx[j - YL]);
+							}
+							index++;
+						}
+					}
+				}
+			}
+		}
+		endKernel(PERF_EZ, (uint64_t)RangeNx * RangeNy * EzRangeZ);
+
+		// 4次精度の差分を使う成分を補正する
+		if (m_SpatialOrder == 4){
+			const size_t FlagOrigin = (size_t)(m_Size.x + 1) * (m_Size.y + 1);
+			const uint8_t *FlagX = m_ExHighOrderFlag.data() + FlagOrigin;
+			const uint8_t *FlagY = m_EyHighOrderFlag.data() + FlagOrigin;
+			const uint8_t *FlagZ = m_EzHighOrderFlag.data() + FlagOrigin;
+			addHighOrderTerm<T, CS, LN, true>(Ex, Hz, YL, Hy, ZL, FlagX, FlagX, ExCIndex, m_ExHighOrderMask, index3_t(m_StartM.x, m_StartN.y, m_StartN.z), RangeMx, RangeNy, ExRangeZ);
+			addHighOrderTerm<T, CS, LN, true>(Ey, Hx, ZL, Hz, XL, FlagY, FlagY, EyCIndex, m_EyHighOrderMask, index3_t(m_StartN.x, m_StartM.y, m_StartN.z), RangeNx, RangeMy, EyRangeZ);
+			addHighOrderTerm<T, CS, LN, true>(Ez, Hy, XL, Hx, YL, FlagZ, FlagZ, EzCIndex, m_EzHighOrderMask, index3_t(m_StartN.x, m_StartN.y, m_StartM.z), RangeNx, RangeNy, EzRangeZ);
+		}
+
+		double pml_start = (m_Telemetry != nullptr) ? FFTelemetry::now() : 0.0;
+
+		// CPMLの層は通常空間として計算し、接線方向の2つの差分に対する補助変数の寄与を加える
+		// 補助変数は前ステップまでの差分から求めた値を加えた後に、今回の差分で更新する
+		// 補助変数の係数には通常空間の係数を含めてあり、PECのセルでは0とする
+
+		// CPMLの層とPML空間の6つの計算は書き込む成分が重ならないため、1つの並列領域の中でnowaitで続けて分担する
+		// 計算区間ごとに係数を1度だけ読み出し、区間内の成分・分割成分・補助変数を連続して読み書きする
+		vec2_t *CPmlEx = fields.cpml_ex.data();
+		vec2_t *CPmlEy = fields.cpml_ey.data();
+		vec2_t *CPmlEz = fields.cpml_ez.data();
+		vec2_t *PmlDx = fields.pml_dx.data();
+		vec2_t *PmlDy = fields.pml_dy.data();
+		vec2_t *PmlDz = fields.pml_dz.data();
+
+		// CPML Exを補正する
+		const int NumOfCPMLEx = isKernelEnabled(PERF_PML_EX) ? m_NumOfCPMLD.x : 0;
+		auto updateCPMLEx = [&](){
+			updatePMLRuns<vec2_t, CS, LN>(m_CPMLExRunList, Coef2List, [=](ptrdiff_t j, ptrdiff_t s, const vec2_t &coef_psi1, const vec2_t &coef_psi2, const vec2_t &){
+				vec2_t &psi = CPmlEx[s];
+				Ex[j] = (C)Ex[j] + (psi.x - psi.y);
+				psi.x = coef_psi1.x * psi.x + coef_psi1.y * (Hz[j] - Hz[j - YL]);
+				psi.y = coef_psi2.x * psi.y + coef_psi2.y * (Hy[j] - Hy[j - ZL]);
+			});
+		};
+
+		// CPML Eyを補正する
+		const int NumOfCPMLEy = isKernelEnabled(PERF_PML_EY) ? m_NumOfCPMLD.y : 0;
+		auto updateCPMLEy = [&](){
+			updatePMLRuns<vec2_t, CS, LN>(m_CPMLEyRunList, Coef2List, [=](ptrdiff_t j, ptrdiff_t s, const vec2_t &coef_psi1, const vec2_t &coef_psi2, const vec2_t &){
+				vec2_t &psi = CPmlEy[s];
+				Ey[j] = (C)Ey[j] + (psi.x - psi.y);
+				psi.x = coef_psi1.x * psi.x + coef_psi1.y * (Hx[j] - Hx[j - ZL]);
+				psi.y = coef_psi2.x * psi.y + coef_psi2.y * (Hz[j] - Hz[j - XL]);
+			});
+		};
+
+		// CPML Ezを補正する
+		const int NumOfCPMLEz = isKernelEnabled(PERF_PML_EZ) ? m_NumOfCPMLD.z : 0;
+		auto updateCPMLEz = [&](){
+			updatePMLRuns<vec2_t, CS, LN>(m_CPMLEzRunList, Coef2List, [=](ptrdiff_t j, ptrdiff_t s, const vec2_t &coef_psi1, const vec2_t &coef_psi2, const vec2_t &){
+				vec2_t &psi = CPmlEz[s];
+				Ez[j] = (C)Ez[j] + (psi.x - psi.y);
+				psi.x = coef_psi1.x * psi.x + coef_psi1.y * (Hy[j] - Hy[j - XL]);
+				psi.y = coef_psi2.x * psi.y + coef_psi2.y * (Hx[j] - Hx[j - YL]);
+			});
+		};
+
+		// PML Dx,Exを計算する
+		const int NumOfPMLDx = isKernelEnabled(PERF_PML_EX) ? m_NumOfPMLD.x : 0;
+		auto updatePMLDx = [&](){
+			updatePMLRuns<vec2_t, CS, LN>(m_PMLDxRunList, Coef2List, [=](ptrdiff_t j, ptrdiff_t s, const vec2_t &coef_dxy, const vec2_t &coef_dxz, const vec2_t &coef_ex){
+				vec2_t &dx = PmlDx[s];
+				C dx_prev = dx.x + dx.y;
+				dx.x
+					= coef_dxy.x * dx.x
+					+ coef_dxy.y * (Hz[j] - Hz[j - YL]);
+				dx.y
+					= coef_dxz.x * dx.y
+					- coef_dxz.y * (Hy[j] - Hy[j - ZL]);
+				C dx_next = dx.x + dx.y;
+				Ex[j] = coef_ex.x * Ex[j] + coef_ex.y * (dx_next - dx_prev);
+			});
+		};
+
+		// PML Dy,Eyを計算する
+		const int NumOfPMLDy = isKernelEnabled(PERF_PML_EY) ? m_NumOfPMLD.y : 0;
+		auto updatePMLDy = [&](){
+			updatePMLRuns<vec2_t, CS, LN>(m_PMLDyRunList, Coef2List, [=](ptrdiff_t j, ptrdiff_t s, const vec2_t &coef_dyz, const vec2_t &coef_dyx, const vec2_t &coef_ey){
+				vec2_t &dy = PmlDy[s];
+				C dy_prev = dy.x + dy.y;
+				dy.x
+					= coef_dyz.x * dy.x
+					+ coef_dyz.y * (Hx[j] - Hx[j - ZL]);
+				dy.y
+					= coef_dyx.x * dy.y
+					- coef_dyx.y * (Hz[j] - Hz[j - XL]);
+				C dy_next = dy.x + dy.y;
+				Ey[j] = coef_ey.x * Ey[j] + coef_ey.y * (dy_next - dy_prev);
+			});
+		};
+
+		// PML Dz,Ezを計算する
+		const int NumOfPMLDz = isKernelEnabled(PERF_PML_EZ) ? m_NumOfPMLD.z : 0;
+		auto updatePMLDz = [&](){
+			updatePMLRuns<vec2_t, CS, LN>(m_PMLDzRunList, Coef2List, [=](ptrdiff_t j, ptrdiff_t s, const vec2_t &coef_dzx, const vec2_t &coef_dzy, const vec2_t &coef_ez){
+				vec2_t &dz = PmlDz[s];
+				C dz_prev = dz.x + dz.y;
+				dz.x
+					= coef_dzx.x * dz.x
+					+ coef_dzx.y * (Hy[j] - Hy[j - XL]);
+				dz.y
+					= coef_dzy.x * dz.y
+					- coef_dzy.y * (Hx[j] - Hx[j - YL]);
+				C dz_next = dz.x + dz.y;
+				Ez[j] = coef_ez.x * Ez[j] + coef_ez.y * (dz_next - dz_prev);
+			});
+		};
+
+		// カーネルを計測するときはカーネルごとに並列領域を分ける
+		if (m_PerfCounter == nullptr){
+#pragma omp parallel num_threads(getThreads())
+			{
+				if (0 < NumOfCPMLEx) updateCPMLEx();
+				if (0 < NumOfCPMLEy) updateCPMLEy();
+				if (0 < NumOfCPMLEz) updateCPMLEz();
+				if (0 < NumOfPMLDx) updatePMLDx();
+				if (0 < NumOfPMLDy) updatePMLDy();
+				if (0 < NumOfPMLDz) updatePMLDz();
+			}
+		}
+		else{
+			runPMLKernel(PERF_PML_EX, NumOfCPMLEx, updateCPMLEx);
+			runPMLKernel(PERF_PML_EY, NumOfCPMLEy, updateCPMLEy);
+			runPMLKernel(PERF_PML_EZ, NumOfCPMLEz, updateCPMLEz);
+			runPMLKernel(PERF_PML_EX, NumOfPMLDx, updatePMLDx);
+			runPMLKernel(PERF_PML_EY, NumOfPMLDy, updatePMLDy);
+			runPMLKernel(PERF_PML_EZ, NumOfPMLDz, updatePMLDz);
+		}
+
+		if (m_Telemetry != nullptr){
+			double pml_end = FFTelemetry::now();
+			m_Telemetry->addTime(TelemetryPhase::KernelE, pml_start - kernel_start);
+			m_Telemetry->addTime(TelemetryPhase::PMLE, pml_end - pml_start);
+			FFTrace::record(FFTelemetry::getPhaseName(TelemetryPhase::KernelE), "solver", kernel_start, pml_start);
+			FFTrace::record(FFTelemetry::getPhaseName(TelemetryPhase::PMLE), "solver", pml_start, pml_end);
+		}
+
+		// HIE法ではZ方向の差分を陰的に扱い、Ex・Eyの増分を補正する (Ex・EyのZ方向の差分の係数はそれぞれz・y、相手のHy・Hxはy・z)
+		if (m_ImplicitZ){
+			solveImplicitZ<T, CS, true>(Ex, fields.prev_x.data(), ExCIndex, 2, m_HyCIndex.data(), 1, index3_t(m_StartM.x, m_StartN.y, m_StartN.z), RangeMx, RangeNy, ExRangeZ, m_StartM.z, RangeMz);
+			solveImplicitZ<T, CS, true>(Ey, fields.prev_y.data(), EyCIndex, 1, m_HxCIndex.data(), 2, index3_t(m_StartN.x, m_StartM.y, m_StartN.z), RangeNx, RangeMy, EyRangeZ, m_StartM.z, RangeMz);
+		}
+	}
+
+	// 格納型Tと係数リストのレーン間のストライドCS、レーン数LNを指定して磁界を計算する
+	template<typename T, int CS, int LN>
+	void FFSolverCPU::calcHFieldLanes(void){
+		using C = typename Fields_t<T>::compute_t;
+		using vec2_t = typename Fields_t<T>::vec2_t;
+		using vec3_t = typename Fields_t<T>::vec3_t;
+		Fields_t<T> &fields = getFields<T>();
+		const vec2_t *Coef2List = fields.coef2_list.data();
+		const vec3_t *Coef3List = fields.coef3_list.data();
+		const cindex_t *HxCIndex = m_HxCIndex.data();
+		const cindex_t *HyCIndex = m_HyCIndex.data();
+		const cindex_t *HzCIndex = m_HzCIndex.data();
+		const int *HxRowStart = m_HxMask.row_start.data();
+		const RowSpan_t *HxSpanList = m_HxMask.span_list.data();
+		const int *HyRowStart = m_HyMask.row_start.data();
+		const RowSpan_t *HySpanList = m_HyMask.span_list.data();
+		const int *HzRowStart = m_HzMask.row_start.data();
+		const RowSpan_t *HzSpanList = m_HzMask.span_list.data();
+		const T *Ex = fields.ex.data() + fields.e_origin;
+		const T *Ey = fields.ey.data() + fields.e_origin;
+		const T *Ez = fields.ez.data() + fields.e_origin;
+		T *Hx = fields.hx.data() + fields.h_origin;
+		T *Hy = fields.hy.data() + fields.h_origin;
+		T *Hz = fields.hz.data() + fields.h_origin;
+		const int L = (LN == 0) ? m_Lanes : LN;
+		const int CL = (CS == 0) ? 1 : m_CoefLanes;
+		const int X = 1;
+		const int Y = m_Size.x + 1;
+		const int Z = (m_Size.x + 1) * (m_Size.y + 1);
+		const ptrdiff_t XL = (ptrdiff_t)X * L;
+		const ptrdiff_t YL = (ptrdiff_t)Y * L;
+		const ptrdiff_t ZL = (ptrdiff_t)Z * L;
+		const int RangeMx = m_RangeM.x;
+		const int RangeMy = m_RangeM.y;
+		const int RangeMz = m_RangeM.z;
+		const int RangeNx = m_RangeN.x;
+		const int RangeNy = m_RangeN.y;
+		const int RangeNz = m_RangeN.z;
+		const int HxOffset = X * m_StartN.x + Y * m_StartM.y + Z * m_StartM.z;
+		const int HyOffset = X * m_StartM.x + Y * m_StartN.y + Z * m_StartM.z;
+		const int HzOffset = X * m_StartM.x + Y * m_StartM.y + Z * m_StartN.z;
+
+		// 除外されたカーネルはZ方向の範囲を0として飛ばす
+		const int HxRangeZ = isKernelEnabled(PERF_HX) ? RangeMz : 0;
+		const int HyRangeZ = isKernelEnabled(PERF_HY) ? RangeMz : 0;
+		const int HzRangeZ = isKernelEnabled(PERF_HZ) ? RangeNz : 0;
+
+		// HIE法では更新前のHx・Hyを保持し、全ての計算の後で増分を補正する
+		if (m_ImplicitZ){
+			copyImplicitPrev(Hx, Hy);
+		}
+
+		double kernel_start = (m_Telemetry != nullptr) ? FFTelemetry::now() : 0.0;
+
+		// Hxを計算する
+		beginKernel();
+		const Tiling_t HxTiling = getTiling(RangeMy, HxRangeZ);
+		const ActiveRange_t HxActive = getActiveRange(index3_t(m_StartN.x, m_StartM.y, m_StartM.z), RangeNx, RangeMy, HxRangeZ);
+#pragma omp parallel for schedule(dynamic, HxTiling.chunk) num_threads(HxTiling.threads)
+		for (int tile = 0; tile < HxTiling.count; tile++){
+			const int TileY = (tile % HxTiling.num_of_tiles_y) * HxTiling.tile_y;
+			const int TileZ = (tile / HxTiling.num_of_tiles_y) * HxTiling.tile_z;
+			const int StartY = std::max(TileY, HxActive.y0);
+			const int StartZ = std::max(TileZ, HxActive.z0);
+			const int EndY = std::min(TileY + HxTiling.tile_y, HxActive.y1);
+			const int EndZ = std::min(TileZ + HxTiling.tile_z, HxActive.z1);
+			for (int riz = StartZ; riz < EndZ; riz++){
+				for (int riy = StartY; riy < EndY; riy++){
+					const int Row = riy + RangeMy * riz;
+					for (int span = HxRowStart[Row]; span < HxRowStart[Row + 1]; span++){
+						const int StartX = std::max(HxSpanList[span].x0, HxActive.x0);
+						const int EndX = std::min(HxSpanList[span].x1, HxActive.x1);
+						int index = HxOffset + X * StartX + Y * riy + Z * riz;
+						for (int rix = StartX; rix < EndX; rix++){
+							const vec3_t *coef = &Coef3List[HxCIndex[index] * CL];
+							const ptrdiff_t i = (ptrdiff_t)index * L;
+							FFFDTD_SIMD
+							for (int k = 0; k < L; k++){
+								const ptrdiff_t j = i + k;
+								Hx[j]
+									= coef[k * CS].x * Hx[j]
+									- coef[k * CS].y * (Ez[j + YL] - Ez[j])
+									+ coef[k * CS].z * (Ey[j + ZL] - Ey[j]);
+							}
+							index++;
+						}
+					}
+				}
+			}
+		}
+		endKernel(PERF_HX, (uint64_t)RangeNx * RangeMy * HxRangeZ);
+
+		// Hyを計算する
+		beginKernel();
+		const Tiling_t HyTiling = getTiling(RangeNy, HyRangeZ);
+		const ActiveRange_t HyActive = getActiveRange(index3_t(m_StartM.x, m_StartN.y, m_StartM.z), RangeMx, RangeNy, HyRangeZ);
+#pragma omp parallel for schedule(dynamic, HyTiling.chunk) num_threads(HyTiling.threads)
+		for (int tile = 0; tile < HyTiling.count; tile++){
+			const int TileY = (tile % HyTiling.num_of_tiles_y) * HyTiling.tile_y;
+			const int TileZ = (tile / HyTiling.num_of_tiles_y) * HyTiling.tile_z;
+			const int StartY = std::max(TileY, HyActive.y0);
+			const int StartZ = std::max(TileZ, HyActive.z0);
+			const int EndY = std::min(TileY + HyTiling.tile_y, HyActive.y1);
+			const int EndZ = std::min(TileZ + HyTiling.tile_z, HyActive.z1);
+			for (int riz = StartZ; riz < EndZ; riz++){
+				for (int riy = StartY; riy < EndY; riy++){
+					const int Row = riy + RangeNy * riz;
+					for (int span = HyRowStart[Row]; span < HyRowStart[Row + 1]; span++){
+						const int StartX = std::max(HySpanList[span].x0, HyActive.x0);
+						const int EndX = std::min(HySpanList[span].x1, HyActive.x1);
+						int index = HyOffset + X * StartX + Y * riy + Z * riz;
+						for (int rix = StartX; rix < EndX; rix++){
+							const vec3_t *coef = &Coef3List[HyCIndex[index] * CL];
+							const ptrdiff_t i = (ptrdiff_t)index * L;
+							FFFDTD_SIMD
+							for (int k = 0; k < L; k++){
+								const ptrdiff_t j = i + k;
+								Hy[j]
+									= coef[k * CS].x * Hy[j]
+									- coef[k * CS].y * (Ex[j + ZL] - Ex[j])
+									+ coef[k * CS].z * (Ez[j + XL] - Ez[j]);
+							}
+							index++;
+						}
+					}
+				}
+			}
+		}
+		endKernel(PERF_HY, (uint64_t)RangeMx * RangeNy * HyRangeZ);
+
+		// Hzを計算する
+		beginKernel();
+		const Tiling_t HzTiling = getTiling(RangeMy, HzRangeZ);
+		const ActiveRange_t HzActive = getActiveRange(index3_t(m_StartM.x, m_StartM.y, m_StartN.z), RangeMx, RangeMy, HzRangeZ);
+#pragma omp parallel for schedule(dynamic, HzTiling.chunk) num_threads(HzTiling.threads)
+		for (int tile = 0; tile < HzTiling.count; tile++){
+			const int TileY = (tile % HzTiling.num_of_tiles_y) * HzTiling.tile_y;
+			const int TileZ = (tile / HzTiling.num_of_tiles_y) * HzTiling.tile_z;
+			const int StartY = std::max(TileY, HzActive.y0);
+			const int StartZ = std::max(TileZ, HzActive.z0);
+			const int EndY = std::min(TileY + HzTiling.tile_y, HzActive.y1);
+			const int EndZ = std::min(TileZ + HzTiling.tile_z, HzActive.z1);
+			for (int riz = StartZ; riz < EndZ; riz++){
+				for (int riy = StartY; riy < EndY; riy++){
+					const int Row = riy + RangeMy * riz;
+					for (int span = HzRowStart[Row]; span < HzRowStart[Row + 1]; span++){
+						const int StartX = std::max(HzSpanList[span].x0, HzActive.x0);
+						const int EndX = std::min(HzSpanList[span].x1, HzActive.x1);
+						int index = HzOffset + X * StartX + Y * riy + Z * riz;
+						for (int rix = StartX; rix < EndX; rix++){
+							const vec3_t *coef = &Coef3List[HzCIndex[index] * CL];
+							const ptrdiff_t i = (ptrdiff_t)index * L;
+							FFFDTD_SIMD
+							for (int k = 0; k < L; k++){
+								const ptrdiff_t j = i + k;
+								Hz[j]
+									= coef[k * CS].x * Hz[j]
+									- coef[k * CS].y * (Ey[j + XL] - Ey[j])
+									+ coef[k * CS].z * (Ex[j + YL] - Ex[j]);
+							}
+							index++;
+						}
+					}
+				}
+			}
+		}
+		endKernel(PERF_HZ, (uint64_t)RangeMx * RangeMy * HzRangeZ);
+
+		// 4次精度の差分を使う成分を補正する
+		if (m_SpatialOrder == 4){
+			const size_t FlagOrigin = (size_t)(m_Size.x + 1) * (m_Size.y + 1);
+			const uint8_t *FlagX = m_ExHighOrderFlag.data() + FlagOrigin;
+			const uint8_t *FlagY = m_EyHighOrderFlag.data() + FlagOrigin;
+			const uint8_t *FlagZ = m_EzHighOrderFlag.data() + FlagOrigin;
+			addHighOrderTerm<T, CS, LN, false>(Hx, Ez, YL, Ey, ZL, FlagZ, FlagY, HxCIndex, m_HxHighOrderMask, index3_t(m_StartN.x, m_StartM.y, m_StartM.z), RangeNx, RangeMy, HxRangeZ);
+			addHighOrderTerm<T, CS, LN, false>(Hy, Ex, ZL, Ez, XL, FlagX, FlagZ, HyCIndex, m_HyHighOrderMask, index3_t(m_StartM.x, m_StartN.y, m_StartM.z), RangeMx, RangeNy, HyRangeZ);
+			addHighOrderTerm<T, CS, LN, false>(Hz, Ey, XL, Ex, YL, FlagY, FlagX, HzCIndex, m_HzHighOrderMask, index3_t(m_StartM.x, m_StartM.y, m_StartN.z), RangeMx, RangeMy, HzRangeZ);
+		}
+
+		double pml_start = (m_Telemetry != nullptr) ? FFTelemetry::now() : 0.0;
+
+		// CPMLの層は通常空間として計算し、接線方向の2つの差分に対する補助変数の寄与を加える
+
+		// CPMLの層とPML空間の6つの計算は書き込む成分が重ならないため、1つの並列領域の中でnowaitで続けて分担する
+		vec2_t *CPmlHx = fields.cpml_hx.data();
+		vec2_t *CPmlHy = fields.cpml_hy.data();
+		vec2_t *CPmlHz = fields.cpml_hz.data();
+		vec2_t *PmlHx = fields.pml_hx.data();
+		vec2_t *PmlHy = fields.pml_hy.data();
+		vec2_t *PmlHz = fields.pml_hz.data();
+
+		// CPML Hxを補正する
+		const int NumOfCPMLHx = isKernelEnabled(PERF_PML_HX) ? m_NumOfCPMLH.x : 0;
+		auto updateCPMLHx = [&](){
+			updatePMLRuns<vec2_t, CS, LN>(m_CPMLHxRunList, Coef2List, [=](ptrdiff_t j, ptrdiff_t s, const vec2_t &coef_psi1, const vec2_t &coef_psi2, const vec2_t &){
+				vec2_t &psi = CPmlHx[s];
+				Hx[j] = (C)Hx[j] - (psi.x - psi.y);
+				psi.x = coef_psi1.x * psi.x + coef_psi1.y * (Ez[j + YL] - Ez[j]);
+				psi.y = coef_psi2.x * psi.y + coef_psi2.y * (Ey[j + ZL] - Ey[j]);
+			});
+		};
+
+		// CPML Hyを補正する
+		const int NumOfCPMLHy = isKernelEnabled(PERF_PML_HY) ? m_NumOfCPMLH.y : 0;
+		auto updateCPMLHy = [&](){
+			updatePMLRuns<vec2_t, CS, LN>(m_CPMLHyRunList, Coef2List, [=](ptrdiff_t j, ptrdiff_t s, const vec2_t &coef_psi1, const vec2_t &coef_psi2, const vec2_t &){
+				vec2_t &psi = CPmlHy[s];
+				Hy[j] = (C)Hy[j] - (psi.x - psi.y);
+				psi.x = coef_psi1.x * psi.x + coef_psi1.y * (Ex[j + ZL] - Ex[j]);
+				psi.y = coef_psi2.x * psi.y + coef_psi2.y * (Ez[j + XL] - Ez[j]);
+			});
+		};
+
+		// CPML Hzを補正する
+		const int NumOfCPMLHz = isKernelEnabled(PERF_PML_HZ) ? m_NumOfCPMLH.z : 0;
+		auto updateCPMLHz = [&](){
+			updatePMLRuns<vec2_t, CS, LN>(m_CPMLHzRunList, Coef2List, [=](ptrdiff_t j, ptrdiff_t s, const vec2_t &coef_psi1, const vec2_t &coef_psi2, const vec2_t &){
+				vec2_t &psi = CPmlHz[s];
+				Hz[j] = (C)Hz[j] - (psi.x - psi.y);
+				psi.x = coef_psi1.x * psi.x + coef_psi1.y * (Ey[j + XL] - Ey[j]);
+				psi.y = coef_psi2.x * psi.y + coef_psi2.y * (Ex[j + YL] - Ex[j]);
+			});
+		};
+
+		// PML Hxを計算する
+		const int NumOfPMLHx = isKernelEnabled(PERF_PML_HX) ? m_NumOfPMLH.x : 0;
+		auto updatePMLHx = [&](){
+			updatePMLRuns<vec2_t, CS, LN>(m_PMLHxRunList, Coef2List, [=](ptrdiff_t j, ptrdiff_t s, const vec2_t &coef_hxy, const vec2_t &coef_hxz, const vec2_t &){
+				vec2_t &hx = PmlHx[s];
+				hx.x
+					= coef_hxy.x * hx.x
+					- coef_hxy.y * (Ez[j + YL] - Ez[j]);
+				hx.y
+					= coef_hxz.x * hx.y
+					+ coef_hxz.y * (Ey[j + ZL] - Ey[j]);
+				Hx[j] = hx.x + hx.y;
+			});
+		};
+
+		// PML Hyを計算する
+		const int NumOfPMLHy = isKernelEnabled(PERF_PML_HY) ? m_NumOfPMLH.y : 0;
+		auto updatePMLHy = [&](){
+			updatePMLRuns<vec2_t, CS, LN>(m_PMLHyRunList, Coef2List, [=](ptrdiff_t j, ptrdiff_t s, const vec2_t &coef_hyz, const vec2_t &coef_hyx, const vec2_t &){
+				vec2_t &hy = PmlHy[s];
+				hy.x
+					= coef_hyz.x * hy.x
+					- coef_hyz.y * (Ex[j + ZL] - Ex[j]);
+				hy.y
+					= coef_hyx.x * hy.y
+					+ coef_hyx.y * (Ez[j + XL] - Ez[j]);
+				Hy[j] = hy.x + hy.y;
+			});
+		};
+
+		// PML Hzを計算する
+		const int NumOfPMLHz = isKernelEnabled(PERF_PML_HZ) ? m_NumOfPMLH.z : 0;
+		auto updatePMLHz = [&](){
+			updatePMLRuns<vec2_t, CS, LN>(m_PMLHzRunList, Coef2List, [=](ptrdiff_t j, ptrdiff_t s, const vec2_t &coef_hzx, const vec2_t &coef_hzy, const vec2_t &){
+				vec2_t &hz = PmlHz[s];
+				hz.x
+					= coef_hzx.x * hz.x
+					- coef_hzx.y * (Ey[j + XL] - Ey[j]);
+				hz.y
+					= coef_hzy.x * hz.y
+					+ coef_hzy.y * (Ex[j + YL] - Ex[j]);
+				Hz[j] = hz.x + hz.y;
+			});
+		};
+
+		// カーネルを計測するときはカーネルごとに並列領域を分ける
+		if (m_PerfCounter == nullptr){
+#pragma omp parallel num_threads(getThreads())
+			{
+				if (0 < NumOfCPMLHx) updateCPMLHx();
+				if (0 < NumOfCPMLHy) updateCPMLHy();
+				if (0 < NumOfCPMLHz) updateCPMLHz();
+				if (0 < NumOfPMLHx) updatePMLHx();
+				if (0 < NumOfPMLHy) updatePMLHy();
+				if (0 < NumOfPMLHz) updatePMLHz();
+			}
+		}
+		else{
+			runPMLKernel(PERF_PML_HX, NumOfCPMLHx, updateCPMLHx);
+			runPMLKernel(PERF_PML_HY, NumOfCPMLHy, updateCPMLHy);
+			runPMLKernel(PERF_PML_HZ, NumOfCPMLHz, updateCPMLHz);
+			runPMLKernel(PERF_PML_HX, NumOfPMLHx, updatePMLHx);
+			runPMLKernel(PERF_PML_HY, NumOfPMLHy, updatePMLHy);
+			runPMLKernel(PERF_PML_HZ, NumOfPMLHz, updatePMLHz);
+		}
+
+		if (m_Telemetry != nullptr){
+			double pml_end = FFTelemetry::now();
+			m_Telemetry->addTime(TelemetryPhase::KernelH, pml_start - kernel_start);
+			m_Telemetry->addTime(TelemetryPhase::PMLH, pml_end - pml_start);
+			FFTrace::record(FFTelemetry::getPhaseName(TelemetryPhase::KernelH), "solver", kernel_start, pml_start);
+			FFTrace::record(FFTelemetry::getPhaseName(TelemetryPhase::PMLH), "solver", pml_start, pml_end);
+		}
+
+		// HIE法ではZ方向の差分を陰的に扱い、Hx・Hyの増分を補正する (Hx・HyのZ方向の差分の係数はそれぞれz・y、相手のEy・Exはy・z)
+		if (m_ImplicitZ){
+			solveImplicitZ<T, CS, false>(Hx, fields.prev_x.data(), HxCIndex, 2, m_EyCIndex.data(), 1, index3_t(m_StartN.x, m_StartM.y, m_StartM.z), RangeNx, RangeMy, HxRangeZ, m_StartN.z, RangeNz);
+			solveImplicitZ<T, CS, false>(Hy, fields.prev_y.data(), HyCIndex, 1, m_ExCIndex.data(), 2, index3_t(m_StartM.x, m_StartN.y, m_StartM.z), RangeMx, RangeNy, HyRangeZ, m_StartN.z, RangeNz);
+		}
+	}
+
+	// 格納型Tと係数リストのレーン間のストライドCS、レーン数LNを指定して、2次精度で計算した成分に4次精度の差分の補正を加える
+	// 4次精度の差分 (9/8)Δ1 - (1/24)Δ3 (Δ3は3つ離れた2成分の差) を、2階差分Δ2を使って Δ1 (1 - Δ2/24) と分解する
+	// 電界 (IS_Eがtrue) は磁界に Δ1 (P Δ2) を、磁界は電界の差分に Δ2 (P Δ1) を掛けた項を補正とし、-1/24倍して加える
+	// Pは差分の方向に隣り合う2つの電界成分のフラグがともに0でない磁界成分の位置で1とする
+	// 電界と磁界の補正は互いに転置となり、補正する成分の境界でもエネルギーが保存される
+	// 補正は境界でも差分の形を保つため、境界で波が反射しない
+	// 電界は後退差分で field += coef.y * Δa - coef.z * Δb、磁界は前進差分で field -= coef.y * Δa - coef.z * Δb とする
+	// flag_a・flag_bはΔa・Δbの方向に並ぶ電界成分のフラグとする
+	// 通常空間の計算の後に加えるため、半精度とbfloat16では格納時の丸めが1回増える
+	template<typename T, int CS, int LN, bool IS_E>
+	void FFSolverCPU::addHighOrderTerm(T *field, const T *A, ptrdiff_t SA, const T *B, ptrdiff_t SB, const uint8_t *flag_a, const uint8_t *flag_b, const cindex_t *cindex, const RowMask_t &mask, const index3_t &start, int range_x, int range_y, int range_z){
+		using C = typename Fields_t<T>::compute_t;
+		using vec3_t = typename Fields_t<T>::vec3_t;
+		const vec3_t *Coef3List = getFields<T>().coef3_list.data();
+		const int *RowStart = mask.row_start.data();
+		const RowSpan_t *SpanList = mask.span_list.data();
+		const int L = (LN == 0) ? m_Lanes : LN;
+		const int CL = (CS == 0) ? 1 : m_CoefLanes;
+		const int X = 1;
+		const int Y = m_Size.x + 1;
+		const int Z = (m_Size.x + 1) * (m_Size.y + 1);
+		const int Offset = X * start.x + Y * start.y + Z * start.z;
+		const ptrdiff_t FA = SA / L;
+		const ptrdiff_t FB = SB / L;
+		const C C24 = (C)(1.0 / 24.0);
+
+		const Tiling_t Tiling = getTiling(range_y, range_z);
+		const ActiveRange_t Active = getActiveRange(start, range_x, range_y, range_z);
+#pragma omp parallel for schedule(dynamic, Tiling.chunk) num_threads(Tiling.threads)
+		for (int tile = 0; tile < Tiling.count; tile++){
+			const int TileY = (tile % Tiling.num_of_tiles_y) * Tiling.tile_y;
+			const int TileZ = (tile / Tiling.num_of_tiles_y) * Tiling.tile_z;
+			const int StartY = std::max(TileY, Active.y0);
+			const int StartZ = std::max(TileZ, Active.z0);
+			const int EndY = std::min(TileY + Tiling.tile_y, Active.y1);
+			const int EndZ = std::min(TileZ + Tiling.tile_z, Active.z1);
+			for (int riz = StartZ; riz < EndZ; riz++){
+				for (int riy = StartY; riy < EndY; riy++){
+					const int Row = riy + range_y * riz;
+					for (int span = RowStart[Row]; span < RowStart[Row + 1]; span++){
+						const int StartX = std::max(SpanList[span].x0, Active.x0);
+						const int EndX = std::min(SpanList[span].x1, Active.x1);
+						int index = Offset + X * StartX + Y * riy + Z * riz;
+						for (int rix = StartX; rix < EndX; rix++){
+							const vec3_t *coef = &Coef3List[cindex[index] * CL];
+							const ptrdiff_t i = (ptrdiff_t)index * L;
+							if (IS_E){
+								// 成分の正側・負側の磁界成分のP
+								const C PA1 = (flag_a[index] && flag_a[index + FA]) ? (C)1 : (C)0;
+								const C PA0 = (flag_a[index - FA] && flag_a[index]) ? (C)1 : (C)0;
+								const C PB1 = (flag_b[index] && flag_b[index + FB]) ? (C)1 : (C)0;
+								const C PB0 = (flag_b[index - FB] && flag_b[index]) ? (C)1 : (C)0;
+								FFFDTD_SIMD
+								for (int k = 0; k < L; k++){
+									const ptrdiff_t j = i + k;
+									const C da = C24 * (PA0 * ((C)A[j] - 2 * (C)A[j - SA] + (C)A[j - 2 * SA]) - PA1 * ((C)A[j + SA] - 2 * (C)A[j] + (C)A[j - SA]));
+									const C db = C24 * (PB0 * ((C)B[j] - 2 * (C)B[j - SB] + (C)B[j - 2 * SB]) - PB1 * ((C)B[j + SB] - 2 * (C)B[j] + (C)B[j - SB]));
+									field[j] = (C)field[j] + coef[k * CS].y * da - coef[k * CS].z * db;
+								}
+							}
+							else{
+								// 成分と負側・正側の磁界成分のP
+								const C PA0 = (flag_a[index - FA] && flag_a[index]) ? (C)1 : (C)0;
+								const C PA1 = (flag_a[index] && flag_a[index + FA]) ? (C)1 : (C)0;
+								const C PA2 = (flag_a[index + FA] && flag_a[index + 2 * FA]) ? (C)1 : (C)0;
+								const C PB0 = (flag_b[index - FB] && flag_b[index]) ? (C)1 : (C)0;
+								const C PB1 = (flag_b[index] && flag_b[index + FB]) ? (C)1 : (C)0;
+								const C PB2 = (flag_b[index + FB] && flag_b[index + 2 * FB]) ? (C)1 : (C)0;
+								FFFDTD_SIMD
+								for (int k = 0; k < L; k++){
+									const ptrdiff_t j = i + k;
+									const C da = C24 * (2 * PA1 * ((C)A[j + SA] - (C)A[j]) - PA0 * ((C)A[j] - (C)A[j - SA]) - PA2 * ((C)A[j + 2 * SA] - (C)A[j + SA]));
+									const C db = C24 * (2 * PB1 * ((C)B[j + SB] - (C)B[j]) - PB0 * ((C)B[j] - (C)B[j - SB]) - PB2 * ((C)B[j + 2 * SB] - (C)B[j + SB]));
+									field[j] = (C)field[j] - (coef[k * CS].y * da - coef[k * CS].z * db);
+								}
+							}
+							index++;
+						}
+					}
+				}
+			}
+		}
+	}
+	
+	// HIE法で増分を求めるため、更新前のX・Y成分を作業領域にコピーする
+	template<typename T>
+	void FFSolverCPU::copyImplicitPrev(const T *field_x, const T *field_y){
+		Fields_t<T> &fields = getFields<T>();
+		T *PrevX = fields.prev_x.data();
+		T *PrevY = fields.prev_y.data();
+		const size_t Z = (size_t)(m_Size.x + 1) * (m_Size.y + 1) * m_Lanes;
+		const int Nz = m_Size.z + 1;
+#pragma omp parallel for num_threads(getThreads())
+		for (int z = 0; z < Nz; z++){
+			std::copy(field_x + Z * z, field_x + Z * (z + 1), PrevX + Z * z);
+			std::copy(field_y + Z * z, field_y + Z * (z + 1), PrevY + Z * z);
+		}
+	}
+
+	// 格納型Tと係数リストのレーン間のストライドCSを指定して、HIE法でfieldの増分をZ方向の3重対角方程式で補正する
+	// 陽的に求めた増分dを、Z方向の2階差分Lを使った (1 - L/4) d' = d の解d'で置き換える
+	// L d(k) = c(k) * (p+ * (d(k+1) - d(k)) - p- * (d(k) - d(k-1))) とし、cは成分の係数、p+・p-は電界では相手の磁界のk・k-1、磁界では相手の電界のk+1・kの係数とする
+	// 計算範囲外の相手の係数とZ端部の外側の増分は0とする
+	// 電界と磁界の両方を補正すると、タイムステップはZ方向のセル幅によらずX・Y方向のクーラン条件だけで安定となる
+	// X方向に並ぶ列をまとめて前進消去・後退代入し、Y方向の行ごとに並列化する
+	template<typename T, int CS, bool IS_E>
+	void FFSolverCPU::solveImplicitZ(T *field, const T *prev, const cindex_t *cindex, int comp, const cindex_t *pair_cindex, int pair_comp, const index3_t &start, int range_x, int range_y, int range_z, int pair_start_z, int pair_range_z){
+		using C = typename Fields_t<T>::compute_t;
+		using vec3_t = typename Fields_t<T>::vec3_t;
+		const vec3_t *Coef3List = getFields<T>().coef3_list.data();
+		const int L = m_Lanes;
+		const int CL = (CS == 0) ? 1 : m_CoefLanes;
+		const int X = 1;
+		const int Y = m_Size.x + 1;
+		const int Z = (m_Size.x + 1) * (m_Size.y + 1);
+		const int Offset = X * start.x + Y * start.y;
+		const int PairUp = IS_E ? 0 : 1;
+		const C Gamma = (C)0.25;
+
+		// Z方向は列の全体を解くため、活性領域はX・Y方向だけ使う
+		const ActiveRange_t Active = getActiveRange(start, range_x, range_y, range_z);
+		const int W = (Active.x1 - Active.x0) * L;
+		if ((W <= 0) || (range_z <= 0)){
+			return;
+		}
+
+#pragma omp parallel num_threads(getThreads())
+		{
+			// 前進消去した上側の係数と右辺 (Z方向の面ごとにX方向の列とレーンを並べる)
+			std::vector<C> cp((size_t)range_z * W), dp((size_t)range_z * W);
+#pragma omp for schedule(dynamic, 1)
+			for (int riy = Active.y0; riy < Active.y1; riy++){
+				// 前進消去
+				for (int riz = 0; riz < range_z; riz++){
+					const int z = start.z + riz;
+					const bool HasUp = (pair_start_z <= z + PairUp) && (z + PairUp < pair_start_z + pair_range_z);
+					const bool HasLow = (pair_start_z <= z + PairUp - 1) && (z + PairUp - 1 < pair_start_z + pair_range_z);
+					C *CP = &cp[(size_t)riz * W];
+					C *DP = &dp[(size_t)riz * W];
+					int index = Offset + X * Active.x0 + Y * riy + Z * z;
+					for (int w = 0; w < W; w += L){
+						const vec3_t *coef = &Coef3List[cindex[index] * CL];
+						const vec3_t *coef_up = HasUp ? &Coef3List[pair_cindex[index + Z * PairUp] * CL] : nullptr;
+						const vec3_t *coef_low = HasLow ? &Coef3List[pair_cindex[index + Z * (PairUp - 1)] * CL] : nullptr;
+						const ptrdiff_t i = (ptrdiff_t)index * L;
+						for (int k = 0; k < L; k++){
+							const ptrdiff_t j = i + k;
+							const C c = coef[k * CS][comp];
+							const C p_up = HasUp ? coef_up[k * CS][pair_comp] : (C)0;
+							const C p_low = HasLow ? coef_low[k * CS][pair_comp] : (C)0;
+							const C a = -Gamma * c * p_low;
+							const C b = (C)1 + Gamma * c * (p_up + p_low);
+							const C u = -Gamma * c * p_up;
+							const C d = (C)field[j] - (C)prev[j];
+							if (riz == 0){
+								CP[w + k] = u / b;
+								DP[w + k] = d / b;
+							}
+							else{
+								const C m = b - a * CP[w + k - W];
+								CP[w + k] = u / m;
+								DP[w + k] = (d - a * DP[w + k - W]) / m;
+							}
+						}
+						index++;
+					}
+				}
+
+				// 後退代入
+				for (int riz = range_z - 1; 0 <= riz; riz--){
+					const int z = start.z + riz;
+					const C *CP = &cp[(size_t)riz * W];
+					C *DP = &dp[(size_t)riz * W];
+					const ptrdiff_t i = (ptrdiff_t)(Offset + X * Active.x0 + Y * riy + Z * z) * L;
+					for (int w = 0; w < W; w++){
+						if (riz < range_z - 1){
+							DP[w] -= CP[w] * DP[w + W];
+						}
+						field[i + w] = (C)prev[i + w] + DP[w];
+					}
+				}
+			}
+		}
+	}
+
+	// 時間ドメインプローブの位置の電磁界を励振する
+	void FFSolverCPU::setTDProbeValue(oindex_t id, index_t lane, double value){
+		switch (m_Precision){
+		case Precision::Double:
+			setTDProbeValueT<double>(id, lane, value);
+			break;
+		case Precision::Half:
+			setTDProbeValueT<half_t>(id, lane, value);
+			break;
+		case Precision::BFloat16:
+			setTDProbeValueT<bfloat16_t>(id, lane, value);
+			break;
+		default:
+			setTDProbeValueT<float>(id, lane, value);
+			break;
+		}
+	}
+
+	// 格納型Tで時間ドメインプローブの位置の電磁界を励振する
+	template<typename T>
+	void FFSolverCPU::setTDProbeValueT(oindex_t id, index_t lane, double value){
+		// 電磁界の値を反映する
+		Probe_t &probe = m_TDProbeList[id];
+		size_t index = (size_t)probe.index * m_Lanes + lane;
+		T *field = (T*)getFieldData(probe.type);
+		field[index] = (T)(typename Fields_t<T>::compute_t)value;
+	}
+
+	// 端部の電界を交換する
+	// X・Y方向は周期境界のゴーストを埋める処理と共通とする
+	void FFSolverCPU::exchangeEdgeE(Axis axis){
+		if ((axis == Axis::X) || (axis == Axis::Y)){
+			copyPeriodicEdge(true, axis == Axis::X, axis == Axis::Y);
+		}
+		else if (axis == Axis::Z){
+			const size_t Z = (size_t)(m_Size.x + 1) * (m_Size.y + 1) * m_Lanes * getRealSize(m_Precision);
+			uint8_t *Ex = (uint8_t*)getFieldData(EMType::Ex);
+			uint8_t *Ey = (uint8_t*)getFieldData(EMType::Ey);
+			uint8_t *Ez = (uint8_t*)getFieldData(EMType::Ez);
+			memcpy(Ex, Ex + Z * m_Size.z, Z);
+			memcpy(Ey, Ey + Z * m_Size.z, Z);
+			memcpy(Ez + Z * m_Size.z, Ez, Z);
+		}
+	}
+
+	// 端部の磁界を交換する
+	// X・Y方向は周期境界のゴーストを埋める処理と共通とする
+	void FFSolverCPU::exchangeEdgeH(Axis axis){
+		if ((axis == Axis::X) || (axis == Axis::Y)){
+			copyPeriodicEdge(false, axis == Axis::X, axis == Axis::Y);
+		}
+		else if (axis == Axis::Z){
+			const size_t Z = (size_t)(m_Size.x + 1) * (m_Size.y + 1) * m_Lanes * getRealSize(m_Precision);
+			uint8_t *Hx = (uint8_t*)getFieldData(EMType::Hx);
+			uint8_t *Hy = (uint8_t*)getFieldData(EMType::Hy);
+			uint8_t *Hz = (uint8_t*)getFieldData(EMType::Hz);
+			memcpy(Hx + Z * m_Size.z, Hx, Z);
+			memcpy(Hy + Z * m_Size.z, Hy, Z);
+			memcpy(Hz, Hz + Z * m_Size.z, Z);
+		}
+	}
+
+	// X・Y方向の周期境界の端部のゴーストを埋める
+	// 各成分は軸方向にm型のときは負側の値を正側のゴーストに写し、n型のときは正側の値を負側のゴーストに写す
+	// Z方向の面ごとに並列に処理し、面の中ではX方向を写してからY方向を写す (角のゴーストはX方向に写した値から埋まる)
+	// 精度によらずバイト単位で複写する
+	void FFSolverCPU::copyPeriodicEdge(bool is_e, bool periodic_x, bool periodic_y){
+		if (isBloch()){
+			// Bloch周期境界は位相差の回転をかけて写す
+			switch (m_Precision){
+			case Precision::Double:
+				copyBlochEdgeT<double>(is_e, periodic_x, periodic_y);
+				break;
+			case Precision::Half:
+				copyBlochEdgeT<half_t>(is_e, periodic_x, periodic_y);
+				break;
+			case Precision::BFloat16:
+				copyBlochEdgeT<bfloat16_t>(is_e, periodic_x, periodic_y);
+				break;
+			default:
+				copyBlochEdgeT<float>(is_e, periodic_x, periodic_y);
+				break;
+			}
+			return;
+		}
+
+		const size_t X = (size_t)m_Lanes * getRealSize(m_Precision);
+		const size_t Y = (m_Size.x + 1) * X;
+		const size_t Z = (m_Size.y + 1) * Y;
+		const int Ny = (int)m_Size.y + 1;
+		const int Nz = (int)m_Size.z + 1;
+		uint8_t *field[3] = {
+			(uint8_t*)getFieldData(is_e ? EMType::Ex : EMType::Hx),
+			(uint8_t*)getFieldData(is_e ? EMType::Ey : EMType::Hy),
+			(uint8_t*)getFieldData(is_e ? EMType::Ez : EMType::Hz),
+		};
+
+		// X方向は常に0の行を写さない (同じ行の0を写すだけのため)
+		const uint8_t *live[3] = {
+			getLiveRow(is_e ? EMType::Ex : EMType::Hx).data(),
+			getLiveRow(is_e ? EMType::Ey : EMType::Hy).data(),
+			getLiveRow(is_e ? EMType::Ez : EMType::Hz).data(),
+		};
+
+		const size_t upper_x = X * m_Size.x;
+		const size_t upper_y = Y * m_Size.y;
+
+#pragma omp parallel for num_threads(getThreads())
+		for (int iz = 0; iz < Nz; iz++){
+			for (int c = 0; c < 3; c++){
+				uint8_t *plane = field[c] + Z * iz;
+				if (periodic_x){
+					const size_t dst = isTypeM(is_e, c, 0) ? upper_x : 0;
+					const size_t src = isTypeM(is_e, c, 0) ? 0 : upper_x;
+					for (int iy = 0; iy < Ny; iy++){
+						if (live[c][iy + Ny * iz] != 0){
+							memcpy(plane + Y * iy + dst, plane + Y * iy + src, X);
+						}
+					}
+				}
+				if (periodic_y){
+					const size_t dst = isTypeM(is_e, c, 1) ? upper_y : 0;
+					const size_t src = isTypeM(is_e, c, 1) ? 0 : upper_y;
+					memcpy(plane + dst, plane + src, Y);
+				}
+			}
+		}
+	}
+
+	// 格納型TでBloch周期境界の端部のゴーストを埋める
+	// レーンの前半を実部、後半を虚部とする複素数の電磁界として、写す値に位相差φの回転をかける
+	// 正側の周期の値は負側の周期の値のexp(-jφ)倍とし、負側の値を正側に写すときはexp(-jφ)、正側の値を負側に写すときはexp(jφ)をかける
+	template<typename T>
+	void FFSolverCPU::copyBlochEdgeT(bool is_e, bool periodic_x, bool periodic_y){
+		using C = typename Fields_t<T>::compute_t;
+		const index_t B = m_Lanes / 2;
+		const size_t X = m_Lanes;
+		const size_t Y = (m_Size.x + 1) * X;
+		const size_t Z = (m_Size.y + 1) * Y;
+		const int Nx = (int)m_Size.x + 1;
+		const int Ny = (int)m_Size.y + 1;
+		const int Nz = (int)m_Size.z + 1;
+		T *field[3] = {
+			(T*)getFieldData(is_e ? EMType::Ex : EMType::Hx),
+			(T*)getFieldData(is_e ? EMType::Ey : EMType::Hy),
+			(T*)getFieldData(is_e ? EMType::Ez : EMType::Hz),
+		};
+		const uint8_t *live[3] = {
+			getLiveRow(is_e ? EMType::Ex : EMType::Hx).data(),
+			getLiveRow(is_e ? EMType::Ey : EMType::Hy).data(),
+			getLiveRow(is_e ? EMType::Ez : EMType::Hz).data(),
+		};
+		const C cos_x = (C)cos(m_BlochPhase.x);
+		const C sin_x = (C)sin(m_BlochPhase.x);
+		const C cos_y = (C)cos(m_BlochPhase.y);
+		const C sin_y = (C)sin(m_BlochPhase.y);
+		const size_t upper_x = X * m_Size.x;
+		const size_t upper_y = Y * m_Size.y;
+
+		// srcのセルの複素数値に(c + js)をかけてdstのセルに書き込む
+		auto rotate = [B](T *dst, const T *src, C c, C s){
+			for (index_t k = 0; k < B; k++){
+				const C re = (C)src[k];
+				const C im = (C)src[k + B];
+				dst[k] = (T)(re * c - im * s);
+				dst[k + B] = (T)(im * c + re * s);
+			}
+		};
+
+#pragma omp parallel for num_threads(getThreads())
+		for (int iz = 0; iz < Nz; iz++){
+			for (int c = 0; c < 3; c++){
+				T *plane = field[c] + Z * iz;
+				if (periodic_x){
+					const bool to_upper = isTypeM(is_e, c, 0);
+					const size_t dst = to_upper ? upper_x : 0;
+					const size_t src = to_upper ? 0 : upper_x;
+					const C s = to_upper ? -sin_x : sin_x;
+					for (int iy = 0; iy < Ny; iy++){
+						if (live[c][iy + Ny * iz] != 0){
+							rotate(plane + Y * iy + dst, plane + Y * iy + src, cos_x, s);
+						}
+					}
+				}
+				if (periodic_y){
+					const bool to_upper = isTypeM(is_e, c, 1);
+					const size_t dst = to_upper ? upper_y : 0;
+					const size_t src = to_upper ? 0 : upper_y;
+					const C s = to_upper ? -sin_y : sin_y;
+					for (int ix = 0; ix < Nx; ix++){
+						rotate(plane + dst + X * ix, plane + src + X * ix, cos_y, s);
+					}
+				}
+			}
+		}
+	}
+
+	// Z端部の電界を取得する
+	void FFSolverCPU::getEdgeE(const void **top_ex, const void **top_ey, const void **bottom_ez) const{
+		const size_t Z = (size_t)(m_Size.x + 1) * (m_Size.y + 1) * m_Lanes * getRealSize(m_Precision);
+		if (top_ex != nullptr){
+			*top_ex = (const uint8_t*)getFieldData(EMType::Ex) + Z * m_Size.z;
+		}
+		if (top_ey != nullptr){
+			*top_ey = (const uint8_t*)getFieldData(EMType::Ey) + Z * m_Size.z;
+		}
+		if (bottom_ez != nullptr){
+			*bottom_ez = getFieldData(EMType::Ez);
+		}
+	}
+
+	// Z端部の電界を設定する
+	void FFSolverCPU::setEdgeE(const void *bottom_ex, const void *bottom_ey, const void *top_ez){
+		const size_t Z = (size_t)(m_Size.x + 1) * (m_Size.y + 1) * m_Lanes * getRealSize(m_Precision);
+		if (bottom_ex != nullptr){
+			memcpy(getFieldData(EMType::Ex), bottom_ex, Z);
+		}
+		if (bottom_ey != nullptr){
+			memcpy(getFieldData(EMType::Ey), bottom_ey, Z);
+		}
+		if (top_ez != nullptr){
+			memcpy((uint8_t*)getFieldData(EMType::Ez) + Z * m_Size.z, top_ez, Z);
+		}
+	}
+
+	// Z端部の磁界を取得する
+	void FFSolverCPU::getEdgeH(const void **bottom_hx, const void **bottom_hy, const void **top_hz) const{
+		const size_t Z = (size_t)(m_Size.x + 1) * (m_Size.y + 1) * m_Lanes * getRealSize(m_Precision);
+		if (bottom_hx != nullptr){
+			*bottom_hx = getFieldData(EMType::Hx);
+		}
+		if (bottom_hy != nullptr){
+			*bottom_hy = getFieldData(EMType::Hy);
+		}
+		if (top_hz != nullptr){
+			*top_hz = (const uint8_t*)getFieldData(EMType::Hz) + Z * m_Size.z;
+		}
+	}
+
+	// Z端部の磁界を設定する
+	void FFSolverCPU::setEdgeH(const void *top_hx, const void *top_hy, const void *bottom_hz){
+		const size_t Z = (size_t)(m_Size.x + 1) * (m_Size.y + 1) * m_Lanes * getRealSize(m_Precision);
+		if (top_hx != nullptr){
+			memcpy((uint8_t*)getFieldData(EMType::Hx) + Z * m_Size.z, top_hx, Z);
+		}
+		if (top_hy != nullptr){
+			memcpy((uint8_t*)getFieldData(EMType::Hy) + Z * m_Size.z, top_hy, Z);
 		}
 		if (bottom_hz != nullptr){
-			memcpy(m_Hz.data(), bottom_hz, sizeof(real) * Z);
+			memcpy(getFieldData(EMType::Hz), bottom_hz, Z);
+		}
+	}
+
+	// 4次精度の差分で隣接する領域へ送る接線成分を取得する
+	void FFSolverCPU::getOuterEdge(EMType type, const void **bottom, const void **top) const{
+		const size_t Z = (size_t)(m_Size.x + 1) * (m_Size.y + 1) * m_Lanes * getRealSize(m_Precision);
+		const uint8_t *field = (const uint8_t*)getFieldData(type);
+		if (bottom != nullptr){
+			*bottom = field + Z;
+		}
+		if (top != nullptr){
+			*top = field + Z * (m_Size.z - 1);
+		}
+	}
+
+	// 4次精度の差分で読む接線成分の外側の面を設定する
+	void FFSolverCPU::setOuterEdge(EMType type, const void *bottom, const void *top){
+		if (m_SpatialOrder != 4){
+			// 外側の面は4次精度の差分のときだけ確保する
+			throw FFException("Outer edge requires fourth-order spatial stencil");
+		}
+		const size_t Z = (size_t)(m_Size.x + 1) * (m_Size.y + 1) * m_Lanes * getRealSize(m_Precision);
+		uint8_t *field = (uint8_t*)getFieldData(type);
+		if (bottom != nullptr){
+			memcpy(field - Z, bottom, Z);
+		}
+		if (top != nullptr){
+			memcpy(field + Z * (m_Size.z + 1), top, Z);
+		}
+	}
+
+	// 同じ種類のソルバーを作成する
+	FFSolver* FFSolverCPU::createSubSolver(void) const{
+		FFSolverCPU *solver = new FFSolverCPU(0);
+		solver->m_KernelConfig = m_KernelConfig;
+		return solver;
+	}
+
+	// 指定した成分の値を位置のリストの順に読み出す
+	void FFSolverCPU::readFieldValues(EMType type, const std::vector<index_t> &index_list, std::vector<double> &value_list) const{
+		switch (m_Precision){
+		case Precision::Double:
+			readFieldValuesT<double>(type, index_list, value_list);
+			break;
+		case Precision::Half:
+			readFieldValuesT<half_t>(type, index_list, value_list);
+			break;
+		case Precision::BFloat16:
+			readFieldValuesT<bfloat16_t>(type, index_list, value_list);
+			break;
+		default:
+			readFieldValuesT<float>(type, index_list, value_list);
+			break;
+		}
+	}
+
+	// 格納型Tで指定した成分の値を位置のリストの順に読み出す
+	template<typename T>
+	void FFSolverCPU::readFieldValuesT(EMType type, const std::vector<index_t> &index_list, std::vector<double> &value_list) const{
+		using C = typename Fields_t<T>::compute_t;
+		const T *field = (const T*)getFieldData(type);
+		const size_t L = m_Lanes;
+		value_list.resize(index_list.size() * L);
+		for (size_t i = 0; i < index_list.size(); i++){
+			const T *src = field + (size_t)index_list[i] * L;
+			for (size_t k = 0; k < L; k++){
+				value_list[i * L + k] = (C)src[k];
+			}
+		}
+	}
+
+	// 指定した成分の値を位置のリストの順に書き込む
+	void FFSolverCPU::writeFieldValues(EMType type, const std::vector<index_t> &index_list, const std::vector<double> &value_list){
+		switch (m_Precision){
+		case Precision::Double:
+			writeFieldValuesT<double>(type, index_list, value_list);
+			break;
+		case Precision::Half:
+			writeFieldValuesT<half_t>(type, index_list, value_list);
+			break;
+		case Precision::BFloat16:
+			writeFieldValuesT<bfloat16_t>(type, index_list, value_list);
+			break;
+		default:
+			writeFieldValuesT<float>(type, index_list, value_list);
+			break;
+		}
+	}
+
+	// 格納型Tで指定した成分の値を位置のリストの順に書き込む
+	template<typename T>
+	void FFSolverCPU::writeFieldValuesT(EMType type, const std::vector<index_t> &index_list, const std::vector<double> &value_list){
+		using C = typename Fields_t<T>::compute_t;
+		T *field = (T*)getFieldData(type);
+		const size_t L = m_Lanes;
+		if (value_list.size() != index_list.size() * L){
+			throw FFException("Field value count (%u) does not match index count (%u) x lanes (%u)", (unsigned int)value_list.size(), (unsigned int)index_list.size(), (unsigned int)L);
+		}
+		// 書き込んだ行は常に0ではなくなる
+		std::vector<uint8_t> &live = getLiveRow(type);
+		const size_t Y = m_Size.x + 1;
+		for (size_t i = 0; i < index_list.size(); i++){
+			T *dst = field + (size_t)index_list[i] * L;
+			for (size_t k = 0; k < L; k++){
+				dst[k] = (T)(C)value_list[i * L + k];
+			}
+			live[index_list[i] / Y] = 1;
 		}
 	}
 
@@ -1,37 +1,209 @@
 ﻿#pragma once
 
 #include "FFSolver.h"
+#include "Basic/FFPerfCounter.h"
+#include "Basic/FFHalf.h"
+#include "Basic/FFLazyMemory.h"
+#include <type_traits>
+#include <stddef.h>
 
 
 
 namespace FFFDTD{
 	// CPUで計算するソルバーのクラス
 	class FFSolverCPU : public FFSolver{
+		/*** 定義 ***/
+	public:
+		// カーネルの実装と並列化・ブロッキングの設定
+		struct KernelConfig_t{
+			int variant;		// カーネルの実装 (KernelVariant)
+			int threads;		// スレッド数 (0のときはOpenMPの既定値)
+			int tile_y;			// ブロッキングするY方向のセル数 (KERNEL_BLOCKEDのみ)
+			int tile_z;			// ブロッキングするZ方向のセル数 (KERNEL_BLOCKEDのみ)
+			int schedule;		// ループのスケジューリング (KernelSchedule)
+			int chunk;			// スケジューリングのチャンクサイズ (SCHEDULE_STATICでは使わない)
+		};
+
+	private:
+		// カーネルのループのタイル分割
+		struct Tiling_t{
+			int tile_y, tile_z;		// 1タイルのY・Z方向のセル数
+			int num_of_tiles_y;		// Y方向のタイル数
+			int count;				// タイル数
+			int chunk;				// 1スレッドが一度に取るタイル数
+			int threads;			// スレッド数
+		};
+
+		// 活性領域に制限した計算範囲 (計算範囲の始点からの相対座標の半開区間)
+		struct ActiveRange_t{
+			int x0, x1;
+			int y0, y1;
+			int z0, z1;
+		};
+
+		// 通常空間の行 (X方向) の計算区間 (計算範囲の始点からの相対座標の半開区間)
+		struct RowSpan_t{
+			int x0, x1;
+		};
+
+		// 通常空間の行ごとの計算区間のリスト (行rowの区間はspan_list[row_start[row]]からspan_list[row_start[row + 1] - 1]まで)
+		// 行は計算範囲のY・Z方向の相対座標から (ry + range_y * rz) として数える
+		struct RowMask_t{
+			std::vector<int> row_start;
+			std::vector<RowSpan_t> span_list;
+		};
+
+		// PML空間の係数インデックスの等しいX方向に連続したセルの計算区間
+		struct PMLRun_t{
+			int index;				// 先頭のセルの電磁界成分のインデックス
+			int offset;				// 先頭のセルの、全直方体を連結した分割成分・補助変数のセル番号
+			int count;				// セル数
+			cindex2_t cindex2;		// 分割成分・補助変数の係数インデックス
+			cindex_t cindex;		// 通常空間の係数インデックス (PML空間の電界のみ。それ以外は0)
+		};
+
+		// PML空間の行 (X方向) の座標と計算区間の範囲 (run_list[run_start]からrun_list[run_end - 1]まで)
+		struct PMLRow_t{
+			index_t x0, x1;			// X方向の半開区間
+			index_t y, z;
+			int run_start, run_end;
+		};
+
+		// PML空間の行ごとの計算区間のリスト
+		struct PMLRunList_t{
+			std::vector<PMLRow_t> row_list;
+			std::vector<PMLRun_t> run_list;
+		};
+
+		// 格納型ごとの電磁界成分と係数リスト
+		// 電磁界成分は格納型Tで保持し、PMLの分割成分と係数は演算型で保持する
+		// 電磁界成分と分割成分・補助変数は0で初期化したページに格納し、常に0のままの行のページには物理メモリーを割り当てない
+		template<typename T> struct Fields_t{
+			using compute_t = typename std::conditional<std::is_same<T, double>::value, double, float>::type;
+			using vec2_t = tvec2<compute_t, highp>;
+			using vec3_t = tvec3<compute_t, highp>;
+
+			FFLazyVector<T> ex, ey, ez;							// 電界
+			FFLazyVector<T> hx, hy, hz;							// 磁界
+			size_t e_origin = 0;								// 電界の配列の先頭から原点までの要素数 (4次精度の差分で下端の1面下を読むための余白)
+			size_t h_origin = 0;								// 磁界の配列の先頭から原点までの要素数 (PMCの対称面で面の外側を0として読むための余白)
+			FFLazyVector<T> prev_x, prev_y;						// HIE法で更新前のX・Y成分 (電界と磁界の計算で使い回す。HIE法のときのみ確保する)
+			FFLazyVector<vec2_t> pml_dx, pml_dy, pml_dz;		// PML電束密度 (直方体ごとに連続して格納する)
+			FFLazyVector<vec2_t> pml_hx, pml_hy, pml_hz;		// PML磁界 (直方体ごとに連続して格納する)
+			FFLazyVector<vec2_t> cpml_ex, cpml_ey, cpml_ez;		// CPML電界の補助変数 (直方体ごとに連続して格納する)
+			FFLazyVector<vec2_t> cpml_hx, cpml_hy, cpml_hz;		// CPML磁界の補助変数 (直方体ごとに連続して格納する)
+			std::vector<vec2_t> coef2_list;						// 2組係数のリスト
+			std::vector<vec3_t> coef3_list;						// 3組係数のリスト
+		};
+
+
+
 		/*** メンバー変数 ***/
 	private:
-		// 電界
-		std::vector<real> m_Ex, m_Ey, m_Ez;
-		std::vector<cindex_t> m_ExCIndex, m_EyCIndex, m_EzCIndex;
+		// 単精度の電磁界成分と係数リスト (m_PrecisionがSingleのときのみ確保する)
+		Fields_t<float> m_Single;
+
+		// 倍精度の電磁界成分と係数リスト (m_PrecisionがDoubleのときのみ確保する)
+		Fields_t<double> m_Double;
+
+		// 半精度の電磁界成分と係数リスト (m_PrecisionがHalfのときのみ確保する)
+		Fields_t<half_t> m_Half;
+
+		// bfloat16の電磁界成分と係数リスト (m_PrecisionがBFloat16のときのみ確保する)
+		Fields_t<bfloat16_t> m_BFloat16;
+
+		// 電界の係数インデックス (updateStaticMask()の後は計算区間の外の成分を0とし、そのページには物理メモリーを割り当てない)
+		FFLazyVector<cindex_t> m_ExCIndex, m_EyCIndex, m_EzCIndex;
+
+		// 磁界の係数インデックス (電界と同様)
+		FFLazyVector<cindex_t> m_HxCIndex, m_HyCIndex, m_HzCIndex;
+
+		// 電界の行ごとの計算区間 (常に0のままの成分を除いたもの)
+		RowMask_t m_ExMask, m_EyMask, m_EzMask;
+
+		// 磁界の行ごとの計算区間
+		RowMask_t m_HxMask, m_HyMask, m_HzMask;
 
-		// 磁界
-		std::vector<real> m_Hx, m_Hy, m_Hz;
-		std::vector<cindex_t> m_HxCIndex, m_HyCIndex, m_HzCIndex;
+		// 電界・磁界の配列の行 (iy + (Size.y + 1) * iz) ごとの、値が0でなくなりうるか
+		// 0の行は計算せず書き込まれないため、絶対合計値の計算でも読まずにページを割り当てないままとする
+		std::vector<uint8_t> m_ExLiveRow, m_EyLiveRow, m_EzLiveRow;
+		std::vector<uint8_t> m_HxLiveRow, m_HyLiveRow, m_HzLiveRow;
 
-		// PML電束密度
-		std::vector<rvec2> m_PMLDx, m_PMLDy, m_PMLDz;
-		std::vector<cindex2_t> m_PMLDxCIndex, m_PMLDyCIndex, m_PMLDzCIndex;
-		std::vector<index_t> m_PMLDxIndex, m_PMLDyIndex, m_PMLDzIndex;
+		// 4次精度の差分で補正する電界の行ごとの計算区間 (空間差分の次数が4のときのみ使う)
+		RowMask_t m_ExHighOrderMask, m_EyHighOrderMask, m_EzHighOrderMask;
 
-		// PML磁界
-		std::vector<rvec2> m_PMLHx, m_PMLHy, m_PMLHz;
-		std::vector<cindex2_t> m_PMLHxCIndex, m_PMLHyCIndex, m_PMLHzCIndex;
-		std::vector<index_t> m_PMLHxIndex, m_PMLHyIndex, m_PMLHzIndex;
+		// 4次精度の差分で補正する磁界の行ごとの計算区間 (隣り合う2つの補正する電界成分を1組以上参照する成分)
+		RowMask_t m_HxHighOrderMask, m_HyHighOrderMask, m_HzHighOrderMask;
 
-		// 2組係数のリスト
-		std::vector<rvec2> m_Coef2List;
+		// 4次精度の差分で補正する電界成分のフラグ (Z方向に上下1面ずつ余分に持ち、先頭はローカル領域の1面下とする)
+		// 隣り合う2つのフラグがともに0でない位置だけで2階差分の補正を使い、電界と磁界の補正を互いに随伴な差分とする
+		std::vector<uint8_t> m_ExHighOrderFlag, m_EyHighOrderFlag, m_EzHighOrderFlag;
+
+		// PML電束密度の直方体と係数インデックス (常に0の電界成分の判定に使う)
+		std::vector<PMLBox_t> m_PMLDxBoxList, m_PMLDyBoxList, m_PMLDzBoxList;
+
+		// PML電束密度・PML磁界の行ごとの計算区間
+		PMLRunList_t m_PMLDxRunList, m_PMLDyRunList, m_PMLDzRunList;
+		PMLRunList_t m_PMLHxRunList, m_PMLHyRunList, m_PMLHzRunList;
+
+		// CPML電界・CPML磁界の補助変数の行ごとの計算区間
+		PMLRunList_t m_CPMLExRunList, m_CPMLEyRunList, m_CPMLEzRunList;
+		PMLRunList_t m_CPMLHxRunList, m_CPMLHyRunList, m_CPMLHzRunList;
+
+		// 係数リストのエントリーごとの、全レーンの係数が0か (PECの電界の係数)
+		std::vector<bool> m_ZeroCoef2, m_ZeroCoef3;
+
+		// 係数リストの1エントリーあたりの係数の組数 (レーンごとに係数が異なるときはレーン数)
+		index_t m_CoefLanes;
+
+		// カーネルごとのハードウェアカウンター (nullptrのときは計測しない)
+		FFPerfCounter *m_PerfCounter;
+
+		// カーネルの実装と並列化・ブロッキングの設定
+		KernelConfig_t m_KernelConfig;
+
+		// 計算するカーネルのビットマスク (ビット位置はPerfKernel)
+		uint32_t m_KernelMask;
+
+
+
+		/*** 定数 ***/
+	public:
+		// カーネルの種類 (ハードウェアカウンターでの計測とベンチマークでの選択に使う)
+		enum PerfKernel : int{
+			PERF_EX = 0, PERF_EY, PERF_EZ,
+			PERF_PML_EX, PERF_PML_EY, PERF_PML_EZ,
+			PERF_HX, PERF_HY, PERF_HZ,
+			PERF_PML_HX, PERF_PML_HY, PERF_PML_HZ,
+			NUM_OF_PERF_KERNELS
+		};
 
-		// 3組係数のリスト
-		std::vector<rvec3> m_Coef3List;
+		// カーネルの実装
+		// 新しい実装はここに追加し、ベンチマークで基準の実装と結果を照合すること
+		enum KernelVariant : int{
+			KERNEL_REFERENCE = 0,	// 基準の実装 (Z方向の1スライスごとに分割する)
+			KERNEL_BLOCKED,			// Y・Z方向にタイル分割してキャッシュ上で再利用する実装
+			NUM_OF_KERNEL_VARIANTS
+		};
+
+		// ループのスケジューリング
+		enum KernelSchedule : int{
+			SCHEDULE_STATIC = 0,
+			SCHEDULE_DYNAMIC,
+			NUM_OF_KERNEL_SCHEDULES
+		};
+
+		// 全カーネルを計算するビットマスク
+		static const uint32_t ALL_KERNELS = (1u << NUM_OF_PERF_KERNELS) - 1;
+
+		// 調整で1つの設定を計測する最短回数
+		static const int TUNE_MIN_REPS = 3;
+
+		// 調整で1つの設定を計測する最短時間[s]
+		static const double TUNE_MIN_TIME;
+
+		// 行の途中で計算を省く常に0の成分の最少の連続数 (短い区間に細かく分けると分岐が増えるため)
+		static const int MASK_MIN_GAP = 8;
 
 
 
@@ -57,14 +229,23 @@ namespace FFFDTD{
 		// 電界・磁界の絶対合計値を計算する
 		dvec2 calcTotalEM(void) override;
 
+		// 直方体[start, end]の内部と表面の電界・磁界の絶対合計値を計算する
+		dvec2 calcTotalEM(const index3_t &start, const index3_t &end) override;
+
 		// 電磁界成分を格納するメモリーを確保し初期化する
-		void initializeMemory(const index3_t &size, const index3_t &offset_m, const index3_t &offset_n, const index3_t &range_m, const index3_t &range_n) override;
+		void initializeMemory(const index3_t &size, const index3_t &offset_m, const index3_t &offset_n, const index3_t &range_m, const index3_t &range_n, index_t lanes, Precision precision) override;
 
 		// 係数インデックスを格納する
-		void storeCoefficientIndex(EMType type, const std::vector<cindex_t> &normal_cindex, const std::vector<cindex2_t> &pml_cindex, const std::vector<index_t> &pml_index) override;
+		void storeCoefficientIndex(EMType type, const std::vector<cindex_t> &normal_cindex, const std::vector<PMLBox_t> &pml_box_list, const std::vector<PMLBox_t> &cpml_box_list) override;
 
 		// 係数リストを格納する
-		void storeCoefficientList(const std::vector<rvec2> &coef2_list, const std::vector<rvec3> &coef3_list) override;
+		void storeCoefficientList(const std::vector<dvec2> &coef2_list, const std::vector<dvec3> &coef3_list, index_t coef_lanes) override;
+
+		// 更新しても常に0のままの成分を求め、行ごとの計算区間から除く
+		void updateStaticMask(void) override;
+
+		// 指定した軸方向の電界・磁界のうち、4次精度の差分で補正する成分を格納する
+		void storeHighOrderMask(Axis axis, const std::vector<uint8_t> &mask) override;
 
 		// 給電と観測を行う
 		void feedAndMeasure(size_t n) override;
@@ -75,6 +256,54 @@ namespace FFFDTD{
 		// 磁界を計算する
 		void calcHField(void) override;
 
+		// ハードウェアカウンターによるカーネルごとの計測を有効にする
+		void enablePerfCounter(void) override;
+
+		// カーネルごとの計測結果をルーフラインモデルとともに表示し、集計を0にする
+		void printPerfReport(const char *title) override;
+
+		// カーネルの実装を選択する
+		void setKernelVariant(int variant);
+
+		// カーネルの実装を取得する
+		int getKernelVariant(void) const{
+			return m_KernelConfig.variant;
+		}
+
+		// カーネルの実装の名前を取得する
+		static const char* getKernelVariantName(int variant);
+
+		// カーネルの実装と並列化・ブロッキングの設定を行う
+		void setKernelConfig(const KernelConfig_t &config);
+
+		// カーネルの実装と並列化・ブロッキングの設定を取得する
+		const KernelConfig_t& getKernelConfig(void) const{
+			return m_KernelConfig;
+		}
+
+		// 既定のカーネルの設定を取得する
+		static KernelConfig_t getDefaultKernelConfig(void);
+
+		// 現在の空間のサイズに対してカーネルの設定を調整し、結果をキャッシュに保存する
+		// キャッシュに同じCPUと空間のサイズの結果があるときはそれを使う
+		std::string autotune(FFTuneCache &cache) override;
+
+		// 計算するカーネルをビットマスクで限定する (ベンチマーク用)
+		void setKernelMask(uint32_t mask){
+			m_KernelMask = mask;
+		}
+
+		// 電磁界成分の配列を取得する (ベンチマーク用)
+		// 各成分はセルごとにレーン数分の値を連続して格納し、(Size.x + 1) * (Size.y + 1) * (Size.z + 1) * Lanes個の要素を持つ
+		// 空間差分の次数が4のときは、前後に1面ずつZ端部の外側の面を持つ
+		// 要素の型はgetPrecision()の精度に従う
+		void* getFieldData(EMType type);
+
+		// 電磁界成分の配列を取得する
+		const void* getFieldData(EMType type) const{
+			return const_cast<FFSolverCPU*>(this)->getFieldData(type);
+		}
+
 		// 端部の電界を交換する
 		void exchangeEdgeE(Axis axis) override;
 
@@ -82,62 +311,204 @@ namespace FFFDTD{
 		void exchangeEdgeH(Axis axis) override;
 
 		// Z端部の電界を取得する
-		void getEdgeE(const real **top_ex, const real **top_ey, const real **bottom_ez) const override;
+		void getEdgeE(const void **top_ex, const void **top_ey, const void **bottom_ez) const override;
 
 		// Z端部の電界を設定する
-		void setEdgeE(const real *bottom_ex, const real *bottom_ey, const real *top_ez) override;
+		void setEdgeE(const void *bottom_ex, const void *bottom_ey, const void *top_ez) override;
 
 		// Z端部の磁界を取得する
-		void getEdgeH(const real **bottom_hx, const real **bottom_hy, const real **top_hz) const override;
+		void getEdgeH(const void **bottom_hx, const void **bottom_hy, const void **top_hz) const override;
 
 		// Z端部の磁界を設定する
-		void setEdgeH(const real *top_hx, const real *top_hy, const real *bottom_hz) override;
+		void setEdgeH(const void *top_hx, const void *top_hy, const void *bottom_hz) override;
+
+		// 4次精度の差分で隣接する領域へ送る接線成分を取得する
+		void getOuterEdge(EMType type, const void **bottom, const void **top) const override;
+
+		// 4次精度の差分で読む接線成分の外側の面を設定する
+		void setOuterEdge(EMType type, const void *bottom, const void *top) override;
+
+		// 同じ種類のソルバーを作成する (カーネルの設定を引き継ぐ)
+		FFSolver* createSubSolver(void) const override;
+
+		// 指定した成分の値を位置のリストの順に読み出す
+		void readFieldValues(EMType type, const std::vector<index_t> &index_list, std::vector<double> &value_list) const override;
+
+		// 指定した成分の値を位置のリストの順に書き込む
+		void writeFieldValues(EMType type, const std::vector<index_t> &index_list, const std::vector<double> &value_list) override;
+
+	private:
+		// 格納型Tの電磁界成分と係数リストを取得する
+		template<typename T> Fields_t<T>& getFields(void);
+
+		// 格納型Tの電磁界成分と係数リストを確保し初期化する
+		// padは磁界の先頭の余白、haloは4次精度の差分で使う電界の先頭の余白と電磁界の末尾の余白の要素数
+		template<typename T> void allocateFields(size_t volume, size_t pad, size_t halo);
+
+		// 格納型Tの係数リストを格納する
+		template<typename T> void storeCoefficientListT(const std::vector<dvec2> &coef2_list, const std::vector<dvec3> &coef3_list);
+
+		// 格納型TのPMLの分割成分とCPMLの補助変数を確保し初期化する
+		template<typename T> void allocatePML(EMType type, size_t pml_count, size_t cpml_count);
+
+		// 格納型Tの電磁界成分の配列を取得する
+		template<typename T> void* getFieldDataT(EMType type);
+
+		// 格納型Tで電界・磁界の絶対合計値を計算する
+		template<typename T> dvec2 calcTotalEMT(void);
+
+		// 格納型Tで直方体[start, end]の内部と表面の電界・磁界の絶対合計値を計算する
+		template<typename T> dvec2 calcTotalEMT(const index3_t &start, const index3_t &end);
+
+		// X・Y方向の周期境界の端部のゴーストを埋める (is_eがtrueのときは電界、falseのときは磁界)
+		void copyPeriodicEdge(bool is_e, bool periodic_x, bool periodic_y);
+
+		// 格納型TでBloch周期境界の端部のゴーストを埋める
+		template<typename T> void copyBlochEdgeT(bool is_e, bool periodic_x, bool periodic_y);
+
+		// 成分cが軸axisの方向にm型か取得する (電界は成分の方向だけm型、磁界は成分の方向以外がm型)
+		static bool isTypeM(bool is_e, int c, int axis){
+			return (c == axis) == is_e;
+		}
+
+		// 格納型Tで時間ドメインプローブの値を測定値に書き写す
+		template<typename T> void measureTDProbes(size_t n);
+
+		// 格納型Tで時間ドメインプローブの位置の電磁界を励振する
+		template<typename T> void setTDProbeValueT(oindex_t id, index_t lane, double value);
+
+		// 格納型Tで指定した成分の値を位置のリストの順に読み出す
+		template<typename T> void readFieldValuesT(EMType type, const std::vector<index_t> &index_list, std::vector<double> &value_list) const;
+
+		// 格納型Tで指定した成分の値を位置のリストの順に書き込む
+		template<typename T> void writeFieldValuesT(EMType type, const std::vector<index_t> &index_list, const std::vector<double> &value_list);
+
+		// 格納型Tで電界を計算する
+		template<typename T> void calcEFieldT(void);
+
+		// 格納型Tで磁界を計算する
+		template<typename T> void calcHFieldT(void);
+
+		// 格納型Tと係数リストのレーン間のストライドCS、レーン数LNを指定して電界を計算する
+		// CSが0のときは全レーンで係数を共有する。LNが0のときはレーン数をm_Lanesとし、レーンのループをSIMD化する
+		template<typename T, int CS, int LN> void calcEFieldLanes(void);
+
+		// 格納型Tと係数リストのレーン間のストライドCS、レーン数LNを指定して磁界を計算する
+		template<typename T, int CS, int LN> void calcHFieldLanes(void);
+
+		// 格納型Tと係数リストのレーン間のストライドCS、レーン数LNを指定して、2次精度で計算した成分に4次精度の差分の補正を加える
+		// fieldの更新式の2つの差分をA (ストライドSA) とB (ストライドSB) の差分とし、IS_Eがtrueのときは電界、falseのときは磁界とする
+		// flag_a・flag_bはA・Bの方向に並ぶ電界成分のフラグとし、電界のときはfield自身、磁界のときはA・Bの成分のフラグを渡す
+		template<typename T, int CS, int LN, bool IS_E> void addHighOrderTerm(T *field, const T *A, ptrdiff_t SA, const T *B, ptrdiff_t SB, const uint8_t *flag_a, const uint8_t *flag_b, const cindex_t *cindex, const RowMask_t &mask, const index3_t &start, int range_x, int range_y, int range_z);
+
+		// HIE法で増分を求めるため、更新前のX・Y成分を作業領域にコピーする
+		template<typename T> void copyImplicitPrev(const T *field_x, const T *field_y);
+
+		// 格納型Tと係数リストのレーン間のストライドCSを指定して、HIE法でfieldの増分をZ方向の3重対角方程式で補正する
+		// fieldの係数のcomp番目をZ方向の差分の係数とし、Z方向に隣接する相手の成分の係数インデックスをpair_cindex、その係数のpair_comp番目を差分の係数とする
+		// 相手の成分の計算範囲はZ方向の始点pair_start_zから範囲pair_range_zとし、IS_Eがtrueのときは電界、falseのときは磁界とする
+		template<typename T, int CS, bool IS_E> void solveImplicitZ(T *field, const T *prev, const cindex_t *cindex, int comp, const cindex_t *pair_cindex, int pair_comp, const index3_t &start, int range_x, int range_y, int range_z, int pair_start_z, int pair_range_z);
+
+		// 設定に従ってY・Z方向の範囲をタイル分割する
+		Tiling_t getTiling(int range_y, int range_z) const;
+
+		// 始点startから範囲range_x×range_y×range_zの計算範囲を活性領域に制限する
+		ActiveRange_t getActiveRange(const index3_t &start, int range_x, int range_y, int range_z) const;
+
+		// 範囲range_x×range_y×range_zの計算範囲の全体を計算する行ごとの計算区間を作成する
+		static RowMask_t createFullRowMask(int range_x, int range_y, int range_z);
+
+		// 始点startから範囲range_x×range_y×range_zの計算範囲について、is_zeroがtrueの成分を除いた行ごとの計算区間を作成する
+		// 行の途中でis_zeroがtrueの成分はmin_gap個以上連続するときだけ除く
+		template<typename F> static RowMask_t createRowMask(const index3_t &start, int range_x, int range_y, int range_z, int stride_y, int stride_z, int min_gap, F is_zero);
+
+		// PML空間の直方体のリストを、係数インデックスの等しいX方向に連続したセルの計算区間に分ける
+		// normal_cindexがnullptrでないときは、通常空間の係数インデックスも等しいセルを1つの区間とする
+		PMLRunList_t createPMLRunList(const std::vector<PMLBox_t> &box_list, const cindex_t *normal_cindex) const;
+
+		// PML空間の区間のリストから、全てのセルでis_zeroがtrueとなる区間を除く
+		// zero_coefがtrueのときは、分割成分・補助変数の2組の係数がともに全レーンで0の区間だけを除く
+		template<typename F> PMLRunList_t removeZeroPMLRuns(const PMLRunList_t &list, bool zero_coef, F is_zero) const;
+
+		// 成分typeの行ごとの値が0でなくなりうるかのフラグを取得する
+		std::vector<uint8_t>& getLiveRow(EMType type);
+
+		// 並列領域の中で、PML空間の行のうち活性領域に重なるものを分担して計算する (nowaitのため終了を待たない)
+		// CS・LNはcalcEFieldLanes()と同じとする
+		// updateには成分のインデックス、分割成分・補助変数のインデックス、2組の分割成分の係数と通常空間の係数を渡す
+		template<typename V, int CS, int LN, typename F> void updatePMLRuns(const PMLRunList_t &list, const V *coef2_list, F update) const;
+
+		// 並列領域を開いてPML空間の計算updateを呼び出し、カーネルとして計測する
+		template<typename F> void runPMLKernel(PerfKernel kernel, uint64_t count, F update);
+
+		// 並列ループのスレッド数を取得する
+		int getThreads(void) const;
+
+		// count回の並列ループで1スレッドが一度に取るチャンクサイズを取得する
+		int getChunk(int count) const;
+
+		// 電界と磁界の計算1ステップの処理時間[s]を計測する
+		double measureStepTime(void);
+
+		// カーネルを計算するか取得する
+		bool isKernelEnabled(PerfKernel kernel) const{
+			return (m_KernelMask & (1u << kernel)) != 0;
+		}
+
+		// カーネルの計測を開始する
+		void beginKernel(void){
+			if (m_PerfCounter != nullptr){
+				m_PerfCounter->begin();
+			}
+		}
+
+		// カーネルの計測を終了する
+		// countは更新した成分数 (レーンは含めない)
+		void endKernel(PerfKernel kernel, uint64_t count){
+			if (m_PerfCounter != nullptr){
+				recordKernel(kernel, count);
+			}
+		}
+
+		// カーネルの計測結果をモデル上の演算数・転送量とともに加算する
+		void recordKernel(PerfKernel kernel, uint64_t count);
 		
 	protected:
 		// 時間ドメインプローブの位置の電磁界を励振する
-		void setTDProbeValue(oindex_t id, real value) override;
+		void setTDProbeValue(oindex_t id, index_t lane, double value) override;
 
 	public:
+		// デバッグ用に指定した成分・座標の値を取得する
+		double getValueDebug(EMType type, index_t x, index_t y, index_t z, index_t lane = 0) const;
+
 		// デバッグ用に指定した座標のEx成分を取得する
-		real getExDebug(index_t x, index_t y, index_t z) const{
-			const index_t Y = m_Size.x + 1;
-			const index_t Z = (m_Size.x + 1) * (m_Size.y + 1);
-			return m_Ex[x + Y * y + Z * z];
+		double getExDebug(index_t x, index_t y, index_t z, index_t lane = 0) const{
+			return getValueDebug(EMType::Ex, x, y, z, lane);
 		}
 
 		// デバッグ用に指定した座標のEy成分を取得する
-		real getEyDebug(index_t x, index_t y, index_t z) const{
-			const index_t Y = m_Size.x + 1;
-			const index_t Z = (m_Size.x + 1) * (m_Size.y + 1);
-			return m_Ey[x + Y * y + Z * z];
+		double getEyDebug(index_t x, index_t y, index_t z, index_t lane = 0) const{
+			return getValueDebug(EMType::Ey, x, y, z, lane);
 		}
 
 		// デバッグ用に指定した座標のEz成分を取得する
-		real getEzDebug(index_t x, index_t y, index_t z) const{
-			const index_t Y = m_Size.x + 1;
-			const index_t Z = (m_Size.x + 1) * (m_Size.y + 1);
-			return m_Ez[x + Y * y + Z * z];
+		double getEzDebug(index_t x, index_t y, index_t z, index_t lane = 0) const{
+			return getValueDebug(EMType::Ez, x, y, z, lane);
 		}
 
 		// デバッグ用に指定した座標のHx成分を取得する
-		real getHxDebug(index_t x, index_t y, index_t z) const{
-			const index_t Y = m_Size.x + 1;
-			const index_t Z = (m_Size.x + 1) * (m_Size.y + 1);
-			return m_Hx[x + Y * y + Z * z];
+		double getHxDebug(index_t x, index_t y, index_t z, index_t lane = 0) const{
+			return getValueDebug(EMType::Hx, x, y, z, lane);
 		}
 
 		// デバッグ用に指定した座標のHy成分を取得する
-		real getHyDebug(index_t x, index_t y, index_t z) const{
-			const index_t Y = m_Size.x + 1;
-			const index_t Z = (m_Size.x + 1) * (m_Size.y + 1);
-			return m_Hy[x + Y * y + Z * z];
+		double getHyDebug(index_t x, index_t y, index_t z, index_t lane = 0) const{
+			return getValueDebug(EMType::Hy, x, y, z, lane);
 		}
 
 		// デバッグ用に指定した座標のHz成分を取得する
-		real getHzDebug(index_t x, index_t y, index_t z) const{
-			const index_t Y = m_Size.x + 1;
-			const index_t Z = (m_Size.x + 1) * (m_Size.y + 1);
-			return m_Hz[x + Y * y + Z * z];
+		double getHzDebug(index_t x, index_t y, index_t z, index_t lane = 0) const{
+			return getValueDebug(EMType::Hz, x, y, z, lane);
 		}
 	};
 }
@@ -0,0 +1,346 @@
+﻿#include "FFSubgrid.h"
+#include "FFConst.h"
+#include "Basic/FFException.h"
+#include <algorithm>
+
+
+
+namespace FFFDTD{
+	// コンストラクタ
+	FFSubgrid::FFSubgrid(FFSituation *parent, const index3_t &start, const index3_t &end)
+		: m_Parent(parent), m_Start(start), m_End(end)
+		, m_Situation()
+		, m_CouplingList(), m_EntryCount(0), m_Average(), m_DeltaH()
+	{
+		// 直方体の各セルを等分し、両側に粗いセル幅のゴーストセルを加える
+		const FFGrid *grid_list[3] = { &parent->m_GridX, &parent->m_GridY, &parent->m_GridZ };
+		std::vector<double> width_list[3];
+		for (int axis = 0; axis < 3; axis++){
+			const FFGrid &grid = *grid_list[axis];
+			std::vector<double> &width = width_list[axis];
+			width.push_back(grid.width(start[axis] - 1));
+			for (index_t i = start[axis]; i < end[axis]; i++){
+				width.insert(width.end(), SUBGRID_RATIO, grid.width(i) / SUBGRID_RATIO);
+			}
+			width.push_back(grid.width(end[axis]));
+		}
+
+		// 細かいグリッドはPECで囲み、分割せずに1つの領域として計算する
+		m_Situation.setCommunicator(parent->m_Comm);
+		m_Situation.setGrids(FFGrid(width_list[0]), FFGrid(width_list[1]), FFGrid(width_list[2]), BC_t());
+		m_Situation.setDivision(0, m_Situation.m_Size.z);
+		m_Situation.createVolumeData();
+	}
+
+	// 粗いグリッドの座標で、指定した材質IDの直方体を細かいグリッドに配置する
+	bool FFSubgrid::placeCuboid(matid_t matid, const index3_t &pos1, const index3_t &pos2){
+		// ゴーストセルを含む細かいグリッドの範囲に重ならない直方体は配置しない
+		index3_t fine1, fine2;
+		for (int axis = 0; axis < 3; axis++){
+			const index_t p1 = std::min(pos1[axis], pos2[axis]);
+			const index_t p2 = std::max(pos1[axis], pos2[axis]);
+			if ((p2 + 1 <= m_Start[axis]) || (m_End[axis] + 1 <= p1)){
+				return false;
+			}
+			fine1[axis] = toFineLine(axis, p1);
+			fine2[axis] = toFineLine(axis, p2);
+		}
+		return m_Situation.placeCuboid(matid, fine1, fine2);
+	}
+
+	// 粗いグリッドの座標で、PECワイヤーの直方体を細かいグリッドに配置する
+	bool FFSubgrid::placePECCuboid(const index3_t &pos1, const index3_t &pos2){
+		// ゴーストセルの外側のグリッドまでに重ならない直方体は配置しない
+		index3_t fine1, fine2;
+		for (int axis = 0; axis < 3; axis++){
+			const index_t p1 = std::min(pos1[axis], pos2[axis]);
+			const index_t p2 = std::max(pos1[axis], pos2[axis]);
+			if ((p2 + 1 < m_Start[axis]) || (m_End[axis] + 1 < p1)){
+				return false;
+			}
+			fine1[axis] = toFineLine(axis, p1);
+			fine2[axis] = toFineLine(axis, p2);
+		}
+		return m_Situation.placePECCuboid(fine1, fine2);
+	}
+
+	// 細かいグリッドのソルバーを構成し、境界面の結合情報を作成する
+	void FFSubgrid::configureSolver(FFSolver *solver, Precision precision){
+		const FFSituation &parent = *m_Parent;
+
+		// 材質は粗いグリッドと同じものを使う (真空は材質リストの初期化で登録される)
+		m_Situation.initializeMaterialList(parent.m_MaterialList.size());
+		for (size_t matid = FFSituation::MATID_VACUUM + 1; matid < parent.m_MaterialList.size(); matid++){
+			std::vector<FFMaterial*> mat_list;
+			for (const FFMaterial *mat : parent.m_MaterialList[matid]){
+				mat_list.push_back(new FFMaterial(*mat));
+			}
+			if (mat_list.empty() == false){
+				m_Situation.registerMaterial((matid_t)matid, mat_list);
+			}
+		}
+
+		// レーンは粗いグリッドと同じ組 (スイープ・励振ポート・Bloch周期境界の実部と虚部) とする
+		m_Situation.m_Lanes = parent.m_Lanes;
+
+		// 電磁界は境界面から入るため、全域を励振源とみなして活性領域を制限しない
+		m_Situation.m_HasSource = true;
+		m_Situation.m_SourceStart = index3_t(0, 0, 0);
+		m_Situation.m_SourceEnd = m_Situation.m_Size;
+
+		// 粗いグリッドと同じタイムステップとステップ数で計算する
+		m_Situation.configureSolver(solver, parent.m_Timestep, parent.m_NT, std::vector<double>(), precision);
+
+		// 6つの面の接線電界の2成分ごとに結合情報を作成する
+		// 辺の電界は軸の番号が小さい面で書き込む
+		std::map<std::pair<int, index_t>, index_t> primary_map;
+		m_CouplingList.clear();
+		m_EntryCount = 0;
+		for (int axis = 0; axis < 3; axis++){
+			for (int side = 0; side < 2; side++){
+				for (int tau = 0; tau < 3; tau++){
+					if (tau != axis){
+						m_CouplingList.push_back(createCoupling(axis, side == 1, tau, primary_map));
+					}
+				}
+			}
+		}
+		const index_t L = parent.m_Lanes;
+		m_Average.assign((size_t)m_EntryCount * L, 0.0);
+		m_DeltaH.resize(m_CouplingList.size());
+		for (size_t i = 0; i < m_CouplingList.size(); i++){
+			Coupling_t &c = m_CouplingList[i];
+			m_DeltaH[i].assign(c.correct_entry.size() * L, 0.0);
+			c.coarse_value.assign(std::max({ c.coarse_h.size(), c.correct_h.size(), c.write_e.size() }) * L, 0.0);
+			c.fine_value.assign(c.fine_e.size() * L, 0.0);
+		}
+	}
+
+	// 給電・計測を行う
+	void FFSubgrid::feedAndMeasure(void){
+		m_Situation.executeSolverStep1();
+	}
+
+	// 細かいグリッドの磁界を計算する
+	void FFSubgrid::calcHField(void){
+		m_Situation.executeSolverStep2();
+	}
+
+	// 粗いグリッドと細かいグリッドの磁界を結合する
+	// 結合ごとに読み書きする成分は重ならないため、結合を並列に処理する
+	void FFSubgrid::coupleHField(void){
+		FFSolver *coarse = m_Parent->m_Solver;
+		FFSolver *fine = m_Situation.m_Solver;
+		const index_t L = m_Situation.m_Lanes;
+		const int NumOfCouplings = (int)m_CouplingList.size();
+#pragma omp parallel for schedule(dynamic, 1)
+		for (int i = 0; i < NumOfCouplings; i++){
+			Coupling_t &c = m_CouplingList[i];
+			std::vector<double> &coarse_h = c.coarse_value;
+			std::vector<double> &fine_h = c.fine_value;
+
+			// 辺で平均が異なる外側の磁界を補正する
+			if (c.correct_h.empty() == false){
+				const std::vector<double> &delta = m_DeltaH[i];
+				coarse->readFieldValues(c.h_type, c.correct_h, coarse_h);
+				for (size_t k = 0; k < coarse_h.size(); k++){
+					coarse_h[k] += delta[k];
+				}
+				coarse->writeFieldValues(c.h_type, c.correct_h, coarse_h);
+			}
+
+			// ゴーストセルの磁界に粗いグリッドの磁界を写す
+			coarse->readFieldValues(c.h_type, c.coarse_h, coarse_h);
+			for (size_t e = 0; e < c.coarse_h.size(); e++){
+				for (index_t n = c.fine_start[e]; n < c.fine_start[e + 1]; n++){
+					for (index_t lane = 0; lane < L; lane++){
+						fine_h[(size_t)n * L + lane] = c.pec[e] ? 0.0 : coarse_h[e * L + lane];
+					}
+				}
+			}
+			fine->writeFieldValues(c.h_type, c.fine_h, fine_h);
+		}
+	}
+
+	// 細かいグリッドの電界を計算する
+	void FFSubgrid::calcEField(void){
+		m_Situation.executeSolverStep4();
+	}
+
+	// 粗いグリッドと細かいグリッドの電界を結合する
+	// 結合ごとに書き込む成分は重ならないため、平均を求めた後に結合を並列に処理する
+	void FFSubgrid::coupleEField(void){
+		FFSolver *coarse = m_Parent->m_Solver;
+		FFSolver *fine = m_Situation.m_Solver;
+		const index_t L = m_Situation.m_Lanes;
+		const int NumOfCouplings = (int)m_CouplingList.size();
+
+		// 細かいグリッドの表面の電界の重み付き平均を求める
+#pragma omp parallel for schedule(dynamic, 1)
+		for (int i = 0; i < NumOfCouplings; i++){
+			Coupling_t &c = m_CouplingList[i];
+			std::vector<double> &fine_e = c.fine_value;
+			fine->readFieldValues(c.e_type, c.fine_e, fine_e);
+			for (size_t e = 0; e < c.coarse_h.size(); e++){
+				double *average = &m_Average[(c.base + e) * L];
+				std::fill(average, average + L, 0.0);
+				if (c.pec[e]){
+					continue;
+				}
+				for (index_t n = c.fine_start[e]; n < c.fine_start[e + 1]; n++){
+					for (index_t lane = 0; lane < L; lane++){
+						average[lane] += c.weight[n] * fine_e[(size_t)n * L + lane];
+					}
+				}
+			}
+		}
+
+		// 表面の粗いグリッドの電界を平均で置き換え、辺のもう一方の面では外側の磁界の補正量を求める
+#pragma omp parallel for schedule(dynamic, 1)
+		for (int i = 0; i < NumOfCouplings; i++){
+			Coupling_t &c = m_CouplingList[i];
+			std::vector<double> &coarse_e = c.coarse_value;
+			coarse_e.resize(c.write_entry.size() * L);
+			for (size_t w = 0; w < c.write_entry.size(); w++){
+				const double *average = &m_Average[(c.base + c.write_entry[w]) * L];
+				std::copy(average, average + L, &coarse_e[w * L]);
+			}
+			coarse->writeFieldValues(c.e_type, c.write_e, coarse_e);
+
+			std::vector<double> &delta = m_DeltaH[i];
+			for (size_t n = 0; n < c.correct_entry.size(); n++){
+				const double *average = &m_Average[(c.base + c.correct_entry[n]) * L];
+				const double *primary = &m_Average[c.primary[n] * L];
+				for (index_t lane = 0; lane < L; lane++){
+					delta[n * L + lane] = c.h_coef[n * L + lane] * (average[lane] - primary[lane]);
+				}
+			}
+		}
+	}
+
+	// ゴーストセルを除いた細かいグリッドの電磁界の絶対合計値を、粗いグリッドの1セルあたりの値に換算して計算する
+	// 細かいグリッドは粗いセル1つあたりSUBGRID_RATIOの3乗の成分を持つため、その数で割る
+	dvec2 FFSubgrid::calcTotalEM(void){
+		const index3_t start(1, 1, 1);
+		const index3_t end = m_Situation.m_Size - start;
+		dvec2 total = m_Situation.m_Solver->calcTotalEM(start, end) + m_Situation.calcSubgridTotalEM();
+		return total / (double)(SUBGRID_RATIO * SUBGRID_RATIO * SUBGRID_RATIO);
+	}
+
+	// 粗いグリッドのグリッド番号を細かいグリッドのグリッド番号に変換する
+	index_t FFSubgrid::toFineLine(int axis, index_t line) const{
+		if (line < m_Start[axis]){
+			return 0;
+		}
+		if (m_End[axis] < line){
+			return m_Situation.m_Size[axis];
+		}
+		return 1 + (line - m_Start[axis]) * SUBGRID_RATIO;
+	}
+
+	// 直方体の面の接線電界の成分tauの結合情報を作成する
+	// 粗いグリッドの表面の電界 (成分tau) を、面に垂直な軸axis・面内の直交軸sigmaの磁界 (成分sigma) が外側のセルで読む
+	FFSubgrid::Coupling_t FFSubgrid::createCoupling(int axis, bool upper, int tau, std::map<std::pair<int, index_t>, index_t> &primary_map){
+		const FFSituation &parent = *m_Parent;
+		const int sigma = 3 - axis - tau;
+		const EMType e_type_list[3] = { EMType::Ex, EMType::Ey, EMType::Ez };
+		const EMType h_type_list[3] = { EMType::Hx, EMType::Hy, EMType::Hz };
+		const FFGrid *coarse_grid[3] = { &parent.m_GridX, &parent.m_GridY, &parent.m_GridZ };
+		const FFGrid *fine_grid[3] = { &m_Situation.m_GridX, &m_Situation.m_GridY, &m_Situation.m_GridZ };
+		const index3_t &CS = parent.m_Size;
+		const index3_t &FS = m_Situation.m_Size;
+		const index_t L = parent.m_Lanes;
+		const index_t Half = SUBGRID_RATIO / 2;
+
+		// ローカル領域の位置を求める関数 (粗いグリッドはZ方向に分割しない)
+		auto coarseIndex = [&](const index3_t &pos) -> index_t{
+			return pos.x + (CS.x + 1) * (pos.y + (CS.y + 1) * pos.z);
+		};
+		auto fineIndex = [&](const index3_t &pos) -> index_t{
+			return pos.x + (FS.x + 1) * (pos.y + (FS.y + 1) * pos.z);
+		};
+
+		// 面の粗いグリッドの電界は面上のグリッド、電界を読む磁界は外側のセルにある
+		const index_t coarse_line = upper ? m_End[axis] : m_Start[axis];
+		const index_t coarse_cell = upper ? m_End[axis] : (m_Start[axis] - 1);
+		const index_t fine_line = toFineLine(axis, coarse_line);
+		const index_t fine_cell = upper ? (FS[axis] - 1) : 0;
+
+		// 外側の磁界の更新式での表面の電界の符号 (回転の向きと、電界が外側のセルの正側か負側か) と、磁界の係数に使うセル幅
+		const double sign = ((tau == (sigma + 2) % 3) ? 1.0 : -1.0) * (upper ? -1.0 : 1.0);
+		const double d = coarse_grid[axis]->width(coarse_cell);
+
+		Coupling_t c;
+		c.e_type = e_type_list[tau];
+		c.h_type = h_type_list[sigma];
+		c.base = m_EntryCount;
+		c.fine_start.push_back(0);
+		for (index_t k = m_Start[sigma]; k <= m_End[sigma]; k++){
+			for (index_t j = m_Start[tau]; j < m_End[tau]; j++){
+				index3_t pos_e, pos_h;
+				pos_e[axis] = coarse_line;
+				pos_e[tau] = j;
+				pos_e[sigma] = k;
+				pos_h = pos_e;
+				pos_h[axis] = coarse_cell;
+
+				// 粗いグリッドの表面の電界がPECのときは、平均を0としてゴーストの磁界も0にする
+				FFMaterial mat_e;
+				const bool pec = (tau == 0) ? parent.getMaterialEx(pos_e, 0, &mat_e) : ((tau == 1) ? parent.getMaterialEy(pos_e, 0, &mat_e) : parent.getMaterialEz(pos_e, 0, &mat_e));
+				const index_t entry = (index_t)c.coarse_h.size();
+				c.coarse_h.push_back(coarseIndex(pos_h));
+				c.pec.push_back(pec ? 1 : 0);
+
+				// 辺の電界は先に作成した面で書き込み、この面の外側の磁界は平均の差の分だけ補正する
+				const std::pair<int, index_t> key(tau, coarseIndex(pos_e));
+				auto it = primary_map.find(key);
+				if (it == primary_map.end()){
+					primary_map[key] = c.base + entry;
+					c.write_entry.push_back(entry);
+					c.write_e.push_back(coarseIndex(pos_e));
+				}
+				else{
+					c.correct_entry.push_back(entry);
+					c.correct_h.push_back(coarseIndex(pos_h));
+					c.primary.push_back(it->second);
+					for (index_t lane = 0; lane < L; lane++){
+						FFMaterial mat_h;
+						if (sigma == 0){
+							parent.getMaterialHx(pos_h, lane, &mat_h);
+						}
+						else if (sigma == 1){
+							parent.getMaterialHy(pos_h, lane, &mat_h);
+						}
+						else{
+							parent.getMaterialHz(pos_h, lane, &mat_h);
+						}
+						c.h_coef.push_back(-sign * mat_h.calcHCoef(parent.m_Timestep, d, d).y);
+					}
+				}
+
+				// 細かいグリッドの表面の電界は、成分の方向に粗いセルを等分したセルと、面内の直交方向に粗いグリッドkが最も近いグリッドとする
+				// 重みはセル幅とグリッド上の間隔の比とし、粗いグリッドの電界1つ分の重みの和は1となる
+				const index_t fine_j = toFineLine(tau, j);
+				const index_t fine_k = toFineLine(sigma, k);
+				const index_t fine_k1 = (k == m_Start[sigma]) ? fine_k : (fine_k - Half);
+				const index_t fine_k2 = (k == m_End[sigma]) ? fine_k : (fine_k + Half);
+				for (index_t fj = fine_j; fj < fine_j + SUBGRID_RATIO; fj++){
+					for (index_t fk = fine_k1; fk <= fine_k2; fk++){
+						index3_t fine_e, fine_h;
+						fine_e[axis] = fine_line;
+						fine_e[tau] = fj;
+						fine_e[sigma] = fk;
+						fine_h = fine_e;
+						fine_h[axis] = fine_cell;
+						c.fine_e.push_back(fineIndex(fine_e));
+						c.fine_h.push_back(fineIndex(fine_h));
+						c.weight.push_back(fine_grid[tau]->width(fj) / coarse_grid[tau]->width(j) * fine_grid[sigma]->mwidth(fk) / coarse_grid[sigma]->mwidth(k));
+					}
+				}
+				c.fine_start.push_back((index_t)c.fine_e.size());
+			}
+		}
+		m_EntryCount += (index_t)c.coarse_h.size();
+		return c;
+	}
+}
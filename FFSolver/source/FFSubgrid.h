@@ -0,0 +1,148 @@
+﻿#pragma once
+
+#include "FFSituation.h"
+#include <map>
+
+
+
+namespace FFFDTD{
+	// 粗いグリッドに埋め込んだ細分化領域 (サブグリッド) を計算するクラス
+	// 粗いグリッドの直方体[start, end] (グリッド番号の閉区間) の各セルを各軸方向にSUBGRID_RATIO等分した細かいグリッドを、
+	// 独立したFFSituationとソルバーで計算する
+	// 細かいグリッドは直方体の外側に粗いセル幅のゴーストセルを1層ずつ持ち、境界条件はPECとする
+	// ・ゴーストセルの磁界 (表面の電界が読む成分) には、最も近い位置の粗いグリッドの磁界を写す
+	// ・直方体の表面の粗いグリッドの接線電界は、細かいグリッドの表面の電界を双対セルの幅で重み付けした平均とする
+	// 2つの結合は互いに随伴となるため、結合を含めた全体は半離散のエネルギーを保存し、長時間の計算でも発散しない
+	// 直方体の辺の粗いグリッドの電界は2つの面で平均が異なるため、先に作成した面の平均を書き込み、
+	// もう一方の面の外側の磁界は平均の差の分だけ補正する
+	// 時間方向は粗いグリッドと同じタイムステップで計算する (タイムステップは細かいグリッドのクーラン条件で決まる)
+	class FFSubgrid{
+		/*** 定義 ***/
+	private:
+		// 直方体の1つの面の、接線電界の1成分の結合情報
+		// エントリーは面上の粗いグリッドの電界ごとに持ち、その電界の平均に使う細かいグリッドの電界とゴーストの磁界を持つ
+		struct Coupling_t{
+			EMType e_type;						// 電界の成分
+			EMType h_type;						// 電界を読む外側の磁界の成分
+			std::vector<index_t> coarse_h;		// 粗いグリッドで表面の電界を読む外側の磁界の位置
+			std::vector<uint8_t> pec;			// 粗いグリッドの表面の電界がPECか (PECのときは結合しない)
+			std::vector<index_t> fine_start;	// エントリーごとの細かいグリッドの成分のリストの始点 (末尾に総数を持つ)
+			std::vector<index_t> fine_e;		// 細かいグリッドの表面の電界の位置
+			std::vector<index_t> fine_h;		// 細かいグリッドのゴーストの磁界の位置
+			std::vector<double> weight;			// 細かいグリッドの表面の電界の重み
+			index_t base;						// 全ての結合のエントリーの通し番号の始点
+
+			// 表面の電界を書き込むエントリー
+			std::vector<index_t> write_entry;
+			std::vector<index_t> write_e;		// 粗いグリッドの電界の位置
+
+			// 外側の磁界を補正するエントリー
+			std::vector<index_t> correct_entry;
+			std::vector<index_t> correct_h;		// 粗いグリッドの磁界の位置
+			std::vector<index_t> primary;		// 表面の電界を書き込むエントリーの通し番号
+			std::vector<double> h_coef;			// 平均の差から磁界の補正量を求める係数 (レーン数分並べる)
+
+			// 結合ごとに確保しておく作業用の配列 (毎ステップの確保を避け、結合を並列に処理する)
+			std::vector<double> coarse_value;	// 粗いグリッドの成分の値
+			std::vector<double> fine_value;		// 細かいグリッドの成分の値
+		};
+
+
+
+		/*** メンバー変数 ***/
+	private:
+		// 埋め込み先の粗いグリッドのシミュレーション環境
+		FFSituation *m_Parent;
+
+		// 粗いグリッドでの直方体の始点と終点 (グリッド番号)
+		index3_t m_Start, m_End;
+
+		// 細かいグリッドのシミュレーション環境
+		FFSituation m_Situation;
+
+		// 結合情報のリスト
+		std::vector<Coupling_t> m_CouplingList;
+
+		// 全ての結合のエントリーの数
+		index_t m_EntryCount;
+
+		// エントリーごとの表面の電界の平均 (レーン数分並べる)
+		std::vector<double> m_Average;
+
+		// 外側の磁界の補正量 (結合ごとに補正するエントリーのレーン数分並べる)
+		std::vector<std::vector<double>> m_DeltaH;
+
+
+
+		/*** メソッド ***/
+	public:
+		// コンストラクタ
+		// 粗いグリッドの直方体[start, end]を細分化したグリッドを作成する
+		FFSubgrid(FFSituation *parent, const index3_t &start, const index3_t &end);
+
+		// 細かいグリッドのシミュレーション環境を取得する
+		FFSituation& getSituation(void){
+			return m_Situation;
+		}
+
+		// 細かいグリッドのシミュレーション環境を取得する
+		const FFSituation& getSituation(void) const{
+			return m_Situation;
+		}
+
+		// 粗いグリッドでの直方体の始点を取得する
+		const index3_t& getStart(void) const{
+			return m_Start;
+		}
+
+		// 粗いグリッドでの直方体の終点を取得する
+		const index3_t& getEnd(void) const{
+			return m_End;
+		}
+
+		// サブグリッド内の座標の原点 (直方体の始点) の細かいグリッドでのグリッド番号を取得する
+		// サブグリッド内の物体と入れ子のサブグリッドは、直方体の始点を原点とした細かいグリッド番号で指定する
+		static index3_t getOrigin(void){
+			return index3_t(1, 1, 1);
+		}
+
+		// 粗いグリッドの座標で、指定した材質IDの直方体を細かいグリッドに配置する
+		bool placeCuboid(matid_t matid, const index3_t &pos1, const index3_t &pos2);
+
+		// 粗いグリッドの座標で、PECワイヤーの直方体を細かいグリッドに配置する
+		bool placePECCuboid(const index3_t &pos1, const index3_t &pos2);
+
+		// 細かいグリッドのソルバーを構成し、境界面の結合情報を作成する
+		// 粗いグリッドのソルバーを構成した後に呼ぶこと
+		void configureSolver(FFSolver *solver, Precision precision);
+
+		// 給電・計測を行う (サブグリッドにはポートを置かないため、ステップを進めるだけとなる)
+		void feedAndMeasure(void);
+
+		// 細かいグリッドの磁界を計算する (粗いグリッドの磁界の計算と並行して呼べる)
+		void calcHField(void);
+
+		// 粗いグリッドと細かいグリッドの磁界を結合する
+		// 直方体の辺で平均が異なる外側の磁界を補正し、ゴーストセルの磁界に粗いグリッドの磁界を写す
+		void coupleHField(void);
+
+		// 細かいグリッドの電界を計算する (粗いグリッドの電界の計算と並行して呼べる)
+		void calcEField(void);
+
+		// 粗いグリッドと細かいグリッドの電界を結合する
+		// 直方体の表面の粗いグリッドの電界を細かいグリッドの電界の平均で置き換え、辺の平均の差を次の磁界の補正のために保持する
+		void coupleEField(void);
+
+		// ゴーストセルを除いた細かいグリッドの電磁界の絶対合計値を、粗いグリッドの1セルあたりの値に換算して計算する
+		// 入れ子のサブグリッドの電磁界も含める
+		dvec2 calcTotalEM(void);
+
+	private:
+		// 粗いグリッドのグリッド番号を細かいグリッドのグリッド番号に変換する (ゴーストセルの外側は端に寄せる)
+		index_t toFineLine(int axis, index_t line) const;
+
+		// 直方体の面 (軸axisの負側か正側) の接線電界の成分tauの結合情報を作成する
+		// primary_mapは粗いグリッドの電界の成分と位置から、その電界を書き込むエントリーの通し番号を引く表とする
+		Coupling_t createCoupling(int axis, bool upper, int tau, std::map<std::pair<int, index_t>, index_t> &primary_map);
+	};
+}
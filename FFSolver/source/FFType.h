@@ -13,6 +13,14 @@ namespace FFFDTD{
 
 
 
+	// 電磁界成分の精度
+	enum class Precision{
+		Single,		// 単精度 (float)
+		Double,		// 倍精度 (double)
+		Half,		// 半精度で格納し単精度で演算する (half_t)
+		BFloat16,	// bfloat16で格納し単精度で演算する (bfloat16_t)
+	};
+
 #ifndef FFFDTD_DOUBLE_PRECISION_REAL
 	// 実数型
 	using real = float;
@@ -25,6 +33,9 @@ namespace FFFDTD{
 
 	// 実数型4次元ベクトル
 	using rvec4 = fvec4;
+
+	// 入力で指定しないときの精度
+	static const Precision DEFAULT_PRECISION = Precision::Single;
 #else
 	// 実数型
 	using real = double;
@@ -37,8 +48,44 @@ namespace FFFDTD{
 
 	// 実数型4次元ベクトル
 	using rvec4 = dvec4;
+
+	// 入力で指定しないときの精度
+	static const Precision DEFAULT_PRECISION = Precision::Double;
 #endif
 
+	// 精度に対応する格納型1要素のサイズ[byte]を取得する
+	inline size_t getRealSize(Precision precision){
+		switch (precision){
+		case Precision::Double:
+			return sizeof(double);
+		case Precision::Half:
+		case Precision::BFloat16:
+			return sizeof(uint16_t);
+		default:
+			return sizeof(float);
+		}
+	}
+
+	// 精度の名前 (入力ファイルでの表記) を取得する
+	inline const char* getPrecisionName(Precision precision){
+		switch (precision){
+		case Precision::Double:
+			return "Double";
+		case Precision::Half:
+			return "Half";
+		case Precision::BFloat16:
+			return "BFloat16";
+		default:
+			return "Single";
+		}
+	}
+
+	// 精度に対応する演算型1要素のサイズ[byte]を取得する
+	// PMLの分割成分と係数はこの型で保持する
+	inline size_t getComputeSize(Precision precision){
+		return (precision == Precision::Double) ? sizeof(double) : sizeof(float);
+	}
+
 	// 倍精度複素数型
 	using complex = std::complex<double>;
 
@@ -170,6 +217,8 @@ namespace FFFDTD{
 		PEC = 0,		// 電気壁
 		PML,			// PML境界条件
 		Periodic,		// 周期境界条件
+		PMC,			// 磁気壁 (対称面とし、結果を全体モデルに換算する)
+		PECSymmetry,	// 対称面とする電気壁 (PECと同じ計算で、結果を全体モデルに換算する)
 	};
 	
 	// プローブの情報を格納する構造体
@@ -179,6 +228,15 @@ namespace FFFDTD{
 		EMType type;
 	};
 
+	// PML空間の直方体領域を格納する構造体
+	// PML空間は通常空間を囲む最大6個の直方体に分割し、各直方体の中はX方向が連続する順にセルを並べる
+	struct PMLBox_t{
+		index3_t start;					// 始点 (ローカル領域のグリッド番号)
+		index3_t size;					// セル数
+		index_t offset;					// 全直方体を連結したときの先頭のセル番号
+		std::vector<cindex2_t> cindex;	// セルごとの分割成分の係数インデックス
+	};
+
 	// MPIタグ
 	enum class MPITag{
 		Ex,
@@ -187,7 +245,10 @@ namespace FFFDTD{
 		Hx,
 		Hy,
 		Hz,
-		
+		OuterUpX,		// 4次精度の差分で上側の領域へ送る端部から2面目の接線成分
+		OuterUpY,
+		OuterDownX,		// 4次精度の差分で下側の領域へ送る端部から2面目の接線成分
+		OuterDownY,
 
 
 	};
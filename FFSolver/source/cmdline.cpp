@@ -13,6 +13,11 @@ bool Cmdline::parse(int argc, char *argv[]){
 		ST_SOLVERPATH,
 		ST_INPUTPATH,
 		ST_OUTPUTPATH,
+		ST_SPOOLPATH,
+		ST_METRICSPATH,
+		ST_TRACEPATH,
+		ST_TRACEWINDOW,
+		ST_AUTOTUNEPATH,
 	};
 
 	bool show_help = (argc == 0);
@@ -35,9 +40,31 @@ bool Cmdline::parse(int argc, char *argv[]){
 				case 'o':
 					state = ST_OUTPUTPATH;
 					break;
+				case 'd':
+					state = ST_SPOOLPATH;
+					break;
+				case 'm':
+					state = ST_METRICSPATH;
+					break;
+				case 'c':
+					state = ST_TRACEPATH;
+					break;
+				case 'w':
+					state = ST_TRACEWINDOW;
+					break;
+				case 'a':
+					state = ST_AUTOTUNEPATH;
+					break;
+				case 'A':
+					m_TuneOnly = true;
+					state = ST_AUTOTUNEPATH;
+					break;
 				case 't':
 					m_TestMode = true;
 					break;
+				case 'p':
+					m_PerfMode = true;
+					break;
 				default:
 					printf("Unknown option '%s'\n", p);
 					break;
@@ -60,6 +87,39 @@ bool Cmdline::parse(int argc, char *argv[]){
 			state = ST_OPTION;
 			break;
 
+		case ST_SPOOLPATH:
+			m_SpoolPath = p;
+			state = ST_OPTION;
+			break;
+
+		case ST_METRICSPATH:
+			m_MetricsPath = p;
+			state = ST_OPTION;
+			break;
+
+		case ST_TRACEPATH:
+			m_TracePath = p;
+			state = ST_OPTION;
+			break;
+
+		case ST_TRACEWINDOW:
+		{
+			// "first:last"または"first:"の形式
+			unsigned long long first = 0, last = UINT64_MAX;
+			if (sscanf(p, "%llu:%llu", &first, &last) < 1){
+				printf("Invalid trace window '%s'\n", p);
+			}
+			m_TraceFirstStep = first;
+			m_TraceLastStep = last;
+			state = ST_OPTION;
+			break;
+		}
+
+		case ST_AUTOTUNEPATH:
+			m_AutotunePath = p;
+			state = ST_OPTION;
+			break;
+
 		default:
 			state = ST_OPTION;
 			break;
@@ -71,14 +131,29 @@ bool Cmdline::parse(int argc, char *argv[]){
 		puts("  -h  Display this help message");
 		puts("  -i  Path to input file (necessary)");
 		puts("  -o  Path to output file (necessary)");
+		puts("  -d  Path to spool directory to accept jobs (daemon mode)");
+		puts("  -m  Path to metrics file written in JSON Lines (in daemon mode, written per job)");
+		puts("  -c  Path to Chrome trace file of the timeline (in daemon mode, written per job)");
+		puts("  -w  Range of steps recorded in the trace as first:last (default: all steps)");
 		puts("  -t  Test solver's settings flag");
+		puts("  -p  Measure kernels with hardware counters and print roofline report");
+		puts("  -a  Path to kernel tuning cache (tune kernels at startup if not cached)");
+		puts("  -A  Path to kernel tuning cache (tune kernels for the input and exit)");
 		puts("  -s  Path to solver setting file");
 		return false;
 	}
+	if (isDaemonMode()){
+		// デーモンモードでは入力ファイルはジョブとして受け付ける
+		return true;
+	}
 	if (m_InputPath.empty()){
 		puts("Specify one input file (-i [file path])");
 		return false;
 	}
+	if (m_TuneOnly == true){
+		// 調整のみでは結果を出力しない
+		return true;
+	}
 	if (m_OutputPath.empty()){
 		puts("Specify one output file (-o [file path])");
 		return false;
@@ -15,9 +15,31 @@ private:
 	// 出力ファイルへのパス
 	std::string m_OutputPath;
 
+	// ジョブを受け付けるスプールディレクトリへのパス (空のときは入力ファイルを1回だけ処理する)
+	std::string m_SpoolPath;
+
+	// 処理時間と処理量をJSON Linesで書き出すファイルへのパス (空のときは書き出さない)
+	std::string m_MetricsPath;
+
+	// タイムラインをChrome Trace形式で書き出すファイルへのパス (空のときは記録しない)
+	std::string m_TracePath;
+
+	// タイムラインを記録するステップの範囲
+	uint64_t m_TraceFirstStep = 0;
+	uint64_t m_TraceLastStep = UINT64_MAX;
+
+	// カーネルの調整結果のキャッシュファイルへのパス (空のときは調整しない)
+	std::string m_AutotunePath;
+
+	// カーネルを調整するだけで計算しないモード
+	bool m_TuneOnly = false;
+
 	// テストモード
 	bool m_TestMode = false;
 
+	// ハードウェアカウンターでカーネルを計測するモード
+	bool m_PerfMode = false;
+
 
 
 	/*** メソッド ***/
@@ -40,8 +62,53 @@ public:
 		return m_OutputPath.c_str();
 	}
 
+	// ジョブを受け付けるスプールディレクトリへのパスを取得する
+	const char* spoolPath(void) const{
+		return m_SpoolPath.c_str();
+	}
+
+	// 処理時間と処理量を書き出すファイルへのパスを取得する
+	const std::string& metricsPath(void) const{
+		return m_MetricsPath;
+	}
+
+	// タイムラインを書き出すファイルへのパスを取得する
+	const std::string& tracePath(void) const{
+		return m_TracePath;
+	}
+
+	// タイムラインを記録する最初のステップを取得する
+	uint64_t traceFirstStep(void) const{
+		return m_TraceFirstStep;
+	}
+
+	// タイムラインを記録する最後のステップを取得する
+	uint64_t traceLastStep(void) const{
+		return m_TraceLastStep;
+	}
+
+	// カーネルの調整結果のキャッシュファイルへのパスを取得する
+	const std::string& autotunePath(void) const{
+		return m_AutotunePath;
+	}
+
+	// カーネルを調整するだけで計算しないモードか取得する
+	bool isTuneOnlyMode(void) const{
+		return m_TuneOnly;
+	}
+
+	// デーモンモードか取得する
+	bool isDaemonMode(void) const{
+		return !m_SpoolPath.empty();
+	}
+
 	// テストモードか取得する
 	bool isTestMode(void) const{
 		return m_TestMode;
 	}
+
+	// ハードウェアカウンターでカーネルを計測するモードか取得する
+	bool isPerfMode(void) const{
+		return m_PerfMode;
+	}
 };
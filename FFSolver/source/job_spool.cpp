@@ -0,0 +1,132 @@
+﻿#include "job_spool.h"
+#include <stdio.h>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+#if defined(_WIN32)
+#define NOMINMAX
+#include <Windows.h>
+#elif defined(__GNUC__)
+#include <dirent.h>
+#endif
+
+
+
+// 入力ファイルの拡張子
+static const std::string JOB_EXTENSION = ".mp";
+
+// 処理中のジョブにつける拡張子
+static const std::string RUNNING_EXTENSION = ".running";
+
+// 終了を要求するファイルの名前
+static const std::string STOP_FILENAME = "stop";
+
+
+
+// コンストラクタ
+JobSpool::JobSpool(const std::string &directory, int poll_interval)
+	: m_Directory(directory), m_PollInterval(poll_interval)
+{
+
+}
+
+// 次のジョブを待ち、処理中の入力ファイルへのパスを取得する
+bool JobSpool::waitForJob(std::string *job_path){
+	while (true){
+		std::vector<std::string> file_list = listFiles();
+		std::sort(file_list.begin(), file_list.end());
+
+		// 終了が要求されているか調べる
+		if (std::find(file_list.begin(), file_list.end(), STOP_FILENAME) != file_list.end()){
+			remove(makePath(STOP_FILENAME).c_str());
+			return false;
+		}
+
+		// 名前順で最初のジョブを処理中にする
+		for (const std::string &name : file_list){
+			if ((JOB_EXTENSION.size() < name.size()) && (name.compare(name.size() - JOB_EXTENSION.size(), JOB_EXTENSION.size(), JOB_EXTENSION) == 0)){
+				std::string path = makePath(name);
+				std::string running_path = path + RUNNING_EXTENSION;
+				if (rename(path.c_str(), running_path.c_str()) == 0){
+					*job_path = running_path;
+					return true;
+				}
+			}
+		}
+
+		std::this_thread::sleep_for(std::chrono::milliseconds(m_PollInterval));
+	}
+}
+
+// ジョブの結果を出力するファイル名の接頭辞を取得する
+std::string JobSpool::getOutputPrefix(const std::string &job_path) const{
+	// "name.mp.running"から"name_"を作る
+	size_t length = job_path.size() - RUNNING_EXTENSION.size() - JOB_EXTENSION.size();
+	return job_path.substr(0, length) + "_";
+}
+
+// ジョブを完了させる
+void JobSpool::finishJob(const std::string &job_path, bool succeeded){
+	std::string path = job_path.substr(0, job_path.size() - RUNNING_EXTENSION.size());
+	std::string finished_path = path + (succeeded ? ".done" : ".failed");
+	remove(finished_path.c_str());
+	rename(job_path.c_str(), finished_path.c_str());
+}
+
+// 処理中のまま残ったジョブを失敗として完了させる
+std::vector<std::string> JobSpool::recoverJobs(void){
+	std::vector<std::string> file_list = listFiles();
+	std::sort(file_list.begin(), file_list.end());
+	const std::string extension = JOB_EXTENSION + RUNNING_EXTENSION;
+	std::vector<std::string> result;
+	for (const std::string &name : file_list){
+		if ((extension.size() < name.size()) && (name.compare(name.size() - extension.size(), extension.size(), extension) == 0)){
+			std::string job_path = makePath(name);
+			finishJob(job_path, false);
+			result.push_back(job_path);
+		}
+	}
+	return result;
+}
+
+// ディレクトリ内のファイル名を列挙する
+std::vector<std::string> JobSpool::listFiles(void) const{
+	std::vector<std::string> result;
+#if defined(_WIN32)
+	WIN32_FIND_DATAA find_data;
+	HANDLE handle = FindFirstFileA(makePath("*").c_str(), &find_data);
+	if (handle != INVALID_HANDLE_VALUE){
+		do{
+			if ((find_data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) == 0){
+				result.push_back(find_data.cFileName);
+			}
+		} while (FindNextFileA(handle, &find_data) != FALSE);
+		FindClose(handle);
+	}
+#elif defined(__GNUC__)
+	DIR *dir = opendir(m_Directory.c_str());
+	if (dir != nullptr){
+		struct dirent *entry;
+		while ((entry = readdir(dir)) != nullptr){
+			if (entry->d_name[0] != '.'){
+				result.push_back(entry->d_name);
+			}
+		}
+		closedir(dir);
+	}
+#endif
+	return result;
+}
+
+// ディレクトリ内のファイルへのパスを作成する
+std::string JobSpool::makePath(const std::string &name) const{
+	if (m_Directory.empty()){
+		return name;
+	}
+	char last = m_Directory.back();
+	if ((last == '/') || (last == '\\')){
+		return m_Directory + name;
+	}
+	return m_Directory + "/" + name;
+}
@@ -0,0 +1,47 @@
+﻿#pragma once
+
+#include <string>
+#include <vector>
+
+// スプールディレクトリからジョブを受け付けるクラス
+// "*.mp"のファイルを名前順にジョブとして取り出し、処理中は"*.mp.running"、
+// 終了後は"*.mp.done"または"*.mp.failed"にリネームする
+// "stop"という名前のファイルが置かれると受け付けを終了する
+// 異常終了で"*.mp.running"のまま残ったジョブは、次の起動時に失敗として完了させる
+class JobSpool{
+	/*** メンバー変数 ***/
+private:
+	// スプールディレクトリへのパス
+	std::string m_Directory;
+
+	// ジョブの有無を調べる間隔[ms]
+	int m_PollInterval;
+
+
+
+	/*** メソッド ***/
+public:
+	// コンストラクタ
+	JobSpool(const std::string &directory, int poll_interval = 200);
+
+	// 次のジョブを待ち、処理中の入力ファイルへのパスを取得する
+	// 終了が要求されたときはfalseを返す
+	bool waitForJob(std::string *job_path);
+
+	// ジョブの結果を出力するファイル名の接頭辞を取得する
+	std::string getOutputPrefix(const std::string &job_path) const;
+
+	// ジョブを完了させる
+	void finishJob(const std::string &job_path, bool succeeded);
+
+	// 処理中のまま残ったジョブを失敗として完了させ、そのジョブへのパスのリストを取得する
+	// 同じジョブで再び異常終了しないよう、受け付け直さずに失敗とする
+	std::vector<std::string> recoverJobs(void);
+
+private:
+	// ディレクトリ内のファイル名を列挙する
+	std::vector<std::string> listFiles(void) const;
+
+	// ディレクトリ内のファイルへのパスを作成する
+	std::string makePath(const std::string &name) const;
+};
@@ -2,18 +2,23 @@
 
 #include <stdio.h>
 #include <chrono>
+#include <thread>
 #include <array>
 #include <mpi.h>
 #include <stddef.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
-#include "FFSituation.h"
+#include "FFSimulation.h"
 #include "FFSolverCPU.h"
-#include "Circuit/FFVoltageSourceComponent.h"
 #include "Basic/FFException.h"
 
 #include "cmdline.h"
 #include "solver_setting.h"
 #include "parser.h"
+#include "job_spool.h"
+#include "metrics_stream.h"
 
  
 
@@ -32,6 +37,9 @@ static const size_t HOSTNAME_LENGTH = 256;
 // ルートランク
 static const int ROOT_RANK = 0;
 
+// デーモンモードでジョブに失敗したプロセスが、他のプロセスの成否の集計への参加を待つ時間[s]
+static const int JOB_RESULT_TIMEOUT = 60;
+
 
 
 // 自プロセスのランク
@@ -52,11 +60,10 @@ static void waitForPressingAnyKey(void){
 }
 
 // 全プロセスでソルバーを作成し共有する
-static void createSolversAndGather(const char *solver_setting_filepath, std::vector<FFSolver*> &solver_list, std::vector<SOLVERINFO_t> &whole_solverinfo_list, std::vector<std::string> &hostname_list){
+static void createSolversAndGather(const char *solver_setting_filepath, std::vector<FFSolver*> &solver_list, std::vector<uint64_t> &speed_list, std::vector<SOLVERINFO_t> &whole_solverinfo_list, std::vector<std::string> &hostname_list){
 	// FFSolverを作成する
 	char hostname[HOSTNAME_LENGTH];
 	SolverSetting::getHostname(hostname, sizeof(hostname));
-	std::vector<uint64_t> speed_list;
 	SolverSetting::createSolvers(solver_setting_filepath, hostname, &solver_list, &speed_list);
 	uint32_t num_of_solvers = (uint32_t)solver_list.size();
 	if ((g_mpi_my_rank == ROOT_RANK) && (num_of_solvers == 0)){
@@ -107,9 +114,12 @@ static void loadInputFile(const char *input_filepath, std::vector<uint8_t> &inpu
 	// ファイルを読み込んで共有する
 	if (g_mpi_my_rank == ROOT_RANK){
 		// 入力ファイルを開く
+		// 失敗したときもファイルサイズを-1として共有し、全プロセスで例外を発生させる
 		FILE *fp;
 		fp = fopen(input_filepath, "rb");
 		if (fp == NULL){
+			int size_int = -1;
+			MPI_Bcast(&size_int, 1, MPI_INT, ROOT_RANK, MPI_COMM_WORLD);
 			throw FFException("Failed to open the input file");
 		}
 
@@ -117,6 +127,9 @@ static void loadInputFile(const char *input_filepath, std::vector<uint8_t> &inpu
 		fseek(fp, 0, SEEK_END);
 		size_t size = ftell(fp);
 		if (INT_MAX < size){
+			fclose(fp);
+			int size_int = -1;
+			MPI_Bcast(&size_int, 1, MPI_INT, ROOT_RANK, MPI_COMM_WORLD);
 			throw FFException("The input file is too large (maximum 2GB is allowed)");
 		}
 
@@ -134,6 +147,9 @@ static void loadInputFile(const char *input_filepath, std::vector<uint8_t> &inpu
 		// ファイルサイズを受信する
 		int size_int;
 		MPI_Bcast(&size_int, 1, MPI_INT, ROOT_RANK, MPI_COMM_WORLD);
+		if (size_int < 0){
+			throw FFException("Failed to open the input file");
+		}
 		input_data.resize(size_int);
 	}
 	// ファイルの内容を共有する
@@ -149,108 +165,319 @@ static void loadInputFile(const char *input_filepath, std::vector<uint8_t> &inpu
 	}
 }
 
-// 計算能力で処理を割り振る
-static void assignDivision(const index3_t &size, const std::vector<SOLVERINFO_t> &whole_solverinfo_list, std::vector<index_t> &whole_division_list, std::vector<FFSituation> &situation_list){
-	whole_division_list.resize(whole_solverinfo_list.size());
+// 全プロセスのタイムラインを集めてChrome Trace形式で書き出す
+static void writeTrace(const std::string &trace_path){
+	FFTrace::stop();
+	char hostname[HOSTNAME_LENGTH];
+	char process_name[HOSTNAME_LENGTH + 32];
+	SolverSetting::getHostname(hostname, sizeof(hostname));
+	snprintf(process_name, sizeof(process_name), "rank %d (%s)", g_mpi_my_rank, hostname);
+	std::string events = FFTrace::exportEvents(g_mpi_my_rank, process_name);
+
+	// ルートランクに集める
+	int length = (int)events.size();
+	std::vector<int> length_list(g_mpi_total_process), disp_list(g_mpi_total_process);
+	MPI_Gather(&length, 1, MPI_INT, length_list.data(), 1, MPI_INT, ROOT_RANK, MPI_COMM_WORLD);
+	std::string whole_events;
+	if (g_mpi_my_rank == ROOT_RANK){
+		int total_length = 0;
+		for (int p = 0; p < g_mpi_total_process; p++){
+			disp_list[p] = total_length;
+			total_length += length_list[p];
+		}
+		whole_events.resize(total_length);
+	}
+	MPI_Gatherv(events.data(), length, MPI_CHAR, &whole_events[0], length_list.data(), disp_list.data(), MPI_CHAR, ROOT_RANK, MPI_COMM_WORLD);
+	if (g_mpi_my_rank != ROOT_RANK){
+		return;
+	}
+
+	// プロセスごとのイベントをつなげて書き出す
+	FILE *fp = fopen(trace_path.c_str(), "w");
+	if (fp == nullptr){
+		printf("Failed to open the trace file '%s'\n", trace_path.c_str());
+		return;
+	}
+	fputs("{\"traceEvents\":[\n", fp);
+	for (int p = 0; p < g_mpi_total_process; p++){
+		if (0 < p){
+			fputs(",\n", fp);
+		}
+		fwrite(&whole_events[disp_list[p]], 1, length_list[p], fp);
+	}
+	fputs("\n],\"displayTimeUnit\":\"ms\"}\n", fp);
+	fclose(fp);
+}
+
+// 入力ファイルを1回シミュレーションする
+// ソルバーはFFSimulationを通して次のシミュレーションでもメモリーとともに再利用する
+// 処理時間と処理量はmetrics_pathのファイルにJSON Linesで書き出す (空のときは集計表のみ表示する)
+// タイムラインの記録が有効なときはtrace_pathのファイルにChrome Trace形式で書き出す
+// setup_onlyがtrueのときはシミュレーション環境を構成した後、計算せずに戻る (カーネルの調整用)
+static void runSimulation(FFSimulation &simulation, const char *input_filepath, const char *output_prefix, const std::string &metrics_path, const std::string &trace_path, const std::vector<SOLVERINFO_t> &whole_solverinfo_list, const std::vector<std::string> &hostname_list, bool setup_only = false){
+	// 全プロセスで時刻の原点を揃えてタイムラインの記録を開始する
+	if (FFTrace::isEnabled()){
+		MPI_Barrier(MPI_COMM_WORLD);
+		FFTrace::start();
+	}
+
+	// 入力ファイルを読み込み、シミュレーション環境をパースする
+	FFScene scene;
+	{
+		FFTraceScope trace("read_input", "io");
+		std::vector<uint8_t> mp_data;
+		mpack_tree_t mp_tree;
+		loadInputFile(input_filepath, mp_data, mp_tree);
+		try{
+			Parser::parseScene(mpack_tree_root(&mp_tree), scene);
+		}
+		catch (...){
+			mpack_tree_destroy(&mp_tree);
+			throw;
+		}
 
-	// 処理速度の合計を求める
-	uint64_t total_cps = 0;
-	for (auto &it : whole_solverinfo_list){
-		total_cps += it.getSpeed();
+		// 入力データを破棄する
+		mpack_tree_destroy(&mp_tree);
 	}
-	index_t num_of_slices = size.z;
 
-	// 処理速度の比率に従って処理スライス数を割り当てる
-	index_t cell_per_slice = size.x * size.y;
-	index_t num_of_division = 0;
-	for (size_t i = 0; i < whole_solverinfo_list.size(); i++){
-		uint64_t cps = whole_solverinfo_list[i].getSpeed();
-		whole_division_list[i] = (index_t)((num_of_slices * cps + total_cps / 2) / total_cps);
-		num_of_division += whole_division_list[i];
+	// シミュレーション環境を構成する
+	if (g_mpi_my_rank == ROOT_RANK){
+		puts("Configuring solvers...");
+		fflush(stdout);
 	}
-	while (num_of_division != num_of_slices){
+	simulation.setup(scene);
+	if (g_mpi_my_rank == ROOT_RANK){
+		// シミュレーション空間サイズを出力する
+		const index3_t &space_size = simulation.getGlobalSize();
+		puts("Situation :");
+		printf("  Space size = %u x %u x %u\n", space_size.x, space_size.y, space_size.z);
+		printf("  Cell count = %llu\n", (uint64_t)space_size.x * space_size.y * space_size.z);
+		printf("  Optimum timestep = %e s\n", simulation.getOptimumTimestep());
+
+		// 処理スライスの割り当てを出力する
+		puts("Divisions :");
+		const std::vector<index_t> &whole_division_list = simulation.getDivisionList();
+		index_t start = 0;
 		for (size_t i = 0; i < whole_solverinfo_list.size(); i++){
-			if (num_of_slices < num_of_division){
-				if (0 < whole_division_list[i]){
-					whole_division_list[i]--;
-					num_of_division--;
+			if (0 < whole_division_list[i]){
+				auto &info = whole_solverinfo_list[i];
+				int rank = info.getRank();
+				const char *hostname = hostname_list[rank].data();
+				printf("  Division[%d-%d] -> %d:%s solver%d\n", start, start + whole_division_list[i] - 1, rank, hostname, info.getIndex());
+				start += whole_division_list[i];
+			}
+		}
+
+		// 材質情報を出力する
+		puts("Materials :");
+		for (size_t i = 0; i < scene.material_list.size(); i++){
+			auto &mat_list = scene.material_list[i];
+			for (size_t lane = 0; lane < mat_list.size(); lane++){
+				const FFMaterial &mat = mat_list[lane];
+				if (mat_list.size() == 1){
+					printf("  [%d] Eps=%f, Sigma=%f, Mu=%f\n", (int)(i + 1), mat.eps_r(), mat.sigma(), mat.mu_r());
+				}
+				else{
+					printf("  [%d] Lane[%d] Eps=%f, Sigma=%f, Mu=%f\n", (int)(i + 1), (int)lane, mat.eps_r(), mat.sigma(), mat.mu_r());
 				}
 			}
-			else if ((num_of_division < num_of_slices) && (0 < whole_solverinfo_list[i].getSpeed())){
-				whole_division_list[i]++;
-				num_of_division++;
+		}
+
+		// レーンごとの励振ポートを出力する
+		for (size_t lane = 0; lane < scene.excitation_list.size(); lane++){
+			printf("  Lane[%d] excites Port[%u]\n", (int)lane, scene.excitation_list[lane]);
+		}
+		fflush(stdout);
+	}
+	if (setup_only == true){
+		MPI_Barrier(MPI_COMM_WORLD);
+		return;
+	}
+
+	// シミュレーションを行う
+	MPI_Barrier(MPI_COMM_WORLD);
+	if (g_mpi_my_rank == ROOT_RANK){
+		puts("Simulation started");
+		fflush(stdout);
+	}
+	MetricsStream metrics(metrics_path, MPI_COMM_WORLD);
+	bool result = true;
+	while (result == true){
+		size_t it = simulation.getIteration();
+		if ((it % 100) == 0){
+			dvec2 total = simulation.calcTotalEM();
+			if (g_mpi_my_rank == ROOT_RANK){
+				printf("  Step%d : E=%e, H=%e\n", (int)it, total.x, total.y);
+				fflush(stdout);
 			}
-			else if (num_of_division == num_of_slices){
-				break;
+
+			// 前回からの処理時間と処理量を書き出す
+			if (0 < it){
+				metrics.report(it, simulation.getTelemetry());
+				simulation.resetTelemetry();
 			}
 		}
+		result = simulation.step();
+	}
+	if (simulation.isExtrapolated() && (g_mpi_my_rank == ROOT_RANK)){
+		printf("  Converged at Step%d (port histories of the remaining steps are extrapolated)\n", (int)simulation.getIteration());
+		fflush(stdout);
 	}
+	metrics.report(simulation.getIteration(), simulation.getTelemetry());
+	simulation.resetTelemetry();
 
-	// メモリー容量に従って処理スライス数を調整する
-	//
-	// To Do
-	//
+	// シミュレーションを終了する
+	MPI_Barrier(MPI_COMM_WORLD);
+	if (g_mpi_my_rank == ROOT_RANK){
+		puts("Simulation finished");
+		fflush(stdout);
+	}
+	metrics.printSummary();
+
+	// カーネルごとの計測結果を表示する (計測を有効にしていないときは何も表示しない)
+	simulation.printPerfReport();
 
-	// シミュレーション空間の割り振りを決定する
-	index_t division_offset = 0;
-	for (size_t i = 0; i < whole_solverinfo_list.size(); i++){
-		auto &solverinfo = whole_solverinfo_list[i];
-		if (solverinfo.getRank() == g_mpi_my_rank){
-			uint32_t index = solverinfo.getIndex();
-			situation_list[index].setDivision(division_offset, whole_division_list[i]);
-			situation_list[index].createVolumeData();
+	// シミュレーション結果を出力する
+	double output_start = FFTelemetry::now();
+	for (size_t i = 0; i < simulation.getNumberOfPorts(); i++){
+		const FFCircuit *circuit = simulation.getPortCircuit((oindex_t)i);
+		if (circuit == nullptr){
+			continue;
 		}
-		division_offset += whole_division_list[i];
+		// Bloch周期境界では後半のレーンを前半のレーンの虚部として"_im"を付けて書き出す
+		index_t lanes = circuit->lanes();
+		index_t real_lanes = simulation.isBloch() ? (lanes / 2) : lanes;
+		for (index_t lane = 0; lane < lanes; lane++){
+			auto &voltage = circuit->getVoltageHistory(lane);
+			auto &current = circuit->getCurrentHistory(lane);
+			double dt = circuit->dt();
+			const char *part = (lane < real_lanes) ? "" : "_im";
+
+			char fname[256];
+			if (real_lanes == 1){
+				sprintf(fname, "%sport%d%s_td.txt", output_prefix, (int)i, part);
+			}
+			else{
+				sprintf(fname, "%sport%d_lane%d%s_td.txt", output_prefix, (int)i, (int)(lane % real_lanes), part);
+			}
+			FILE *fp = fopen(fname, "w");
+			if (fp == NULL) {
+				continue;
+			}
+			for (size_t n = 0; n < voltage.size(); n++){
+				fprintf(fp, "%e %e %e\n", dt * n, voltage[n], current[n]);
+			}
+			fclose(fp);
+		}
+	}
+	FFTrace::record("write_output", "io", output_start, FFTelemetry::now());
+
+	// タイムラインを書き出す
+	if (FFTrace::isEnabled()){
+		writeTrace(trace_path);
 	}
 }
 
-// ソルバーの接続情報を取得する
-static void getSolverConnection(std::vector<FFSituation> &situation_list, const std::vector<SOLVERINFO_t> &whole_solverinfo_list, std::vector<index_t> &whole_division_list, std::vector<FFSituation*> &bottom_situation, std::vector<FFSituation*> &top_situation, std::vector<int> &bottom_rank, std::vector<int> &top_rank){
-	size_t num_of_situations = situation_list.size();
-	bottom_situation.resize(num_of_situations, nullptr);
-	top_situation.resize(num_of_situations, nullptr);
-	bottom_rank.resize(num_of_situations, -1);
-	top_rank.resize(num_of_situations, -1);
-	
-	for (size_t i = 0; i < whole_solverinfo_list.size(); i++){
-		auto &solverinfo = whole_solverinfo_list[i];
-		if ((solverinfo.getRank() == g_mpi_my_rank) && (0 < whole_division_list[i])){
-			uint32_t index = solverinfo.getIndex();
-			
-			// 下に別のソルバーが接続されているか調べる
-			for (size_t j = i; 0 < j--;){
-				if (0 < whole_division_list[j]){
-					auto &bottom_solverinfo = whole_solverinfo_list[j];
-					if (bottom_solverinfo.getRank() == g_mpi_my_rank){
-						bottom_situation[index] = &situation_list[bottom_solverinfo.getIndex()];
-						//printf("  [%d] Rank[%d] Bottom section is FFSituation[%d]\n", (int)i, g_mpi_my_rank, bottom_solverinfo.getIndex());
-					}
-					else{
-						bottom_rank[index] = bottom_solverinfo.getRank();
-						//printf("  [%d] Rank[%d] Bottom section is Rank[%d]\n", (int)i, g_mpi_my_rank, bottom_solverinfo.getRank());
-					}
-					break;
-				}
+
+
+
+// スプールディレクトリのジョブを順にシミュレーションする
+// MPIとソルバーは全てのジョブで共有し、ジョブの間に再作成しない
+// 処理時間と処理量はmetrics_pathが空でなければジョブごとに"<name>_metrics.jsonl"へ書き出す
+// タイムラインは記録が有効なときジョブごとに"<name>_trace.json"へ書き出す
+static void runDaemon(FFSimulation &simulation, const char *spool_path, const std::string &metrics_path, const std::vector<SOLVERINFO_t> &whole_solverinfo_list, const std::vector<std::string> &hostname_list){
+	JobSpool spool(spool_path);
+	if (g_mpi_my_rank == ROOT_RANK){
+		// 前回のデーモンの異常終了で処理中のまま残ったジョブを失敗として完了させる
+		for (const std::string &job_path : spool.recoverJobs()){
+			printf("Job '%s' was left running and is marked as failed\n", job_path.c_str());
+		}
+		printf("Waiting for jobs in '%s'\n", spool_path);
+		fflush(stdout);
+	}
+
+	// ジョブの成否の集計は、失敗したジョブの中断された通信と混ざらないよう別のコミュニケーターで行う
+	MPI_Comm result_comm;
+	MPI_Comm_dup(MPI_COMM_WORLD, &result_comm);
+
+	while (true){
+		// 次のジョブを受け付け、入力ファイルへのパスを全プロセスで共有する
+		std::string job_path;
+		int length = -1;
+		if (g_mpi_my_rank == ROOT_RANK){
+			if (spool.waitForJob(&job_path) == true){
+				length = (int)job_path.size();
 			}
+		}
+		MPI_Bcast(&length, 1, MPI_INT, ROOT_RANK, MPI_COMM_WORLD);
+		if (length < 0){
+			break;
+		}
+		job_path.resize(length);
+		MPI_Bcast(&job_path[0], length, MPI_CHAR, ROOT_RANK, MPI_COMM_WORLD);
+		std::string output_prefix = spool.getOutputPrefix(job_path);
+		if (g_mpi_my_rank == ROOT_RANK){
+			printf("Job '%s' started\n", job_path.c_str());
+			fflush(stdout);
+		}
+
+		// ジョブをシミュレーションする
+		// 入力データの誤りは全プロセスで同じ箇所で検出されるため、失敗してもジョブの受け付けを続ける
+		bool succeeded = true;
+		try{
+			std::string job_metrics_path = metrics_path.empty() ? std::string() : (output_prefix + "metrics.jsonl");
+			std::string job_trace_path = output_prefix + "trace.json";
+			runSimulation(simulation, job_path.c_str(), output_prefix.c_str(), job_metrics_path, job_trace_path, whole_solverinfo_list, hostname_list);
+		}
+		catch (FFException &exception){
+			exception.print();
+			succeeded = false;
+		}
+		catch (std::exception &exception){
+			puts(exception.what());
+			succeeded = false;
+		}
+		catch (...){
+			puts("Job aborted with unknown reason");
+			succeeded = false;
+		}
 
-			// 上に別のソルバーが接続されているか調べる
-			for (size_t j = i + 1; j < whole_solverinfo_list.size(); j++){
-				if (0 < whole_division_list[j]){
-					auto &top_solverinfo = whole_solverinfo_list[j];
-					if (top_solverinfo.getRank() == g_mpi_my_rank){
-						top_situation[index] = &situation_list[top_solverinfo.getIndex()];
-						//printf("  [%d] Rank[%d] Top section is FFSituation[%d]\n", (int)i, g_mpi_my_rank, top_solverinfo.getIndex());
-					}
-					else{
-						top_rank[index] = top_solverinfo.getRank();
-						//printf("  [%d] Rank[%d] Top section is Rank[%d]\n", (int)i, g_mpi_my_rank, top_solverinfo.getRank());
-					}
-					break;
+		// 全プロセスの成否をまとめ、ジョブを完了させる
+		// 一部のプロセスだけが失敗したときは、他のプロセスがジョブの通信で待ち続けて集計に参加できない
+		// そのときは失敗したプロセスが一定時間で待つのをやめて全体を中断し、ジョブは次の起動時に失敗として完了させる
+		int result = succeeded ? 1 : 0;
+		int whole_result = 0;
+		MPI_Request request;
+		MPI_Iallreduce(&result, &whole_result, 1, MPI_INT, MPI_MIN, result_comm, &request);
+		if (succeeded == true){
+			MPI_Wait(&request, MPI_STATUS_IGNORE);
+		}
+		else{
+			auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(JOB_RESULT_TIMEOUT);
+			int completed = 0;
+			MPI_Test(&request, &completed, MPI_STATUS_IGNORE);
+			while (completed == 0){
+				if (deadline < std::chrono::steady_clock::now()){
+					printf("Job '%s' failed on rank %d while other ranks are still running it\n", job_path.c_str(), g_mpi_my_rank);
+					fflush(stdout);
+					MPI_Abort(MPI_COMM_WORLD, 1);
 				}
+				std::this_thread::sleep_for(std::chrono::milliseconds(10));
+				MPI_Test(&request, &completed, MPI_STATUS_IGNORE);
 			}
 		}
+		if (g_mpi_my_rank == ROOT_RANK){
+			spool.finishJob(job_path, whole_result != 0);
+			printf("Job '%s' %s\n", job_path.c_str(), (whole_result != 0) ? "finished" : "failed");
+			fflush(stdout);
+		}
+	}
+
+	MPI_Comm_free(&result_comm);
+	if (g_mpi_my_rank == ROOT_RANK){
+		puts("Daemon stopped");
+		fflush(stdout);
 	}
-	//fflush(stdout);
 }
 
 
@@ -261,6 +488,9 @@ int main(int argc, char *argv[]){
 	// 自プロセスのソルバーへのポインタのリスト
 	std::vector<FFSolver*> solver_list;
 
+	// 終了時にユーザーのキー入力を待つか
+	bool wait_key = true;
+
 	// MPIを初期化する
 	int mpi_multithread_level;
 	MPI_Init_thread(&argc, &argv, MPI_THREAD_MULTIPLE, &mpi_multithread_level);
@@ -303,9 +533,10 @@ int main(int argc, char *argv[]){
 		}
 
 		// 全プロセスでソルバーを作成し、ソルバー情報を共有する
+		std::vector<uint64_t> speed_list;					// 自プロセスのソルバーの処理速度のリスト
 		std::vector<SOLVERINFO_t> whole_solverinfo_list;	// 全体のソルバー情報のリスト
 		std::vector<std::string> hostname_list;				// ホスト名のリスト
-		createSolversAndGather(cmdline.solverSettingPath(), solver_list, whole_solverinfo_list, hostname_list);
+		createSolversAndGather(cmdline.solverSettingPath(), solver_list, speed_list, whole_solverinfo_list, hostname_list);
 		if (g_mpi_my_rank == ROOT_RANK){
 			// 全てのソルバー情報を出力する
 			puts("Solvers :");
@@ -331,183 +562,66 @@ int main(int argc, char *argv[]){
 			goto finalize;
 		}
 
-		// FFSituationを作成する
-		int num_of_solvers = (int)solver_list.size();
-		std::vector<FFSituation> situation_list(num_of_solvers);
-
-		// 入力ファイルを読み込む
-		std::vector<uint8_t> mp_data;
-		mpack_tree_t mp_tree;
-		loadInputFile(cmdline.inputPath(), mp_data, mp_tree);
-		mpack_node_t mp_root_node = mpack_tree_root(&mp_tree);
-
-		// Spaceノードをパースする
-		mpack_node_t mp_space_node = mpack_node_map_cstr(mp_root_node, "Space");
-		index3_t space_size = Parser::parseGridAndBC(mp_space_node, situation_list);
-		double num_of_voxels = (double)space_size.x * (double)space_size.y * (double)space_size.z;
-		if (g_mpi_my_rank == ROOT_RANK){
-			// シミュレーション空間サイズを出力する
-			puts("Situation :");
-			printf("  Space size = %u x %u x %u\n", space_size.x, space_size.y, space_size.z);
-			printf("  Cell count = %llu\n", (uint64_t)space_size.x * space_size.y * space_size.z);
-			fflush(stdout);
-		}
-
-		// 最適なタイムステップを計算する
-		double optimum_timestep = 0.0;
-		if (g_mpi_my_rank == ROOT_RANK){
-			optimum_timestep = situation_list[0].calcTimestep();
-			printf("  Optimum timestep = %e s\n", optimum_timestep);
-		}
-		MPI_Bcast(&optimum_timestep, 1, MPI_DOUBLE, ROOT_RANK, MPI_COMM_WORLD);
-		
-		// 計算能力で処理を割り振る
-		std::vector<index_t> whole_division_list;
-		assignDivision(space_size, whole_solverinfo_list, whole_division_list, situation_list);
-		if (g_mpi_my_rank == ROOT_RANK){
-			// 処理スライスの割り当てを出力する
-			puts("Divisions :");
-			index_t start = 0;
-			for (size_t i = 0; i < whole_solverinfo_list.size(); i++){
-				if (0 < whole_division_list[i]){
-					auto &info = whole_solverinfo_list[i];
-					int rank = info.getRank();
-					const char *hostname = hostname_list[rank].data();
-					printf("  Division[%d-%d] -> %d:%s solver%d\n", start, start + whole_division_list[i] - 1, rank, hostname, info.getIndex());
-					start += whole_division_list[i];
-				}
+		// ハードウェアカウンターでの計測のフラグを全プロセスで共有する
+		bool perfmode = cmdline.isPerfMode();
+		MPI_Bcast(&perfmode, 1, MPI_C_BOOL, ROOT_RANK, MPI_COMM_WORLD);
+		if (perfmode == true){
+			if (g_mpi_my_rank == ROOT_RANK){
+				puts("Measuring memory bandwidth...");
+				fflush(stdout);
 			}
-			fflush(stdout);
-		}
-
-		// ソルバーの接続情報を取得する
-		std::vector<FFSituation*> bottom_situation, top_situation;
-		std::vector<int> bottom_rank, top_rank;
-		getSolverConnection(situation_list, whole_solverinfo_list, whole_division_list, bottom_situation, top_situation, bottom_rank, top_rank);
-
-		// Materialノードをパースする
-		mpack_node_t mp_material_node = mpack_node_map_cstr(mp_root_node, "Material");
-		Parser::parseMaterials(mp_material_node, situation_list);
-		if (g_mpi_my_rank == ROOT_RANK){
-			// 材質情報を出力する
-			puts("Materials :");
-			size_t count = situation_list[0].getNumberOfMaterials();
-			for (size_t i = 1; i < count; i++){
-				const FFMaterial *mat = situation_list[0].getMaterialByID((matid_t)i);
-				printf("  [%d] Eps=%f, Sigma=%f, Mu=%f\n", (int)i, mat->eps_r(), mat->sigma(), mat->mu_r());
+			for (auto solver : solver_list){
+				solver->enablePerfCounter();
 			}
-			fflush(stdout);
 		}
 
-		// Objectノードをパースする
-		mpack_node_t mp_object_node = mpack_node_map_cstr(mp_root_node, "Object");
-		Parser::parseObjects(mp_object_node, situation_list);
-
-		// Portノードをパースする
-		mpack_node_t mp_port_node = mpack_node_map_cstr(mp_root_node, "Port");
-		Parser::parsePorts(mp_port_node, situation_list);
-
-		// Solverノードをパースし、ソルバーを構成する
-		if (g_mpi_my_rank == ROOT_RANK){
-			puts("Configuring solvers...");
-			fflush(stdout);
+		// タイムラインの記録の設定を全プロセスで共有する
+		uint64_t trace_setting[3] = {cmdline.tracePath().empty() ? 0ULL : 1ULL, cmdline.traceFirstStep(), cmdline.traceLastStep()};
+		MPI_Bcast(trace_setting, 3, MPI_UINT64_T, ROOT_RANK, MPI_COMM_WORLD);
+		if (trace_setting[0] != 0){
+			FFTrace::enable(trace_setting[1], trace_setting[2]);
 		}
-		mpack_node_t mp_solver_node = mpack_node_map_cstr(mp_root_node, "Solver");
-		size_t max_iteration = Parser::parseSolvers(mp_solver_node, situation_list, solver_list, optimum_timestep);
-		solver_list.clear();
 
-		// 入力データを破棄する
-		mpack_tree_destroy(&mp_tree);
-		mp_data.clear();
-
-		// シミュレーションを行う
-		MPI_Barrier(MPI_COMM_WORLD);
-		if (g_mpi_my_rank == ROOT_RANK){
-			puts("Simulation started");
-			fflush(stdout);
+#ifdef _OPENMP
+		// 自プロセスに複数のソルバーがあるときは、ソルバーごとのスレッドの中でカーネルを並列に計算させる
+		if (1 < solver_list.size()){
+			omp_set_max_active_levels(2);
 		}
-		for (size_t it = 0; it < max_iteration; it++){
-			if ((it % 100) == 0){
-				double total_e = 0.0, total_h = 0.0;
-#pragma omp parallel for reduction(+ : total_e, total_h)
-				for (int i = 0; i < num_of_solvers; i++){
-					dvec2 total = situation_list[i].calcTotalEM();
-					total_e += total.x;
-					total_h += total.y;
-				}
-				double buf[2] = {total_e, total_h};
-				if (g_mpi_my_rank == ROOT_RANK){
-					double recv_buf[2];
-					MPI_Reduce(buf, recv_buf, 2, MPI_DOUBLE, MPI_SUM, ROOT_RANK, MPI_COMM_WORLD);
-					printf("  Step%d : E=%e, H=%e\n", (int)it, recv_buf[0], recv_buf[1]);
-					fflush(stdout);
-				}
-				else{
-					MPI_Reduce(buf, nullptr, 2, MPI_DOUBLE, MPI_SUM, ROOT_RANK, MPI_COMM_WORLD);
-				}
-			}
-			bool result = true;
-#pragma omp parallel
-			{
-#pragma omp for reduction(&& : result)
-				for (int i = 0; i < num_of_solvers; i++){
-					result &= situation_list[i].executeSolverStep1();
-				}
-				if (result == true){
-#pragma omp for
-					for (int i = 0; i < num_of_solvers; i++){
-						situation_list[i].executeSolverStep2();
-					}
-#pragma omp for
-					for (int i = 0; i < num_of_solvers; i++){
-						situation_list[i].executeSolverStep3(bottom_situation[i], top_situation[i], bottom_rank[i], top_rank[i]);
-					}
-#pragma omp for
-					for (int i = 0; i < num_of_solvers; i++){
-						situation_list[i].executeSolverStep4();
-					}
-#pragma omp for
-					for (int i = 0; i < num_of_solvers; i++){
-						situation_list[i].executeSolverStep5(bottom_situation[i], top_situation[i], bottom_rank[i], top_rank[i]);
-					}
-				}
-			}
-			if (result == false){
-				break;
+#endif
+
+		// 全プロセスのソルバーでシミュレーションを行うFFSimulationを作成する
+		FFSimulation simulation(solver_list, speed_list, MPI_COMM_WORLD);
+
+		// カーネルの調整の設定を全プロセスで共有する
+		{
+			std::string autotune_path = cmdline.autotunePath();
+			int length = (int)autotune_path.size();
+			MPI_Bcast(&length, 1, MPI_INT, ROOT_RANK, MPI_COMM_WORLD);
+			autotune_path.resize(length);
+			if (0 < length){
+				MPI_Bcast(&autotune_path[0], length, MPI_CHAR, ROOT_RANK, MPI_COMM_WORLD);
 			}
+			simulation.setAutotuneCache(autotune_path);
+		}
+		bool tuneonly = cmdline.isTuneOnlyMode();
+		MPI_Bcast(&tuneonly, 1, MPI_C_BOOL, ROOT_RANK, MPI_COMM_WORLD);
+		if (tuneonly == true){
+			// 入力ファイルでシミュレーション環境を構成してカーネルを調整し、計算せずに終了する
+			runSimulation(simulation, cmdline.inputPath(), "tmp/", cmdline.metricsPath(), cmdline.tracePath(), whole_solverinfo_list, hostname_list, true);
+			goto finalize;
 		}
 
-		// シミュレーションを終了する
-		MPI_Barrier(MPI_COMM_WORLD);
-		if (g_mpi_my_rank == ROOT_RANK){
-			puts("Simulation finished");
-			fflush(stdout);
+		// デーモンモードのフラグを全プロセスで共有する
+		bool daemonmode = cmdline.isDaemonMode();
+		MPI_Bcast(&daemonmode, 1, MPI_C_BOOL, ROOT_RANK, MPI_COMM_WORLD);
+		if (daemonmode == false){
+			// 入力ファイルを1回シミュレーションする
+			runSimulation(simulation, cmdline.inputPath(), "tmp/", cmdline.metricsPath(), cmdline.tracePath(), whole_solverinfo_list, hostname_list);
 		}
-		
-		// シミュレーション結果を出力する
-		for (int i = 0; i < num_of_solvers; i++){
-			FFSituation &situation = situation_list[i];
-			std::vector<const FFPort*> port_list = situation.getPortList();
-			for (size_t i = 0; i < port_list.size(); i++){
-				if (port_list[i] == nullptr){
-					continue;
-				}
-				const FFCircuit *circuit = port_list[i]->getCircuit();
-				auto &voltage = circuit->getVoltageHistory();
-				auto &current = circuit->getCurrentHistory();
-				double dt = circuit->dt();
-
-				char fname[256];
-				sprintf(fname, "tmp/port%d_td.txt", (int)i);
-				FILE *fp = fopen(fname, "w");
-				if (fp == NULL) {
-					continue;
-				}
-				for (size_t n = 0; n < voltage.size(); n++){
-					fprintf(fp, "%e %e %e\n", dt * n, voltage[n], current[n]);
-				}
-				fclose(fp);
-			}
+		else{
+			// スプールディレクトリのジョブを順にシミュレーションする
+			runDaemon(simulation, cmdline.spoolPath(), cmdline.metricsPath(), whole_solverinfo_list, hostname_list);
+			wait_key = false;
 		}
 
 		if (g_mpi_my_rank == ROOT_RANK){
@@ -539,7 +653,9 @@ finalize:
 		delete solver;
 	}
 
-	waitForPressingAnyKey();
+	if (wait_key == true){
+		waitForPressingAnyKey();
+	}
 	
 	return 0;
 }
@@ -0,0 +1,126 @@
+﻿#include "metrics_stream.h"
+#include <algorithm>
+
+using namespace FFFDTD;
+
+
+
+// ルートランク
+static const int ROOT_RANK = 0;
+
+// 1プロセス分の集計値の個数 (区分ごとの処理時間, ステップ数, セル数, メモリー量, 送受信量, 経過時間)
+static const int RECORD_SIZE = FFTelemetry::NUM_OF_PHASES + 5;
+
+
+
+// コンストラクタ
+MetricsStream::MetricsStream(const std::string &path, MPI_Comm comm)
+	: m_Comm(comm), m_Rank(0), m_NumOfProcesses(1), m_File(nullptr)
+	, m_StartTime(FFTelemetry::now()), m_LastTime(m_StartTime)
+	, m_Total()
+{
+	MPI_Comm_rank(m_Comm, &m_Rank);
+	MPI_Comm_size(m_Comm, &m_NumOfProcesses);
+	if ((m_Rank == ROOT_RANK) && (path.empty() == false)){
+		m_File = fopen(path.c_str(), "w");
+		if (m_File == nullptr){
+			printf("Failed to open the metrics file '%s'\n", path.c_str());
+		}
+	}
+}
+
+// デストラクタ
+MetricsStream::~MetricsStream(){
+	if (m_File != nullptr){
+		fclose(m_File);
+	}
+}
+
+// 前回からの集計を全プロセスから集めて書き出す
+void MetricsStream::report(size_t step, const FFTelemetry &interval){
+	FFTraceScope trace("write_metrics", "io");
+	double now = FFTelemetry::now();
+	double wall_time = now - m_LastTime;
+	m_LastTime = now;
+	m_Total += interval;
+
+	std::vector<double> records = gather(interval, wall_time);
+	if (m_File == nullptr){
+		return;
+	}
+	for (int p = 0; p < m_NumOfProcesses; p++){
+		const double *record = &records[p * RECORD_SIZE];
+		const double *phase_time = record;
+		const double *amount = record + FFTelemetry::NUM_OF_PHASES;
+		double wall = amount[4];
+		double mpi_wait = phase_time[(int)TelemetryPhase::MPIWait];
+		fprintf(m_File, "{\"rank\":%d,\"step\":%llu,\"elapsed\":%.6f,\"wall\":%.6f,\"steps\":%.0f,\"cells_per_sec\":%.6e,\"mem_bytes\":%.0f,\"mem_bytes_per_sec\":%.6e,\"halo_bytes\":%.0f,\"mpi_wait_fraction\":%.6f,\"phases\":{",
+			p, (unsigned long long)step, now - m_StartTime, wall, amount[0],
+			(0.0 < wall) ? (amount[1] / wall) : 0.0,
+			amount[2], (0.0 < wall) ? (amount[2] / wall) : 0.0,
+			amount[3], (0.0 < wall) ? (mpi_wait / wall) : 0.0);
+		for (int i = 0; i < FFTelemetry::NUM_OF_PHASES; i++){
+			fprintf(m_File, "%s\"%s\":%.6e", (i == 0) ? "" : ",", FFTelemetry::getPhaseName((TelemetryPhase)i), phase_time[i]);
+		}
+		fputs("}}\n", m_File);
+	}
+	fflush(m_File);
+}
+
+// 累計を全プロセスから集めて集計表を表示する
+void MetricsStream::printSummary(void){
+	std::vector<double> records = gather(m_Total, FFTelemetry::now() - m_StartTime);
+	if (m_Rank != ROOT_RANK){
+		return;
+	}
+
+	// プロセスごとの処理速度を表示する
+	puts("Telemetry :");
+	puts("  Rank      Wall[s]       Cell/s   Memory[B/s]      Halo[B]  MPI wait");
+	for (int p = 0; p < m_NumOfProcesses; p++){
+		const double *record = &records[p * RECORD_SIZE];
+		const double *amount = record + FFTelemetry::NUM_OF_PHASES;
+		double wall = amount[4];
+		double mpi_wait = record[(int)TelemetryPhase::MPIWait];
+		printf("  [%2d] %12.3f %12.4e %13.4e %12.4e %8.2f%%\n", p, wall,
+			(0.0 < wall) ? (amount[1] / wall) : 0.0,
+			(0.0 < wall) ? (amount[2] / wall) : 0.0,
+			amount[3], (0.0 < wall) ? (100.0 * mpi_wait / wall) : 0.0);
+	}
+
+	// 区分ごとの処理時間のプロセス間のばらつきを表示する
+	puts("  Phase             Min[s]       Avg[s]       Max[s]  Max/Avg");
+	for (int i = 0; i < FFTelemetry::NUM_OF_PHASES; i++){
+		double min_time = records[i], max_time = records[i], sum_time = 0.0;
+		for (int p = 0; p < m_NumOfProcesses; p++){
+			double time = records[p * RECORD_SIZE + i];
+			min_time = std::min(min_time, time);
+			max_time = std::max(max_time, time);
+			sum_time += time;
+		}
+		double avg_time = sum_time / m_NumOfProcesses;
+		printf("  %-12s %12.4f %12.4f %12.4f %8.3f\n", FFTelemetry::getPhaseName((TelemetryPhase)i), min_time, avg_time, max_time, (0.0 < avg_time) ? (max_time / avg_time) : 0.0);
+	}
+	fflush(stdout);
+}
+
+// 集計を全プロセスからルートランクに集める
+std::vector<double> MetricsStream::gather(const FFTelemetry &telemetry, double wall_time) const{
+	double record[RECORD_SIZE];
+	for (int i = 0; i < FFTelemetry::NUM_OF_PHASES; i++){
+		record[i] = telemetry.getTime((TelemetryPhase)i);
+	}
+	double *amount = record + FFTelemetry::NUM_OF_PHASES;
+	amount[0] = (double)telemetry.getSteps();
+	amount[1] = (double)telemetry.getCellUpdates();
+	amount[2] = (double)telemetry.getMemoryBytes();
+	amount[3] = (double)telemetry.getHaloBytes();
+	amount[4] = wall_time;
+
+	std::vector<double> records;
+	if (m_Rank == ROOT_RANK){
+		records.resize(RECORD_SIZE * m_NumOfProcesses);
+	}
+	MPI_Gather(record, RECORD_SIZE, MPI_DOUBLE, records.data(), RECORD_SIZE, MPI_DOUBLE, ROOT_RANK, m_Comm);
+	return records;
+}
@@ -0,0 +1,56 @@
+﻿#pragma once
+
+#include "Basic/FFTelemetry.h"
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include <mpi.h>
+
+// 全プロセスの処理時間と処理量を集めて出力するクラス
+// 一定ステップごとにJSON Lines形式で1プロセス1行ずつ書き出し、終了時に集計表を表示する
+// report()とprintSummary()はコミュニケーター内の全プロセスで呼び出すこと
+class MetricsStream{
+	/*** メンバー変数 ***/
+private:
+	// コミュニケーター
+	MPI_Comm m_Comm;
+
+	// 自プロセスのランク
+	int m_Rank;
+
+	// プロセス数
+	int m_NumOfProcesses;
+
+	// 出力先のファイル (ルートランクのみ、出力しないときはnullptr)
+	FILE *m_File;
+
+	// 計測を開始した時刻[s]
+	double m_StartTime;
+
+	// 前回出力した時刻[s]
+	double m_LastTime;
+
+	// 自プロセスの累計
+	FFFDTD::FFTelemetry m_Total;
+
+
+
+	/*** メソッド ***/
+public:
+	// コンストラクタ
+	// ファイルへのパスが空のときはJSON Linesを書き出さず、集計表のみ表示する
+	MetricsStream(const std::string &path, MPI_Comm comm);
+
+	// デストラクタ
+	~MetricsStream();
+
+	// 前回からの集計を全プロセスから集めて書き出す
+	void report(size_t step, const FFFDTD::FFTelemetry &interval);
+
+	// 累計を全プロセスから集めて集計表を表示する
+	void printSummary(void);
+
+private:
+	// 集計を全プロセスからルートランクに集める
+	std::vector<double> gather(const FFFDTD::FFTelemetry &telemetry, double wall_time) const;
+};
@@ -1,7 +1,7 @@
 ﻿#include "parser.h"
 #include "FFConst.h"
 #include "Basic/FFException.h"
-#include "Circuit/FFVoltageSourceComponent.h"
+#include <algorithm>
 
 
 
@@ -35,7 +35,7 @@ namespace Parser{
 	static std::vector<T> getArray(mpack_node_t &node){
 		if (mpack_node_type(node) == mpack_type_array){
 			size_t count = mpack_node_array_length(node);
-			std::vector<double> result(count);
+			std::vector<T> result(count);
 			for (size_t i = 0; i < count; i++){
 				result[i] = func(mpack_node_array_at(node, i));
 			}
@@ -63,6 +63,44 @@ namespace Parser{
 		}
 	}
 
+	// 3軸の配列を負側と正側の面の値としてパースする
+	// 各軸の要素は両面に共通の値、または負側と正側の値の2要素の配列とする
+	template<typename V, typename F>
+	static void getFaceValues(mpack_node_t &node, V &lower, V &upper, F func){
+		if (mpack_node_array_length(node) != 3){
+			mpack_node_flag_error(node, mpack_error_type);
+			return;
+		}
+		for (int axis = 0; axis < 3; axis++){
+			mpack_node_t axis_node = mpack_node_array_at(node, axis);
+			if (mpack_node_type(axis_node) == mpack_type_array){
+				if (mpack_node_array_length(axis_node) != 2){
+					mpack_node_flag_error(axis_node, mpack_error_type);
+					return;
+				}
+				lower[axis] = func(mpack_node_array_at(axis_node, 0));
+				upper[axis] = func(mpack_node_array_at(axis_node, 1));
+			}
+			else{
+				lower[axis] = upper[axis] = func(axis_node);
+			}
+		}
+	}
+
+	// 数値または数値の配列をスイープ値のリストとしてパースする
+	// ノードが存在しないときは既定値のみを返す
+	static std::vector<double> getSweepValues(mpack_node_t &node, double default_value){
+		if (mpack_node_type(node) == mpack_type_nil){
+			return std::vector<double>(1, default_value);
+		}
+		else if (mpack_node_type(node) == mpack_type_array){
+			return getArray<double, mpack_node_double>(node);
+		}
+		else{
+			return std::vector<double>(1, mpack_node_double(node));
+		}
+	}
+
 	// ノードから文字列を取得する
 	static std::string getString(mpack_node_t &node){
 		return std::string(mpack_node_str(node), mpack_node_strlen(node));
@@ -114,11 +152,26 @@ namespace Parser{
 		return X_PLUS;
 	}
 
+	// msgpackのルートノードからシミュレーション環境全体をパースする
+	void parseScene(mpack_node_t root_node, FFScene &scene){
+		parseGridAndBC(mpack_node_map_cstr(root_node, "Space"), scene);
+		parseMaterials(mpack_node_map_cstr(root_node, "Material"), scene);
+		parseObjects(mpack_node_map_cstr(root_node, "Object"), scene.object_list);
+		parsePorts(mpack_node_map_cstr(root_node, "Port"), scene);
+
+		// サブグリッド (省略時はなし)
+		mpack_node_t subgrid_node = mpack_node_map_cstr_optional(root_node, "Subgrid");
+		if (mpack_node_type(subgrid_node) != mpack_type_nil){
+			parseSubgrids(subgrid_node, scene.subgrid_list);
+		}
+		parseSolvers(mpack_node_map_cstr(root_node, "Solver"), scene);
+	}
+
 	// msgpackノードからグリッドと境界条件をパースする
-	index3_t parseGridAndBC(mpack_node_t root_node, std::vector<FFSituation> &situation_list){
+	void parseGridAndBC(mpack_node_t root_node, FFScene &scene){
 		try{
-			FFGrid grid_x, grid_y, grid_z;
-			BC_t bc;
+			FFGrid &grid_x = scene.grid_x, &grid_y = scene.grid_y, &grid_z = scene.grid_z;
+			BC_t &bc = scene.bc;
 
 			// 文字列から境界条件を判別する
 			auto string_to_bc = [&](mpack_node_t &node) -> BoundaryCondition{
@@ -134,6 +187,12 @@ namespace Parser{
 				else if (strcmp(buf, "Periodic") == 0){
 					return BoundaryCondition::Periodic;
 				}
+				else if (strcmp(buf, "PMC") == 0){
+					return BoundaryCondition::PMC;
+				}
+				else if (strcmp(buf, "PECSymmetry") == 0){
+					return BoundaryCondition::PECSymmetry;
+				}
 				else{
 					mpack_node_flag_error(node, mpack_error_data);
 					return BoundaryCondition::PEC;
@@ -149,39 +208,71 @@ namespace Parser{
 				throw "Grid information";
 			}
 
-			// 境界条件をパースする
+			// 境界条件をパースする (面ごとに指定できる)
 			mpack_node_t bc_node = mpack_node_map_cstr(root_node, "BoundaryCondition");
-			bc.x = string_to_bc(mpack_node_array_at(bc_node, 0));
-			bc.y = string_to_bc(mpack_node_array_at(bc_node, 1));
-			bc.z = string_to_bc(mpack_node_array_at(bc_node, 2));
+			getFaceValues(bc_node, bc.lower, bc.upper, string_to_bc);
 			if (msgpackError(bc_node) != mpack_ok){
 				throw "Boundary conditions";
 			}
 
+			// 周期境界の位相差[rad]をパースする (省略時は0で、0以外の軸はBloch周期境界とする)
+			mpack_node_t phase_node = mpack_node_map_cstr_optional(root_node, "PhaseShift");
+			if (mpack_node_type(phase_node) != mpack_type_nil){
+				for (int axis = 0; axis < 3; axis++){
+					bc.phase[axis] = mpack_node_double(mpack_node_array_at(phase_node, axis));
+				}
+				if (msgpackError(phase_node) != mpack_ok){
+					throw "Phase shift";
+				}
+			}
+
 			// PMLパラメータをパースする
 			mpack_node_t pml_node = mpack_node_map_cstr_optional(root_node, "PML");
 			if (mpack_node_type(pml_node) != mpack_type_nil){
 				mpack_node_t pml_l_node = mpack_node_map_cstr(pml_node, "Layers");
 				mpack_node_t pml_m_node = mpack_node_map_cstr(pml_node, "Order");
 				mpack_node_t pml_r0_node = mpack_node_map_cstr(pml_node, "R0");
-				bc.pmlL = getVec3<index_t, mpack_node_u32>(pml_l_node);
+				getFaceValues(pml_l_node, bc.pmlLower, bc.pmlUpper, mpack_node_u32);
 				bc.pmlM = mpack_node_double(pml_m_node);
 				bc.pmlR0 = mpack_node_double(pml_r0_node);
 				if (msgpackError(pml_node) != mpack_ok){
 					throw "PML parameters";
 				}
+
+				// 軸ごとのPMLの種類 (省略時は全軸で分割型PML)
+				mpack_node_t pml_type_node = mpack_node_map_cstr_optional(pml_node, "Type");
+				if (mpack_node_type(pml_type_node) != mpack_type_nil){
+					for (int axis = 0; axis < 3; axis++){
+						mpack_node_t type_node = mpack_node_array_at(pml_type_node, axis);
+						if (compareToString(type_node, "CPML")){
+							bc.pmlCPML[axis] = true;
+						}
+						else if (compareToString(type_node, "Split")){
+							bc.pmlCPML[axis] = false;
+						}
+						else{
+							throw "Unknown PML type";
+						}
+					}
+				}
+
+				// CPMLのκとαの最大値 (省略時は既定値)
+				mpack_node_t pml_kappa_node = mpack_node_map_cstr_optional(pml_node, "Kappa");
+				if (mpack_node_type(pml_kappa_node) != mpack_type_nil){
+					bc.pmlKappa = mpack_node_double(pml_kappa_node);
+				}
+				mpack_node_t pml_alpha_node = mpack_node_map_cstr_optional(pml_node, "Alpha");
+				if (mpack_node_type(pml_alpha_node) != mpack_type_nil){
+					bc.pmlAlpha = mpack_node_double(pml_alpha_node);
+				}
+				if ((msgpackError(pml_node) != mpack_ok) || (bc.pmlKappa < 1.0) || (bc.pmlAlpha < 0.0)){
+					throw "CPML parameters";
+				}
 			}
 
 			if (msgpackError(bc_node) != mpack_ok){
 				throw "Unknown";
 			}
-
-			// FFSituationに設定する
-			for (auto &situation : situation_list){
-				situation.setGrids(grid_x, grid_y, grid_z, bc);
-			}
-
-			return index3_t(grid_x.count(), grid_y.count(), grid_z.count());
 		}
 		catch (const char *msg){
 			throw FFException("Parse error '%s'", msg);
@@ -189,16 +280,14 @@ namespace Parser{
 	}
 
 	// msgpackノードから媒質の物性情報をパースする
-	void parseMaterials(mpack_node_t root_node, std::vector<FFSituation> &situation_list){
+	void parseMaterials(mpack_node_t root_node, FFScene &scene){
 		try{
 			size_t count = mpack_node_array_length(root_node);	// この材質リストにMATID=0は含まれない
 			if (MAX_MATID < (count + 1)){
 				throw "Material count is too much";
 			}
 
-			for (auto &situation : situation_list){
-				situation.initializeMaterialList(count + 1);
-			}
+			scene.material_list.resize(count);
 
 			for (size_t i = 0; i < count; i++){
 				mpack_node_t node = mpack_node_array_at(root_node, i);
@@ -207,16 +296,30 @@ namespace Parser{
 				mpack_node_t sigma_node = mpack_node_map_cstr_optional(node, "Sigma");
 				mpack_node_t mu_node = mpack_node_map_cstr_optional(node, "Mu");
 
-				double eps = (mpack_node_type(eps_node) != mpack_type_nil) ? mpack_node_double(eps_node) : 1.0;
-				double sigma = (mpack_node_type(sigma_node) != mpack_type_nil) ? mpack_node_double(sigma_node) : 0.0;
-				double mu = (mpack_node_type(mu_node) != mpack_type_nil) ? mpack_node_double(mu_node) : 1.0;
+				std::vector<double> eps = getSweepValues(eps_node, 1.0);
+				std::vector<double> sigma = getSweepValues(sigma_node, 0.0);
+				std::vector<double> mu = getSweepValues(mu_node, 1.0);
 
 				if (msgpackError(root_node) != mpack_ok){
 					throw "Material information";
 				}
 
-				for (auto &situation : situation_list){
-					situation.registerMaterial((matid_t)(i + 1), new FFMaterial(eps, sigma, mu));
+				// 配列で指定された物性値はレーンごとにスイープする
+				size_t sweep_count = std::max(std::max(eps.size(), sigma.size()), mu.size());
+				if (((eps.size() != 1) && (eps.size() != sweep_count)) ||
+					((sigma.size() != 1) && (sigma.size() != sweep_count)) ||
+					((mu.size() != 1) && (mu.size() != sweep_count)))
+				{
+					throw "Material sweep values have different lengths";
+				}
+
+				std::vector<FFMaterial> &mat_list = scene.material_list[i];
+				mat_list.resize(sweep_count);
+				for (size_t k = 0; k < sweep_count; k++){
+					mat_list[k] = FFMaterial(
+						eps[(eps.size() == 1) ? 0 : k],
+						sigma[(sigma.size() == 1) ? 0 : k],
+						mu[(mu.size() == 1) ? 0 : k]);
 				}
 			}
 		}
@@ -226,7 +329,7 @@ namespace Parser{
 	}
 
 	// msgpackノードから物体情報をパースする
-	void parseObjects(mpack_node_t root_node, std::vector<FFSituation> &situation_list){
+	void parseObjects(mpack_node_t root_node, std::vector<FFScene::Cuboid_t> &object_list){
 		try{
 			size_t count = mpack_node_array_length(root_node);
 			for (size_t i = 0; i < count; i++){
@@ -235,7 +338,8 @@ namespace Parser{
 				mpack_node_t mat_node = mpack_node_map_cstr(node, "Material");
 				std::string type = getString(mpack_node_map_cstr(node, "Type"));
 
-				bool pec = compareToString(mat_node, "PEC");
+				// Excludeは計算を省く領域とし、内部と表面の電界を0に保つためPECとして配置する
+				bool pec = compareToString(mat_node, "PEC") || compareToString(mat_node, "Exclude");
 				matid_t matid = (pec == false) ? mpack_node_u16(mat_node) : 0;
 
 				if (msgpackError(root_node) != mpack_ok){
@@ -243,18 +347,12 @@ namespace Parser{
 				}
 
 				if (type.compare("Cuboid") == 0){
-					index3_t start = getVec3<index_t, mpack_node_u32>(mpack_node_map_cstr(node, "Start"));
-					index3_t end = getVec3<index_t, mpack_node_u32>(mpack_node_map_cstr(node, "End"));
-					if (pec == true){
-						for (auto &situation : situation_list){
-							situation.placePECCuboid(start, end);
-						}
-					}
-					else{
-						for (auto &situation : situation_list){
-							situation.placeCuboid(matid, start, end);
-						}
-					}
+					FFScene::Cuboid_t cuboid;
+					cuboid.pec = pec;
+					cuboid.matid = matid;
+					cuboid.start = getVec3<index_t, mpack_node_u32>(mpack_node_map_cstr(node, "Start"));
+					cuboid.end = getVec3<index_t, mpack_node_u32>(mpack_node_map_cstr(node, "End"));
+					object_list.push_back(cuboid);
 				}
 				else{
 					throw "Unknown object type";
@@ -270,8 +368,40 @@ namespace Parser{
 		}
 	}
 
+	// msgpackノードからサブグリッド情報を入れ子のものまでパースする
+	// 物体と入れ子のサブグリッドは、直方体の始点を原点とした細かいグリッドの座標で指定する
+	void parseSubgrids(mpack_node_t root_node, std::vector<FFScene::Subgrid_t> &subgrid_list){
+		try{
+			size_t count = mpack_node_array_length(root_node);
+			for (size_t i = 0; i < count; i++){
+				mpack_node_t node = mpack_node_array_at(root_node, i);
+
+				FFScene::Subgrid_t subgrid;
+				subgrid.start = getVec3<index_t, mpack_node_u32>(mpack_node_map_cstr(node, "Start"));
+				subgrid.end = getVec3<index_t, mpack_node_u32>(mpack_node_map_cstr(node, "End"));
+
+				if (msgpackError(root_node) != mpack_ok){
+					throw "Subgrid information";
+				}
+
+				mpack_node_t object_node = mpack_node_map_cstr_optional(node, "Object");
+				if (mpack_node_type(object_node) != mpack_type_nil){
+					parseObjects(object_node, subgrid.object_list);
+				}
+				mpack_node_t child_node = mpack_node_map_cstr_optional(node, "Subgrid");
+				if (mpack_node_type(child_node) != mpack_type_nil){
+					parseSubgrids(child_node, subgrid.subgrid_list);
+				}
+				subgrid_list.push_back(subgrid);
+			}
+		}
+		catch (const char *msg){
+			throw FFException("Parse error '%s'", msg);
+		}
+	}
+
 	// msgpackノードからポート情報をパースする
-	void parsePorts(mpack_node_t root_node, std::vector<FFSituation> &situation_list){
+	void parsePorts(mpack_node_t root_node, FFScene &scene){
 		try{
 			size_t count = mpack_node_array_length(root_node);
 			for (size_t i = 0; i < count; i++){
@@ -291,9 +421,12 @@ namespace Parser{
 					double esr = (mpack_node_type(esr_node) == mpack_type_nil) ? 0.0 : mpack_node_double(esr_node);
 					std::string waveform = getString(mpack_node_map_cstr(node, "Waveform"));
 
-					for (auto &situation : situation_list){
-						situation.placePort(pos, dir, new FFVoltageSourceComponent(new FFWaveform(waveform), esr));
-					}
+					FFScene::Port_t port;
+					port.pos = pos;
+					port.dir = dir;
+					port.waveform = waveform;
+					port.esr = esr;
+					scene.port_list.push_back(port);
 				}
 				else{
 					throw "Unknown port type";
@@ -310,29 +443,90 @@ namespace Parser{
 	}
 
 	// msgpackノードからソルバー情報をパースする
-	size_t parseSolvers(mpack_node_t root_node, std::vector<FFSituation> &situation_list, std::vector<FFSolver*> &solver_list, double optimum_timestep){
+	void parseSolvers(mpack_node_t root_node, FFScene &scene){
 		try{
-			// タイムステップ
+			// タイムステップ (文字列のときは最適なタイムステップを使う)
 			mpack_node_t timestep_node = mpack_node_map_cstr(root_node, "Timestep");
-			double timestep = (mpack_node_type(timestep_node) == mpack_type_str) ? optimum_timestep : mpack_node_double(timestep_node);
+			scene.timestep = (mpack_node_type(timestep_node) == mpack_type_str) ? 0.0 : mpack_node_double(timestep_node);
 			
 			// 解析周波数のリスト
-			std::vector<double> freq_list = getArray<double, mpack_node_double>(mpack_node_map_cstr(root_node, "Frequency"));
+			scene.freq_list = getArray<double, mpack_node_double>(mpack_node_map_cstr(root_node, "Frequency"));
 
 			// 計算ステップ数
-			size_t iteration = mpack_node_u32(mpack_node_map_cstr(root_node, "Iteration"));
+			scene.iteration = mpack_node_u32(mpack_node_map_cstr(root_node, "Iteration"));
+
+			// レーンごとに励振するポートのリスト (省略時は1レーンで全てのポートを励振する)
+			std::vector<oindex_t> &excitation_list = scene.excitation_list;
+			mpack_node_t excitation_node = mpack_node_map_cstr_optional(root_node, "Excitation");
+			if (mpack_node_type(excitation_node) != mpack_type_nil){
+				excitation_list = getArray<oindex_t, mpack_node_u32>(excitation_node);
+				if (excitation_list.empty()){
+					throw "Excitation list is empty";
+				}
+			}
 
-			if (msgpackError(root_node) != mpack_ok){
-				throw "Solver information";
+			// 電磁界成分の精度 (省略時は既定の精度)
+			mpack_node_t precision_node = mpack_node_map_cstr_optional(root_node, "Precision");
+			if (mpack_node_type(precision_node) != mpack_type_nil){
+				if (compareToString(precision_node, "Single")){
+					scene.precision = Precision::Single;
+				}
+				else if (compareToString(precision_node, "Double")){
+					scene.precision = Precision::Double;
+				}
+				else if (compareToString(precision_node, "Half")){
+					scene.precision = Precision::Half;
+				}
+				else if (compareToString(precision_node, "BFloat16")){
+					scene.precision = Precision::BFloat16;
+				}
+				else{
+					throw "Unknown precision";
+				}
 			}
 
-			// ソルバーを構成する
-#pragma omp parallel for
-			for (int i = 0; i < (int)situation_list.size(); i++){
-				situation_list[i].configureSolver(solver_list[i], timestep, iteration, freq_list);
+			// 空間差分の次数 (省略時は2次)
+			mpack_node_t order_node = mpack_node_map_cstr_optional(root_node, "SpatialOrder");
+			if (mpack_node_type(order_node) != mpack_type_nil){
+				scene.spatial_order = (int)mpack_node_u32(order_node);
+				if ((scene.spatial_order != 2) && (scene.spatial_order != 4)){
+					throw "Spatial order must be 2 or 4";
+				}
 			}
 
-			return iteration;
+			// 時間積分の方式 (省略時は陽解法)
+			mpack_node_t scheme_node = mpack_node_map_cstr_optional(root_node, "Scheme");
+			if (mpack_node_type(scheme_node) != mpack_type_nil){
+				if (compareToString(scheme_node, "Explicit")){
+					scene.implicit_z = false;
+				}
+				else if (compareToString(scheme_node, "HIE")){
+					scene.implicit_z = true;
+				}
+				else{
+					throw "Unknown scheme";
+				}
+			}
+
+			// 極・留数モデルによる打ち切り判定 (省略時は最後のステップまで計算する)
+			mpack_node_t early_stop_node = mpack_node_map_cstr_optional(root_node, "EarlyStop");
+			if (mpack_node_type(early_stop_node) != mpack_type_nil){
+				scene.early_stop_tolerance = mpack_node_double(mpack_node_map_cstr(early_stop_node, "Tolerance"));
+				if (!(0.0 < scene.early_stop_tolerance)){
+					throw "Early stop tolerance must be positive";
+				}
+				mpack_node_t max_freq_node = mpack_node_map_cstr_optional(early_stop_node, "MaxFrequency");
+				if (mpack_node_type(max_freq_node) != mpack_type_nil){
+					scene.early_stop_max_freq = mpack_node_double(max_freq_node);
+					if (!(0.0 < scene.early_stop_max_freq)){
+						throw "Early stop max frequency must be positive";
+					}
+				}
+			}
+
+			if (msgpackError(root_node) != mpack_ok){
+				throw "Solver information";
+			}
 		}
 		catch (const char *msg){
 			throw FFException("Parse error '%s'", msg);
@@ -1,6 +1,6 @@
 ﻿#pragma once
 
-#include "FFSituation.h"
+#include "FFScene.h"
 #include "mpack/mpack.h" 
 
 
@@ -8,19 +8,25 @@
 namespace Parser{
 	using namespace FFFDTD;
 
+	// msgpackのルートノードからシミュレーション環境全体をパースする
+	void parseScene(mpack_node_t root_node, FFScene &scene);
+
 	// msgpackノードからグリッドと境界条件をパースする
-	index3_t parseGridAndBC(mpack_node_t root_node, std::vector<FFSituation> &situation_list);
+	void parseGridAndBC(mpack_node_t root_node, FFScene &scene);
 
 	// msgpackノードから媒質の物性情報をパースする
-	void parseMaterials(mpack_node_t root_node, std::vector<FFSituation> &situation_list);
+	void parseMaterials(mpack_node_t root_node, FFScene &scene);
 
 	// msgpackノードから物体情報をパースする
-	void parseObjects(mpack_node_t root_node, std::vector<FFSituation> &situation_list);
+	void parseObjects(mpack_node_t root_node, std::vector<FFScene::Cuboid_t> &object_list);
+
+	// msgpackノードからサブグリッド情報を入れ子のものまでパースする
+	void parseSubgrids(mpack_node_t root_node, std::vector<FFScene::Subgrid_t> &subgrid_list);
 
 	// msgpackノードからポート情報をパースする
-	void parsePorts(mpack_node_t root_node, std::vector<FFSituation> &situation_list);
+	void parsePorts(mpack_node_t root_node, FFScene &scene);
 
-	// msgpackノードからソルバー情報をパースし、ソルバーを構成する
-	size_t parseSolvers(mpack_node_t root_node, std::vector<FFSituation> &situation_list, std::vector<FFSolver*> &solver_list, double optimum_timestep);
+	// msgpackノードからソルバー情報をパースする
+	void parseSolvers(mpack_node_t root_node, FFScene &scene);
 
 }
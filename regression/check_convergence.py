@@ -0,0 +1,93 @@
+# 4次精度の差分の格子収束を確認する
+#
+# X方向に20mm離れた2つのポートの間で50GHzの位相を測り、自由空間の位相との差 (位相誤差) を比べる
+#   grid2:  2次精度、格子幅1mm
+#   grid4:  4次精度、格子幅1mm
+#   fine2:  2次精度、格子幅0.5mm
+# 4次精度は格子幅hで、2次精度の格子幅h/2と同等以下の位相誤差となることを確認する
+# 空間はポートの軸からPMLまで32格子以上を取る (狭い空間では4次精度の内部と2次精度で計算する境界付近の層の間の
+# 位相速度の差による斜入射の反射がポートの位相に加わり、4次精度の誤差が大きく見える)
+#
+# 使い方: python3 check_convergence.py --solver <FFSolverのパス> [--mpiexec mpiexec] [--mpiarg <引数>]
+
+import argparse
+import cmath
+import math
+import os
+import shutil
+import subprocess
+import sys
+import tempfile
+
+from make_scenes import PULSE, encode
+
+# 位相を測る周波数[Hz]
+FREQUENCY = 50e9
+
+# 光速[m/s]
+LIGHT_SPEED = 2.99792458e8
+
+# X方向に並べたポート3つの自由空間 (最初のポートで励振し、残りの2つのポートの間の位相を測る)
+def line(order, d, nx, ny, layers, xs, iteration):
+	c = ny // 2
+	ports = [{"Type": "VoltageSource", "Position": [x, c, c], "Direction": "+Z", "ESR": 50.0, "Waveform": (PULSE if i == 0 else "0")} for i, x in enumerate(xs)]
+	return {
+		"Space": {"Grid": [[d]*nx, [d]*ny, [d]*ny], "BoundaryCondition": ["PML", "PML", "PML"], "PML": {"Layers": [layers]*3, "Order": 3.0, "R0": 1e-6}},
+		"Material": [{"Epsilon": 1.0}],
+		"Object": [],
+		"Port": ports,
+		"Solver": {"Timestep": "Auto", "Frequency": [1e9], "Iteration": iteration, "Excitation": [0], "SpatialOrder": order},
+	}
+
+# シーン名 -> (シーン, 位相を測るポートの間隔[m])
+SCENES = {
+	"grid2": (line(2, 1e-3, 60, 80, 8, (10, 25, 45), 600), 20e-3),
+	"grid4": (line(4, 1e-3, 60, 80, 8, (10, 25, 45), 600), 20e-3),
+	"fine2": (line(2, 0.5e-3, 120, 160, 16, (20, 50, 90), 1200), 20e-3),
+}
+
+# ポートの時間領域の出力から周波数成分の位相を求める
+def phase(path):
+	total = 0j
+	with open(path) as f:
+		for line in f:
+			values = line.split()
+			if 2 <= len(values):
+				total += float(values[1]) * cmath.exp(-2j * math.pi * FREQUENCY * float(values[0]))
+	return cmath.phase(total)
+
+# シーンをシミュレーションし、位相誤差[rad]を求める
+def runScene(args, scene, distance):
+	work = tempfile.mkdtemp(prefix="ffconvergence_")
+	try:
+		os.mkdir(os.path.join(work, "tmp"))
+		with open(os.path.join(work, "scene.mp"), 'wb') as f:
+			f.write(encode(scene))
+		with open(os.path.join(work, "solvers.ini"), 'w') as f:
+			f.write("[default]\nCPU = 1, 100\n")
+		command = [args.mpiexec] + args.mpiarg + ["-np", "1", os.path.abspath(args.solver), "-i", "scene.mp", "-o", "out", "-s", "solvers.ini"]
+		subprocess.run(command, cwd=work, input="\n", stdout=subprocess.DEVNULL, stderr=subprocess.STDOUT, universal_newlines=True, check=True)
+		error = phase(os.path.join(work, "tmp", "port1_td.txt")) - phase(os.path.join(work, "tmp", "port2_td.txt"))
+		error -= 2.0 * math.pi * FREQUENCY / LIGHT_SPEED * distance
+		return (error + math.pi) % (2.0 * math.pi) - math.pi
+	finally:
+		shutil.rmtree(work, ignore_errors=True)
+
+def main():
+	parser = argparse.ArgumentParser()
+	parser.add_argument("--solver", required=True, help="path to the FFSolver executable")
+	parser.add_argument("--mpiexec", default="mpiexec", help="MPI launcher")
+	parser.add_argument("--mpiarg", action="append", default=[], help="extra argument to the MPI launcher")
+	args = parser.parse_args()
+
+	errors = {}
+	for name, (scene, distance) in SCENES.items():
+		errors[name] = runScene(args, scene, distance)
+		print("%-6s %+.3f rad over %g mm" % (name, errors[name], distance * 1e3))
+
+	ok = abs(errors["grid4"]) <= abs(errors["fine2"])
+	print("order 4 at h %s order 2 at h/2" % ("matches" if ok else "FAILED to match"))
+	return 0 if ok else 1
+
+if __name__ == '__main__':
+	sys.exit(main())
@@ -0,0 +1,121 @@
+# 回帰テスト用のシーンをscenes/に作成する
+#
+# 入力ファイルはMessagePackで書き出す (外部モジュールを使わない最小限のエンコーダーを持つ)
+
+import os
+import struct
+
+# オブジェクトをMessagePackにエンコードする
+def encode(o):
+	if o is None:
+		return b'\xc0'
+	if o is True:
+		return b'\xc3'
+	if o is False:
+		return b'\xc2'
+	if isinstance(o, int):
+		if 0 <= o < 128:
+			return bytes([o])
+		if 0 <= o < 2**32:
+			return b'\xce' + struct.pack('>I', o)
+		return b'\xd3' + struct.pack('>q', o)
+	if isinstance(o, float):
+		return b'\xcb' + struct.pack('>d', o)
+	if isinstance(o, str):
+		b = o.encode()
+		return b'\xdb' + struct.pack('>I', len(b)) + b
+	if isinstance(o, (list, tuple)):
+		return b'\xdd' + struct.pack('>I', len(o)) + b''.join(encode(x) for x in o)
+	if isinstance(o, dict):
+		return b'\xdf' + struct.pack('>I', len(o)) + b''.join(encode(k) + encode(v) for k, v in o.items())
+	raise TypeError(o)
+
+# 励振波形 (50GHzの正弦波をガウス関数で変調する)
+PULSE = "exp(-((t-6e-11)/2e-11)^2)*sin(3.14159265e11*t)"
+
+# 24^3のPEC共振器 (50Ωのポート1つ、長時間の安定性を確認する)
+def cavity(order, iteration=20000, n=24):
+	d = 1e-3
+	return {
+		"Space": {"Grid": [[d]*n, [d]*n, [d]*n], "BoundaryCondition": ["PEC", "PEC", "PEC"]},
+		"Material": [{"Epsilon": 1.0}],
+		"Object": [],
+		"Port": [{"Type": "VoltageSource", "Position": [8, 10, 12], "Direction": "+Z", "ESR": 50.0, "Waveform": PULSE}],
+		"Solver": {"Timestep": "Auto", "Frequency": [1e10], "Iteration": iteration, "SpatialOrder": order},
+	}
+
+# 8層のPMLで囲んだ40^3の空間 (比誘電率4の立方体とポート2つ)
+def open_box(order, iteration=20000, n=40):
+	d = 1e-3
+	return {
+		"Space": {"Grid": [[d]*n, [d]*n, [d]*n], "BoundaryCondition": ["PML", "PML", "PML"], "PML": {"Layers": [8, 8, 8], "Order": 3.0, "R0": 1e-6}},
+		"Material": [{"Epsilon": 1.0}, {"Epsilon": 4.0}],
+		"Object": [{"Type": "Cuboid", "Material": 2, "Start": [18, 18, 18], "End": [24, 24, 24]}],
+		"Port": [
+			{"Type": "VoltageSource", "Position": [14, 20, 20], "Direction": "+Z", "ESR": 50.0, "Waveform": PULSE},
+			{"Type": "VoltageSource", "Position": [28, 20, 20], "Direction": "+Z", "ESR": 50.0, "Waveform": "0"},
+		],
+		"Solver": {"Timestep": "Auto", "Frequency": [1e10], "Iteration": iteration, "SpatialOrder": order},
+	}
+
+# 60x32x32の自由空間に並べたポート3つ (X方向に伝わる波の位相を比べる)
+def dispersion(order, iteration=600):
+	d = 1e-3
+	nx = 60
+	ny = 32
+	c = ny // 2
+	ports = [{"Type": "VoltageSource", "Position": [x, c, c], "Direction": "+Z", "ESR": 50.0, "Waveform": (PULSE if i == 0 else "0")} for i, x in enumerate((10, 25, 45))]
+	return {
+		"Space": {"Grid": [[d]*nx, [d]*ny, [d]*ny], "BoundaryCondition": ["PML", "PML", "PML"], "PML": {"Layers": [8, 8, 8], "Order": 3.0, "R0": 1e-6}},
+		"Material": [{"Epsilon": 1.0}],
+		"Object": [],
+		"Port": ports,
+		"Solver": {"Timestep": "Auto", "Frequency": [1e9], "Iteration": iteration, "Excitation": [0], "SpatialOrder": order},
+	}
+
+# 40^3の空間の誘電体とPECの線 (倍精度)
+def dielectric(order, iteration=400, n=40):
+	d = 1e-3
+	h = n // 2
+	return {
+		"Space": {"Grid": [[d]*n, [d]*n, [d]*n], "BoundaryCondition": ["PML", "PML", "PML"], "PML": {"Layers": [8, 8, 8], "Order": 3.0, "R0": 1e-6}},
+		"Material": [{"Epsilon": 4.0}],
+		"Object": [
+			{"Type": "Cuboid", "Material": 1, "Start": [h, h, h], "End": [h + 5, h + 5, h + 5]},
+			{"Type": "Cuboid", "Material": "PEC", "Start": [h - 3, h - 3, h - 6], "End": [h - 3, h - 3, h - 1]},
+		],
+		"Port": [{"Type": "VoltageSource", "Position": [h - 3, h - 3, h - 1], "Direction": "+Z", "ESR": 50.0, "Waveform": "exp(-((t-3e-11)/1e-11)^2)"}],
+		"Solver": {"Timestep": "Auto", "Frequency": [1e9], "Iteration": iteration, "SpatialOrder": order, "Precision": "Double"},
+	}
+
+# HIE法と4次精度の差分の組み合わせ (設定の誤りとして報告されるべきシーン)
+def hie_order4():
+	d = 0.2e-3
+	f = 10e-6
+	return {
+		"Space": {"Grid": [[d]*30, [d]*30, [d]*14 + [f]*4 + [d]*14], "BoundaryCondition": ["PML", "PML", "PML"],
+				  "PML": {"Layers": [8, 8, 8], "Order": 3.0, "R0": 1e-6, "Type": ["CPML", "CPML", "CPML"]}},
+		"Material": [],
+		"Object": [],
+		"Port": [{"Type": "VoltageSource", "Position": [15, 15, 14], "Direction": "+Z", "ESR": 50.0, "Waveform": "exp(-((t-6e-11)/2e-11)^2)"}],
+		"Solver": {"Timestep": "Auto", "Frequency": [1e9], "Iteration": 100, "Scheme": "HIE", "SpatialOrder": 4},
+	}
+
+SCENES = {
+	"c46_2": cavity(2),
+	"c46_4": cavity(4),
+	"p46_2": open_box(2),
+	"p46_4": open_box(4),
+	"d2": dispersion(2),
+	"d4": dispersion(4),
+	"o2d": dielectric(2),
+	"o4d": dielectric(4),
+	"hie4": hie_order4(),
+}
+
+if __name__ == '__main__':
+	directory = os.path.join(os.path.dirname(os.path.abspath(__file__)), "scenes")
+	os.makedirs(directory, exist_ok=True)
+	for name, scene in SCENES.items():
+		with open(os.path.join(directory, name + ".mp"), 'wb') as f:
+			f.write(encode(scene))
@@ -0,0 +1,171 @@
+# 回帰テストを実行する
+#
+# scenes/のシーンをプロセス数を変えながらシミュレーションし、ポートの出力をexpected.txtのハッシュと比べる
+# ポートの出力はプロセス数によらずビット単位で同じになるため、どのプロセス数でも同じハッシュと比べる
+# ハッシュはGCC (-O2 -march=native) でビルドしたx86-64のソルバーで記録したもので、
+# 別のコンパイラーや命令セットでは丸めの違いで一致しないことがある (そのときは--updateで記録し直し、プロセス数の間の一致を確認する)
+# "error"と記録したシーンは、設定の誤りが例外として報告され、プロセスが正常に終了することを確認する
+# 最後にデーモンモードで誤ったジョブと正しいジョブを順に投入し、誤ったジョブを失敗として完了させて次のジョブを処理することを確認する
+#
+# 使い方: python3 run_regression.py --solver <FFSolverのパス> [--np 1,3] [--mpiexec mpiexec] [--mpiarg <引数>] [--update] [シーン名...]
+
+import argparse
+import glob
+import hashlib
+import os
+import shutil
+import subprocess
+import sys
+import tempfile
+import time
+
+# 1回のシミュレーションの制限時間[s]
+TIMEOUT = 1200
+
+# このスクリプトのあるディレクトリ
+ROOT = os.path.dirname(os.path.abspath(__file__))
+
+# 期待値のファイルを読み込む (シーン名 -> ハッシュまたは"error")
+def loadExpected(path):
+	expected = {}
+	with open(path) as f:
+		for line in f:
+			line = line.split('#')[0].split()
+			if len(line) == 2:
+				expected[line[0]] = line[1]
+	return expected
+
+# 期待値のファイルを書き出す
+def saveExpected(path, expected):
+	with open(path, 'w') as f:
+		f.write("# シーン名とポートの出力のハッシュ (全ポートの時間領域の出力を番号順に連結したもののMD5の先頭8桁)\n")
+		f.write("# errorのシーンは設定の誤りとして報告されるべきもの\n")
+		for name in sorted(expected):
+			f.write("%s %s\n" % (name, expected[name]))
+
+# シーンを1回シミュレーションし、ポートの出力のハッシュとログを取得する
+def runScene(args, scene_path, np):
+	work = tempfile.mkdtemp(prefix="ffregression_")
+	try:
+		os.mkdir(os.path.join(work, "tmp"))
+		with open(os.path.join(work, "solvers.ini"), 'w') as f:
+			f.write("[default]\nCPU = 1, 100\n")
+		command = [args.mpiexec] + args.mpiarg + ["-np", str(np), os.path.abspath(args.solver), "-i", scene_path, "-o", "out", "-s", "solvers.ini"]
+		# 終了時のキー入力の待ちには改行を与える
+		result = subprocess.run(command, cwd=work, input="\n", stdout=subprocess.PIPE, stderr=subprocess.STDOUT, universal_newlines=True, timeout=TIMEOUT)
+		log = result.stdout
+		files = sorted(glob.glob(os.path.join(work, "tmp", "port*_td.txt")))
+		if not files or "An exception occured" in log or "terminate called" in log:
+			return None, log
+		md5 = hashlib.md5()
+		for path in files:
+			with open(path, 'rb') as f:
+				md5.update(f.read())
+		return md5.hexdigest()[:8], log
+	finally:
+		shutil.rmtree(work, ignore_errors=True)
+
+# デーモンモードで誤ったジョブの後に正しいジョブを処理できることを確認する
+def runDaemonCheck(args, np, bad_name, good_name, good_hash):
+	work = tempfile.mkdtemp(prefix="ffregression_")
+	try:
+		spool = os.path.join(work, "spool")
+		os.mkdir(spool)
+		with open(os.path.join(work, "solvers.ini"), 'w') as f:
+			f.write("[default]\nCPU = 1, 100\n")
+		# ジョブは名前順に取り出される
+		shutil.copy(os.path.join(ROOT, "scenes", bad_name + ".mp"), os.path.join(spool, "a_" + bad_name + ".mp"))
+		shutil.copy(os.path.join(ROOT, "scenes", good_name + ".mp"), os.path.join(spool, "b_" + good_name + ".mp"))
+		command = [args.mpiexec] + args.mpiarg + ["-np", str(np), os.path.abspath(args.solver), "-d", "spool", "-s", "solvers.ini"]
+		process = subprocess.Popen(command, cwd=work, stdin=subprocess.DEVNULL, stdout=subprocess.PIPE, stderr=subprocess.STDOUT, universal_newlines=True)
+
+		# 2つ目のジョブが完了したら終了を要求する
+		good_job = os.path.join(spool, "b_" + good_name + ".mp")
+		deadline = time.time() + TIMEOUT
+		while time.time() < deadline and process.poll() is None:
+			if os.path.exists(good_job + ".done") or os.path.exists(good_job + ".failed"):
+				break
+			time.sleep(0.2)
+		open(os.path.join(spool, "stop"), 'w').close()
+		try:
+			log = process.communicate(timeout=60)[0]
+		except subprocess.TimeoutExpired:
+			process.kill()
+			log = process.communicate()[0]
+
+		md5 = hashlib.md5()
+		for path in sorted(glob.glob(os.path.join(spool, "b_" + good_name + "_port*_td.txt"))):
+			with open(path, 'rb') as f:
+				md5.update(f.read())
+		ok = os.path.exists(os.path.join(spool, "a_" + bad_name + ".mp.failed")) and os.path.exists(good_job + ".done")
+		ok = ok and (process.returncode == 0) and ("terminate called" not in log) and ("Daemon stopped" in log)
+		ok = ok and (args.update or md5.hexdigest()[:8] == good_hash)
+		return ok, log
+	finally:
+		shutil.rmtree(work, ignore_errors=True)
+
+# ログの末尾を表示する
+def printLog(log, lines=10):
+	for line in log.splitlines()[-lines:]:
+		print("    " + line)
+
+def main():
+	parser = argparse.ArgumentParser()
+	parser.add_argument("--solver", required=True, help="path to the FFSolver executable")
+	parser.add_argument("--np", default="1,3", help="comma separated process counts")
+	parser.add_argument("--mpiexec", default="mpiexec", help="MPI launcher")
+	parser.add_argument("--mpiarg", action="append", default=[], help="extra argument to the MPI launcher")
+	parser.add_argument("--update", action="store_true", help="record the hashes of this run as expected")
+	parser.add_argument("scenes", nargs="*", help="scene names (default: all)")
+	args = parser.parse_args()
+
+	expected_path = os.path.join(ROOT, "expected.txt")
+	expected = loadExpected(expected_path)
+	names = args.scenes or sorted(os.path.splitext(os.path.basename(path))[0] for path in glob.glob(os.path.join(ROOT, "scenes", "*.mp")))
+	np_list = [int(np) for np in args.np.split(',')]
+
+	failures = 0
+	for name in names:
+		scene_path = os.path.join(ROOT, "scenes", name + ".mp")
+		hashes = []
+		for np in np_list:
+			digest, log = runScene(args, scene_path, np)
+			want = expected.get(name)
+			if want == "error":
+				# 例外として報告され、異常終了しないこと
+				ok = (digest is None) and ("An exception occured" in log) and ("terminate called" not in log)
+				print("%-8s np%d %s" % (name, np, "ok (error reported)" if ok else "FAILED (error not reported)"))
+			elif digest is None:
+				ok = False
+				print("%-8s np%d FAILED (no output)" % (name, np))
+			else:
+				hashes.append(digest)
+				ok = args.update or (digest == want)
+				print("%-8s np%d %s %s" % (name, np, digest, "ok" if ok else "FAILED (expected %s)" % want))
+			if not ok:
+				printLog(log)
+				failures += 1
+
+		# プロセス数によらず同じ出力となること
+		if 1 < len(set(hashes)):
+			print("%-8s FAILED (outputs differ between process counts)" % name)
+			failures += 1
+		elif args.update and hashes:
+			expected[name] = hashes[0]
+
+	# デーモンモードで誤ったジョブを失敗として完了させ、次のジョブを続けること
+	if not args.scenes:
+		for np in np_list:
+			ok, log = runDaemonCheck(args, np, "hie4", "d2", expected.get("d2"))
+			print("%-8s np%d %s" % ("daemon", np, "ok" if ok else "FAILED"))
+			if not ok:
+				printLog(log)
+				failures += 1
+
+	if args.update:
+		saveExpected(expected_path, expected)
+	print("%d failure(s)" % failures)
+	return 1 if 0 < failures else 0
+
+if __name__ == '__main__':
+	sys.exit(main())